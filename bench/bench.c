@@ -0,0 +1,438 @@
+// bench.c
+
+#include "../src/interpret/treewalk/comptime.h"
+#include "../src/interpret/treewalk/interpreter.h"
+#include "../src/interpret/vm/compiler.h"
+#include "../src/interpret/vm/vm.h"
+#include "../src/parser/declaration.h"
+#include "../src/parser/expression.h"
+#include "../src/parser/resolver.h"
+#include "../src/parser/type.h"
+#include "../src/util/intern.h"
+#include "../src/util/readfile.h"
+#include "corpus.h"
+#include <argp.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// every corpus is lexed, parsed and, if it's meant to run, run on both
+// interpreters, each the given number of times with the fastest one kept.
+// lexing and parsing are timed apart by doing what parse_file does in two
+// steps
+
+struct Options {
+  size_t scale;
+  size_t runs;
+  const char* dir;
+  const char* report;
+};
+
+static struct Options options = { 1, 3, "build/corpus", "build/bench.json" };
+
+enum Backend { BACKEND_TREEWALK, BACKEND_VM, BACKEND_FINAL };
+
+static const char* backend_names[BACKEND_FINAL] = { "treewalk", "vm" };
+
+struct Result {
+  const char* name;
+  size_t bytes, tokens, nodes, ops;
+  double lex, parse;            // seconds
+  double execute[BACKEND_FINAL];
+};
+
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double per_second(double amount, double seconds) {
+  return seconds > 0 ? amount / seconds : 0;
+}
+
+
+
+// ### COUNTING ### //
+
+static size_t nodes_in_expression(const struct Nodes*, uint32_t);
+static size_t nodes_in_type(const struct Nodes*, const struct Type*);
+
+static size_t nodes_in_vardecls(const struct Nodes* nodes,
+    const struct VarDeclList* list) {
+  size_t count = 0;
+  for(size_t i = 0; i < count_vardecls(list); i++)
+    count += 1 + nodes_in_type(nodes, list->members[i].lvalue.type)
+      + nodes_in_expression(nodes, list->members[i].rvalue);
+  return count;
+}
+
+static size_t nodes_in_types(const struct Nodes* nodes,
+    const struct TypeList* list) {
+  size_t count = 0;
+  for(size_t i = 0; list && i < list->size; i++)
+    count += nodes_in_type(nodes, list->members[i]);
+  return count;
+}
+
+static size_t nodes_in_type(const struct Nodes* nodes,
+    const struct Type* ast) {
+  if(!ast) return 0;
+
+  switch(ast->type) {
+    case TYPE_PRIMITIVE: return 1;
+    case TYPE_WRAPPER:   return 1 + nodes_in_type(nodes, ast->as.wrapper.type);
+    case TYPE_ARRAY:
+      return 1 + nodes_in_expression(nodes, ast->as.array.size)
+        + nodes_in_type(nodes, ast->as.array.type);
+    case TYPE_COMPOUND:
+      switch(ast->as.compound.type) {
+        case COMP_STRUCT:
+          return 1 + nodes_in_vardecls(nodes,
+              ast->as.compound.as._struct->fields);
+        case COMP_UNION:
+          return 1 + nodes_in_types(nodes,
+              ast->as.compound.as._union->fields);
+        case COMP_FUNC:
+          return 1 + nodes_in_vardecls(nodes, ast->as.compound.as.sig->args)
+            + nodes_in_type(nodes, ast->as.compound.as.sig->returns);
+      }
+  }
+  return 0;
+}
+
+static size_t nodes_in_statement(const struct Nodes* nodes,
+    const struct Statement* stmt) {
+  switch(stmt->type) {
+    case STMT_EXPR:
+    case STMT_BLOCK: return nodes_in_expression(nodes, stmt->as.expr);
+    case STMT_VAR:   return nodes_in_vardecls(nodes, stmt->as.var->vars);
+  }
+  return 0;
+}
+
+static size_t nodes_in_block(const struct Nodes* nodes, uint32_t ast) {
+  struct Block block = block_of(nodes, ast);
+  size_t count = 1 + nodes_in_expression(nodes, block.expr);
+
+  for(size_t i = 0; i < block.size; i++) {
+    struct Statement stmt = block_statement(nodes, &block, i);
+    count += nodes_in_statement(nodes, &stmt);
+  }
+
+  return count;
+}
+
+static size_t nodes_in_list(const struct Nodes* nodes, uint32_t at) {
+  struct ExprList list = list_at(nodes, at);
+  size_t count = 0;
+
+  for(size_t i = 0; i < list.size; i++)
+    count += nodes_in_expression(nodes, list_member(nodes, &list, i));
+  return count;
+}
+
+static size_t nodes_in_expression(const struct Nodes* nodes, uint32_t ast) {
+  if(!ast) return 0;
+
+  struct NodeData data = nodes->data[ast];
+
+  switch((enum ExprType)nodes->tags[ast]) {
+    case EXPR_LITERAL:
+    case EXPR_VARIABLE:    return 1;
+    case EXPR_UNARY:
+    case EXPR_GROUP:
+    case EXPR_FIELD:
+      return 1 + nodes_in_expression(nodes, data.lhs);
+    case EXPR_ARRAY_INIT:
+      return 1 + nodes_in_list(nodes, data.lhs);
+    case EXPR_CALL:
+      return 1 + nodes_in_expression(nodes, data.lhs)
+        + nodes_in_list(nodes, data.rhs);
+    case EXPR_BINARY:
+    case EXPR_ASSIGN:
+    case EXPR_ARRAY_INDEX:
+      return 1 + nodes_in_expression(nodes, data.lhs)
+        + nodes_in_expression(nodes, data.rhs);
+    case EXPR_CAST:
+      return 1 + nodes_in_expression(nodes, data.lhs)
+        + nodes_in_type(nodes, cast_of(nodes, ast).type);
+    case EXPR_BLOCK:       return nodes_in_block(nodes, ast);
+    case EXPR_IF:
+    case EXPR_WHILE: {
+      struct IfWhile ifwhile = ifwhile_of(nodes, ast);
+      return 1 + nodes_in_expression(nodes, ifwhile.condition)
+        + nodes_in_expression(nodes, ifwhile.body)
+        + nodes_in_expression(nodes, ifwhile.else_clause);
+    }
+    case EXPR_FOR: {
+      struct ForLoop loop = forloop_of(nodes, ast);
+      return 1 + nodes_in_statement(nodes, &loop.init)
+        + nodes_in_expression(nodes, loop.condition)
+        + nodes_in_expression(nodes, loop.step)
+        + nodes_in_expression(nodes, loop.body);
+    }
+  }
+  return 0;
+}
+
+static size_t nodes_in_ast(const struct AST* ast) {
+  const struct Nodes* nodes = &ast->nodes;
+  size_t count = 0;
+
+  for(size_t i = 0; i < ast->size; i++) {
+    const struct Declaration* decl = ast->members[i];
+    count += 1;
+
+    switch(decl->type) {
+      case DECL_VAR:
+        count += nodes_in_vardecls(nodes, decl->as.var->vars);
+        break;
+      case DECL_STRUCT:
+        count += nodes_in_vardecls(nodes, decl->as._struct->fields);
+        break;
+      case DECL_UNION:
+        count += nodes_in_types(nodes, decl->as._union->fields);
+        break;
+      case DECL_FUNC:
+        count += nodes_in_vardecls(nodes, decl->as.function->sig->args)
+          + nodes_in_type(nodes, decl->as.function->sig->returns)
+          + nodes_in_block(nodes, decl->as.function->body);
+        break;
+      case DECL_INC:
+        break;
+    }
+  }
+
+  return count;
+}
+
+
+
+// ### MEASURING ### //
+
+static void init_parser(struct Parser* parser, const char* filename,
+    const struct Source* source, struct AST* ast) {
+  parser->filename = filename;
+  parser->source = source->text;
+  parser->program_index = source->text;
+  parser->located = source->text;
+  parser->arena = &ast->arena;
+  parser->nodes = &ast->nodes;
+  NEW_VECTOR(&parser->pending);
+  NEW_VECTOR(&parser->decls);
+  NEW_VECTOR(&parser->types);
+  parser->row = 0; parser->col = 0;
+  parser->flags = 0;
+  parser->is_panic = false; parser->did_panic = false;
+}
+
+// the tree from the last run is kept to count and run
+static struct AST* measure_front(struct Result* result, const char* path) {
+  struct Source source = read_file(path);
+  struct AST* ast = NULL;
+
+  result->bytes = source.size;
+  result->lex = result->parse = 0;
+
+  for(size_t run = 0; run < options.runs; run++) {
+    if(ast) free_ast(ast);
+    ast = new_ast();
+
+    struct Parser parser;
+    init_parser(&parser, path, &source, ast);
+
+    double start = now();
+    tokenize(&parser, source.size);
+    double lexed = now();
+
+    parser.cursor = 0;
+    parser.current = token_at(&parser.tokens, 0);
+    while(!MATCH_TOKEN(&parser, EOF))
+      APPEND_VECTOR(ast, parse_declaration(&parser));
+    double parsed = now();
+
+    result->tokens = parser.tokens.size - 1;
+    free_tokens(&parser.tokens);
+    FREE_VECTOR(&parser.pending);
+    FREE_VECTOR(&parser.decls);
+    FREE_VECTOR(&parser.types);
+
+    if(parser.did_panic) {
+      free_ast(ast);
+      ast = NULL;
+      break;
+    }
+
+    if(!run || lexed - start < result->lex) result->lex = lexed - start;
+    if(!run || parsed - lexed < result->parse) result->parse = parsed - lexed;
+  }
+
+  close_file(&source);
+  if(ast) result->nodes = nodes_in_ast(ast);
+  return ast;
+}
+
+// what the program prints goes to /dev/null
+static double execute(enum Backend backend, struct AST* ast) {
+  struct Program* program = backend == BACKEND_VM ? compile_tree(ast) : NULL;
+  if(backend == BACKEND_VM && !program) return -1;
+
+  fflush(stdout);
+  int saved = dup(STDOUT_FILENO);
+  int null = open("/dev/null", O_WRONLY);
+  dup2(null, STDOUT_FILENO);
+  close(null);
+
+  double start = now();
+  if(backend == BACKEND_VM) run_program(program);
+  else walk_tree(ast, NULL);
+  fflush(stdout);
+  double seconds = now() - start;
+
+  dup2(saved, STDOUT_FILENO);
+  close(saved);
+  return seconds;
+}
+
+static bool measure(struct Result* result, enum CorpusKind kind) {
+  char path[4096];
+  snprintf(path, sizeof(path), "%s/%s.2c", options.dir, corpus_names[kind]);
+
+  FILE* out = fopen(path, "w");
+  if(!out) {
+    fprintf(stderr, "bench: can't write %s\n", path);
+    return false;
+  }
+  result->name = corpus_names[kind];
+  result->ops = generate_corpus(kind, options.scale, out);
+  fclose(out);
+
+  struct AST* ast = measure_front(result, path);
+  if(!ast) {
+    fprintf(stderr, "bench: %s doesn't parse\n", path);
+    return false;
+  }
+
+  for(size_t i = 0; i < BACKEND_FINAL; i++) result->execute[i] = 0;
+  if(result->ops) {
+    if(!resolve_ast(ast) || !evaluate_comptime(ast)) {
+      fprintf(stderr, "bench: %s doesn't resolve\n", path);
+      free_ast(ast);
+      return false;
+    }
+
+    for(size_t i = 0; i < BACKEND_FINAL; i++)
+      for(size_t run = 0; run < options.runs; run++) {
+        double seconds = execute(i, ast);
+        if(!run || seconds < result->execute[i]) result->execute[i] = seconds;
+      }
+  }
+
+  free_ast(ast);
+  return true;
+}
+
+
+
+// ### REPORTING ### //
+
+static void print_result(const struct Result* r) {
+  printf("%-10s %9.2f MB/s %12.0f tokens/s %12.0f nodes/s",
+      r->name, per_second(r->bytes / 1e6, r->lex),
+      per_second(r->tokens, r->lex), per_second(r->nodes, r->parse));
+
+  for(size_t i = 0; r->ops && i < BACKEND_FINAL; i++)
+    printf("  %s %.0f ops/s", backend_names[i],
+        per_second(r->ops, r->execute[i]));
+  printf("\n");
+}
+
+static bool write_report(const struct Result* results, size_t count) {
+  FILE* out = fopen(options.report, "w");
+  if(!out) return false;
+
+  fprintf(out, "{\n  \"scale\": %zu,\n  \"runs\": %zu,\n  \"corpora\": [\n",
+      options.scale, options.runs);
+
+  for(size_t i = 0; i < count; i++) {
+    const struct Result* r = &results[i];
+
+    fprintf(out, "    {\n      \"name\": \"%s\",\n", r->name);
+    fprintf(out, "      \"bytes\": %zu, \"tokens\": %zu, \"nodes\": %zu,\n",
+        r->bytes, r->tokens, r->nodes);
+    fprintf(out, "      \"lex_seconds\": %.9f, \"parse_seconds\": %.9f,\n",
+        r->lex, r->parse);
+    fprintf(out, "      \"lex_mb_per_second\": %.3f, "
+        "\"lex_tokens_per_second\": %.0f,\n",
+        per_second(r->bytes / 1e6, r->lex), per_second(r->tokens, r->lex));
+    fprintf(out, "      \"parse_nodes_per_second\": %.0f,\n",
+        per_second(r->nodes, r->parse));
+    fprintf(out, "      \"ops\": %zu,\n      \"execute\": {", r->ops);
+
+    for(size_t b = 0; r->ops && b < BACKEND_FINAL; b++)
+      fprintf(out, "%s\n        \"%s\": { \"seconds\": %.9f, "
+          "\"ops_per_second\": %.0f }", b ? "," : "", backend_names[b],
+          r->execute[b], per_second(r->ops, r->execute[b]));
+
+    fprintf(out, "%s}\n    }%s\n", r->ops ? "\n      " : "",
+        i + 1 < count ? "," : "");
+  }
+
+  fprintf(out, "  ]\n}\n");
+  return !fclose(out);
+}
+
+
+
+static int parseopt(int key, char* arg, struct argp_state* state) {
+  switch(key) {
+    case 's': options.scale = strtoul(arg, NULL, 10); break;
+    case 'r': options.runs = strtoul(arg, NULL, 10);  break;
+    case 'd': options.dir = arg;                      break;
+    case 'o': options.report = arg;                   break;
+    case ARGP_KEY_END:
+      if(!options.scale || !options.runs)
+        argp_failure(state, 1, 0, "the scale and runs must be at least 1");
+      break;
+  }
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  struct argp_option argp_options[] = {
+    { "scale", 's', "N", 0, "Make every corpus N times the default size", 0 },
+    { "runs", 'r', "N", 0, "Time everything N times and keep the fastest",
+      0 },
+    { "dir", 'd', "DIR", 0, "Write the corpora to DIR", 0 },
+    { "output", 'o', "FILE", 0, "Write the report to FILE, as json", 0 },
+    { 0 }
+  };
+  struct argp argp = { argp_options, parseopt, NULL,
+    "twonic benchmarks", NULL, NULL, NULL };
+  if(argp_parse(&argp, argc, argv, 0, NULL, NULL)) return 1;
+
+  mkdir(options.dir, 0755);
+
+  struct Result results[CORPUS_FINAL];
+  int status = 0;
+
+  for(size_t i = 0; i < CORPUS_FINAL; i++) {
+    if(!measure(&results[i], i)) {
+      status = 1;
+      break;
+    }
+    print_result(&results[i]);
+  }
+
+  if(!status && !write_report(results, CORPUS_FINAL)) {
+    fprintf(stderr, "bench: can't write %s\n", options.report);
+    status = 1;
+  }
+
+  intern_destroy();
+  return status;
+}
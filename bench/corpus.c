@@ -0,0 +1,177 @@
+// corpus.c
+
+#include "corpus.h"
+#include <stdint.h>
+
+const char* corpus_names[CORPUS_FINAL] = {
+  "nested", "functions", "tables", "loops",
+};
+
+// a fixed seed, so every corpus is the same from run to run
+static uint64_t seed;
+
+static size_t rng(size_t bound) {
+  seed = seed * 6364136223846793005u + 1442695040888963407u;
+  return (seed >> 33) % bound;
+}
+
+static const char* operators[] = { "+", "-", "*", "&", "|", "^" };
+#define OPERATORS (sizeof(operators) / sizeof(*operators))
+
+// what a for loop of n trips executes: n + 1 conditions, n steps, n bodies
+static size_t for_ops(size_t n, size_t body) {
+  return (n + 1) + n + n * body;
+}
+
+
+
+// one side of each operator is a leaf, so the depth grows with the size
+static void nested_expression(FILE* out, size_t depth) {
+  if(!depth) {
+    switch(rng(3)) {
+      case 0: fprintf(out, "a"); break;
+      case 1: fprintf(out, "b"); break;
+      case 2: fprintf(out, "%zu", rng(1000)); break;
+    }
+    return;
+  }
+
+  const char* op = operators[rng(OPERATORS)];
+  if(rng(2)) {
+    fprintf(out, "(");
+    nested_expression(out, depth - 1);
+    fprintf(out, " %s %zu)", op, rng(100));
+  } else {
+    fprintf(out, "(%zu %s ", rng(100), op);
+    nested_expression(out, depth - 1);
+    fprintf(out, ")");
+  }
+}
+
+static size_t generate_nested(size_t scale, FILE* out) {
+  for(size_t i = 0; i < 100 * scale; i++) {
+    fprintf(out, "function nested%zu(a: isize, b: isize) isize {\n", i);
+    for(size_t j = 0; j < 4; j++) {
+      fprintf(out, "  let x%zu = ", j);
+      nested_expression(out, 48);
+      fprintf(out, ";\n");
+    }
+    fprintf(out, "  x0 + x1 + x2 + x3\n}\n\n");
+  }
+
+  fprintf(out, "function main(void) isize {\n  0\n}\n");
+  return 0;
+}
+
+
+// each function executes 5 operators whichever way its branch goes
+#define FUNCTION_OPS 5
+#define CALLS 32
+
+static size_t generate_functions(size_t scale, FILE* out) {
+  size_t count = 2000 * scale;
+
+  for(size_t i = 0; i < count; i++)
+    fprintf(out,
+        "function f%zu(x: isize, y: isize) isize {\n"
+        "  let t = x * %zu + y;\n"
+        "  if ((t & %zu) == 0) { t ^ %zu } else { t + %zu }\n"
+        "}\n\n",
+        i, rng(1000) + 1, rng(15) + 1, rng(1 << 16), rng(1 << 16));
+
+  fprintf(out, "function main(void) isize {\n  let acc = 0;\n");
+  fprintf(out, "  for (let i = 0; i < %d; i += 1) {\n", CALLS);
+  for(size_t i = 0; i < count; i++)
+    fprintf(out, "    acc += f%zu(i, acc);\n", i);
+  fprintf(out, "  };\n  print(acc);\n  0\n}\n");
+
+  return for_ops(CALLS, count * (FUNCTION_OPS + 1));
+}
+
+
+static size_t generate_tables(size_t scale, FILE* out) {
+  for(size_t i = 0; i < 100 * scale; i++) {
+    fprintf(out, "let table%zu: [64]isize = [", i);
+    for(size_t j = 0; j < 64; j++)
+      fprintf(out, "%s%zu", j ? ", " : "", rng((size_t)1 << rng(40)));
+    fprintf(out, "];\n");
+  }
+  fprintf(out, "\n");
+
+  static const char* words[] = {
+    "lorem", "ipsum", "dolor", "sit", "amet", "consectetur", "adipiscing",
+    "elit", "sed", "do", "eiusmod", "tempor",
+  };
+  for(size_t i = 0; i < 1000 * scale; i++) {
+    fprintf(out, "let string%zu = \"", i);
+    for(size_t j = 0, n = rng(12) + 4; j < n; j++)
+      fprintf(out, "%s%s", j ? " " : "", words[rng(12)]);
+    fprintf(out, "\";\n");
+  }
+
+  fprintf(out, "\nfunction main(void) isize {\n  0\n}\n");
+  return 0;
+}
+
+
+// the kernels and what one trip through each executes
+static size_t generate_loops(size_t scale, FILE* out) {
+  size_t n = 200000 * scale, m = 100, rounds = 20 * scale;
+
+  fprintf(out,
+      "function mix(n: isize) isize {\n"
+      "  let acc = 1;\n"
+      "  for (let i = 0; i < n; i += 1) acc += (i * 3) ^ (acc >> 2);\n"
+      "  acc\n"
+      "}\n\n");
+  size_t ops = for_ops(n, 4);
+
+  fprintf(out,
+      "function count(n: isize) isize {\n"
+      "  let acc = 0;\n"
+      "  let i = 0;\n"
+      "  while (i < n) {\n"
+      "    acc = acc + (i & 7) * 5;\n"
+      "    i += 1;\n"
+      "  };\n"
+      "  acc\n"
+      "}\n\n");
+  ops += (n + 1) + n * 4;
+
+  fprintf(out,
+      "function grid(m: isize) isize {\n"
+      "  let acc = 0;\n"
+      "  for (let i = 0; i < m; i += 1)\n"
+      "    for (let j = 0; j < m; j += 1) acc += i * j + 1;\n"
+      "  acc\n"
+      "}\n\n");
+  ops += rounds * for_ops(m, for_ops(m, 3));
+
+  fprintf(out,
+      "function main(void) isize {\n"
+      "  print(mix(%zu));\n"
+      "  print(count(%zu));\n"
+      "  for (let r = 0; r < %zu; r += 1) print(grid(%zu));\n"
+      "  0\n"
+      "}\n", n, n, rounds, m);
+  ops += for_ops(rounds, 0);
+
+  return ops;
+}
+
+#undef FUNCTION_OPS
+#undef CALLS
+#undef OPERATORS
+
+size_t generate_corpus(enum CorpusKind kind, size_t scale, FILE* out) {
+  seed = 0x2c2c2c2c + kind;
+
+  switch(kind) {
+    case CORPUS_NESTED:    return generate_nested(scale, out);
+    case CORPUS_FUNCTIONS: return generate_functions(scale, out);
+    case CORPUS_TABLES:    return generate_tables(scale, out);
+    case CORPUS_LOOPS:     return generate_loops(scale, out);
+    case CORPUS_FINAL:     break;
+  }
+  return 0;
+}
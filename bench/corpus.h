@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdio.h>
+
+// synthetic programs for the benchmarks. each kind stresses one thing, grows
+// linearly with the scale, and comes out the same on every run, so reports
+// from different builds can be compared
+
+enum CorpusKind {
+  CORPUS_NESTED,    // deeply nested arithmetic
+  CORPUS_FUNCTIONS, // thousands of small functions, all called from main
+  CORPUS_TABLES,    // long tables of numbers and strings
+  CORPUS_LOOPS,     // loop heavy kernels
+  CORPUS_FINAL,
+};
+
+extern const char* corpus_names[CORPUS_FINAL];
+
+// writes the program and returns how many operations running it executes,
+// counting every binary operator and compound assignment, or 0 if it's only
+// meant to be lexed and parsed
+size_t generate_corpus(enum CorpusKind, size_t scale, FILE*);
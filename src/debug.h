@@ -4,6 +4,11 @@
 #define FLAG_LEX   2
 #define FLAG_AST   4
 #define FLAG_BC    8
+#define FLAG_ASM   16
+#define FLAG_EMIT_C 32
+#define FLAG_NO_CACHE 64
+#define FLAG_TIME_PASSES 128
+#define FLAG_MEM_STATS 256
 
 #define HAS_FLAG(x, y) ((x & y) == y)
 #define GET_STAGE(x) \
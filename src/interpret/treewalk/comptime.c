@@ -0,0 +1,372 @@
+// comptime.c
+
+#include "comptime.h"
+#include "ctx.h"
+#include "expression.h"
+#include "../../util/stats.h"
+#include <stdio.h>
+
+// expressions are folded bottom up by the tree walker, running in a sandbox
+// that rejects anything reaching outside the expression, so what can't be
+// folded is left for run time exactly as it was
+//
+// a global that folds to a literal and is never assigned is a constant, and
+// its uses become the literal. that only happens when the declared type is
+// one the literal already is, so no backend reads it differently
+
+// steps a single expression may take before it's given up on
+#define FUEL 10000
+
+struct Comptime {
+  struct Interpreter sandbox;
+  struct Value* constants; // by global slot, undefined if not a constant
+  const char** names;      // of the constants, for array sizes
+  bool* assigned;          // by global slot
+  size_t globals;
+  bool marking;            // only finding assigned globals
+  const char* file;        // of the declaration being folded
+  bool had_error;
+};
+
+
+static void comptime_error(struct Comptime* c, uint32_t ast,
+    const char* name) {
+  c->had_error = true;
+
+  print_error_at(c->file, c->sandbox.nodes->offsets[ast]);
+  printf(" at \"%s\"\n", name);
+  print_error_message(PARSE_ERROR_CODES + ERROR_NOT_CONSTANT,
+      error_strings[ERROR_NOT_CONSTANT]);
+}
+
+
+static bool is_literal(const struct Nodes* nodes, uint32_t ast) {
+  return nodes->tags[ast] == EXPR_LITERAL
+    && nodes->ops[ast] != VAL_IDENTIFIER;
+}
+
+// a missing operand doesn't keep an expression from folding
+static bool is_folded(const struct Nodes* nodes, uint32_t ast) {
+  return !ast || is_literal(nodes, ast);
+}
+
+static bool is_folded_statement(const struct Nodes* nodes,
+    const struct Statement* stmt) {
+  return stmt->type != STMT_VAR && is_folded(nodes, stmt->as.expr);
+}
+
+static bool is_foldable(const struct Value* value) {
+  switch(value->type) {
+    case VAL_INT:
+    case VAL_BOOL:
+    case VAL_CHAR:
+    case VAL_STRING: return true;
+    default:         return false;
+  }
+}
+
+static bool holds_as_is(const struct Type* type, const struct Value* value) {
+  if(!type) return true;
+  if(type->type != TYPE_PRIMITIVE) return false;
+
+  switch(type->as.primitive) {
+    case TOKEN_USIZE:
+    case TOKEN_UINT64: return value->type == VAL_INT;
+    case TOKEN_BOOL:   return value->type == VAL_BOOL;
+    case TOKEN_CHAR:   return value->type == VAL_CHAR;
+    default:           return false;
+  }
+}
+
+// identifiers are only left unresolved in types, where they can name a
+// constant
+static const struct Value* constant_named(const struct Comptime* c,
+    const char* name) {
+  for(size_t i = c->globals; i > 0; i--)
+    if(c->names[i - 1] == name) return &c->constants[i - 1];
+  return NULL;
+}
+
+// && and || give back one of their operands, which the backends type by
+// the left one, so they are only folded when both agree
+static void try_fold(struct Comptime* c, uint32_t ast) {
+  struct Nodes* nodes = c->sandbox.nodes;
+
+  if(nodes->tags[ast] == EXPR_BINARY && (nodes->ops[ast] == TOKEN_LOGIC_AND
+        || nodes->ops[ast] == TOKEN_LOGIC_OR)) {
+    struct Binary binary = binary_of(nodes, ast);
+    if(!is_literal(nodes, binary.left) || !is_literal(nodes, binary.right)
+        || nodes->ops[binary.left] != nodes->ops[binary.right])
+      return;
+  }
+
+  c->sandbox.fuel = FUEL;
+  struct Value value = walk_expression(ast, &c->sandbox);
+
+  if(c->sandbox.flow != FLOW_NORMAL) c->sandbox.flow = FLOW_NORMAL;
+  else if(is_foldable(&value)) set_literal(nodes, ast, value);
+}
+
+
+static void fold_expression(struct Comptime*, uint32_t);
+static void fold_block(struct Comptime*, uint32_t);
+static void fold_vardecls(struct Comptime*, struct VarDeclList*);
+static void fold_types(struct Comptime*, struct TypeList*, const char*);
+
+static void fold_type(struct Comptime* c, struct Type* ast,
+    const char* name) {
+  if(!ast) return;
+
+  switch(ast->type) {
+    case TYPE_PRIMITIVE: break;
+    case TYPE_WRAPPER:
+      fold_type(c, ast->as.wrapper.type, name);
+      break;
+    case TYPE_ARRAY:
+      // a missing size is a slice
+      if(ast->as.array.size) {
+        fold_expression(c, ast->as.array.size);
+        if(!c->marking && (!is_literal(c->sandbox.nodes, ast->as.array.size)
+              || c->sandbox.nodes->ops[ast->as.array.size] != VAL_INT))
+          comptime_error(c, ast->as.array.size, name);
+      }
+      fold_type(c, ast->as.array.type, name);
+      break;
+    case TYPE_COMPOUND:
+      switch(ast->as.compound.type) {
+        case COMP_STRUCT:
+          fold_vardecls(c, ast->as.compound.as._struct->fields);
+          break;
+        case COMP_UNION:
+          fold_types(c, ast->as.compound.as._union->fields, name);
+          break;
+        case COMP_FUNC:
+          fold_vardecls(c, ast->as.compound.as.sig->args);
+          fold_type(c, ast->as.compound.as.sig->returns, name);
+          break;
+      }
+      break;
+  }
+}
+
+static void fold_vardecls(struct Comptime* c, struct VarDeclList* list) {
+  for(size_t i = 0; i < count_vardecls(list); i++) {
+    struct VarDecl* var = &list->members[i];
+    fold_type(c, var->lvalue.type, var->lvalue.name);
+    if(var->rvalue) fold_expression(c, var->rvalue);
+  }
+}
+
+static void fold_types(struct Comptime* c, struct TypeList* list,
+    const char* name) {
+  for(size_t i = 0; list && i < list->size; i++)
+    fold_type(c, list->members[i], name);
+}
+
+static void fold_statement(struct Comptime* c, const struct Statement* ast) {
+  switch(ast->type) {
+    case STMT_EXPR:  fold_expression(c, ast->as.expr); break;
+    case STMT_BLOCK: fold_block(c, ast->as.block);     break;
+    case STMT_VAR:   fold_vardecls(c, ast->as.var->vars); break;
+  }
+}
+
+static void fold_block(struct Comptime* c, uint32_t ast) {
+  struct Block block = block_of(c->sandbox.nodes, ast);
+
+  for(size_t i = 0; i < block.size; i++) {
+    struct Statement stmt = block_statement(c->sandbox.nodes, &block, i);
+    fold_statement(c, &stmt);
+  }
+  if(block.expr) fold_expression(c, block.expr);
+}
+
+static void fold_list(struct Comptime* c, uint32_t at) {
+  struct ExprList list = list_at(c->sandbox.nodes, at);
+  for(size_t i = 0; i < list.size; i++)
+    fold_expression(c, list_member(c->sandbox.nodes, &list, i));
+}
+
+// the operands first, then the expression itself if they all folded. only
+// an expression whose operands are literals is walked, so every node is
+// walked at most once and folding stays linear
+static void fold_expression(struct Comptime* c, uint32_t ast) {
+  if(!ast) return;
+
+  struct Nodes* nodes = c->sandbox.nodes;
+  struct NodeData data = nodes->data[ast];
+  bool folded;
+
+  switch((enum ExprType)nodes->tags[ast]) {
+    case EXPR_LITERAL: {
+      const struct Value* constant;
+      if(!c->marking && is_identifier(nodes, ast)
+          && (constant = constant_named(c, literal_of(nodes, ast).as.string))
+          && constant->type != VAL_UNDEFINED)
+        set_literal(nodes, ast, *constant);
+      return;
+    }
+    case EXPR_VARIABLE: {
+      struct VarRef ref = variable_of(nodes, ast);
+      if(!c->marking && ref.depth == 1
+          && c->constants[ref.slot].type != VAL_UNDEFINED)
+        set_literal(nodes, ast, c->constants[ref.slot]);
+      return;
+    }
+    case EXPR_UNARY:
+    case EXPR_GROUP:
+      fold_expression(c, data.lhs);
+      folded = is_literal(nodes, data.lhs);
+      break;
+    case EXPR_BINARY:
+      fold_expression(c, data.lhs);
+      fold_expression(c, data.rhs);
+      folded = is_literal(nodes, data.lhs) && is_literal(nodes, data.rhs);
+      break;
+    case EXPR_ASSIGN:
+      if(c->marking && nodes->tags[data.lhs] == EXPR_VARIABLE
+          && variable_of(nodes, data.lhs).depth == 1)
+        c->assigned[variable_of(nodes, data.lhs).slot] = true;
+      else fold_expression(c, data.lhs);
+      fold_expression(c, data.rhs);
+      return;
+    case EXPR_CALL:
+      // functions are called by name, so a plain callee is left alone
+      if(nodes->tags[data.lhs] != EXPR_LITERAL)
+        fold_expression(c, data.lhs);
+      fold_list(c, data.rhs);
+      return;
+    case EXPR_FIELD:
+      fold_expression(c, data.lhs);
+      return;
+    case EXPR_ARRAY_INIT:
+      fold_list(c, data.lhs);
+      return;
+    case EXPR_ARRAY_INDEX:
+      fold_expression(c, data.lhs);
+      fold_expression(c, data.rhs);
+      return;
+    case EXPR_CAST:
+      fold_expression(c, data.lhs);
+      fold_type(c, cast_of(nodes, ast).type, "as");
+      return;
+    case EXPR_BLOCK: {
+      fold_block(c, ast);
+      struct Block block = block_of(nodes, ast);
+      folded = is_folded(nodes, block.expr);
+      for(size_t i = 0; folded && i < block.size; i++) {
+        struct Statement stmt = block_statement(nodes, &block, i);
+        folded = is_folded_statement(nodes, &stmt);
+      }
+      break;
+    }
+    case EXPR_IF:
+    case EXPR_WHILE: {
+      struct IfWhile ifwhile = ifwhile_of(nodes, ast);
+      fold_expression(c, ifwhile.condition);
+      fold_expression(c, ifwhile.body);
+      fold_expression(c, ifwhile.else_clause);
+      folded = is_literal(nodes, ifwhile.condition)
+        && is_folded(nodes, ifwhile.body)
+        && is_folded(nodes, ifwhile.else_clause);
+      break;
+    }
+    case EXPR_FOR: {
+      struct ForLoop loop = forloop_of(nodes, ast);
+      fold_statement(c, &loop.init);
+      fold_expression(c, loop.condition);
+      fold_expression(c, loop.step);
+      fold_expression(c, loop.body);
+      folded = is_folded_statement(nodes, &loop.init)
+        && is_folded(nodes, loop.condition) && is_folded(nodes, loop.step)
+        && is_folded(nodes, loop.body);
+      break;
+    }
+  }
+
+  if(!c->marking && folded) try_fold(c, ast);
+}
+
+
+static void fold_globals(struct Comptime* c, struct Variable* ast) {
+  for(size_t i = 0; i < ast->vars->size; i++) {
+    struct LValue* lvalue = &ast->vars->members[i].lvalue;
+    uint32_t rvalue = ast->vars->members[i].rvalue;
+
+    fold_type(c, lvalue->type, lvalue->name);
+    if(!rvalue) continue;
+    fold_expression(c, rvalue);
+
+    struct Value literal = literal_of(c->sandbox.nodes, rvalue);
+    if(!c->marking && is_literal(c->sandbox.nodes, rvalue)
+        && !c->assigned[lvalue->slot] && is_foldable(&literal)
+        && holds_as_is(lvalue->type, &literal)) {
+      c->constants[lvalue->slot] = literal;
+      c->names[lvalue->slot] = lvalue->name;
+    }
+  }
+}
+
+static void fold_function(struct Comptime* c, struct Function* ast) {
+  fold_vardecls(c, ast->sig->args);
+  fold_type(c, ast->sig->returns, ast->sig->name);
+  fold_block(c, ast->body);
+}
+
+// globals first, in order, since a function can use any of them
+static void fold_declarations(struct Comptime* c, struct AST* ast) {
+  for(size_t i = 0; i < ast->size; i++)
+    if(ast->members[i]->type == DECL_VAR) {
+      c->file = ast->members[i]->file;
+      fold_globals(c, ast->members[i]->as.var);
+    }
+
+  for(size_t i = 0; i < ast->size; i++) {
+    struct Declaration* decl = ast->members[i];
+    c->file = decl->file;
+
+    switch(decl->type) {
+      case DECL_FUNC:
+        fold_function(c, decl->as.function);
+        break;
+      case DECL_STRUCT:
+        fold_vardecls(c, decl->as._struct->fields);
+        break;
+      case DECL_UNION:
+        fold_types(c, decl->as._union->fields, decl->as._union->name);
+        break;
+      case DECL_VAR:
+      case DECL_INC:
+        break;
+    }
+  }
+}
+
+bool evaluate_comptime(struct AST* ast) {
+  struct Comptime c = {
+    .globals = ast->globals, .marking = true, .file = NULL,
+    .had_error = false,
+  };
+
+  size_t count = ast->globals ? ast->globals : 1;
+  c.constants = stats_malloc(count * sizeof(*c.constants));
+  c.names = stats_calloc(count, sizeof(*c.names));
+  c.assigned = stats_calloc(count, sizeof(*c.assigned));
+  for(size_t i = 0; i < ast->globals; i++) c.constants[i] = UNDEFINED_VAL;
+
+  init_interpreter(&c.sandbox, 0);
+  c.sandbox.nodes = &ast->nodes;
+  c.sandbox.sandboxed = true;
+
+  // anything assigned anywhere isn't a constant, even before the assignment
+  fold_declarations(&c, ast);
+  c.marking = false;
+  fold_declarations(&c, ast);
+
+  free_interpreter(&c.sandbox);
+  free(c.constants);
+  free(c.names);
+  free(c.assigned);
+
+  return !c.had_error;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include "../../parser/parser.h"
+
+// reduces what can be known before the program runs to literals: constant
+// expressions, global initializers and array sizes. returns false, with the
+// errors printed, if an array size isn't a constant
+bool evaluate_comptime(struct AST*);
@@ -2,39 +2,57 @@
 
 #include "ctx.h"
 #include "../../util/panic.h"
-
-void push_frame(struct Interpreter* ctx, const char* func) {
-  struct Frame frame;
-  frame.function = func;
-  hm_init(&frame.variables);
-
-  APPEND_ARRAYLIST(&ctx->frames, frame);
+#include "../../util/stats.h"
+
+void init_interpreter(struct Interpreter* ctx, size_t globals) {
+  NEW_VECTOR(&ctx->frames);
+  ctx->stack = stats_malloc(VALUE_STACK_SIZE * sizeof(*ctx->stack));
+  ctx->top = ctx->stack;
+  ctx->globals = stats_calloc(globals ? globals : 1, sizeof(*ctx->globals));
+  hm_init(&ctx->functions);
+  ctx->flow = FLOW_NORMAL;
+  ctx->sandboxed = false;
+  ctx->fuel = 0;
+  ctx->profile = NULL;
+  ctx->nodes = NULL;
 }
 
-struct Frame* peek_frame(struct Interpreter* ctx, size_t index) {
-  return &ctx->frames.members[index];
+void free_interpreter(struct Interpreter* ctx) {
+  FREE_VECTOR(&ctx->frames);
+  free(ctx->stack);
+  free(ctx->globals);
+  hm_destroy(&ctx->functions);
 }
 
-struct Frame* peek_current(struct Interpreter* ctx) {
-  return peek_frame(ctx, ctx->frames.size - 1);
+void push_value(struct Interpreter* ctx, struct Value value) {
+  if(ctx->top >= ctx->stack + VALUE_STACK_SIZE) panic(1, "stack overflow");
+  *ctx->top++ = value;
 }
 
-void pop_frame(struct Interpreter* ctx) {
-  hm_destroy(&peek_current(ctx)->variables);
-}
+// the arguments were already pushed by the caller and become the first slots
+void push_frame(struct Interpreter* ctx, const struct Function* function,
+    uint32_t call, size_t args) {
+  size_t slots = function->slots;
 
-void set_variable(struct Interpreter* ctx, const char* name,
-    struct Value* value) {
-  hm_set(&peek_current(ctx)->variables, name, (uintptr_t)value);
+  struct Frame frame;
+  frame.function = function;
+  frame.call = call;
+  frame.slots = ctx->top - args;
+
+  if(frame.slots + slots > ctx->stack + VALUE_STACK_SIZE)
+    panic(1, "stack overflow");
+
+  for(ctx->top = frame.slots + args; ctx->top < frame.slots + slots;)
+    *ctx->top++ = UNDEFINED_VAL;
+
+  APPEND_VECTOR(&ctx->frames, frame);
 }
 
-struct Value* get_variable(struct Interpreter* ctx, const char* name) {
-  for(size_t i = ctx->frames.size; i >= 0; i--) {
-    struct Value* value =
-      (struct Value*)hm_get(&peek_frame(ctx, i)->variables, name);
-      if(value) return value;
-  }
+void pop_frame(struct Interpreter* ctx) {
+  ctx->top = ctx->frames.members[--ctx->frames.size].slots;
+}
 
-  panic(1, "no variable with that name");
-  return NULL;
+struct Value* get_variable(struct Interpreter* ctx, const struct VarRef* ref) {
+  if(ref->depth) return &ctx->globals[ref->slot];
+  return &ctx->frames.members[ctx->frames.size - 1].slots[ref->slot];
 }
@@ -2,24 +2,61 @@
 
 #include "../../value.h"
 #include "../../util/hash.h"
-#include "../../util/arraylist.h"
+#include "../../util/vector.h"
+#include "../../parser/declaration.h"
+#include "../../parser/expression.h"
 #include "../../parser/type.h"
+#include "profile.h"
+
+#define VALUE_STACK_SIZE (1 << 16)
 
 struct Var {
   struct Type* type;
   struct Value value;
 };
 
+// a frame's variables are a window into the interpreter's value stack, one
+// slot per local as numbered by the resolver
 struct Frame {
-  const char* function;
-  struct HashMap variables;
+  const struct Function* function;
+  uint32_t call; // the node in the caller, or 0 for main
+  struct Value* slots;
 };
 
-DEFINE_ARRAYLIST(StackFrames, struct Frame);
+// deep enough for most programs' calls never to leave it
+DEFINE_VECTOR(StackFrames, struct Frame, 32);
+
+// how control leaves an expression early; set by return, break and continue
+// and cleared by whatever catches it. a sandboxed evaluation that has to
+// give up is rejected, which nothing catches
+enum Flow { FLOW_NORMAL, FLOW_BREAK, FLOW_CONTINUE, FLOW_RETURN, FLOW_REJECT };
 
 struct Interpreter {
+  struct Nodes* nodes; // of the ast being walked
   struct StackFrames frames;
+  struct Value* stack;
+  struct Value* top;
+  struct Value* globals;
+  struct HashMap functions; // name -> struct Function*
+
+  enum Flow flow;
+  struct Value flow_value;
+
+  // set while evaluating at compile time: touching a variable, calling,
+  // printing, jumping out, failing, or taking more than fuel steps rejects
+  // the expression instead
+  bool sandboxed;
+  size_t fuel;
+
+  struct Profile* profile; // NULL unless profiling
 };
 
-void push_frame(struct Interpreter*, const char*);
+void init_interpreter(struct Interpreter*, size_t);
+void free_interpreter(struct Interpreter*);
+
+void push_value(struct Interpreter*, struct Value);
+void push_frame(struct Interpreter*, const struct Function*, uint32_t,
+    size_t);
 void pop_frame(struct Interpreter*);
+
+struct Value* get_variable(struct Interpreter*, const struct VarRef*);
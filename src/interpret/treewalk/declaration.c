@@ -2,26 +2,69 @@
 
 #include "expression.h"
 #include "declaration.h"
+#include "../../parser/parser.h"
+#include "../../util/panic.h"
+#include "../../util/trace.h"
 
-static void walk_function(struct Function* ast, struct Interpreter* ctx) {
-  push_frame(ctx, ast->sig->name ? : "<anonymous function>");
+struct Value call_function(struct Function* ast, uint32_t call, size_t args,
+    struct Interpreter* ctx) {
+  if(ctx->profile) profile_enter(ctx->profile, ast);
+  uint64_t start = trace_begin();
+  push_frame(ctx, ast, call, args);
 
-  // set the arguments to values in the hashmap
-  // walk_vardecls(ctx, ast->sig->args);
-
-  struct Value* returned = walk_block(ast->body, ctx);
   // TODO: typecheck returned value and return it if its poggers
+  struct Value returned = walk_block(ast->body, ctx);
+
+  switch(ctx->flow) {
+    case FLOW_NORMAL:
+    case FLOW_REJECT: break;
+    case FLOW_RETURN:
+      returned = ctx->flow_value;
+      ctx->flow = FLOW_NORMAL;
+      break;
+    case FLOW_BREAK:
+    case FLOW_CONTINUE:
+      panic(1, "break or continue outside of a loop");
+  }
 
   pop_frame(ctx);
+  trace_end("call", ast->sig->name, start);
+  if(ctx->profile) profile_leave(ctx->profile);
+  return returned;
+}
+
+// a name is only ever given to one function; a second is reported at both
+// definitions instead of quietly replacing the first
+static bool define_function(struct Function* ast, struct Interpreter* ctx) {
+  const char* name = ast->sig->name;
+  struct Function* first = (struct Function*)hm_get(&ctx->functions, name);
+  if(!first) {
+    hm_set(&ctx->functions, name, (uintptr_t)ast);
+    return true;
+  }
+
+  print_error_at(ast->file, ctx->nodes->offsets[ast->body]);
+  printf(" at \"%s\"\n", name);
+  print_error_message(PARSE_ERROR_CODES + ERROR_REDEFINED_FUNCTION,
+      error_strings[ERROR_REDEFINED_FUNCTION]);
+  print_error_also("first defined", first->file,
+      ctx->nodes->offsets[first->body]);
+  return false;
 }
 
-void walk_declaration(struct Declaration* ast, struct Interpreter* ctx) {
+bool walk_declaration(struct Declaration* ast, struct Interpreter* ctx) {
   switch(ast->type) {
     case DECL_VAR:
+      walk_variable(ast->as.var, ctx->globals, ctx);
+      break;
+    case DECL_FUNC:
+      if(ast->as.function->sig->name)
+        return define_function(ast->as.function, ctx);
+      break;
     case DECL_STRUCT:
     case DECL_UNION:
-    case DECL_FUNC:   return walk_function(ast->as.function, ctx);
     case DECL_INC:
       break;
   }
+  return true;
 }
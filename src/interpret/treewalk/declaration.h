@@ -3,4 +3,8 @@
 #include "ctx.h"
 #include "../../parser/declaration.h"
 
-void walk_declaration(struct Declaration*, struct Interpreter*);
+// false if it defines a function that already is
+bool walk_declaration(struct Declaration*, struct Interpreter*);
+// call is where it was called from, for the sampling profiler
+struct Value call_function(struct Function*, uint32_t, size_t,
+    struct Interpreter*);
@@ -1,142 +1,399 @@
 // expression.c
 
 #include "expression.h"
+#include "declaration.h"
+#include "sample.h"
+#include "../../util/intern.h"
+#include "../../util/panic.h"
 #include <stdio.h>
-#include <string.h>
 
 
-static struct Value* walk_literal(struct Expression* ast,
-    struct Interpreter* ctx) {
-  struct Value* value = malloc(sizeof(*value));
+static struct Value reject(struct Interpreter* ctx) {
+  ctx->flow = FLOW_REJECT;
+  return UNDEFINED_VAL;
+}
 
-  value->type = ast->as.literal.type;
-  value->as = ast->as.literal.as;
 
-  return value;
-}
+// return and break carry their operand out in ctx->flow_value
+static struct Value walk_jump(const struct Unary* ast, struct Interpreter* ctx,
+    enum Flow flow) {
+  if(ctx->sandboxed) return reject(ctx);
+
+  struct Value value = UNDEFINED_VAL;
+  if(flow != FLOW_CONTINUE) value = walk_expression(ast->operand, ctx);
 
+  if(ctx->flow == FLOW_NORMAL) {
+    ctx->flow = flow;
+    ctx->flow_value = value;
+  }
+
+  return UNDEFINED_VAL;
+}
 
-static struct Value* walk_binary(struct Binary* ast,
+static struct Value walk_unary(const struct Unary* ast,
     struct Interpreter* ctx) {
-  struct Value* left = walk_expression(ast->left, ctx);
-  struct Value* right = walk_expression(ast->right, ctx);
+  switch(ast->op) {
+    case TOKEN_RETURN:   return walk_jump(ast, ctx, FLOW_RETURN);
+    case TOKEN_BREAK:    return walk_jump(ast, ctx, FLOW_BREAK);
+    case TOKEN_CONTINUE: return walk_jump(ast, ctx, FLOW_CONTINUE);
+    default: break;
+  }
+
+  struct Value operand = walk_expression(ast->operand, ctx);
 
   switch(ast->op) {
-    case TOKEN_LOGIC_AND:
-    case TOKEN_LOGIC_OR:
+    case TOKEN_SUB:
+      if(MATCH_VAL(&operand, INT)) return INT_VAL(-FROM_INT(&operand));
+      if(MATCH_VAL(&operand, FLOAT)) return FLOAT_VAL(-operand.as.floating);
+      break;
+    case TOKEN_BIT_NOT:
+    case TOKEN_LOGIC_NOT:
+      if(MATCH_VAL(&operand, INT)) return INT_VAL(~FROM_INT(&operand));
+      return BOOL_VAL(!is_truthy(&operand));
+    default: break;
+  }
+
+  return UNDEFINED_VAL;
+}
 
-    case TOKEN_CATCH:
-    case TOKEN_ORELSE:
-    case TOKEN_AS:
 
-    case TOKEN_NOT_EQ:
-    case TOKEN_EQ:
+static struct Value walk_logic(const struct Binary* ast,
+    struct Interpreter* ctx) {
+  struct Value left = walk_expression(ast->left, ctx);
 
+  if(is_truthy(&left) == (ast->op == TOKEN_LOGIC_OR)) return left;
+  return walk_expression(ast->right, ctx);
+}
+
+
+// like the vm, > and >= are < and <= the other way around
+static bool arith_of(enum TokenType op, enum Arith* arith) {
+  switch(op) {
+    case TOKEN_NOT_EQ:   *arith = ARITH_NE;  return true;
+    case TOKEN_EQ:       *arith = ARITH_EQ;  return true;
     case TOKEN_LT:
+    case TOKEN_GT:       *arith = ARITH_LT;  return true;
     case TOKEN_LT_EQ:
-    case TOKEN_GT:
-    case TOKEN_GT_EQ:
+    case TOKEN_GT_EQ:    *arith = ARITH_LE;  return true;
+    case TOKEN_ADD:
+    case TOKEN_ADD_WRAP: *arith = ARITH_ADD; return true;
+    case TOKEN_SUB:
+    case TOKEN_SUB_WRAP: *arith = ARITH_SUB; return true;
+    case TOKEN_MUL:
+    case TOKEN_MUL_WRAP: *arith = ARITH_MUL; return true;
+    case TOKEN_DIV:      *arith = ARITH_DIV; return true;
+    case TOKEN_MOD:      *arith = ARITH_MOD; return true;
+    default:             return false;
+  }
+}
+
+// anything but two ints goes the way the vm's does
+static struct Value binary_slow(enum TokenType op, const struct Value* x,
+    const struct Value* y, struct Interpreter* ctx) {
+  if(op == TOKEN_GT || op == TOKEN_GT_EQ) {
+    const struct Value* left = x;
+    x = y;
+    y = left;
+  }
+
+  enum Arith arith;
+  struct Value result;
+  if(arith_of(op, &arith) && arith_values(arith, x, y, &result))
+    return result;
+
+  if(ctx->sandboxed) return reject(ctx);
+  panic(1, "invalid operands for arithmetic");
+  return UNDEFINED_VAL;
+}
 
+static struct Value binary_op(enum TokenType op, struct Value left,
+    struct Value right, struct Interpreter* ctx) {
+  if(!MATCH_VAL(&left, INT) || !MATCH_VAL(&right, INT))
+    return binary_slow(op, &left, &right, ctx);
+
+  size_t x = FROM_INT(&left), y = FROM_INT(&right);
+
+  switch(op) {
+    case TOKEN_NOT_EQ:   return BOOL_VAL(x != y);
+    case TOKEN_EQ:       return BOOL_VAL(x == y);
+
+    case TOKEN_LT:       return BOOL_VAL(x < y);
+    case TOKEN_LT_EQ:    return BOOL_VAL(x <= y);
+    case TOKEN_GT:       return BOOL_VAL(x > y);
+    case TOKEN_GT_EQ:    return BOOL_VAL(x >= y);
+
+    // how wide shifts behave is left to whatever runs the program
     case TOKEN_BIT_SHL:
+      if(y >= 64 && ctx->sandboxed) return reject(ctx);
+      return INT_VAL(x << y);
     case TOKEN_BIT_SHR:
-    case TOKEN_BIT_AND:
-    case TOKEN_BIT_OR:
-    case TOKEN_BIT_XOR:
+      if(y >= 64 && ctx->sandboxed) return reject(ctx);
+      return INT_VAL(x >> y);
+    case TOKEN_BIT_AND:  return INT_VAL(x & y);
+    case TOKEN_BIT_OR:   return INT_VAL(x | y);
+    case TOKEN_BIT_XOR:  return INT_VAL(x ^ y);
 
     case TOKEN_ADD:
-      if(MATCH_VAL(left, INT) && MATCH_VAL(right, INT)) {
-        size_t x = FROM_INT(left) + FROM_INT(right);
-        free(left); free(right);
-
-        return alloc_int_val(x);
-      }
-      break;
-    case TOKEN_ADD_WRAP:
+    case TOKEN_ADD_WRAP: return INT_VAL(x + y);
     case TOKEN_SUB:
-    case TOKEN_SUB_WRAP:
+    case TOKEN_SUB_WRAP: return INT_VAL(x - y);
 
     case TOKEN_MUL:
-    case TOKEN_MUL_WRAP:
+    case TOKEN_MUL_WRAP: return INT_VAL(x * y);
     case TOKEN_DIV:
     case TOKEN_MOD:
+      if(y == 0 && ctx->sandboxed) return reject(ctx);
+      if(y == 0) panic(1, "division by zero");
+      return INT_VAL(op == TOKEN_DIV ? x / y : x % y);
+
+    case TOKEN_CATCH:
+    case TOKEN_ORELSE:
+    case TOKEN_AS:
 
     // should probably delete this
     case TOKEN_LOGIC_XOR:
     default: break;
   }
 
-  return NULL;
+  return UNDEFINED_VAL;
 }
 
+static struct Value walk_binary(const struct Binary* ast,
+    struct Interpreter* ctx) {
+  if(ast->op == TOKEN_LOGIC_AND || ast->op == TOKEN_LOGIC_OR)
+    return walk_logic(ast, ctx);
+
+  struct Value left = walk_expression(ast->left, ctx);
+  if(ctx->flow != FLOW_NORMAL) return UNDEFINED_VAL;
+  struct Value right = walk_expression(ast->right, ctx);
 
-static struct Value* walk_print(struct Value* args,
+  return binary_op(ast->op, left, right, ctx);
+}
+
+
+static struct Value walk_assign(const struct Binary* ast,
     struct Interpreter* ctx) {
-  switch(args->type) {
-
-  case VAL_UNDEFINED:
-  case VAL_BOOL:
-  case VAL_INT:
-    printf("%zu\n", args->as.integer); break;
-  case VAL_FLOAT:
-  case VAL_CHAR:
-  case VAL_STRING:
-  case VAL_IDENTIFIER:
-  case VAL_PTR:
-      break;
+  if(ctx->sandboxed) return reject(ctx);
+  if(ctx->nodes->tags[ast->left] != EXPR_VARIABLE)
+    panic(1, "expression is not assignable");
+
+  struct Value right = walk_expression(ast->right, ctx);
+  struct VarRef ref = variable_of(ctx->nodes, ast->left);
+  struct Value* variable = get_variable(ctx, &ref);
+
+  // every compound assignment token directly follows its operator
+  if(ast->op == TOKEN_ASSIGN) *variable = right;
+  else *variable = binary_op(ast->op - 1, *variable, right, ctx);
+
+  return *variable;
+}
+
+
+static struct Value walk_print(const struct ExprList* args,
+    struct Interpreter* ctx) {
+  for(size_t i = 0; i < args->size; i++) {
+    if(i) printf(" ");
+    struct Value arg = walk_expression(list_member(ctx->nodes, args, i), ctx);
+    print_value(&arg);
   }
+
+  printf("\n");
+  return UNDEFINED_VAL;
+}
+
+// the arguments are pushed straight into what becomes the callee's frame
+static void walk_arguments(const struct ExprList* args,
+    struct Interpreter* ctx) {
+  for(size_t i = 0; i < args->size; i++)
+    push_value(ctx, walk_expression(list_member(ctx->nodes, args, i), ctx));
 }
 
-static struct Value* walk_call(struct Call* ast, struct Interpreter* ctx) {
-  struct Value* callee = walk_expression(ast->callee, ctx);
-  struct Value* arguments = walk_expression(ast->arguments, ctx);
+static struct Value walk_call(uint32_t expr, struct Interpreter* ctx) {
+  if(ctx->sandboxed) return reject(ctx);
+  struct Call call = call_of(ctx->nodes, expr);
+
+  struct Value callee = walk_expression(call.callee, ctx);
+  if(!MATCH_VAL(&callee, IDENTIFIER)) panic(1, "call of non-identifier");
+
+  struct Function* function =
+    (struct Function*)hm_get(&ctx->functions, callee.as.string);
+
+  if(!function && callee.as.string == intern_cstr("print"))
+    return walk_print(&call.arguments, ctx);
+  if(!function) panic(1, "undefined function");
+
+  walk_arguments(&call.arguments, ctx);
+  if(call.arguments.size != count_vardecls(function->sig->args))
+    panic(1, "wrong number of arguments");
+
+  return call_function(function, expr, call.arguments.size, ctx);
+}
 
-  if(MATCH_VAL(callee, IDENTIFIER) && !strcmp(callee->as.string, "print")) {
-    free(callee);
-    walk_print(arguments, ctx);
+
+static struct Value walk_if(const struct IfWhile* ast,
+    struct Interpreter* ctx) {
+  struct Value condition = walk_expression(ast->condition, ctx);
+  if(ctx->flow != FLOW_NORMAL) return UNDEFINED_VAL;
+
+  if(is_truthy(&condition)) return walk_expression(ast->body, ctx);
+  if(ast->else_clause) return walk_expression(ast->else_clause, ctx);
+  return UNDEFINED_VAL;
+}
+
+// a while loop's value is its break value, or its else clause if the
+// condition ran out
+static struct Value walk_while(const struct IfWhile* ast,
+    struct Interpreter* ctx) {
+  for(;;) {
+    struct Value condition = walk_expression(ast->condition, ctx);
+    if(ctx->flow != FLOW_NORMAL) return UNDEFINED_VAL;
+    if(!is_truthy(&condition)) break;
+
+    walk_expression(ast->body, ctx);
+
+    switch(ctx->flow) {
+      case FLOW_NORMAL:   break;
+      case FLOW_CONTINUE: ctx->flow = FLOW_NORMAL; break;
+      case FLOW_BREAK:    ctx->flow = FLOW_NORMAL; return ctx->flow_value;
+      case FLOW_RETURN:
+      case FLOW_REJECT:   return UNDEFINED_VAL;
+    }
   }
 
-  return NULL;
+  if(ast->else_clause) return walk_expression(ast->else_clause, ctx);
+  return UNDEFINED_VAL;
 }
 
+static void walk_statement(const struct Statement*, struct Interpreter*);
 
-struct Value* walk_expression(struct Expression* ast, struct Interpreter* ctx) {
-  switch(ast->type) {
-  case EXPR_LITERAL:     return walk_literal(ast, ctx);
-  case EXPR_UNARY:
-  case EXPR_BINARY:      return walk_binary(&ast->as.binary, ctx);
-  case EXPR_GROUP:
-  case EXPR_CALL:        return walk_call(&ast->as.call, ctx);
+// like a while loop, except that continue still runs the step
+static struct Value walk_for(const struct ForLoop* ast,
+    struct Interpreter* ctx) {
+  if(has_statement(&ast->init)) walk_statement(&ast->init, ctx);
+  if(ctx->flow != FLOW_NORMAL) return UNDEFINED_VAL;
+
+  for(;;) {
+    if(ast->condition) {
+      struct Value condition = walk_expression(ast->condition, ctx);
+      if(ctx->flow != FLOW_NORMAL) return UNDEFINED_VAL;
+      if(!is_truthy(&condition)) break;
+    }
+
+    walk_expression(ast->body, ctx);
+
+    switch(ctx->flow) {
+      case FLOW_NORMAL:   break;
+      case FLOW_CONTINUE: ctx->flow = FLOW_NORMAL; break;
+      case FLOW_BREAK:    ctx->flow = FLOW_NORMAL; return ctx->flow_value;
+      case FLOW_RETURN:
+      case FLOW_REJECT:   return UNDEFINED_VAL;
+    }
+
+    if(ast->step) walk_expression(ast->step, ctx);
+    if(ctx->flow != FLOW_NORMAL) return UNDEFINED_VAL;
+  }
+
+  return UNDEFINED_VAL;
+}
+
+
+struct Value walk_expression(uint32_t ast, struct Interpreter* ctx) {
+  if(ctx->sandboxed) {
+    if(ctx->fuel == 0) return reject(ctx);
+    ctx->fuel -= 1;
+  }
+  if(ctx->profile) profile_expression(ctx->profile, ctx->nodes, ast);
+  if(samples_due) take_sample(ctx, ast);
+
+  const struct Nodes* nodes = ctx->nodes;
+
+  switch((enum ExprType)nodes->tags[ast]) {
+  case EXPR_LITERAL:     return literal_of(nodes, ast);
+  case EXPR_UNARY: {
+    struct Unary unary = unary_of(nodes, ast);
+    return walk_unary(&unary, ctx);
+  }
+  case EXPR_BINARY: {
+    struct Binary binary = binary_of(nodes, ast);
+    return walk_binary(&binary, ctx);
+  }
+  case EXPR_GROUP:       return walk_expression(nodes->data[ast].lhs, ctx);
+  case EXPR_CALL:        return walk_call(ast, ctx);
+  case EXPR_ASSIGN: {
+    struct Binary binary = binary_of(nodes, ast);
+    return walk_assign(&binary, ctx);
+  }
+  case EXPR_BLOCK:       return walk_block(ast, ctx);
+  case EXPR_IF: {
+    struct IfWhile ifwhile = ifwhile_of(nodes, ast);
+    return walk_if(&ifwhile, ctx);
+  }
+  case EXPR_WHILE: {
+    struct IfWhile ifwhile = ifwhile_of(nodes, ast);
+    return walk_while(&ifwhile, ctx);
+  }
+  case EXPR_FOR: {
+    struct ForLoop loop = forloop_of(nodes, ast);
+    return walk_for(&loop, ctx);
+  }
+  case EXPR_VARIABLE: {
+    if(ctx->sandboxed) return reject(ctx);
+    struct VarRef ref = variable_of(nodes, ast);
+    return *get_variable(ctx, &ref);
+  }
   case EXPR_FIELD:
   case EXPR_ARRAY_INDEX:
   case EXPR_ARRAY_INIT:
   case EXPR_CAST:
-  case EXPR_ASSIGN:
-  case EXPR_LIST:
-  case EXPR_BLOCK:       return walk_block(&ast->as.block, ctx);
-  case EXPR_IF:
-  case EXPR_WHILE:
     break;
   }
+
+  return UNDEFINED_VAL;
 }
 
 
-static void walk_statement(struct Statement* ast, struct Interpreter* ctx) {
+void walk_variable(struct Variable* ast, struct Value* slots,
+    struct Interpreter* ctx) {
+  for(size_t i = 0; i < ast->vars->size; i++) {
+    const struct VarDecl* var = &ast->vars->members[i];
+    struct Value value = UNDEFINED_VAL;
+
+    if(var->rvalue) value = walk_expression(var->rvalue, ctx);
+    slots[var->lvalue.slot] = value;
+  }
+}
+
+static void walk_statement(const struct Statement* ast,
+    struct Interpreter* ctx) {
   switch(ast->type) {
     case STMT_EXPR:  walk_expression(ast->as.expr, ctx); return;
-    case STMT_BLOCK:
+    case STMT_BLOCK: walk_block(ast->as.block, ctx);     return;
     case STMT_VAR:
-      break;
+      if(ctx->sandboxed) {
+        reject(ctx);
+        return;
+      }
+      walk_variable(ast->as.var,
+          ctx->frames.members[ctx->frames.size - 1].slots, ctx);
+      return;
   }
 }
 
 
-static void walk_statements(struct StatementList ast, struct Interpreter* ctx) {
-  for(size_t i = 0; i < ast.size; i++) walk_statement(&ast.members[i], ctx);
+// stops early once a return, break or continue is in flight
+static void walk_statements(const struct Block* ast,
+    struct Interpreter* ctx) {
+  for(size_t i = 0; i < ast->size && ctx->flow == FLOW_NORMAL; i++) {
+    struct Statement stmt = block_statement(ctx->nodes, ast, i);
+    walk_statement(&stmt, ctx);
+  }
 }
 
-struct Value* walk_block(struct Block* ast, struct Interpreter* ctx) {
-  walk_statements(ast->stmts, ctx);
+struct Value walk_block(uint32_t ast, struct Interpreter* ctx) {
+  struct Block block = block_of(ctx->nodes, ast);
+  walk_statements(&block, ctx);
 
-  if(ast->expr) return walk_expression(ast->expr, ctx);
-  return NULL;
+  if(block.expr && ctx->flow == FLOW_NORMAL)
+    return walk_expression(block.expr, ctx);
+  return UNDEFINED_VAL;
 }
@@ -2,6 +2,8 @@
 
 #include "ctx.h"
 #include "../../parser/expression.h"
+#include "../../parser/declaration.h"
 
-struct Value* walk_expression(struct Expression*, struct Interpreter*);
-struct Value* walk_block(struct Block*, struct Interpreter*);
+struct Value walk_expression(uint32_t, struct Interpreter*);
+struct Value walk_block(uint32_t, struct Interpreter*);
+void walk_variable(struct Variable*, struct Value*, struct Interpreter*);
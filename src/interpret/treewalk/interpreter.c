@@ -3,12 +3,32 @@
 #include "ctx.h"
 #include "interpreter.h"
 #include "declaration.h"
+#include "../../util/intern.h"
+#include "../../util/panic.h"
 
-void walk_tree(struct AST* ast) {
+// globals are initialized and functions registered in order, then main runs;
+// like the vm, main's parameters are left undefined. nothing runs if a
+// function is defined twice
+bool walk_tree(struct AST* ast, struct Profile* profile) {
   struct Interpreter interpreter;
-  NEW_ARRAYLIST(&interpreter.frames);
+  init_interpreter(&interpreter, ast->globals);
+  interpreter.nodes = &ast->nodes;
+  interpreter.profile = profile;
 
+  bool ok = true;
   for(size_t i = 0; i < ast->size; i++) {
-    walk_declaration(ast->members[i], &interpreter);
+    if(!walk_declaration(ast->members[i], &interpreter)) ok = false;
   }
+  if(!ok) {
+    free_interpreter(&interpreter);
+    return false;
+  }
+
+  struct Function* main_function =
+    (struct Function*)hm_get(&interpreter.functions, intern_cstr("main"));
+  if(!main_function) panic(1, "no main function");
+
+  call_function(main_function, 0, 0, &interpreter);
+  free_interpreter(&interpreter);
+  return true;
 }
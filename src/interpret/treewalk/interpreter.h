@@ -2,4 +2,7 @@
 
 #include "../../parser/parser.h"
 
-void walk_tree(struct AST*);
+#include "profile.h"
+
+// profiled when given a profile; false if the program was rejected
+bool walk_tree(struct AST*, struct Profile*);
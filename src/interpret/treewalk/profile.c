@@ -0,0 +1,346 @@
+// profile.c
+
+#include "profile.h"
+#include "../../util/arraylist.h"
+#include "../../util/hash.h"
+#include "../../util/lines.h"
+#include "../../util/stats.h"
+#include <errno.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+struct FunctionProfile {
+  const struct Function* function;
+  size_t calls;
+  size_t active;      // frames of it on the stack
+  uint64_t inclusive; // nanoseconds, counted by its outermost frame only
+  uint64_t exclusive;
+};
+
+// one per distinct call stack, as a node in the tree of them
+struct CallNode {
+  struct FunctionProfile* function;
+  struct CallNode* parent;
+  struct CallNode* chained; // next in its bucket
+  uint64_t self;
+};
+
+struct ProfileFrame {
+  struct CallNode* node;
+  uint64_t start;
+  uint64_t children; // time spent in the calls it made
+};
+
+struct ExpressionCount {
+  uint32_t offset;
+  const char* file; // NULL outside of any function
+  size_t count;
+};
+
+DEFINE_ARRAYLIST(FunctionProfiles, struct FunctionProfile*);
+DEFINE_ARRAYLIST(CallNodes, struct CallNode*);
+DEFINE_ARRAYLIST(ProfileFrames, struct ProfileFrame);
+DEFINE_ARRAYLIST(ExpressionCounts, struct ExpressionCount);
+
+// functions are only ever called by name, and no two share one, so the
+// interned name stands for the function
+struct Profile {
+  struct HashMap functions;   // name -> struct FunctionProfile*
+  struct FunctionProfiles all;
+  struct CallNode** buckets;  // by caller's node and callee
+  size_t nbuckets;
+  struct CallNodes nodes;
+  struct ProfileFrames frames;
+  size_t* expressions;        // by node, index + 1 into counts
+  size_t nexpressions;        // grown to the largest node seen
+  struct ExpressionCounts counts;
+};
+
+
+static uint64_t now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static const char* function_name(const struct Function* function) {
+  return function->sig->name ? : "<anonymous function>";
+}
+
+struct Profile* new_profile(void) {
+  struct Profile* profile = stats_malloc(sizeof(*profile));
+
+  hm_init(&profile->functions);
+  NEW_ARRAYLIST(&profile->all);
+  profile->nbuckets = 64;
+  profile->buckets = stats_calloc(profile->nbuckets, sizeof(*profile->buckets));
+  NEW_ARRAYLIST(&profile->nodes);
+  NEW_ARRAYLIST(&profile->frames);
+  profile->expressions = NULL;
+  profile->nexpressions = 0;
+  NEW_ARRAYLIST(&profile->counts);
+
+  return profile;
+}
+
+void free_profile(struct Profile* profile) {
+  FREE_MEMBERS(&profile->all, free);
+  FREE_MEMBERS(&profile->nodes, free);
+
+  hm_destroy(&profile->functions);
+  free(profile->all.members);
+  free(profile->buckets);
+  free(profile->nodes.members);
+  free(profile->frames.members);
+  free(profile->expressions);
+  free(profile->counts.members);
+  free(profile);
+}
+
+
+static struct FunctionProfile* find_function(struct Profile* profile,
+    const struct Function* function) {
+  struct FunctionProfile* found = (struct FunctionProfile*)
+    hm_get(&profile->functions, function->sig->name);
+  if(found) return found;
+
+  found = stats_malloc(sizeof(*found));
+  *found = (struct FunctionProfile){ function, 0, 0, 0, 0 };
+  APPEND_ARRAYLIST(&profile->all, found);
+  hm_set(&profile->functions, function->sig->name, (uintptr_t)found);
+
+  return found;
+}
+
+static size_t bucket(const struct Profile* profile,
+    const struct CallNode* parent, const struct FunctionProfile* function) {
+  uint64_t h = ((uintptr_t)parent ^ ((uintptr_t)function << 1))
+    * 0x9e3779b97f4a7c15u;
+  return (h >> 32) & (profile->nbuckets - 1);
+}
+
+// the buckets are doubled whenever there are more nodes than them
+static void rehash_nodes(struct Profile* profile) {
+  free(profile->buckets);
+  profile->nbuckets *= 2;
+  profile->buckets = stats_calloc(profile->nbuckets, sizeof(*profile->buckets));
+
+  for(size_t i = 0; i < profile->nodes.size; i++) {
+    struct CallNode* node = profile->nodes.members[i];
+    size_t at = bucket(profile, node->parent, node->function);
+    node->chained = profile->buckets[at];
+    profile->buckets[at] = node;
+  }
+}
+
+static struct CallNode* find_node(struct Profile* profile,
+    struct CallNode* parent, struct FunctionProfile* function) {
+  size_t at = bucket(profile, parent, function);
+  for(struct CallNode* node = profile->buckets[at]; node; node = node->chained)
+    if(node->parent == parent && node->function == function) return node;
+
+  struct CallNode* node = stats_malloc(sizeof(*node));
+  *node = (struct CallNode){ function, parent, profile->buckets[at], 0 };
+  profile->buckets[at] = node;
+  APPEND_ARRAYLIST(&profile->nodes, node);
+
+  if(profile->nodes.size > profile->nbuckets) rehash_nodes(profile);
+  return node;
+}
+
+
+// the clock is read last on the way in and first on the way out, so as
+// little of the bookkeeping as possible lands in the function's own time
+void profile_enter(struct Profile* profile, struct Function* function) {
+  struct FunctionProfile* callee = find_function(profile, function);
+  struct CallNode* parent = profile->frames.size
+    ? profile->frames.members[profile->frames.size - 1].node : NULL;
+
+  callee->calls += 1;
+  callee->active += 1;
+
+  struct ProfileFrame frame = { find_node(profile, parent, callee), 0, 0 };
+  APPEND_ARRAYLIST(&profile->frames, frame);
+  profile->frames.members[profile->frames.size - 1].start = now();
+}
+
+void profile_leave(struct Profile* profile) {
+  uint64_t end = now();
+
+  struct ProfileFrame frame = profile->frames.members[--profile->frames.size];
+  struct FunctionProfile* callee = frame.node->function;
+  uint64_t elapsed = end - frame.start;
+
+  frame.node->self += elapsed - frame.children;
+  callee->exclusive += elapsed - frame.children;
+  if(!--callee->active) callee->inclusive += elapsed;
+
+  if(profile->frames.size)
+    profile->frames.members[profile->frames.size - 1].children += elapsed;
+}
+
+static void grow_expressions(struct Profile* profile, uint32_t node) {
+  size_t size = profile->nexpressions ? profile->nexpressions : 64;
+  while(size <= node) size *= 2;
+
+  profile->expressions = stats_realloc(profile->expressions,
+      size * sizeof(*profile->expressions));
+  memset(profile->expressions + profile->nexpressions, 0,
+      (size - profile->nexpressions) * sizeof(*profile->expressions));
+  profile->nexpressions = size;
+}
+
+void profile_expression(struct Profile* profile, const struct Nodes* nodes,
+    uint32_t node) {
+  if(node >= profile->nexpressions) grow_expressions(profile, node);
+  size_t index = profile->expressions[node];
+
+  if(!index) {
+    struct ExpressionCount count = { nodes->offsets[node], NULL, 0 };
+    if(profile->frames.size)
+      count.file = profile->frames.members[profile->frames.size - 1]
+        .node->function->function->file;
+
+    APPEND_ARRAYLIST(&profile->counts, count);
+    index = profile->counts.size;
+    profile->expressions[node] = index;
+  }
+
+  profile->counts.members[index - 1].count += 1;
+}
+
+
+// root first, split by semicolons
+static void write_stacks(FILE* out, const struct Profile* profile) {
+  struct CallNodes path;
+  NEW_ARRAYLIST(&path);
+
+  for(size_t i = 0; i < profile->nodes.size; i++) {
+    struct CallNode* node = profile->nodes.members[i];
+    if(!node->self) continue;
+
+    path.size = 0;
+    for(struct CallNode* n = node; n; n = n->parent) APPEND_ARRAYLIST(&path, n);
+
+    for(size_t j = path.size; j-- > 0;)
+      fprintf(out, "%s%s", function_name(path.members[j]->function->function),
+          j ? ";" : "");
+    fprintf(out, " %" PRIu64 "\n", node->self);
+  }
+
+  free(path.members);
+}
+
+static int by_exclusive(const void* a, const void* b) {
+  const struct FunctionProfile* x = *(struct FunctionProfile* const*)a;
+  const struct FunctionProfile* y = *(struct FunctionProfile* const*)b;
+  return (x->exclusive < y->exclusive) - (x->exclusive > y->exclusive);
+}
+
+static void write_functions(FILE* out, const struct Profile* profile) {
+  size_t size = profile->all.size;
+  struct FunctionProfile** sorted =
+    stats_malloc((size ? size : 1) * sizeof(*sorted));
+  memcpy(sorted, profile->all.members, size * sizeof(*sorted));
+  qsort(sorted, size, sizeof(*sorted), by_exclusive);
+
+  fprintf(out, "%12s %14s %14s  %s\n", "calls", "inclusive ms", "exclusive ms",
+      "function");
+  for(size_t i = 0; i < size; i++)
+    fprintf(out, "%12zu %14.3f %14.3f  %s (%s)\n", sorted[i]->calls,
+        sorted[i]->inclusive / 1e6, sorted[i]->exclusive / 1e6,
+        function_name(sorted[i]->function), sorted[i]->function->file);
+
+  free(sorted);
+}
+
+// a line's count is that of the busiest expression parsed at it; lines
+// where nothing ran are left blank
+static void write_listing(FILE* out, const struct Profile* profile,
+    const char* file) {
+  fprintf(out, "\n== %s\n", file);
+
+  struct LineMap map;
+  if(!open_lines(&map, file)) {
+    fprintf(out, "(%s)\n", strerror(errno));
+    return;
+  }
+
+  size_t* counts = stats_calloc(map.lines, sizeof(*counts));
+  for(size_t i = 0; i < profile->counts.size; i++) {
+    const struct ExpressionCount* count = &profile->counts.members[i];
+    if(!count->file || strcmp(count->file, file)) continue;
+
+    size_t line = line_of(&map, count->offset);
+    if(count->count > counts[line]) counts[line] = count->count;
+  }
+
+  const char* text = map.source.text;
+  for(size_t line = 0; line < map.lines; line++) {
+    size_t start = map.starts[line];
+    size_t end = line + 1 < map.lines ? map.starts[line + 1] - 1 : map.size;
+    if(end > start && text[end - 1] == '\r') end -= 1;
+
+    if(counts[line]) fprintf(out, "%12zu | ", counts[line]);
+    else fprintf(out, "%12s | ", "");
+    fprintf(out, "%.*s\n", (int)(end - start), text + start);
+  }
+
+  free(counts);
+  close_lines(&map);
+}
+
+// each file once, in the order its code first ran
+DEFINE_ARRAYLIST(FileList, const char*);
+
+static void write_listings(FILE* out, const struct Profile* profile) {
+  struct FileList written;
+  NEW_ARRAYLIST(&written);
+
+  for(size_t i = 0; i < profile->counts.size; i++) {
+    const char* file = profile->counts.members[i].file;
+    if(!file) continue;
+
+    bool seen = false;
+    for(size_t j = 0; !seen && j < written.size; j++)
+      seen = !strcmp(written.members[j], file);
+    if(seen) continue;
+
+    write_listing(out, profile, file);
+    APPEND_ARRAYLIST(&written, file);
+  }
+
+  free(written.members);
+}
+
+
+static FILE* open_output(const char* base, const char* extension) {
+  size_t len = strlen(base);
+  char* path = stats_malloc(len + strlen(extension) + 1);
+  memcpy(path, base, len);
+  strcpy(path + len, extension);
+
+  FILE* file = fopen(path, "w");
+  if(!file) printf("error: could not open %s: %s\n", path, strerror(errno));
+
+  free(path);
+  return file;
+}
+
+bool write_profile(const struct Profile* profile, const char* base) {
+  FILE* stacks = open_output(base, ".folded");
+  if(!stacks) return false;
+  write_stacks(stacks, profile);
+  fclose(stacks);
+
+  FILE* listing = open_output(base, ".txt");
+  if(!listing) return false;
+  write_functions(listing, profile);
+  write_listings(listing, profile);
+  fclose(listing);
+
+  return true;
+}
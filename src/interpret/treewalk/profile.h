@@ -0,0 +1,24 @@
+#pragma once
+
+#include "../../parser/declaration.h"
+#include "../../parser/expression.h"
+#include <stdbool.h>
+
+// what --profile collects while the tree walker runs: calls and inclusive
+// and exclusive time per function, the time spent under each distinct call
+// stack, and how many times each expression was evaluated. the profiler's
+// own bookkeeping is counted to whichever function it happens in
+struct Profile;
+
+struct Profile* new_profile(void);
+void free_profile(struct Profile*);
+
+void profile_enter(struct Profile*, struct Function*);
+void profile_leave(struct Profile*);
+void profile_expression(struct Profile*, const struct Nodes*, uint32_t);
+
+// writes FILE.folded, each call stack with the nanoseconds spent in its
+// innermost function as flamegraph.pl reads them, and FILE.txt, the
+// functions by exclusive time and then every file they came from with how
+// many times each line ran
+bool write_profile(const struct Profile*, const char*);
@@ -0,0 +1,211 @@
+// sample.c
+
+#include "sample.h"
+#include "../../util/arraylist.h"
+#include "../../util/lines.h"
+#include "../../util/stats.h"
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+// a function and the position in it a sample was at; the outermost frames
+// have no parent
+struct SampleNode {
+  const struct Function* function; // NULL outside of any function
+  uint32_t offset;
+  struct SampleNode* parent;
+  struct SampleNode* chained;      // next in its bucket
+  size_t count;
+};
+
+DEFINE_ARRAYLIST(SampleNodes, struct SampleNode*);
+
+// there's only ever the one timer, so there's only ever the one tree
+volatile sig_atomic_t samples_due = 0;
+
+static struct SampleNode** buckets;
+static size_t nbuckets;
+static struct SampleNodes nodes;
+
+
+// nothing else is safe to do in a handler
+static void on_sigprof(int number) {
+  (void)number;
+  samples_due += 1;
+}
+
+void start_sampling(unsigned hz) {
+  nbuckets = 64;
+  buckets = stats_calloc(nbuckets, sizeof(*buckets));
+  NEW_ARRAYLIST(&nodes);
+  samples_due = 0;
+
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = on_sigprof;
+  action.sa_flags = SA_RESTART; // print shouldn't fail with EINTR
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGPROF, &action, NULL);
+
+  long interval = 1000000 / hz; // microseconds
+  struct itimerval timer;
+  timer.it_interval =
+    (struct timeval){ interval / 1000000, interval % 1000000 };
+  timer.it_value = timer.it_interval;
+  setitimer(ITIMER_PROF, &timer, NULL);
+}
+
+// a signal already on its way is dropped rather than left to kill us
+void stop_sampling(void) {
+  struct itimerval off = { { 0, 0 }, { 0, 0 } };
+  setitimer(ITIMER_PROF, &off, NULL);
+  signal(SIGPROF, SIG_IGN);
+}
+
+
+static size_t bucket(const struct SampleNode* parent,
+    const struct Function* function, uint32_t offset) {
+  uint64_t h = ((uintptr_t)parent ^ ((uintptr_t)function << 1) ^ offset)
+    * 0x9e3779b97f4a7c15u;
+  return (h >> 32) & (nbuckets - 1);
+}
+
+static void rehash_nodes(void) {
+  free(buckets);
+  nbuckets *= 2;
+  buckets = stats_calloc(nbuckets, sizeof(*buckets));
+
+  for(size_t i = 0; i < nodes.size; i++) {
+    struct SampleNode* node = nodes.members[i];
+    size_t at = bucket(node->parent, node->function, node->offset);
+    node->chained = buckets[at];
+    buckets[at] = node;
+  }
+}
+
+static struct SampleNode* find_node(struct SampleNode* parent,
+    const struct Function* function, uint32_t offset) {
+  size_t at = bucket(parent, function, offset);
+  for(struct SampleNode* node = buckets[at]; node; node = node->chained)
+    if(node->parent == parent && node->function == function
+        && node->offset == offset) return node;
+
+  struct SampleNode* node = stats_malloc(sizeof(*node));
+  *node = (struct SampleNode){ function, offset, parent, buckets[at], 0 };
+  buckets[at] = node;
+  APPEND_ARRAYLIST(&nodes, node);
+
+  if(nodes.size > nbuckets) rehash_nodes();
+  return node;
+}
+
+// every tick since the last sample counts to this one. a frame is at the
+// call that made the next one, and the innermost is at the expression
+// about to be evaluated
+void take_sample(const struct Interpreter* ctx, uint32_t at) {
+  size_t ticks = samples_due;
+  samples_due = 0;
+
+  const uint32_t* offsets = ctx->nodes->offsets;
+  struct SampleNode* node = NULL;
+  for(size_t i = 0; i < ctx->frames.size; i++) {
+    uint32_t where = i + 1 < ctx->frames.size
+      ? ctx->frames.members[i + 1].call : at;
+    node = find_node(node, ctx->frames.members[i].function, offsets[where]);
+  }
+  if(!node) node = find_node(NULL, NULL, offsets[at]);
+
+  node->count += ticks;
+}
+
+
+struct OpenFile {
+  const char* name;
+  struct LineMap map;
+  bool readable;
+};
+
+DEFINE_ARRAYLIST(OpenFiles, struct OpenFile);
+
+static const struct OpenFile* open_file(struct OpenFiles* files,
+    const char* name) {
+  for(size_t i = 0; i < files->size; i++)
+    if(!strcmp(files->members[i].name, name)) return &files->members[i];
+
+  struct OpenFile file = { .name = name };
+  file.readable = open_lines(&file.map, name);
+  APPEND_ARRAYLIST(files, file);
+  return &files->members[files->size - 1];
+}
+
+// rows and columns from 1, as editors count them
+static void write_frame(FILE* out, struct OpenFiles* files,
+    const struct SampleNode* node) {
+  if(!node->function) {
+    fprintf(out, "<toplevel>");
+    return;
+  }
+
+  const char* name = node->function->sig->name ? : "<anonymous function>";
+  const struct OpenFile* file = open_file(files, node->function->file);
+  if(!file->readable) {
+    fprintf(out, "%s (%s)", name, file->name);
+    return;
+  }
+
+  size_t line = line_of(&file->map, node->offset);
+  fprintf(out, "%s (%s:%zu:%zu)", name, file->name, line + 1,
+      node->offset - file->map.starts[line] + 1);
+}
+
+static void write_stacks(FILE* out) {
+  struct SampleNodes path;
+  NEW_ARRAYLIST(&path);
+  struct OpenFiles files;
+  NEW_ARRAYLIST(&files);
+
+  for(size_t i = 0; i < nodes.size; i++) {
+    struct SampleNode* node = nodes.members[i];
+    if(!node->count) continue;
+
+    path.size = 0;
+    for(struct SampleNode* n = node; n; n = n->parent)
+      APPEND_ARRAYLIST(&path, n);
+
+    for(size_t j = path.size; j-- > 0;) {
+      write_frame(out, &files, path.members[j]);
+      if(j) fprintf(out, ";");
+    }
+    fprintf(out, " %zu\n", node->count);
+  }
+
+  for(size_t i = 0; i < files.size; i++)
+    if(files.members[i].readable) close_lines(&files.members[i].map);
+  free(files.members);
+  free(path.members);
+}
+
+// the samples are dropped once written, whether or not they could be
+bool write_samples(const char* base) {
+  size_t len = strlen(base);
+  char* path = stats_malloc(len + sizeof(".folded"));
+  memcpy(path, base, len);
+  memcpy(path + len, ".folded", sizeof(".folded"));
+
+  FILE* out = fopen(path, "w");
+  bool ok = out;
+  if(!ok) printf("error: could not open %s: %s\n", path, strerror(errno));
+  else {
+    write_stacks(out);
+    fclose(out);
+  }
+  free(path);
+
+  FREE_MEMBERS(&nodes, free);
+  free(nodes.members);
+  free(buckets);
+
+  return ok;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "ctx.h"
+#include <signal.h>
+#include <stdbool.h>
+
+// what --sample-profile collects: a SIGPROF timer only marks a sample as
+// due, and the tree walker takes it at the next expression it evaluates,
+// where the frames are safe to read. stacks are kept as a tree of the
+// functions and the positions in them they were sampled at
+
+extern volatile sig_atomic_t samples_due;
+
+void start_sampling(unsigned);
+void stop_sampling(void);
+void take_sample(const struct Interpreter*, uint32_t);
+
+// writes the stacks root first, each frame as function (file:row:col), as
+// flamegraph.pl and pprof read them
+bool write_samples(const char*);
@@ -0,0 +1,148 @@
+// chunk.c
+
+#include "chunk.h"
+#include "../../util/stats.h"
+#include <stdio.h>
+
+const char* opcode_strings[OP_FINAL] = {
+  "LOADK",
+  "LOADNIL",
+  "MOVE",
+  "GETG",
+  "SETG",
+  "ADD",
+  "SUB",
+  "MUL",
+  "DIV",
+  "MOD",
+  "SHL",
+  "SHR",
+  "BAND",
+  "BOR",
+  "BXOR",
+  "EQ",
+  "NE",
+  "LT",
+  "LE",
+  "NEG",
+  "NOT",
+  "JMP",
+  "JMPF",
+  "JMPT",
+  "CALL",
+  "PRINT",
+  "RET",
+};
+
+struct Proto* alloc_proto(const char* name) {
+  struct Proto* proto = stats_malloc(sizeof(*proto));
+
+  proto->name = name;
+  proto->arity = 0;
+  proto->registers = 0;
+  NEW_ARRAYLIST(&proto->code);
+  NEW_ARRAYLIST(&proto->constants);
+
+  return proto;
+}
+
+static bool same_constant(const struct Value* x, const struct Value* y) {
+  if(x->type != y->type) return false;
+
+  switch(x->type) {
+    case VAL_BOOL:  return x->as.boolean == y->as.boolean;
+    case VAL_INT:   return x->as.integer == y->as.integer;
+    case VAL_FLOAT: return x->as.floating == y->as.floating;
+    case VAL_CHAR:  return x->as.character == y->as.character;
+    case VAL_STRING:
+    case VAL_IDENTIFIER: return x->as.string == y->as.string;
+    default: return false;
+  }
+}
+
+// constants are deduplicated, so a literal used in a loop is stored once
+size_t add_constant(struct Proto* proto, struct Value value) {
+  for(size_t i = 0; i < proto->constants.size; i++)
+    if(same_constant(&proto->constants.members[i], &value)) return i;
+
+  APPEND_ARRAYLIST(&proto->constants, value);
+  return proto->constants.size - 1;
+}
+
+
+
+// ### PRINT FUNCTIONS ### //
+
+static void print_constant(const struct Value* value) {
+  switch(value->type) {
+    case VAL_UNDEFINED:  printf("undefined");                            break;
+    case VAL_BOOL:       printf("%s", value->as.boolean? "true":"false"); break;
+    case VAL_INT:        printf("%zu", value->as.integer);                break;
+    case VAL_FLOAT:      printf("%f", value->as.floating);                break;
+    case VAL_CHAR:       printf("'%c'", value->as.character);             break;
+    case VAL_STRING:     printf("\"%s\"", value->as.string);             break;
+    case VAL_IDENTIFIER: printf("%s", value->as.string);                  break;
+    case VAL_PTR:        printf("%p", (void*)value->as.ptr);              break;
+  }
+}
+
+static void print_instruction(const struct Proto* proto, size_t index) {
+  Instruction i = proto->code.members[index];
+  enum OpCode op = INSTR_OP(i);
+
+  printf("  %04zu %-8s ", index, opcode_strings[op]);
+
+  switch(op) {
+    case OP_LOADK:
+      printf("r%-3u k%-3u ; ", INSTR_A(i), INSTR_BX(i));
+      print_constant(&proto->constants.members[INSTR_BX(i)]);
+      break;
+    case OP_LOADNIL:
+    case OP_RET:
+      printf("r%-3u", INSTR_A(i));
+      break;
+    case OP_MOVE:
+    case OP_NEG:
+    case OP_NOT:
+      printf("r%-3u r%-3u", INSTR_A(i), INSTR_B(i));
+      break;
+    case OP_JMP:
+      printf("%-9d ; -> %04zd", INSTR_SBX(i), index + 1 + INSTR_SBX(i));
+      break;
+    case OP_JMPF:
+    case OP_JMPT:
+      printf("r%-3u %-4d ; -> %04zd", INSTR_A(i), INSTR_SBX(i),
+          index + 1 + INSTR_SBX(i));
+      break;
+    case OP_GETG:
+    case OP_SETG:
+      printf("r%-3u g%-3u", INSTR_A(i), INSTR_BX(i));
+      break;
+    case OP_CALL:
+      printf("r%-3u f%-3u", INSTR_A(i), INSTR_BX(i));
+      break;
+    case OP_PRINT:
+      printf("r%-3u %-4u", INSTR_A(i), INSTR_B(i));
+      break;
+    default:
+      printf("r%-3u r%-3u r%-3u", INSTR_A(i), INSTR_B(i), INSTR_C(i));
+      break;
+  }
+
+  printf("\n");
+}
+
+void print_proto(const struct Proto* proto) {
+  printf("function %s (arity %zu, %zu registers, %zu constants)\n",
+      proto->name, proto->arity, proto->registers, proto->constants.size);
+
+  for(size_t i = 0; i < proto->code.size; i++) print_instruction(proto, i);
+}
+
+void print_program(const struct Program* program) {
+  for(size_t i = 0; i < program->protos.size; i++) {
+    printf("f%zu: ", i);
+    print_proto(program->protos.members[i]);
+    printf("\n");
+  }
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stdint.h>
+#include "../../value.h"
+#include "../../util/arraylist.h"
+
+// every instruction is a single 32-bit word:
+//   [ op:8 | a:8 | b:8 | c:8 ]  or  [ op:8 | a:8 | bx:16 ]
+// a, b and c name registers relative to the current frame's base; bx is
+// a constant, global or function index, or a signed jump offset biased by
+// SBX_BIAS
+enum OpCode {
+  OP_LOADK,   // R[a] = K[bx]
+  OP_LOADNIL, // R[a] = undefined
+  OP_MOVE,    // R[a] = R[b]
+  OP_GETG,    // R[a] = G[bx]
+  OP_SETG,    // G[bx] = R[a]
+
+  OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_MOD, // R[a] = R[b] op R[c]
+  OP_SHL, OP_SHR, OP_BAND, OP_BOR, OP_BXOR,
+  OP_EQ, OP_NE, OP_LT, OP_LE,
+
+  OP_NEG, OP_NOT, // R[a] = op R[b]
+
+  OP_JMP,   // ip += sbx
+  OP_JMPF,  // if !R[a] then ip += sbx
+  OP_JMPT,  // if R[a] then ip += sbx
+
+  OP_CALL,  // R[a] = F[bx](R[a], ..., R[a + arity - 1])
+  OP_PRINT, // print R[a], ..., R[a + b - 1]
+  OP_RET,   // return R[a]
+
+  OP_FINAL,
+};
+
+typedef uint32_t Instruction;
+
+#define SBX_BIAS 0x7fff
+#define MAX_REGISTERS 256
+
+#define ENCODE_ABC(op, a, b, c) \
+  ((Instruction)(op) | ((Instruction)(a) << 8) \
+   | ((Instruction)(b) << 16) | ((Instruction)(c) << 24))
+#define ENCODE_ABX(op, a, bx) \
+  ((Instruction)(op) | ((Instruction)(a) << 8) | ((Instruction)(bx) << 16))
+#define ENCODE_ASBX(op, a, sbx) ENCODE_ABX(op, a, (sbx) + SBX_BIAS)
+
+#define INSTR_OP(i)  ((enum OpCode)((i) & 0xff))
+#define INSTR_A(i)   (((i) >> 8) & 0xff)
+#define INSTR_B(i)   (((i) >> 16) & 0xff)
+#define INSTR_C(i)   ((i) >> 24)
+#define INSTR_BX(i)  ((i) >> 16)
+#define INSTR_SBX(i) ((int32_t)INSTR_BX(i) - SBX_BIAS)
+
+DEFINE_ARRAYLIST(Code, Instruction);
+DEFINE_ARRAYLIST(Constants, struct Value);
+
+// a compiled function
+struct Proto {
+  const char* name;
+  struct Code code;
+  struct Constants constants;
+  size_t arity;
+  size_t registers; // how many registers a frame of this function needs
+};
+
+DEFINE_ARRAYLIST(Protos, struct Proto*);
+
+// the entry proto initializes the globals in order, then calls main
+struct Program {
+  struct Protos protos;
+  size_t entry;
+  size_t globals; // how many, each undefined until it's initialized
+};
+
+extern const char* opcode_strings[OP_FINAL];
+
+struct Proto* alloc_proto(const char*);
+size_t add_constant(struct Proto*, struct Value);
+
+void print_proto(const struct Proto*);
+void print_program(const struct Program*);
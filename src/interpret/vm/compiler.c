@@ -0,0 +1,723 @@
+// compiler.c
+
+#include "compiler.h"
+#include "../../parser/declaration.h"
+#include "../../parser/expression.h"
+#include "../../util/hash.h"
+#include "../../util/intern.h"
+#include "../../util/stats.h"
+#include <stdio.h>
+
+// lowers the ast into register bytecode. every expression is compiled into a
+// destination register; locals live in the registers the resolver gave them
+// as slots and temporaries are allocated stack-wise above them, so c->top is
+// always the first free one
+
+#define DISCARD (-1) // destination for expressions whose value is unused
+
+enum CompileErrorType {
+  COMPILE_ERROR_UNSUPPORTED,
+  COMPILE_ERROR_UNDEFINED_FUNCTION,
+  COMPILE_ERROR_REDEFINED_FUNCTION,
+  COMPILE_ERROR_NOT_ASSIGNABLE,
+  COMPILE_ERROR_ARITY,
+  COMPILE_ERROR_OUTSIDE_LOOP,
+  COMPILE_ERROR_TOO_MANY_REGISTERS,
+  COMPILE_ERROR_TOO_MANY_CONSTANTS,
+  COMPILE_ERROR_TOO_MANY_GLOBALS,
+  COMPILE_ERROR_JUMP_TOO_FAR,
+  COMPILE_ERROR_NO_MAIN,
+
+  COMPILE_ERROR_FINAL,
+};
+
+static const char* compile_error_strings[COMPILE_ERROR_FINAL] = {
+  "unsupported by the bytecode compiler",
+  "undefined function",
+  "function is already defined",
+  "expression is not assignable",
+  "wrong number of arguments",
+  "break or continue outside of a loop",
+  "too many registers; function is too large",
+  "too many constants; function is too large",
+  "too many globals",
+  "jump is too far; function is too large",
+  "no main function",
+};
+
+DEFINE_ARRAYLIST(Jumps, size_t);
+
+struct Loop {
+  size_t start;
+  int dst;
+  struct Jumps breaks, continues;
+  struct Loop* enclosing;
+};
+
+struct Compiler {
+  const struct Nodes* nodes;
+  struct Program* program;
+  struct Proto* proto;
+  const struct Function* function; // NULL while initializing globals
+  struct HashMap functions; // name -> index into program->protos, plus one
+  struct Loop* loop;
+  size_t top;
+  const char* file; // of the function being compiled
+  uint32_t node;    // being compiled, which errors are reported at
+  bool had_error;
+};
+
+
+// errors without a file are the whole program's
+static void compile_error(struct Compiler* c, enum CompileErrorType type,
+    const char* detail) {
+  c->had_error = true;
+
+  if(c->file) print_error_at(c->file, c->nodes->offsets[c->node]);
+  else print_error_place("<program>");
+  if(detail) printf(" at \"%s\"", detail);
+  printf("\n");
+  print_error_message(COMPILE_ERROR_CODES + type, compile_error_strings[type]);
+}
+
+
+
+// ### EMITTING FUNCTIONS ### //
+
+static size_t emit(struct Compiler* c, Instruction instruction) {
+  APPEND_ARRAYLIST(&c->proto->code, instruction);
+  return c->proto->code.size - 1;
+}
+
+static size_t emit_jump(struct Compiler* c, enum OpCode op, uint8_t reg) {
+  return emit(c, ENCODE_ASBX(op, reg, 0));
+}
+
+static void emit_jump_to(struct Compiler* c, enum OpCode op, uint8_t reg,
+    size_t target) {
+  long offset = (long)target - (long)(c->proto->code.size + 1);
+  if(offset < -SBX_BIAS) compile_error(c, COMPILE_ERROR_JUMP_TOO_FAR, NULL);
+  emit(c, ENCODE_ASBX(op, reg, offset));
+}
+
+// point a previously emitted jump at the next instruction
+static void patch_jump(struct Compiler* c, size_t jump) {
+  long offset = (long)c->proto->code.size - (long)(jump + 1);
+  if(offset > UINT16_MAX - SBX_BIAS)
+    compile_error(c, COMPILE_ERROR_JUMP_TOO_FAR, NULL);
+
+  Instruction* instruction = &c->proto->code.members[jump];
+  *instruction = ENCODE_ASBX(INSTR_OP(*instruction), INSTR_A(*instruction),
+      offset);
+}
+
+static void patch_jumps(struct Compiler* c, struct Jumps* jumps) {
+  for(size_t i = 0; i < jumps->size; i++) patch_jump(c, jumps->members[i]);
+  free(jumps->members);
+}
+
+static void emit_constant(struct Compiler* c, struct Value value,
+    uint8_t dst) {
+  size_t k = add_constant(c->proto, value);
+  if(k > UINT16_MAX) compile_error(c, COMPILE_ERROR_TOO_MANY_CONSTANTS, NULL);
+  emit(c, ENCODE_ABX(OP_LOADK, dst, k));
+}
+
+static void emit_move(struct Compiler* c, int dst, uint8_t src) {
+  if(dst != DISCARD && dst != src) emit(c, ENCODE_ABC(OP_MOVE, dst, src, 0));
+}
+
+
+
+// ### REGISTERS ### //
+
+static uint8_t push_register(struct Compiler* c) {
+  if(c->top >= MAX_REGISTERS) {
+    compile_error(c, COMPILE_ERROR_TOO_MANY_REGISTERS, NULL);
+    return MAX_REGISTERS - 1;
+  }
+
+  c->top += 1;
+  if(c->top > c->proto->registers) c->proto->registers = c->top;
+  return c->top - 1;
+}
+
+// globals live outside any frame, so they're only ever loaded into a
+// register and stored back from one
+static void emit_global(struct Compiler* c, enum OpCode op, uint8_t reg,
+    size_t slot) {
+  if(slot > UINT16_MAX) compile_error(c, COMPILE_ERROR_TOO_MANY_GLOBALS, NULL);
+  emit(c, ENCODE_ABX(op, reg, slot));
+}
+
+
+
+// ### COMPILING FUNCTIONS ### //
+
+static void compile_expression(struct Compiler*, uint32_t, int);
+static void compile_block(struct Compiler*, uint32_t, int);
+static void compile_statement(struct Compiler*, const struct Statement*);
+
+// get the value of an expression into some register, without copying it if
+// its already a local
+static uint8_t compile_operand(struct Compiler* c, uint32_t ast) {
+  if(c->nodes->tags[ast] == EXPR_VARIABLE
+      && variable_of(c->nodes, ast).depth == 0)
+    return variable_of(c->nodes, ast).slot;
+
+  uint8_t reg = push_register(c);
+  compile_expression(c, ast, reg);
+  return reg;
+}
+
+
+static void compile_reference(struct Compiler* c, const struct VarRef* ast,
+    int dst) {
+  if(ast->depth == 0) emit_move(c, dst, ast->slot);
+  else emit_global(c, OP_GETG, dst, ast->slot);
+}
+
+
+static void compile_arith(struct Compiler* c, enum TokenType op, uint8_t dst,
+    uint8_t left, uint8_t right) {
+  enum OpCode code;
+
+  switch(op) {
+    case TOKEN_ADD:
+    case TOKEN_ADD_WRAP: code = OP_ADD;  break;
+    case TOKEN_SUB:
+    case TOKEN_SUB_WRAP: code = OP_SUB;  break;
+    case TOKEN_MUL:
+    case TOKEN_MUL_WRAP: code = OP_MUL;  break;
+    case TOKEN_DIV:      code = OP_DIV;  break;
+    case TOKEN_MOD:      code = OP_MOD;  break;
+    case TOKEN_BIT_SHL:  code = OP_SHL;  break;
+    case TOKEN_BIT_SHR:  code = OP_SHR;  break;
+    case TOKEN_BIT_AND:  code = OP_BAND; break;
+    case TOKEN_BIT_OR:   code = OP_BOR;  break;
+    case TOKEN_BIT_XOR:  code = OP_BXOR; break;
+    case TOKEN_EQ:       code = OP_EQ;   break;
+    case TOKEN_NOT_EQ:   code = OP_NE;   break;
+    case TOKEN_LT:       code = OP_LT;   break;
+    case TOKEN_LT_EQ:    code = OP_LE;   break;
+
+    // a > b is b < a
+    case TOKEN_GT:
+      emit(c, ENCODE_ABC(OP_LT, dst, right, left)); return;
+    case TOKEN_GT_EQ:
+      emit(c, ENCODE_ABC(OP_LE, dst, right, left)); return;
+
+    default:
+      compile_error(c, COMPILE_ERROR_UNSUPPORTED, token_strings[op]);
+      return;
+  }
+
+  emit(c, ENCODE_ABC(code, dst, left, right));
+}
+
+
+static void compile_binary(struct Compiler* c, const struct Binary* ast,
+    int dst) {
+  if(ast->op == TOKEN_LOGIC_AND || ast->op == TOKEN_LOGIC_OR) {
+    compile_expression(c, ast->left, dst);
+    size_t jump = emit_jump(c,
+        ast->op == TOKEN_LOGIC_AND ? OP_JMPF : OP_JMPT, dst);
+    compile_expression(c, ast->right, dst);
+    patch_jump(c, jump);
+    return;
+  }
+
+  uint8_t left = compile_operand(c, ast->left);
+  uint8_t right = compile_operand(c, ast->right);
+  compile_arith(c, ast->op, dst, left, right);
+}
+
+
+// whether compiling ast straight into a local's register is safe, i.e. the
+// destination is only written by the last instruction
+static bool writes_once(const struct Nodes* nodes, uint32_t ast) {
+  switch(nodes->tags[ast]) {
+    case EXPR_LITERAL:
+    case EXPR_VARIABLE:
+    case EXPR_UNARY:
+    case EXPR_CALL:   return true;
+    case EXPR_BINARY: return nodes->ops[ast] != TOKEN_LOGIC_AND
+                        && nodes->ops[ast] != TOKEN_LOGIC_OR;
+    case EXPR_GROUP:  return writes_once(nodes, nodes->data[ast].lhs);
+    default:          return false;
+  }
+}
+
+// a global is worked on in a temporary, then written back
+static void compile_global_assign(struct Compiler* c, const struct Binary* ast,
+    const struct VarRef* ref, int dst) {
+  uint8_t value = push_register(c);
+
+  if(ast->op == TOKEN_ASSIGN) compile_expression(c, ast->right, value);
+  else {
+    emit_global(c, OP_GETG, value, ref->slot);
+    uint8_t right = compile_operand(c, ast->right);
+    compile_arith(c, ast->op - 1, value, value, right);
+  }
+
+  emit_global(c, OP_SETG, value, ref->slot);
+  emit_move(c, dst, value);
+}
+
+static void compile_assign(struct Compiler* c, const struct Binary* ast,
+    int dst) {
+  if(c->nodes->tags[ast->left] != EXPR_VARIABLE) {
+    compile_error(c, COMPILE_ERROR_NOT_ASSIGNABLE, NULL);
+    return;
+  }
+
+  struct VarRef ref = variable_of(c->nodes, ast->left);
+  if(ref.depth) {
+    compile_global_assign(c, ast, &ref, dst);
+    return;
+  }
+
+  uint8_t local = ref.slot;
+  if(ast->op == TOKEN_ASSIGN) {
+    if(writes_once(c->nodes, ast->right))
+      compile_expression(c, ast->right, local);
+    else {
+      uint8_t tmp = push_register(c);
+      compile_expression(c, ast->right, tmp);
+      emit_move(c, local, tmp);
+    }
+
+  } else {
+    // every compound assignment token directly follows its operator
+    uint8_t right = compile_operand(c, ast->right);
+    compile_arith(c, ast->op - 1, local, local, right);
+  }
+
+  emit_move(c, dst, local);
+}
+
+
+static void compile_jump_out(struct Compiler* c, const struct Unary* ast) {
+  if(!c->loop) {
+    compile_error(c, COMPILE_ERROR_OUTSIDE_LOOP, NULL);
+    return;
+  }
+
+  if(ast->op == TOKEN_BREAK) {
+    compile_expression(c, ast->operand, c->loop->dst);
+    APPEND_ARRAYLIST(&c->loop->breaks, emit_jump(c, OP_JMP, 0));
+  } else APPEND_ARRAYLIST(&c->loop->continues, emit_jump(c, OP_JMP, 0));
+}
+
+static void compile_unary(struct Compiler* c, const struct Unary* ast,
+    int dst) {
+  switch(ast->op) {
+    case TOKEN_RETURN:
+      emit(c, ENCODE_ABC(OP_RET, compile_operand(c, ast->operand), 0, 0));
+      return;
+    case TOKEN_BREAK:
+    case TOKEN_CONTINUE:
+      compile_jump_out(c, ast);
+      return;
+    case TOKEN_SUB:
+      emit(c, ENCODE_ABC(OP_NEG, dst, compile_operand(c, ast->operand), 0));
+      return;
+    case TOKEN_BIT_NOT:
+    case TOKEN_LOGIC_NOT:
+      emit(c, ENCODE_ABC(OP_NOT, dst, compile_operand(c, ast->operand), 0));
+      return;
+    default:
+      compile_error(c, COMPILE_ERROR_UNSUPPORTED, token_strings[ast->op]);
+  }
+}
+
+
+// arguments are evaluated into consecutive registers starting at c->top
+static size_t compile_arguments(struct Compiler* c,
+    const struct ExprList* args) {
+  for(size_t i = 0; i < args->size; i++)
+    compile_expression(c, list_member(c->nodes, args, i), push_register(c));
+
+  return args->size;
+}
+
+static void compile_call(struct Compiler* c, const struct Call* ast,
+    int dst) {
+  if(!is_identifier(c->nodes, ast->callee)) {
+    compile_error(c, COMPILE_ERROR_UNSUPPORTED, "call of non-identifier");
+    return;
+  }
+
+  const char* name = literal_of(c->nodes, ast->callee).as.string;
+  size_t function = hm_get(&c->functions, name);
+
+  // the result lands in the base register, even when there are no arguments
+  uint8_t base = push_register(c);
+  c->top = base;
+
+  if(!function && name == intern_cstr("print")) {
+    size_t count = compile_arguments(c, &ast->arguments);
+    emit(c, ENCODE_ABC(OP_PRINT, base, count, 0));
+    if(dst != DISCARD) emit(c, ENCODE_ABC(OP_LOADNIL, dst, 0, 0));
+    return;
+  }
+
+  if(!function) {
+    compile_error(c, COMPILE_ERROR_UNDEFINED_FUNCTION, name);
+    return;
+  }
+
+  size_t count = compile_arguments(c, &ast->arguments);
+  if(count != c->program->protos.members[function - 1]->arity)
+    compile_error(c, COMPILE_ERROR_ARITY, name);
+
+  emit(c, ENCODE_ABX(OP_CALL, base, function - 1));
+  emit_move(c, dst, base);
+}
+
+
+static void compile_if(struct Compiler* c, const struct IfWhile* ast,
+    int dst) {
+  size_t top = c->top;
+  size_t skip_body = emit_jump(c, OP_JMPF, compile_operand(c, ast->condition));
+  c->top = top;
+
+  compile_expression(c, ast->body, dst);
+
+  if(!ast->else_clause && dst == DISCARD) {
+    patch_jump(c, skip_body);
+    return;
+  }
+
+  size_t skip_else = emit_jump(c, OP_JMP, 0);
+  patch_jump(c, skip_body);
+
+  if(ast->else_clause) compile_expression(c, ast->else_clause, dst);
+  else emit(c, ENCODE_ABC(OP_LOADNIL, dst, 0, 0));
+
+  patch_jump(c, skip_else);
+}
+
+
+// the condition is tested at the bottom so each iteration costs one jump:
+//       jmp cond
+// body: ...
+// cond: jmpt cond, body
+//       else clause; breaks land after it
+static void compile_while(struct Compiler* c, const struct IfWhile* ast,
+    int dst) {
+  struct Loop loop = { .dst = dst, .enclosing = c->loop };
+  NEW_ARRAYLIST(&loop.breaks);
+  NEW_ARRAYLIST(&loop.continues);
+
+  size_t to_condition = emit_jump(c, OP_JMP, 0);
+  loop.start = c->proto->code.size;
+
+  c->loop = &loop;
+  compile_expression(c, ast->body, DISCARD);
+  c->loop = loop.enclosing;
+
+  patch_jump(c, to_condition);
+  patch_jumps(c, &loop.continues);
+
+  size_t top = c->top;
+  emit_jump_to(c, OP_JMPT, compile_operand(c, ast->condition), loop.start);
+  c->top = top;
+
+  if(ast->else_clause) compile_expression(c, ast->else_clause, dst);
+  else if(dst != DISCARD) emit(c, ENCODE_ABC(OP_LOADNIL, dst, 0, 0));
+
+  patch_jumps(c, &loop.breaks);
+}
+
+// the same shape, with the step between the body and the condition:
+//       init
+//       jmp cond
+// body: ...
+//       step; continues land here
+// cond: jmpt cond, body
+static void compile_for(struct Compiler* c, const struct ForLoop* ast,
+    int dst) {
+  struct Loop loop = { .dst = dst, .enclosing = c->loop };
+  NEW_ARRAYLIST(&loop.breaks);
+  NEW_ARRAYLIST(&loop.continues);
+
+  if(has_statement(&ast->init)) compile_statement(c, &ast->init);
+
+  size_t to_condition = emit_jump(c, OP_JMP, 0);
+  loop.start = c->proto->code.size;
+
+  c->loop = &loop;
+  compile_expression(c, ast->body, DISCARD);
+  c->loop = loop.enclosing;
+
+  patch_jumps(c, &loop.continues);
+  if(ast->step) compile_expression(c, ast->step, DISCARD);
+  patch_jump(c, to_condition);
+
+  size_t top = c->top;
+  if(ast->condition)
+    emit_jump_to(c, OP_JMPT, compile_operand(c, ast->condition), loop.start);
+  else emit_jump_to(c, OP_JMP, 0, loop.start);
+  c->top = top;
+
+  if(dst != DISCARD) emit(c, ENCODE_ABC(OP_LOADNIL, dst, 0, 0));
+  patch_jumps(c, &loop.breaks);
+}
+
+
+// whether an expression does anything useful with a DISCARD destination
+static bool is_discardable(const struct Nodes* nodes, uint32_t ast) {
+  switch(nodes->tags[ast]) {
+    case EXPR_ASSIGN:
+    case EXPR_BLOCK:
+    case EXPR_IF:
+    case EXPR_WHILE:
+    case EXPR_FOR:
+    case EXPR_CALL:  return true;
+    case EXPR_UNARY: return nodes->ops[ast] == TOKEN_RETURN
+                       || nodes->ops[ast] == TOKEN_BREAK
+                       || nodes->ops[ast] == TOKEN_CONTINUE;
+    case EXPR_GROUP: return is_discardable(nodes, nodes->data[ast].lhs);
+    default:         return false;
+  }
+}
+
+// temporaries used by an expression are released once its compiled
+static void compile_expression(struct Compiler* c, uint32_t ast, int dst) {
+  const struct Nodes* nodes = c->nodes;
+  size_t top = c->top;
+  uint32_t node = c->node;
+  c->node = ast;
+  if(dst == DISCARD && !is_discardable(nodes, ast)) dst = push_register(c);
+
+  switch((enum ExprType)nodes->tags[ast]) {
+    case EXPR_LITERAL:
+      emit_constant(c, literal_of(nodes, ast), dst);
+      break;
+    case EXPR_VARIABLE: {
+      struct VarRef ref = variable_of(nodes, ast);
+      compile_reference(c, &ref, dst);
+      break;
+    }
+    case EXPR_UNARY: {
+      struct Unary unary = unary_of(nodes, ast);
+      compile_unary(c, &unary, dst);
+      break;
+    }
+    case EXPR_BINARY: {
+      struct Binary binary = binary_of(nodes, ast);
+      compile_binary(c, &binary, dst);
+      break;
+    }
+    case EXPR_GROUP:
+      compile_expression(c, nodes->data[ast].lhs, dst);
+      break;
+    case EXPR_CALL: {
+      struct Call call = call_of(nodes, ast);
+      compile_call(c, &call, dst);
+      break;
+    }
+    case EXPR_ASSIGN: {
+      struct Binary binary = binary_of(nodes, ast);
+      compile_assign(c, &binary, dst);
+      break;
+    }
+    case EXPR_BLOCK:
+      compile_block(c, ast, dst);
+      break;
+    case EXPR_IF: {
+      struct IfWhile ifwhile = ifwhile_of(nodes, ast);
+      compile_if(c, &ifwhile, dst);
+      break;
+    }
+    case EXPR_WHILE: {
+      struct IfWhile ifwhile = ifwhile_of(nodes, ast);
+      compile_while(c, &ifwhile, dst);
+      break;
+    }
+    case EXPR_FOR: {
+      struct ForLoop loop = forloop_of(nodes, ast);
+      compile_for(c, &loop, dst);
+      break;
+    }
+    case EXPR_FIELD:
+    case EXPR_ARRAY_INDEX:
+    case EXPR_ARRAY_INIT:
+    case EXPR_CAST:
+      compile_error(c, COMPILE_ERROR_UNSUPPORTED, NULL);
+      break;
+  }
+
+  c->top = top;
+  c->node = node;
+}
+
+
+static void compile_variable(struct Compiler* c, struct Variable* ast) {
+  // the initializer can't see its own slot, so it can be written directly
+  for(size_t i = 0; i < ast->vars->size; i++) {
+    const struct VarDecl* var = &ast->vars->members[i];
+    uint8_t reg = var->lvalue.slot;
+
+    if(var->rvalue) compile_expression(c, var->rvalue, reg);
+    else emit(c, ENCODE_ABC(OP_LOADNIL, reg, 0, 0));
+  }
+}
+
+static void compile_statement(struct Compiler* c,
+    const struct Statement* ast) {
+  switch(ast->type) {
+    case STMT_EXPR:  compile_expression(c, ast->as.expr, DISCARD); break;
+    case STMT_VAR:
+      if(c->function) compile_variable(c, ast->as.var);
+      else compile_error(c, COMPILE_ERROR_UNSUPPORTED, "local in a global");
+      break;
+    case STMT_BLOCK: {
+      size_t top = c->top;
+      compile_block(c, ast->as.block, DISCARD);
+      c->top = top;
+    } break;
+  }
+}
+
+static void compile_block(struct Compiler* c, uint32_t ast, int dst) {
+  struct Block block = block_of(c->nodes, ast);
+
+  for(size_t i = 0; i < block.size; i++) {
+    struct Statement stmt = block_statement(c->nodes, &block, i);
+    compile_statement(c, &stmt);
+  }
+
+  if(block.expr) compile_expression(c, block.expr, dst);
+  else if(dst != DISCARD) emit(c, ENCODE_ABC(OP_LOADNIL, dst, 0, 0));
+}
+
+
+static void compile_function(struct Compiler* c, struct Function* ast,
+    struct Proto* proto) {
+  c->proto = proto;
+  c->function = ast;
+  c->loop = NULL;
+  c->file = ast->file;
+  c->node = ast->body;
+
+  // the caller leaves the arguments in the first registers, which are also
+  // the first slots
+  if(ast->slots >= MAX_REGISTERS) {
+    compile_error(c, COMPILE_ERROR_TOO_MANY_REGISTERS, NULL);
+    return;
+  }
+  c->top = proto->registers = ast->slots;
+
+  uint8_t result = push_register(c);
+  compile_block(c, ast->body, result);
+  emit(c, ENCODE_ABC(OP_RET, result, 0, 0));
+}
+
+
+// the initializers run in order before main, whose parameters are left
+// undefined like the tree walker leaves them, and whose result is the
+// program's
+static void compile_globals(struct Compiler* c, struct AST* ast,
+    struct Proto* proto, size_t main) {
+  c->proto = proto;
+  c->function = NULL;
+  c->loop = NULL;
+  c->top = 0;
+
+  for(size_t i = 0; i < ast->size; i++) {
+    if(ast->members[i]->type != DECL_VAR) continue;
+    c->file = ast->members[i]->file;
+    c->node = 0;
+
+    struct VarDeclList* vars = ast->members[i]->as.var->vars;
+    for(size_t v = 0; v < vars->size; v++) {
+      uint8_t reg = push_register(c);
+      if(vars->members[v].rvalue)
+        compile_expression(c, vars->members[v].rvalue, reg);
+      else emit(c, ENCODE_ABC(OP_LOADNIL, reg, 0, 0));
+
+      emit_global(c, OP_SETG, reg, vars->members[v].lvalue.slot);
+      c->top = 0;
+    }
+  }
+
+  // the result lands in the base register, like any call's
+  uint8_t base = push_register(c);
+  c->top = base;
+  for(size_t i = 0; i < c->program->protos.members[main]->arity; i++)
+    emit(c, ENCODE_ABC(OP_LOADNIL, push_register(c), 0, 0));
+
+  emit(c, ENCODE_ABX(OP_CALL, base, main));
+  emit(c, ENCODE_ABC(OP_RET, base, 0, 0));
+}
+
+// the function the nth proto was declared for, which are in the same order
+static struct Function* nth_function(const struct AST* ast, size_t n) {
+  for(size_t i = 0; i < ast->size; i++)
+    if(ast->members[i]->type == DECL_FUNC && n-- == 0)
+      return ast->members[i]->as.function;
+  return NULL;
+}
+
+// every function is declared before any is compiled, so calls can refer to
+// functions defined further down
+static void declare_function(struct Compiler* c, const struct AST* tree,
+    struct Function* ast) {
+  const char* name = ast->sig->name ? : intern_cstr("<anonymous function>");
+
+  struct Proto* proto = alloc_proto(name);
+  proto->arity = count_vardecls(ast->sig->args);
+  APPEND_ARRAYLIST(&c->program->protos, proto);
+
+  c->file = ast->file;
+  c->node = ast->body;
+
+  size_t defined = hm_get(&c->functions, name);
+  if(!defined) {
+    hm_set(&c->functions, name, c->program->protos.size);
+    return;
+  }
+
+  struct Function* first = nth_function(tree, defined - 1);
+  compile_error(c, COMPILE_ERROR_REDEFINED_FUNCTION, name);
+  print_error_also("first defined", first->file,
+      c->nodes->offsets[first->body]);
+}
+
+struct Program* compile_tree(struct AST* ast) {
+  struct Compiler compiler = {
+    .nodes = &ast->nodes, .proto = NULL, .function = NULL,
+    .file = NULL, .node = 0, .had_error = false,
+  };
+  hm_init(&compiler.functions);
+
+  struct Program* program = stats_malloc(sizeof(*program));
+  NEW_ARRAYLIST(&program->protos);
+  compiler.program = program;
+
+  for(size_t i = 0; i < ast->size; i++)
+    if(ast->members[i]->type == DECL_FUNC)
+      declare_function(&compiler, ast, ast->members[i]->as.function);
+
+  size_t main = hm_get(&compiler.functions, intern_cstr("main"));
+  compiler.file = NULL;
+  if(!main) compile_error(&compiler, COMPILE_ERROR_NO_MAIN, NULL);
+
+  for(size_t i = 0, f = 0; i < ast->size; i++)
+    if(ast->members[i]->type == DECL_FUNC)
+      compile_function(&compiler, ast->members[i]->as.function,
+          program->protos.members[f++]);
+
+  struct Proto* init = alloc_proto(intern_cstr("<globals>"));
+  APPEND_ARRAYLIST(&program->protos, init);
+  program->entry = program->protos.size - 1;
+  program->globals = ast->globals;
+  if(main) compile_globals(&compiler, ast, init, main - 1);
+
+  hm_destroy(&compiler.functions);
+
+  if(!compiler.had_error) return program;
+  else return NULL;
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+#include "chunk.h"
+#include "../../parser/parser.h"
+
+struct Program* compile_tree(struct AST*);
@@ -0,0 +1,203 @@
+// vm.c
+
+#include "vm.h"
+#include "../../util/panic.h"
+#include "../../util/stats.h"
+#include <stdio.h>
+
+#define STACK_SIZE (1 << 16)
+#define FRAMES_MAX 1024
+
+struct CallFrame {
+  const struct Proto* proto;
+  const Instruction* ip;
+  struct Value* base;
+};
+
+static double to_float(const struct Value* value) {
+  if(MATCH_VAL(value, INT)) return (double)value->as.integer;
+  if(MATCH_VAL(value, FLOAT)) return value->as.floating;
+  panic(1, "expected a number");
+  return 0;
+}
+
+// everything that isn't int op int ends up here
+static struct Value arith_slow(enum Arith op, const struct Value* x,
+    const struct Value* y) {
+  struct Value result;
+  if(!arith_values(op, x, y, &result))
+    panic(1, "invalid operands for arithmetic");
+  return result;
+}
+
+struct Value run_program(const struct Program* program) {
+  static void* dispatch[OP_FINAL] = {
+    [OP_LOADK]   = &&do_loadk,   [OP_LOADNIL] = &&do_loadnil,
+    [OP_MOVE]    = &&do_move,
+    [OP_GETG]    = &&do_getg,    [OP_SETG]    = &&do_setg,
+    [OP_ADD]     = &&do_add,     [OP_SUB]     = &&do_sub,
+    [OP_MUL]     = &&do_mul,     [OP_DIV]     = &&do_div,
+    [OP_MOD]     = &&do_mod,     [OP_SHL]     = &&do_shl,
+    [OP_SHR]     = &&do_shr,     [OP_BAND]    = &&do_band,
+    [OP_BOR]     = &&do_bor,     [OP_BXOR]    = &&do_bxor,
+    [OP_EQ]      = &&do_eq,      [OP_NE]      = &&do_ne,
+    [OP_LT]      = &&do_lt,      [OP_LE]      = &&do_le,
+    [OP_NEG]     = &&do_neg,     [OP_NOT]     = &&do_not,
+    [OP_JMP]     = &&do_jmp,     [OP_JMPF]    = &&do_jmpf,
+    [OP_JMPT]    = &&do_jmpt,    [OP_CALL]    = &&do_call,
+    [OP_PRINT]   = &&do_print,   [OP_RET]     = &&do_ret,
+  };
+
+  struct Value* stack = stats_calloc(STACK_SIZE, sizeof(*stack));
+  struct CallFrame* frames = stats_malloc(FRAMES_MAX * sizeof(*frames));
+  struct Value* globals = stats_calloc(program->globals, sizeof(*globals));
+  struct Value result;
+
+  const struct Proto* const* protos =
+    (const struct Proto* const*)program->protos.members;
+  struct CallFrame* frame = frames;
+  frame->proto = protos[program->entry];
+  frame->base = stack;
+
+  // hot state is kept in locals and written back to the frame on calls
+  const Instruction* ip = frame->proto->code.members;
+  const struct Value* k = frame->proto->constants.members;
+  struct Value* base = stack;
+  Instruction i;
+
+#define R(x) (base[x])
+#define DISPATCH() goto *dispatch[INSTR_OP(i = *ip++)]
+
+#define INT_OP(op, fast) do { \
+    const struct Value* x = &R(INSTR_B(i)); \
+    const struct Value* y = &R(INSTR_C(i)); \
+    if(MATCH_VAL(x, INT) && MATCH_VAL(y, INT)) R(INSTR_A(i)) = fast; \
+    else R(INSTR_A(i)) = arith_slow(op, x, y); \
+    DISPATCH(); \
+  } while(0)
+
+#define ARITH(op, sym) \
+  INT_OP(op, INT_VAL(FROM_INT(x) sym FROM_INT(y)))
+#define COMPARE(op, sym) \
+  INT_OP(op, BOOL_VAL(FROM_INT(x) sym FROM_INT(y)))
+#define DIVIDE(op, sym) do { \
+    if(MATCH_VAL(&R(INSTR_C(i)), INT) && FROM_INT(&R(INSTR_C(i))) == 0) \
+      panic(1, "division by zero"); \
+    ARITH(op, sym); \
+  } while(0)
+#define BITWISE(sym) do { \
+    const struct Value* x = &R(INSTR_B(i)); \
+    const struct Value* y = &R(INSTR_C(i)); \
+    if(!MATCH_VAL(x, INT) || !MATCH_VAL(y, INT)) \
+      panic(1, "invalid operands for bitwise operation"); \
+    R(INSTR_A(i)) = INT_VAL(FROM_INT(x) sym FROM_INT(y)); \
+    DISPATCH(); \
+  } while(0)
+
+  DISPATCH();
+
+do_loadk:   R(INSTR_A(i)) = k[INSTR_BX(i)];  DISPATCH();
+do_loadnil: R(INSTR_A(i)).type = VAL_UNDEFINED; DISPATCH();
+do_move:    R(INSTR_A(i)) = R(INSTR_B(i));   DISPATCH();
+do_getg:    R(INSTR_A(i)) = globals[INSTR_BX(i)]; DISPATCH();
+do_setg:    globals[INSTR_BX(i)] = R(INSTR_A(i)); DISPATCH();
+
+do_add:  ARITH(ARITH_ADD, +);
+do_sub:  ARITH(ARITH_SUB, -);
+do_mul:  ARITH(ARITH_MUL, *);
+do_div:  DIVIDE(ARITH_DIV, /);
+do_mod:  DIVIDE(ARITH_MOD, %);
+do_shl:  BITWISE(<<);
+do_shr:  BITWISE(>>);
+do_band: BITWISE(&);
+do_bor:  BITWISE(|);
+do_bxor: BITWISE(^);
+do_eq:   COMPARE(ARITH_EQ, ==);
+do_ne:   COMPARE(ARITH_NE, !=);
+do_lt:   COMPARE(ARITH_LT, <);
+do_le:   COMPARE(ARITH_LE, <=);
+
+do_neg: {
+    const struct Value* x = &R(INSTR_B(i));
+    if(MATCH_VAL(x, INT)) R(INSTR_A(i)) = INT_VAL(-FROM_INT(x));
+    else R(INSTR_A(i)) = FLOAT_VAL(-to_float(x));
+    DISPATCH();
+  }
+do_not: {
+    const struct Value* x = &R(INSTR_B(i));
+    if(MATCH_VAL(x, INT)) R(INSTR_A(i)) = INT_VAL(~FROM_INT(x));
+    else R(INSTR_A(i)) = BOOL_VAL(!is_truthy(x));
+    DISPATCH();
+  }
+
+do_jmp:
+  ip += INSTR_SBX(i);
+  DISPATCH();
+do_jmpf: {
+    const struct Value* x = &R(INSTR_A(i));
+    if(MATCH_VAL(x, BOOL) ? !x->as.boolean : !is_truthy(x))
+      ip += INSTR_SBX(i);
+    DISPATCH();
+  }
+do_jmpt: {
+    const struct Value* x = &R(INSTR_A(i));
+    if(MATCH_VAL(x, BOOL) ? x->as.boolean : is_truthy(x))
+      ip += INSTR_SBX(i);
+    DISPATCH();
+  }
+
+do_call: {
+    const struct Proto* callee = protos[INSTR_BX(i)];
+    struct Value* callee_base = base + INSTR_A(i);
+
+    if(frame - frames + 1 >= FRAMES_MAX
+        || callee_base + callee->registers > stack + STACK_SIZE)
+      panic(1, "stack overflow");
+
+    frame->ip = ip;
+    frame += 1;
+    frame->proto = callee;
+    frame->base = callee_base;
+
+    ip = callee->code.members;
+    k = callee->constants.members;
+    base = callee_base;
+    DISPATCH();
+  }
+
+do_print:
+  for(size_t arg = 0; arg < INSTR_B(i); arg++) {
+    if(arg) printf(" ");
+    print_value(&R(INSTR_A(i) + arg));
+  }
+  printf("\n");
+  DISPATCH();
+
+do_ret:
+  // the callee's first register is the caller's destination register
+  if(frame == frames) {
+    result = R(INSTR_A(i));
+    goto done;
+  }
+  base[0] = R(INSTR_A(i));
+
+  frame -= 1;
+  ip = frame->ip;
+  k = frame->proto->constants.members;
+  base = frame->base;
+  DISPATCH();
+
+done:
+  free(globals);
+  free(frames);
+  free(stack);
+  return result;
+
+#undef R
+#undef DISPATCH
+#undef INT_OP
+#undef ARITH
+#undef COMPARE
+#undef DIVIDE
+#undef BITWISE
+}
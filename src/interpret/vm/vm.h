@@ -0,0 +1,5 @@
+#pragma once
+
+#include "chunk.h"
+
+struct Value run_program(const struct Program*);
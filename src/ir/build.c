@@ -0,0 +1,925 @@
+// build.c
+
+#include "ir.h"
+#include "../parser/declaration.h"
+#include "../parser/expression.h"
+#include "../util/hash.h"
+#include "../util/intern.h"
+#include <stdio.h>
+
+// builds ssa straight from the ast with the algorithm of braun et al.: every
+// local slot is a variable, each block remembers the value its variables end
+// up with, and reading one that a block doesn't define looks through its
+// predecessors, placing phis where they meet. a block is sealed once all its
+// predecessors are known; until then, reads in it get placeholder phis that
+// are completed when it is. trivial phis are left for the copy propagation
+// pass to remove
+//
+// every value is an untyped word, so the only thing the kinds decide while
+// building is how print is told to show each argument. a local's kind is
+// that of whatever was last assigned to it, like in the tree walker, as
+// long as every path agrees on it; a global keeps the kind it starts with
+
+enum IRErrorType {
+  IR_ERROR_UNSUPPORTED,
+  IR_ERROR_UNDEFINED_FUNCTION,
+  IR_ERROR_REDEFINED_FUNCTION,
+  IR_ERROR_NOT_ASSIGNABLE,
+  IR_ERROR_KIND_BY_PATH,
+  IR_ERROR_GLOBAL_KIND,
+  IR_ERROR_ARITY,
+  IR_ERROR_OUTSIDE_LOOP,
+  IR_ERROR_NO_MAIN,
+
+  IR_ERROR_FINAL,
+};
+
+static const char* ir_error_strings[IR_ERROR_FINAL] = {
+  "unsupported by the native backends",
+  "undefined function",
+  "function is already defined",
+  "expression is not assignable",
+  "variable holds a different kind of value on different paths",
+  "global is assigned a different kind of value than it started with",
+  "wrong number of arguments",
+  "break or continue outside of a loop",
+  "no main function",
+};
+
+// a block that control flow with a value meets at, with the value each
+// incoming edge brings, in the order of the block's predecessors
+struct Join {
+  struct IRBlock* block;
+  struct IRInstrs values;
+};
+
+struct Loop {
+  struct IRBlock* next; // where continue jumps
+  struct Join* end;     // and break
+  enum Kind kind;       // of the first break's value
+  bool broken;
+  struct Loop* enclosing;
+};
+
+struct Builder {
+  const struct Nodes* nodes;
+  struct IRProgram* program;
+  struct IRFunction* fn;
+  struct Function* function; // NULL while initializing globals
+  struct HashMap functions;  // name -> struct Function*
+  struct Slot* locals;
+  struct Slot* globals;
+  struct IRBlock* block;     // where instructions are appended
+  struct Loop* loop;
+  const char* file;          // of the declaration being built
+  uint32_t node;             // being built, which errors are reported at
+  bool had_error;
+};
+
+// a value and its static kind, which can differ from the kind of the
+// instruction that produced it, e.g. an int constant stored in an isize
+struct Operand {
+  struct IRInstr* value;
+  enum Kind kind;
+};
+
+
+// errors without a file are the whole program's
+static void ir_error(struct Builder* b, enum IRErrorType type,
+    const char* detail) {
+  b->had_error = true;
+
+  if(b->file) print_error_at(b->file, b->nodes->offsets[b->node]);
+  else print_error_place("<program>");
+  if(detail) printf(" at \"%s\"", detail);
+  printf("\n");
+  print_error_message(IR_ERROR_CODES + type, ir_error_strings[type]);
+}
+
+
+
+// ### EMITTING FUNCTIONS ### //
+
+static struct IRInstr* emit(struct Builder* b, enum IROp op, enum Kind kind,
+    size_t nargs) {
+  struct IRInstr* instr = ir_instr(b->fn, op, kind, nargs);
+  ir_append(b->block, instr);
+  return instr;
+}
+
+static struct IRInstr* emit_constant(struct Builder* b, uint64_t value,
+    enum Kind kind) {
+  struct IRInstr* instr = emit(b, IR_CONST, kind, 0);
+  instr->imm = value;
+  return instr;
+}
+
+static struct IRInstr* emit_unary(struct Builder* b, enum IROp op,
+    enum Kind kind, struct IRInstr* operand) {
+  struct IRInstr* instr = emit(b, op, kind, 1);
+  instr->args[0] = operand;
+  return instr;
+}
+
+// code after a terminator is unreachable, but still has to go somewhere, so
+// it gets a block of its own that ir_order_blocks drops
+static void emit_terminator(struct Builder* b, struct IRInstr* instr) {
+  ir_append(b->block, instr);
+
+  b->block = ir_block(b->fn);
+  b->block->sealed = true;
+}
+
+static void emit_jump(struct Builder* b, struct IRBlock* to) {
+  struct IRBlock* from = b->block;
+  emit_terminator(b, ir_instr(b->fn, IR_JUMP, KIND_NONE, 0));
+  ir_add_edge(from, to);
+}
+
+static void emit_branch(struct Builder* b, struct IRInstr* condition,
+    struct IRBlock* then, struct IRBlock* otherwise) {
+  struct IRBlock* from = b->block;
+  struct IRInstr* branch = ir_instr(b->fn, IR_BRANCH, KIND_NONE, 1);
+  branch->args[0] = condition;
+
+  emit_terminator(b, branch);
+  ir_add_edge(from, then);
+  ir_add_edge(from, otherwise);
+}
+
+
+
+// ### VARIABLES ### //
+
+static void write_variable(struct IRBlock* block, size_t var,
+    struct IRInstr* value) {
+  for(size_t i = 0; i < block->defs.size; i++)
+    if(block->defs.members[i].var == var) {
+      block->defs.members[i].value = value;
+      return;
+    }
+
+  struct IRDef def = { var, value };
+  APPEND_ARRAYLIST(&block->defs, def);
+}
+
+// phis go before everything else in their block
+static struct IRInstr* new_phi(struct Builder* b, struct IRBlock* block,
+    size_t var, enum Kind kind) {
+  struct IRInstr* phi = ir_instr(b->fn, IR_PHI, kind, 0);
+  phi->imm = var;
+  ir_insert(block, 0, phi);
+  return phi;
+}
+
+static struct IRInstr* read_variable(struct Builder*, struct IRBlock*,
+    size_t);
+
+static bool is_dead(const struct IRFunction* fn, const struct IRBlock* block) {
+  return block->preds.size == 0 && block != fn->blocks.members[0];
+}
+
+static void add_phi_operands(struct Builder* b, struct IRInstr* phi) {
+  struct IRBlock* block = phi->block;
+
+  phi->nargs = block->preds.size;
+  phi->args = arena_alloc(&b->fn->arena, phi->nargs * sizeof(*phi->args));
+
+  for(size_t i = 0; i < phi->nargs; i++)
+    phi->args[i] = read_variable(b, block->preds.members[i], phi->imm);
+
+  // the phi's kind was the variable's when it was made, and a print may
+  // already have been told it. code after a return, break or continue is
+  // built into a block nothing jumps to, whose values never arrive
+  for(size_t i = 0; i < phi->nargs; i++)
+    if(phi->args[i] != phi && phi->args[i]->kind != phi->kind
+        && !is_dead(b->fn, block->preds.members[i])) {
+      ir_error(b, IR_ERROR_KIND_BY_PATH, b->locals[phi->imm].name);
+      return;
+    }
+}
+
+// a variable nothing defines is undefined, which only happens in blocks
+// without predecessors
+static struct IRInstr* undefined_value(struct Builder* b,
+    struct IRBlock* block) {
+  struct IRInstr* instr = ir_instr(b->fn, IR_CONST, KIND_NONE, 0);
+  ir_insert(block, 0, instr);
+  return instr;
+}
+
+static struct IRInstr* read_variable(struct Builder* b, struct IRBlock* block,
+    size_t var) {
+  for(size_t i = 0; i < block->defs.size; i++)
+    if(block->defs.members[i].var == var) return block->defs.members[i].value;
+
+  struct IRInstr* value;
+
+  if(!block->sealed) {
+    value = new_phi(b, block, var, b->locals[var].kind);
+    APPEND_ARRAYLIST(&block->incomplete, value);
+  } else if(block->preds.size == 0) {
+    value = undefined_value(b, block);
+  } else if(block->preds.size == 1) {
+    value = read_variable(b, block->preds.members[0], var);
+  } else {
+    // the phi is defined first so loops find it instead of recursing
+    value = new_phi(b, block, var, b->locals[var].kind);
+    write_variable(block, var, value);
+    add_phi_operands(b, value);
+  }
+
+  write_variable(block, var, value);
+  return value;
+}
+
+static void seal_block(struct Builder* b, struct IRBlock* block) {
+  for(size_t i = 0; i < block->incomplete.size; i++)
+    add_phi_operands(b, block->incomplete.members[i]);
+
+  block->incomplete.size = 0;
+  block->sealed = true;
+}
+
+
+static void init_join(struct Builder* b, struct Join* join) {
+  join->block = ir_block(b->fn);
+  NEW_ARRAYLIST(&join->values);
+}
+
+static void join_edge(struct Builder* b, struct Join* join,
+    struct IRInstr* value) {
+  emit_jump(b, join->block);
+  APPEND_ARRAYLIST(&join->values, value);
+}
+
+// continues in the join's block with the value the edges brought
+static struct IRInstr* finish_join(struct Builder* b, struct Join* join,
+    enum Kind kind) {
+  seal_block(b, join->block);
+  b->block = join->block;
+
+  struct IRInstr* value = NULL;
+  if(join->values.size) {
+    value = new_phi(b, join->block, 0, kind);
+    value->nargs = join->values.size;
+    value->args = arena_alloc(&b->fn->arena,
+        value->nargs * sizeof(*value->args));
+
+    for(size_t i = 0; i < value->nargs; i++)
+      value->args[i] = join->values.members[i];
+  } else value = emit_constant(b, 0, KIND_NONE);
+
+  free(join->values.members);
+  return value;
+}
+
+
+
+// ### BUILDING FUNCTIONS ### //
+
+static struct Operand build_expression(struct Builder*, uint32_t);
+static struct Operand build_block(struct Builder*, uint32_t);
+static void build_statement(struct Builder*, const struct Statement*);
+
+static struct Operand undefined(struct Builder* b) {
+  return (struct Operand){ emit_constant(b, 0, KIND_NONE), KIND_NONE };
+}
+
+// locals don't exist while globals are initialized
+static struct Slot* slot_of(struct Builder* b, const struct VarRef* ref) {
+  if(ref->depth == 1) return &b->globals[ref->slot];
+  if(b->function) return &b->locals[ref->slot];
+
+  ir_error(b, IR_ERROR_UNSUPPORTED, ref->name);
+  return NULL;
+}
+
+
+static struct Operand build_literal(struct Builder* b,
+    const struct Value* ast) {
+  switch(ast->type) {
+    case VAL_UNDEFINED: return undefined(b);
+    case VAL_INT:
+      return (struct Operand){
+        emit_constant(b, ast->as.integer, KIND_INT), KIND_INT };
+    case VAL_BOOL:
+      return (struct Operand){
+        emit_constant(b, ast->as.boolean, KIND_BOOL), KIND_BOOL };
+    case VAL_CHAR:
+      return (struct Operand){
+        emit_constant(b, ast->as.character, KIND_CHAR), KIND_CHAR };
+    case VAL_STRING: {
+      struct IRInstr* instr = emit(b, IR_STRING, KIND_STRING, 0);
+      instr->name = ast->as.string;
+      return (struct Operand){ instr, KIND_STRING };
+    }
+    default:
+      ir_error(b, IR_ERROR_UNSUPPORTED,
+          ast->type == VAL_FLOAT ? "float" : NULL);
+      return undefined(b);
+  }
+}
+
+
+static struct Operand build_variable_ref(struct Builder* b,
+    const struct VarRef* ast) {
+  struct Slot* slot = slot_of(b, ast);
+  if(!slot) return undefined(b);
+
+  if(ast->depth == 0) {
+    struct IRInstr* value = read_variable(b, b->block, ast->slot);
+    return (struct Operand){ value, value->kind };
+  }
+
+  struct IRInstr* load = emit(b, IR_LOAD, slot->kind, 0);
+  load->imm = ast->slot;
+  return (struct Operand){ load, slot->kind };
+}
+
+// the value as stored
+static struct IRInstr* build_store(struct Builder* b, const struct VarRef* ref,
+    struct IRInstr* value) {
+  struct Slot* slot = slot_of(b, ref);
+  if(!slot) return value;
+
+  if(ref->depth == 0) {
+    write_variable(b->block, ref->slot, value);
+    slot->kind = value->kind;
+  } else {
+    struct IRInstr* store = emit(b, IR_STORE, KIND_NONE, 1);
+    store->imm = ref->slot;
+    store->args[0] = value;
+  }
+
+  return value;
+}
+
+
+static struct IRInstr* build_return(struct Builder* b,
+    struct IRInstr* value) {
+  struct IRInstr* ret = ir_instr(b->fn, IR_RETURN, KIND_NONE, 1);
+  ret->args[0] = value;
+
+  emit_terminator(b, ret);
+  return ret;
+}
+
+static struct Operand build_jump_out(struct Builder* b,
+    const struct Unary* ast) {
+  struct Loop* loop = b->loop;
+  if(!loop) {
+    ir_error(b, IR_ERROR_OUTSIDE_LOOP, NULL);
+    return undefined(b);
+  }
+
+  if(ast->op == TOKEN_CONTINUE) emit_jump(b, loop->next);
+  else {
+    struct Operand value = ast->operand
+      ? build_expression(b, ast->operand) : undefined(b);
+
+    if(!loop->broken) loop->kind = value.kind;
+    loop->broken = true;
+    join_edge(b, loop->end, value.value);
+  }
+
+  return undefined(b);
+}
+
+static struct Operand build_unary(struct Builder* b,
+    const struct Unary* ast) {
+  switch(ast->op) {
+    case TOKEN_RETURN:
+      if(!b->function) {
+        ir_error(b, IR_ERROR_UNSUPPORTED, "return in a global");
+        return undefined(b);
+      }
+      build_return(b, ast->operand
+          ? build_expression(b, ast->operand).value : undefined(b).value);
+      return undefined(b);
+    case TOKEN_BREAK:
+    case TOKEN_CONTINUE:
+      return build_jump_out(b, ast);
+    default: break;
+  }
+
+  struct Operand operand = build_expression(b, ast->operand);
+
+  switch(ast->op) {
+    case TOKEN_SUB:
+      return (struct Operand){
+        emit_unary(b, IR_NEG, KIND_INT, operand.value), KIND_INT };
+    case TOKEN_BIT_NOT:
+    case TOKEN_LOGIC_NOT:
+      if(operand.kind == KIND_INT)
+        return (struct Operand){
+          emit_unary(b, IR_NOT, operand.kind, operand.value), operand.kind };
+      return (struct Operand){
+        emit_unary(b, IR_LOGIC_NOT, KIND_BOOL, operand.value), KIND_BOOL };
+    default:
+      ir_error(b, IR_ERROR_UNSUPPORTED, token_strings[ast->op]);
+      return undefined(b);
+  }
+}
+
+
+// a && b is b if a is truthy, else a; a || b the other way around
+static struct Operand build_logic(struct Builder* b,
+    const struct Binary* ast) {
+  struct Join join;
+  init_join(b, &join);
+  struct IRBlock* right_block = ir_block(b->fn);
+
+  struct Operand left = build_expression(b, ast->left);
+  APPEND_ARRAYLIST(&join.values, left.value);
+
+  if(ast->op == TOKEN_LOGIC_AND)
+    emit_branch(b, left.value, right_block, join.block);
+  else emit_branch(b, left.value, join.block, right_block);
+
+  seal_block(b, right_block);
+  b->block = right_block;
+  struct Operand right = build_expression(b, ast->right);
+  join_edge(b, &join, right.value);
+
+  enum Kind kind = left.kind == right.kind ? left.kind : KIND_INT;
+  return (struct Operand){ finish_join(b, &join, kind), kind };
+}
+
+static struct Operand build_arith(struct Builder* b, enum TokenType op,
+    struct Operand left, struct Operand right) {
+  enum Kind kind = KIND_INT;
+  enum IROp code;
+
+  switch(op) {
+    case TOKEN_ADD:
+    case TOKEN_ADD_WRAP: code = IR_ADD; break;
+    case TOKEN_SUB:
+    case TOKEN_SUB_WRAP: code = IR_SUB; break;
+    case TOKEN_MUL:
+    case TOKEN_MUL_WRAP: code = IR_MUL; break;
+    case TOKEN_DIV:      code = IR_DIV; break;
+    case TOKEN_MOD:      code = IR_MOD; break;
+    case TOKEN_BIT_SHL:  code = IR_SHL; break;
+    case TOKEN_BIT_SHR:  code = IR_SHR; break;
+    case TOKEN_BIT_AND:  code = IR_AND; break;
+    case TOKEN_BIT_OR:   code = IR_OR;  break;
+    case TOKEN_BIT_XOR:  code = IR_XOR; break;
+    case TOKEN_EQ:       code = IR_EQ;  kind = KIND_BOOL; break;
+    case TOKEN_NOT_EQ:   code = IR_NE;  kind = KIND_BOOL; break;
+    case TOKEN_LT:       code = IR_LT;  kind = KIND_BOOL; break;
+    case TOKEN_LT_EQ:    code = IR_LE;  kind = KIND_BOOL; break;
+    case TOKEN_GT:       code = IR_GT;  kind = KIND_BOOL; break;
+    case TOKEN_GT_EQ:    code = IR_GE;  kind = KIND_BOOL; break;
+    default:
+      ir_error(b, IR_ERROR_UNSUPPORTED, token_strings[op]);
+      return undefined(b);
+  }
+
+  struct IRInstr* instr = emit(b, code, kind, 2);
+  instr->args[0] = left.value;
+  instr->args[1] = right.value;
+
+  return (struct Operand){ instr, kind };
+}
+
+static struct Operand build_binary(struct Builder* b,
+    const struct Binary* ast) {
+  if(ast->op == TOKEN_LOGIC_AND || ast->op == TOKEN_LOGIC_OR)
+    return build_logic(b, ast);
+
+  struct Operand left = build_expression(b, ast->left);
+  struct Operand right = build_expression(b, ast->right);
+  return build_arith(b, ast->op, left, right);
+}
+
+
+static struct Operand build_assign(struct Builder* b,
+    const struct Binary* ast) {
+  if(b->nodes->tags[ast->left] != EXPR_VARIABLE) {
+    ir_error(b, IR_ERROR_NOT_ASSIGNABLE, NULL);
+    return undefined(b);
+  }
+
+  struct VarRef variable = variable_of(b->nodes, ast->left);
+  const struct VarRef* ref = &variable;
+  struct Slot* slot = slot_of(b, ref);
+  if(!slot) return undefined(b);
+
+  // like the tree walker, the variable is read after the right side ran
+  struct Operand value = build_expression(b, ast->right);
+  if(ast->op != TOKEN_ASSIGN) {
+    // every compound assignment token directly follows its operator
+    struct Operand current = build_variable_ref(b, ref);
+    value = build_arith(b, ast->op - 1, current, value);
+  }
+  if(ref->depth && value.kind != slot->kind)
+    ir_error(b, IR_ERROR_GLOBAL_KIND, ref->name);
+
+  return (struct Operand){ build_store(b, ref, value.value), value.kind };
+}
+
+
+static struct Operand build_print(struct Builder* b,
+    const struct ExprList* args) {
+  if(!args->size) {
+    struct IRInstr* print = emit(b, IR_PRINT, KIND_NONE, 0);
+    print->imm = '\n';
+  }
+
+  for(size_t i = 0; i < args->size; i++) {
+    struct Operand value = build_expression(b, list_member(b->nodes, args, i));
+    struct IRInstr* print = emit(b, IR_PRINT, value.kind, 1);
+    print->args[0] = value.value;
+    print->imm = i + 1 < args->size ? ' ' : '\n';
+  }
+
+  return undefined(b);
+}
+
+static struct Operand build_call(struct Builder* b, const struct Call* ast) {
+  if(!is_identifier(b->nodes, ast->callee)) {
+    ir_error(b, IR_ERROR_UNSUPPORTED, "call of non-identifier");
+    return undefined(b);
+  }
+
+  const char* name = literal_of(b->nodes, ast->callee).as.string;
+  struct Function* function =
+    (struct Function*)hm_get(&b->functions, name);
+
+  if(!function && name == intern_cstr("print"))
+    return build_print(b, &ast->arguments);
+
+  if(!function) {
+    ir_error(b, IR_ERROR_UNDEFINED_FUNCTION, name);
+    return undefined(b);
+  }
+
+  size_t count = count_vardecls(function->sig->args);
+  size_t given = ast->arguments.size;
+  struct IRInstr** args = malloc((given ? given : 1) * sizeof(*args));
+
+  for(size_t i = 0; i < given; i++)
+    args[i] = build_expression(b,
+        list_member(b->nodes, &ast->arguments, i)).value;
+
+  if(given != count) {
+    ir_error(b, IR_ERROR_ARITY, name);
+    free(args);
+    return undefined(b);
+  }
+
+  enum Kind kind = type_kind(function->sig->returns, KIND_INT);
+  struct IRInstr* call = emit(b, IR_CALL, kind, count);
+  call->name = name;
+  for(size_t i = 0; i < count; i++) call->args[i] = args[i];
+
+  free(args);
+  return (struct Operand){ call, kind };
+}
+
+
+static struct Operand build_if(struct Builder* b,
+    const struct IfWhile* ast) {
+  struct IRBlock* then = ir_block(b->fn);
+  struct IRBlock* otherwise = ir_block(b->fn);
+  struct Join join;
+  init_join(b, &join);
+
+  emit_branch(b, build_expression(b, ast->condition).value, then, otherwise);
+  seal_block(b, then);
+  seal_block(b, otherwise);
+
+  b->block = then;
+  struct Operand body = build_expression(b, ast->body);
+  join_edge(b, &join, body.value);
+
+  b->block = otherwise;
+  struct Operand other = ast->else_clause
+    ? build_expression(b, ast->else_clause) : undefined(b);
+  join_edge(b, &join, other.value);
+
+  return (struct Operand){ finish_join(b, &join, body.kind), body.kind };
+}
+
+
+// the condition gets a block of its own, which continue jumps back to; it
+// stays unsealed until the body is built, since the body can jump to it
+static struct Operand build_while(struct Builder* b,
+    const struct IfWhile* ast) {
+  struct IRBlock* condition = ir_block(b->fn);
+  struct IRBlock* body = ir_block(b->fn);
+  struct IRBlock* exit = ir_block(b->fn);
+  struct Join end;
+  init_join(b, &end);
+
+  struct Loop loop = {
+    .next = condition, .end = &end, .kind = KIND_NONE, .broken = false,
+    .enclosing = b->loop,
+  };
+
+  emit_jump(b, condition);
+  b->block = condition;
+  emit_branch(b, build_expression(b, ast->condition).value, body, exit);
+  seal_block(b, body);
+  seal_block(b, exit);
+
+  b->block = body;
+  b->loop = &loop;
+  build_expression(b, ast->body);
+  b->loop = loop.enclosing;
+  emit_jump(b, condition);
+  seal_block(b, condition);
+
+  b->block = exit;
+  struct Operand other = ast->else_clause
+    ? build_expression(b, ast->else_clause) : undefined(b);
+  join_edge(b, &end, other.value);
+
+  enum Kind kind = loop.broken ? loop.kind : other.kind;
+  return (struct Operand){ finish_join(b, &end, kind), kind };
+}
+
+// the step gets a block between the body and the condition, which is where
+// continue jumps; that leaves the loop with a single back edge
+static struct Operand build_for(struct Builder* b,
+    const struct ForLoop* ast) {
+  if(has_statement(&ast->init)) build_statement(b, &ast->init);
+
+  struct IRBlock* condition = ir_block(b->fn);
+  struct IRBlock* body = ir_block(b->fn);
+  struct IRBlock* step = ir_block(b->fn);
+  struct IRBlock* exit = ir_block(b->fn);
+  struct Join end;
+  init_join(b, &end);
+
+  struct Loop loop = {
+    .next = step, .end = &end, .kind = KIND_NONE, .broken = false,
+    .enclosing = b->loop,
+  };
+
+  emit_jump(b, condition);
+  b->block = condition;
+  if(ast->condition)
+    emit_branch(b, build_expression(b, ast->condition).value, body, exit);
+  else emit_jump(b, body);
+  seal_block(b, body);
+  seal_block(b, exit);
+
+  b->block = body;
+  b->loop = &loop;
+  build_expression(b, ast->body);
+  b->loop = loop.enclosing;
+  emit_jump(b, step);
+  seal_block(b, step);
+
+  b->block = step;
+  if(ast->step) build_expression(b, ast->step);
+  emit_jump(b, condition);
+  seal_block(b, condition);
+
+  b->block = exit;
+  join_edge(b, &end, undefined(b).value);
+
+  enum Kind kind = loop.broken ? loop.kind : KIND_NONE;
+  return (struct Operand){ finish_join(b, &end, kind), kind };
+}
+
+
+static struct Operand build_node(struct Builder* b, uint32_t ast) {
+  const struct Nodes* nodes = b->nodes;
+
+  switch((enum ExprType)nodes->tags[ast]) {
+    case EXPR_LITERAL: {
+      struct Value literal = literal_of(nodes, ast);
+      return build_literal(b, &literal);
+    }
+    case EXPR_VARIABLE: {
+      struct VarRef ref = variable_of(nodes, ast);
+      return build_variable_ref(b, &ref);
+    }
+    case EXPR_UNARY: {
+      struct Unary unary = unary_of(nodes, ast);
+      return build_unary(b, &unary);
+    }
+    case EXPR_BINARY: {
+      struct Binary binary = binary_of(nodes, ast);
+      return build_binary(b, &binary);
+    }
+    case EXPR_GROUP:    return build_expression(b, nodes->data[ast].lhs);
+    case EXPR_CALL: {
+      struct Call call = call_of(nodes, ast);
+      return build_call(b, &call);
+    }
+    case EXPR_ASSIGN: {
+      struct Binary binary = binary_of(nodes, ast);
+      return build_assign(b, &binary);
+    }
+    case EXPR_BLOCK:    return build_block(b, ast);
+    case EXPR_IF: {
+      struct IfWhile ifwhile = ifwhile_of(nodes, ast);
+      return build_if(b, &ifwhile);
+    }
+    case EXPR_WHILE: {
+      struct IfWhile ifwhile = ifwhile_of(nodes, ast);
+      return build_while(b, &ifwhile);
+    }
+    case EXPR_FOR: {
+      struct ForLoop loop = forloop_of(nodes, ast);
+      return build_for(b, &loop);
+    }
+    case EXPR_FIELD:
+    case EXPR_ARRAY_INDEX:
+    case EXPR_ARRAY_INIT:
+    case EXPR_CAST:
+      ir_error(b, IR_ERROR_UNSUPPORTED, NULL);
+      break;
+  }
+
+  return undefined(b);
+}
+
+static struct Operand build_expression(struct Builder* b, uint32_t ast) {
+  uint32_t node = b->node;
+  b->node = ast;
+  struct Operand operand = build_node(b, ast);
+  b->node = node;
+  return operand;
+}
+
+
+// globals are variables declared while there is no function
+static void build_variable(struct Builder* b, struct Variable* ast) {
+  for(size_t i = 0; i < ast->vars->size; i++) {
+    const struct VarDecl* var = &ast->vars->members[i];
+    const struct LValue* lvalue = &var->lvalue;
+    struct VarRef ref = {
+      .name = lvalue->name, .depth = b->function ? 0 : 1, .slot = lvalue->slot,
+    };
+
+    struct Operand value = var->rvalue
+      ? build_expression(b, var->rvalue) : undefined(b);
+
+    struct Slot* slot = slot_of(b, &ref);
+    if(!slot) continue;
+    slot->name = lvalue->name;
+
+    // a global without an initializer has the kind it's declared with
+    if(!b->function)
+      slot->kind = var->rvalue ? value.kind
+        : type_kind(lvalue->type, KIND_NONE);
+    build_store(b, &ref, value.value);
+  }
+}
+
+static void build_statement(struct Builder* b, const struct Statement* ast) {
+  switch(ast->type) {
+    case STMT_EXPR:  build_expression(b, ast->as.expr); break;
+    case STMT_BLOCK: build_block(b, ast->as.block);     break;
+    case STMT_VAR:
+      if(b->function) build_variable(b, ast->as.var);
+      else ir_error(b, IR_ERROR_UNSUPPORTED, "local in a global");
+      break;
+  }
+}
+
+static struct Operand build_block(struct Builder* b, uint32_t ast) {
+  struct Block block = block_of(b->nodes, ast);
+
+  for(size_t i = 0; i < block.size; i++) {
+    struct Statement stmt = block_statement(b->nodes, &block, i);
+    build_statement(b, &stmt);
+  }
+
+  if(block.expr) return build_expression(b, block.expr);
+  return undefined(b);
+}
+
+
+static struct IRFunction* new_function(struct Builder* b, const char* name,
+    size_t arity) {
+  struct IRFunction* fn = malloc(sizeof(*fn));
+  fn->name = name;
+  fn->arity = arity;
+  fn->values = 0;
+  fn->block_ids = 0;
+  NEW_ARRAYLIST(&fn->blocks);
+  arena_init(&fn->arena);
+
+  b->fn = fn;
+  b->block = ir_block(fn);
+  b->block->sealed = true;
+  b->loop = NULL;
+  return fn;
+}
+
+// the building-only state of the blocks isn't needed past this point
+static void finish_function(struct IRFunction* fn) {
+  ir_order_blocks(fn);
+
+  for(size_t i = 0; i < fn->blocks.size; i++) {
+    struct IRBlock* block = fn->blocks.members[i];
+    block->defs.size = 0;
+    block->incomplete.size = 0;
+  }
+}
+
+static void build_function(struct Builder* b, struct Function* ast) {
+  size_t arity = count_vardecls(ast->sig->args);
+  struct IRFunction* fn = new_function(b, ast->sig->name, arity);
+  b->function = ast;
+  b->file = ast->file;
+  b->node = ast->body;
+  b->locals = alloc_slots(ast->slots);
+
+  for(size_t slot = 0; slot < arity; slot++) {
+    const struct LValue* lvalue = &ast->sig->args->members[slot].lvalue;
+    struct VarRef ref = { .name = lvalue->name, .depth = 0, .slot = slot };
+
+    b->locals[slot].name = lvalue->name;
+    b->locals[slot].kind = type_kind(lvalue->type, KIND_INT);
+
+    struct IRInstr* param = emit(b, IR_PARAM, b->locals[slot].kind, 0);
+    param->imm = slot;
+    build_store(b, &ref, param);
+  }
+
+  build_return(b, build_block(b, ast->body).value);
+  finish_function(fn);
+
+  APPEND_ARRAYLIST(&b->program->functions, fn);
+  if(ast->sig->name == intern_cstr("main")) b->program->main = fn;
+
+  free(b->locals);
+  b->function = NULL;
+}
+
+static void build_globals(struct Builder* b, struct AST* ast) {
+  b->program->init = new_function(b, NULL, 0);
+
+  for(size_t i = 0; i < ast->size; i++)
+    if(ast->members[i]->type == DECL_VAR) {
+      b->file = ast->members[i]->file;
+      b->node = 0;
+      build_variable(b, ast->members[i]->as.var);
+    }
+
+  build_return(b, undefined(b).value);
+  finish_function(b->program->init);
+}
+
+// every function is declared before any is built, so calls can refer to
+// functions defined further down
+static void declare_function(struct Builder* b, struct Function* ast) {
+  if(!ast->sig->name) return;
+  b->file = ast->file;
+  b->node = ast->body;
+
+  struct Function* first =
+    (struct Function*)hm_get(&b->functions, ast->sig->name);
+  if(!first) {
+    hm_set(&b->functions, ast->sig->name, (uintptr_t)ast);
+    return;
+  }
+
+  ir_error(b, IR_ERROR_REDEFINED_FUNCTION, ast->sig->name);
+  print_error_also("first defined", first->file,
+      b->nodes->offsets[first->body]);
+}
+
+struct IRProgram* build_ir(struct AST* ast) {
+  struct IRProgram* program = malloc(sizeof(*program));
+  NEW_ARRAYLIST(&program->functions);
+  program->main = NULL;
+  program->globals = ast->globals;
+
+  struct Builder builder = {
+    .nodes = &ast->nodes, .program = program, .function = NULL,
+    .file = NULL, .node = 0, .had_error = false,
+  };
+  hm_init(&builder.functions);
+  builder.globals = alloc_slots(ast->globals);
+
+  for(size_t i = 0; i < ast->size; i++)
+    if(ast->members[i]->type == DECL_FUNC)
+      declare_function(&builder, ast->members[i]->as.function);
+
+  builder.file = NULL;
+  if(!hm_get(&builder.functions, intern_cstr("main")))
+    ir_error(&builder, IR_ERROR_NO_MAIN, NULL);
+
+  build_globals(&builder, ast);
+
+  for(size_t i = 0; i < ast->size; i++)
+    if(ast->members[i]->type == DECL_FUNC
+        && ast->members[i]->as.function->sig->name)
+      build_function(&builder, ast->members[i]->as.function);
+
+  hm_destroy(&builder.functions);
+  free(builder.globals);
+
+  if(!builder.had_error) return program;
+
+  free_ir(program);
+  return NULL;
+}
@@ -0,0 +1,309 @@
+// ir.c
+
+#include "ir.h"
+#include <inttypes.h>
+#include <stdio.h>
+
+const char* ir_op_names[IR_OP_FINAL] = {
+  "const", "string", "param", "phi", "copy", "load", "call",
+  "neg", "not", "lnot",
+  "add", "sub", "mul", "div", "mod", "shl", "shr",
+  "and", "or", "xor",
+  "eq", "ne", "lt", "le", "gt", "ge",
+  "store", "print",
+  "jump", "branch", "return",
+};
+
+struct IRInstr* ir_instr(struct IRFunction* fn, enum IROp op, enum Kind kind,
+    size_t nargs) {
+  struct IRInstr* instr = arena_alloc(&fn->arena, sizeof(*instr));
+  *instr = (struct IRInstr){
+    .op = op, .kind = kind, .id = fn->values++,
+    .block = NULL, .args = NULL, .nargs = nargs, .imm = 0, .name = NULL,
+  };
+
+  if(nargs)
+    instr->args = arena_alloc(&fn->arena, nargs * sizeof(*instr->args));
+  return instr;
+}
+
+struct IRBlock* ir_block(struct IRFunction* fn) {
+  struct IRBlock* block = arena_alloc(&fn->arena, sizeof(*block));
+  block->id = fn->block_ids++;
+  block->nsuccs = 0;
+  block->sealed = false;
+  block->idom = NULL;
+  block->order = 0;
+  block->counted = false;
+  block->trips = 0;
+
+  NEW_ARRAYLIST(&block->instrs);
+  NEW_ARRAYLIST(&block->preds);
+  NEW_ARRAYLIST(&block->defs);
+  NEW_ARRAYLIST(&block->incomplete);
+
+  APPEND_ARRAYLIST(&fn->blocks, block);
+  return block;
+}
+
+static void free_block(struct IRBlock* block) {
+  free(block->instrs.members);
+  free(block->preds.members);
+  free(block->defs.members);
+  free(block->incomplete.members);
+}
+
+void ir_append(struct IRBlock* block, struct IRInstr* instr) {
+  instr->block = block;
+  APPEND_ARRAYLIST(&block->instrs, instr);
+}
+
+// ahead of the instruction that was at index
+void ir_insert(struct IRBlock* block, size_t index, struct IRInstr* instr) {
+  instr->block = block;
+
+  APPEND_ARRAYLIST(&block->instrs, instr);
+  for(size_t i = block->instrs.size - 1; i > index; i--)
+    block->instrs.members[i] = block->instrs.members[i - 1];
+  block->instrs.members[index] = instr;
+}
+
+void ir_add_edge(struct IRBlock* from, struct IRBlock* to) {
+  from->succs[from->nsuccs++] = to;
+  APPEND_ARRAYLIST(&to->preds, from);
+}
+
+// phis lose the argument for the predecessor too
+void ir_remove_pred(struct IRBlock* block, size_t index) {
+  block->preds.size -= 1;
+  for(size_t i = index; i < block->preds.size; i++)
+    block->preds.members[i] = block->preds.members[i + 1];
+
+  for(size_t i = 0; i < block->instrs.size; i++) {
+    struct IRInstr* phi = block->instrs.members[i];
+    if(phi->op != IR_PHI) break;
+
+    phi->nargs -= 1;
+    for(size_t j = index; j < phi->nargs; j++) phi->args[j] = phi->args[j + 1];
+  }
+}
+
+struct IRInstr* ir_terminator(const struct IRBlock* block) {
+  if(!block->instrs.size) return NULL;
+
+  struct IRInstr* last = block->instrs.members[block->instrs.size - 1];
+  return ir_is_terminator(last->op) ? last : NULL;
+}
+
+bool ir_is_terminator(enum IROp op) {
+  return op == IR_JUMP || op == IR_BRANCH || op == IR_RETURN;
+}
+
+// pure instructions can be folded, merged or dropped when unused; division
+// isn't, since it can fail
+bool ir_is_pure(enum IROp op) {
+  switch(op) {
+    case IR_LOAD:
+    case IR_CALL:
+    case IR_DIV:
+    case IR_MOD:
+    case IR_STORE:
+    case IR_PRINT:
+    case IR_JUMP:
+    case IR_BRANCH:
+    case IR_RETURN: return false;
+    default:        return true;
+  }
+}
+
+
+
+// ### BLOCK ORDER ### //
+
+#define UNVISITED ((size_t)-1)
+
+static struct IRBlock* intersect(struct IRBlock* a, struct IRBlock* b) {
+  while(a != b) {
+    while(a->order > b->order) a = a->idom;
+    while(b->order > a->order) b = b->idom;
+  }
+  return a;
+}
+
+// the iterative algorithm of cooper, harvey and kennedy; blocks are in
+// reverse postorder, so a block's idom always comes before it
+static void compute_dominators(struct IRFunction* fn) {
+  struct IRBlock* entry = fn->blocks.members[0];
+  for(size_t i = 0; i < fn->blocks.size; i++)
+    fn->blocks.members[i]->idom = NULL;
+  entry->idom = entry;
+
+  for(bool changed = true; changed; ) {
+    changed = false;
+
+    for(size_t i = 1; i < fn->blocks.size; i++) {
+      struct IRBlock* block = fn->blocks.members[i];
+      struct IRBlock* idom = NULL;
+
+      for(size_t j = 0; j < block->preds.size; j++) {
+        struct IRBlock* pred = block->preds.members[j];
+        if(!pred->idom) continue;
+        idom = idom ? intersect(pred, idom) : pred;
+      }
+
+      if(block->idom != idom) {
+        block->idom = idom;
+        changed = true;
+      }
+    }
+  }
+}
+
+void ir_order_blocks(struct IRFunction* fn) {
+  size_t count = fn->blocks.size;
+  for(size_t i = 0; i < count; i++) fn->blocks.members[i]->order = UNVISITED;
+
+  // depth first, with how many of each block's successors are left to visit
+  // kept alongside it. they are visited last first, so the first one ends up
+  // right after its block, where a branch can fall through to it
+  struct IRBlock** postorder = malloc(count * sizeof(*postorder));
+  struct IRBlock** stack = malloc(count * sizeof(*stack));
+  size_t* next = malloc(count * sizeof(*next));
+  size_t visited = 0, depth = 0;
+
+  stack[depth] = fn->blocks.members[0];
+  next[depth++] = fn->blocks.members[0]->nsuccs;
+  fn->blocks.members[0]->order = 0;
+
+  while(depth) {
+    struct IRBlock* block = stack[depth - 1];
+
+    if(next[depth - 1] > 0) {
+      struct IRBlock* succ = block->succs[--next[depth - 1]];
+      if(succ->order != UNVISITED) continue;
+
+      succ->order = 0;
+      stack[depth] = succ;
+      next[depth++] = succ->nsuccs;
+    } else {
+      postorder[visited++] = block;
+      depth -= 1;
+    }
+  }
+
+  // unreachable blocks are unlinked from their successors first
+  for(size_t i = 0; i < count; i++) {
+    struct IRBlock* block = fn->blocks.members[i];
+    if(block->order != UNVISITED) continue;
+
+    for(size_t s = 0; s < block->nsuccs; s++) {
+      struct IRBlock* succ = block->succs[s];
+      for(size_t p = succ->preds.size; p > 0; p--)
+        if(succ->preds.members[p - 1] == block) ir_remove_pred(succ, p - 1);
+    }
+  }
+
+  for(size_t i = 0; i < count; i++)
+    if(fn->blocks.members[i]->order == UNVISITED)
+      free_block(fn->blocks.members[i]);
+
+  fn->blocks.size = visited;
+  for(size_t i = 0; i < visited; i++) {
+    struct IRBlock* block = postorder[visited - 1 - i];
+    block->order = i;
+    fn->blocks.members[i] = block;
+  }
+
+  free(postorder);
+  free(stack);
+  free(next);
+
+  compute_dominators(fn);
+}
+
+#undef UNVISITED
+
+
+
+// ### PRINTING ### //
+
+static void print_instr(const struct IRInstr* instr) {
+  printf("    ");
+  if(!ir_is_terminator(instr->op) && instr->op != IR_STORE
+      && instr->op != IR_PRINT)
+    printf("v%zu = ", instr->id);
+
+  printf("%s", ir_op_names[instr->op]);
+
+  switch(instr->op) {
+    case IR_CONST:  printf(" %" PRIu64, instr->imm);        break;
+    case IR_STRING: printf(" \"%s\"", instr->name);         break;
+    case IR_CALL:   printf(" %s", instr->name);             break;
+    case IR_PARAM:  printf(" %" PRIu64, instr->imm);        break;
+    case IR_LOAD:
+    case IR_STORE:  printf(" g%" PRIu64, instr->imm);       break;
+    case IR_PRINT:  printf(" %s", instr->imm == '\n' ? "newline" : "space");
+      break;
+    default: break;
+  }
+
+  for(size_t i = 0; i < instr->nargs; i++)
+    printf("%s v%zu", i || instr->op == IR_CALL || instr->op == IR_STORE
+        || instr->op == IR_PRINT ? "," : "", instr->args[i]->id);
+
+  if(instr->op == IR_JUMP || instr->op == IR_BRANCH)
+    for(size_t i = 0; i < instr->block->nsuccs; i++)
+      printf("%s bb%zu", i || instr->nargs ? "," : "",
+          instr->block->succs[i]->id);
+
+  if(instr->kind != KIND_NONE && !ir_is_terminator(instr->op))
+    printf(" : %s", kind_names[instr->kind]);
+  printf("\n");
+}
+
+static void print_function(const struct IRFunction* fn) {
+  printf("function %s(%zu)\n", fn->name ? fn->name : "<globals>", fn->arity);
+
+  for(size_t i = 0; i < fn->blocks.size; i++) {
+    const struct IRBlock* block = fn->blocks.members[i];
+    printf("  bb%zu:", block->id);
+
+    if(block->preds.size) {
+      printf(" ; preds");
+      for(size_t p = 0; p < block->preds.size; p++)
+        printf(" bb%zu", block->preds.members[p]->id);
+    }
+    if(block->counted) printf(" ; trips %" PRIu64, block->trips);
+    printf("\n");
+
+    for(size_t j = 0; j < block->instrs.size; j++)
+      print_instr(block->instrs.members[j]);
+  }
+}
+
+void print_ir(const struct IRProgram* program) {
+  print_function(program->init);
+
+  for(size_t i = 0; i < program->functions.size; i++) {
+    printf("\n");
+    print_function(program->functions.members[i]);
+  }
+}
+
+
+
+static void free_function(struct IRFunction* fn) {
+  for(size_t i = 0; i < fn->blocks.size; i++)
+    free_block(fn->blocks.members[i]);
+
+  free(fn->blocks.members);
+  arena_destroy(&fn->arena);
+  free(fn);
+}
+
+void free_ir(struct IRProgram* program) {
+  free_function(program->init);
+  FREE_MEMBERS(&program->functions, free_function);
+  free(program->functions.members);
+  free(program);
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include "kind.h"
+#include "../parser/parser.h"
+#include "../util/arena.h"
+#include "../util/arraylist.h"
+#include <stdint.h>
+
+// an ssa form of each function, built from the resolved ast and optimized
+// before the native backends lower it. locals become ssa values, so only
+// globals are ever loaded or stored; blocks start with their phis and end
+// with exactly one terminator, and every phi has one argument per
+// predecessor, in the same order
+
+enum IROp {
+  // values
+  IR_CONST,      // imm
+  IR_STRING,     // name, the string itself
+  IR_PARAM,      // imm is the argument's index
+  IR_PHI,
+  IR_COPY,
+  IR_LOAD,       // imm is the global's slot
+  IR_CALL,       // name is the callee
+
+  IR_NEG, IR_NOT, IR_LOGIC_NOT,
+
+  IR_ADD, IR_SUB, IR_MUL, IR_DIV, IR_MOD, IR_SHL, IR_SHR,
+  IR_AND, IR_OR, IR_XOR,
+  IR_EQ, IR_NE, IR_LT, IR_LE, IR_GT, IR_GE,
+
+  // effects
+  IR_STORE,      // imm is the global's slot
+  IR_PRINT,      // prints its argument by its kind, if it has one, then imm
+
+  // terminators
+  IR_JUMP, IR_BRANCH, IR_RETURN,
+
+  IR_OP_FINAL,
+};
+
+extern const char* ir_op_names[IR_OP_FINAL];
+
+struct IRBlock;
+
+struct IRInstr {
+  enum IROp op;
+  enum Kind kind;  // of the value
+  size_t id;
+  struct IRBlock* block;
+  struct IRInstr** args;
+  size_t nargs;
+  uint64_t imm;
+  const char* name;
+};
+
+DEFINE_ARRAYLIST(IRInstrs, struct IRInstr*);
+DEFINE_ARRAYLIST(IRBlocks, struct IRBlock*);
+
+// used while building: the value each variable has at the end of a block
+struct IRDef {
+  size_t var;
+  struct IRInstr* value;
+};
+
+DEFINE_ARRAYLIST(IRDefs, struct IRDef);
+
+// a branch's successors are the true and then false targets
+struct IRBlock {
+  size_t id;
+  struct IRInstrs instrs;
+  struct IRBlocks preds;
+  struct IRBlock* succs[2];
+  size_t nsuccs;
+
+  struct IRDefs defs;
+  struct IRInstrs incomplete; // phis waiting for the block to be sealed
+  bool sealed;
+
+  struct IRBlock* idom;
+  size_t order; // reverse postorder index, set by ir_order_blocks
+
+  // for loop headers, how many times the body runs, when that is known
+  bool counted;
+  uint64_t trips;
+};
+
+struct IRFunction {
+  const char* name; // NULL for the global initializer
+  size_t arity;
+  struct IRBlocks blocks; // the entry block is first
+  size_t values;          // value ids handed out so far
+  size_t block_ids;       // and block ids
+  struct Arena arena;
+};
+
+DEFINE_ARRAYLIST(IRFunctions, struct IRFunction*);
+
+struct IRProgram {
+  struct IRFunctions functions;
+  struct IRFunction* init; // initializes the globals in order
+  struct IRFunction* main;
+  size_t globals;
+};
+
+// NULL if the program uses something the ir can't express; the errors are
+// printed
+struct IRProgram* build_ir(struct AST*);
+void free_ir(struct IRProgram*);
+
+void optimize_ir(struct IRProgram*);
+void print_ir(const struct IRProgram*);
+
+// helpers shared by the builder, the passes and the backends
+struct IRInstr* ir_instr(struct IRFunction*, enum IROp, enum Kind, size_t);
+struct IRBlock* ir_block(struct IRFunction*);
+void ir_append(struct IRBlock*, struct IRInstr*);
+void ir_insert(struct IRBlock*, size_t index, struct IRInstr*);
+void ir_add_edge(struct IRBlock* from, struct IRBlock* to);
+void ir_remove_pred(struct IRBlock*, size_t);
+struct IRInstr* ir_terminator(const struct IRBlock*);
+
+bool ir_is_pure(enum IROp);
+bool ir_is_terminator(enum IROp);
+
+// sorts the reachable blocks into reverse postorder, drops the rest, and
+// computes their dominators
+void ir_order_blocks(struct IRFunction*);
@@ -0,0 +1,26 @@
+// kind.c
+
+#include "kind.h"
+
+const char* kind_names[] = {
+  "none", "int", "bool", "char", "string",
+};
+
+struct Slot* alloc_slots(size_t count) {
+  struct Slot* slots = malloc((count ? count : 1) * sizeof(struct Slot));
+
+  for(size_t i = 0; i < count; i++)
+    slots[i] = (struct Slot){ NULL, KIND_NONE };
+
+  return slots;
+}
+
+enum Kind type_kind(const struct Type* type, enum Kind otherwise) {
+  if(!type || type->type != TYPE_PRIMITIVE) return otherwise;
+
+  switch(type->as.primitive) {
+    case TOKEN_BOOL: return KIND_BOOL;
+    case TOKEN_CHAR: return KIND_CHAR;
+    default:         return KIND_INT;
+  }
+}
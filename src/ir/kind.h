@@ -0,0 +1,27 @@
+#pragma once
+
+#include "../parser/type.h"
+
+// the backends treat every value as an untyped 64-bit word and track each
+// expression's kind statically instead, only to tell print how to show it.
+// integers are unsigned and as wide as a word whatever they're declared as,
+// like the tree walker's and the vm's, so every backend gives the same
+// answers
+
+enum Kind {
+  KIND_NONE, KIND_INT, KIND_BOOL, KIND_CHAR, KIND_STRING
+};
+
+extern const char* kind_names[];
+
+// what is known about a slot: the name of what was last declared in it, and
+// the kind of what was last stored in it
+struct Slot {
+  const char* name;
+  enum Kind kind;
+};
+
+struct Slot* alloc_slots(size_t);
+
+// the kind of a declared type, or otherwise if it isn't a primitive
+enum Kind type_kind(const struct Type*, enum Kind otherwise);
@@ -0,0 +1,898 @@
+// optimize.c
+
+#include "ir.h"
+#include "../parser/token.h"
+#include <string.h>
+
+// the passes work on one function at a time. values that turn out to equal
+// another one aren't rewritten in place; they are recorded as replaced, every
+// use is redirected to the replacement on the next sweep, and they are
+// removed with the dead code at the end
+//
+//   simplify   copy propagation, trivial phis, constant folding, a few
+//              algebraic identities and branches on constants, repeated
+//              until nothing changes
+//   cse        common subexpressions, looked up along the dominator tree
+//   loops      invariant code motion, strength reduction of induction
+//              variables and trip counts, innermost loops first
+//   dce        everything pure that nothing with an effect depends on
+//
+// then blocks that always follow each other are merged, and critical edges
+// are split, so the backends can resolve phis with copies at the end of each
+// predecessor
+
+struct Optimizer {
+  struct IRFunction* fn;
+  struct IRInstr** replaced; // by value id
+};
+
+static struct IRInstr* resolve(struct Optimizer* o, struct IRInstr* instr) {
+  while(o->replaced[instr->id]) instr = o->replaced[instr->id];
+  return instr;
+}
+
+static void replace(struct Optimizer* o, struct IRInstr* instr,
+    struct IRInstr* with) {
+  o->replaced[instr->id] = with;
+}
+
+// passes that add instructions grow the table with them
+static struct IRInstr* new_instr(struct Optimizer* o, enum IROp op,
+    enum Kind kind, size_t nargs) {
+  struct IRInstr* instr = ir_instr(o->fn, op, kind, nargs);
+  o->replaced = realloc(o->replaced, o->fn->values * sizeof(*o->replaced));
+  o->replaced[instr->id] = NULL;
+  return instr;
+}
+
+static void make_constant(struct IRInstr* instr, uint64_t value) {
+  instr->op = IR_CONST;
+  instr->nargs = 0;
+  instr->imm = value;
+}
+
+static bool is_constant(const struct IRInstr* instr, uint64_t value) {
+  return instr->op == IR_CONST && instr->imm == value;
+}
+
+
+
+// ### SIMPLIFYING ### //
+
+// a phi whose arguments are all one value, or itself, is that value
+static struct IRInstr* trivial_phi(struct IRInstr* phi) {
+  struct IRInstr* same = NULL;
+
+  for(size_t i = 0; i < phi->nargs; i++) {
+    struct IRInstr* arg = phi->args[i];
+    if(arg == phi || arg == same) continue;
+    if(same) return NULL;
+    same = arg;
+  }
+
+  return same;
+}
+
+// evaluates an instruction whose arguments are all constants the way the
+// backends would at run time; false if it can't be, like a division by zero
+static bool fold(const struct IRInstr* instr, uint64_t* result) {
+  uint64_t x = instr->nargs > 0 ? instr->args[0]->imm : 0;
+  uint64_t y = instr->nargs > 1 ? instr->args[1]->imm : 0;
+
+  switch(instr->op) {
+    case IR_NEG:       *result = -x; return true;
+    case IR_NOT:       *result = ~x; return true;
+    case IR_LOGIC_NOT: *result = !x; return true;
+
+    case IR_ADD: *result = x + y; return true;
+    case IR_SUB: *result = x - y; return true;
+    case IR_MUL: *result = x * y; return true;
+    case IR_AND: *result = x & y; return true;
+    case IR_OR:  *result = x | y; return true;
+    case IR_XOR: *result = x ^ y; return true;
+
+    // shift counts are taken mod 64, like x86 does
+    case IR_SHL: *result = x << (y & 63); return true;
+    case IR_SHR: *result = x >> (y & 63); return true;
+
+    case IR_DIV:
+    case IR_MOD:
+      if(y == 0) return false;
+      *result = instr->op == IR_DIV ? x / y : x % y;
+      return true;
+
+    case IR_EQ: *result = x == y; return true;
+    case IR_NE: *result = x != y; return true;
+    case IR_LT: *result = x < y;  return true;
+    case IR_LE: *result = x <= y; return true;
+    case IR_GT: *result = x > y;  return true;
+    case IR_GE: *result = x >= y; return true;
+
+    default: return false;
+  }
+}
+
+// identities that don't need both operands to be known, as the value the
+// instruction equals; NULL if there is none
+static struct IRInstr* identity(struct IRInstr* instr) {
+  if(instr->nargs != 2) return NULL;
+  struct IRInstr* x = instr->args[0];
+  struct IRInstr* y = instr->args[1];
+
+  switch(instr->op) {
+    case IR_ADD:
+    case IR_OR:
+    case IR_XOR:
+      if(is_constant(x, 0)) return y;
+      if(is_constant(y, 0)) return x;
+      return NULL;
+    case IR_SUB:
+    case IR_SHL:
+    case IR_SHR:
+      return is_constant(y, 0) ? x : NULL;
+    case IR_MUL:
+      if(is_constant(x, 1) || is_constant(y, 0)) return y;
+      if(is_constant(y, 1) || is_constant(x, 0)) return x;
+      return NULL;
+    case IR_DIV:
+      return is_constant(y, 1) ? x : NULL;
+    case IR_AND:
+      return x == y ? x : NULL;
+    default:
+      return NULL;
+  }
+}
+
+static bool all_constant(const struct IRInstr* instr) {
+  if(!instr->nargs) return false;
+
+  for(size_t i = 0; i < instr->nargs; i++)
+    if(instr->args[i]->op != IR_CONST) return false;
+  return true;
+}
+
+// a branch on a constant only ever goes one way
+static void fold_branch(struct IRBlock* block, struct IRInstr* branch) {
+  size_t dead = branch->args[0]->imm ? 1 : 0;
+  struct IRBlock* succ = block->succs[dead];
+
+  for(size_t p = 0; p < succ->preds.size; p++)
+    if(succ->preds.members[p] == block) {
+      ir_remove_pred(succ, p);
+      break;
+    }
+
+  block->succs[0] = block->succs[1 - dead];
+  block->nsuccs = 1;
+  branch->op = IR_JUMP;
+  branch->nargs = 0;
+}
+
+static bool simplify_instr(struct Optimizer* o, struct IRInstr* instr) {
+  if(o->replaced[instr->id]) return false;
+
+  bool changed = false;
+  for(size_t i = 0; i < instr->nargs; i++) {
+    struct IRInstr* arg = resolve(o, instr->args[i]);
+    changed |= arg != instr->args[i];
+    instr->args[i] = arg;
+  }
+
+  struct IRInstr* same = NULL;
+  uint64_t value;
+
+  switch(instr->op) {
+    case IR_COPY: same = instr->args[0]; break;
+    case IR_PHI:  same = trivial_phi(instr); break;
+    case IR_BRANCH:
+      if(instr->args[0]->op != IR_CONST) break;
+      fold_branch(instr->block, instr);
+      return true;
+    default:
+      if(all_constant(instr) && fold(instr, &value)) {
+        make_constant(instr, value);
+        return true;
+      }
+      same = identity(instr);
+      break;
+  }
+
+  // a phi in an unreachable loop can be its own only argument
+  if(same && same != instr) {
+    replace(o, instr, same);
+    return true;
+  }
+
+  return changed;
+}
+
+static void simplify(struct Optimizer* o) {
+  for(bool changed = true; changed; ) {
+    changed = false;
+
+    for(size_t i = 0; i < o->fn->blocks.size; i++) {
+      struct IRBlock* block = o->fn->blocks.members[i];
+      for(size_t j = 0; j < block->instrs.size; j++)
+        changed |= simplify_instr(o, block->instrs.members[j]);
+    }
+
+    // folded branches can leave blocks behind
+    if(changed) ir_order_blocks(o->fn);
+  }
+}
+
+
+
+// ### COMMON SUBEXPRESSIONS ### //
+
+static bool is_commutative(enum IROp op) {
+  switch(op) {
+    case IR_ADD:
+    case IR_MUL:
+    case IR_AND:
+    case IR_OR:
+    case IR_XOR:
+    case IR_EQ:
+    case IR_NE: return true;
+    default:    return false;
+  }
+}
+
+// commutative operands are ordered by id, with constants last so the
+// backends can use them as immediates
+static void canonicalize(struct IRInstr* instr) {
+  struct IRInstr* x = instr->args[0];
+  struct IRInstr* y = instr->args[1];
+
+  bool swap = x->op == IR_CONST && y->op != IR_CONST;
+  if((x->op == IR_CONST) == (y->op == IR_CONST)) swap = x->id > y->id;
+
+  if(swap) {
+    instr->args[0] = y;
+    instr->args[1] = x;
+  }
+}
+
+static bool same_expression(const struct IRInstr* a, const struct IRInstr* b) {
+  if(a->op != b->op || a->imm != b->imm
+      || a->name != b->name || a->nargs != b->nargs)
+    return false;
+
+  for(size_t i = 0; i < a->nargs; i++)
+    if(a->args[i] != b->args[i]) return false;
+  return true;
+}
+
+static size_t hash_expression(const struct IRInstr* instr) {
+  size_t hash = instr->op * 31 + instr->imm;
+  hash = hash * 31 + (uintptr_t)instr->name;
+
+  for(size_t i = 0; i < instr->nargs; i++)
+    hash = hash * 31 + instr->args[i]->id;
+  return hash ^ (hash >> 17);
+}
+
+static bool dominates(const struct IRBlock* a, const struct IRBlock* b) {
+  while(b != a && b->idom != b) b = b->idom;
+  return b == a;
+}
+
+// every candidate seen so far stays in the table, since blocks come in
+// reverse postorder and a match is only usable where it dominates; that is
+// the same as scoping the table to the dominator tree, without the walk
+static void eliminate_common(struct Optimizer* o) {
+  size_t capacity = 16;
+  while(capacity < 2 * o->fn->values) capacity *= 2;
+  struct IRInstr** table = calloc(capacity, sizeof(*table));
+
+  for(size_t i = 0; i < o->fn->blocks.size; i++) {
+    struct IRBlock* block = o->fn->blocks.members[i];
+
+    for(size_t j = 0; j < block->instrs.size; j++) {
+      struct IRInstr* instr = block->instrs.members[j];
+      if(o->replaced[instr->id]) continue;
+
+      for(size_t a = 0; a < instr->nargs; a++)
+        instr->args[a] = resolve(o, instr->args[a]);
+      if(!ir_is_pure(instr->op) || instr->op == IR_PHI) continue;
+
+      if(is_commutative(instr->op)) canonicalize(instr);
+
+      size_t index = hash_expression(instr) & (capacity - 1);
+      struct IRInstr* match = NULL;
+      for(; table[index]; index = (index + 1) & (capacity - 1))
+        if(same_expression(table[index], instr)
+            && dominates(table[index]->block, block)) {
+          match = table[index];
+          break;
+        }
+
+      if(match) replace(o, instr, match);
+      else table[index] = instr;
+    }
+  }
+
+  free(table);
+}
+
+
+
+// ### LOOPS ### //
+
+// a natural loop: the header, and every block that reaches one of its back
+// edges without going through it
+struct Loop {
+  struct IRBlock* header;
+  struct IRBlock* preheader; // the only way in, which ends in a jump
+  struct IRBlock* latch;     // where the back edge comes from, if only one
+  bool* body;                // by block order
+  size_t size;
+};
+
+// an induction variable: a header phi that the latch passes back with a
+// constant added or subtracted
+struct Induction {
+  struct IRInstr* phi;
+  struct IRInstr* init; // from the preheader
+  struct IRInstr* next; // from the latch, phi + step or phi - step
+  struct IRInstr* step;
+};
+
+static bool in_loop(const struct Loop* loop, const struct IRBlock* block) {
+  return loop->body[block->order];
+}
+
+static size_t pred_index(const struct IRBlock* block,
+    const struct IRBlock* pred) {
+  size_t index = 0;
+  while(block->preds.members[index] != pred) index++;
+  return index;
+}
+
+// right before the block's terminator
+static void insert_last(struct IRBlock* block, struct IRInstr* instr) {
+  ir_insert(block, block->instrs.size - 1, instr);
+}
+
+static struct IRInstr* new_constant(struct Optimizer* o,
+    struct IRBlock* block, uint64_t value, enum Kind kind) {
+  struct IRInstr* instr = new_instr(o, IR_CONST, kind, 0);
+  instr->imm = value;
+  insert_last(block, instr);
+  return instr;
+}
+
+static struct IRInstr* new_binary(struct Optimizer* o, struct IRBlock* block,
+    enum IROp op, struct IRInstr* x, struct IRInstr* y) {
+  struct IRInstr* instr = new_instr(o, op, x->kind, 2);
+  instr->args[0] = x;
+  instr->args[1] = y;
+  insert_last(block, instr);
+  return instr;
+}
+
+// false if the block doesn't head a loop
+static bool find_loop(const struct IRFunction* fn, struct IRBlock* header,
+    struct Loop* loop) {
+  *loop = (struct Loop){ .header = header };
+  loop->body = calloc(fn->blocks.size, sizeof(*loop->body));
+  struct IRBlock** stack = malloc(fn->blocks.size * sizeof(*stack));
+  size_t depth = 0, latches = 0;
+
+  loop->body[header->order] = true;
+  loop->size = 1;
+
+  for(size_t p = 0; p < header->preds.size; p++) {
+    struct IRBlock* pred = header->preds.members[p];
+    if(!dominates(header, pred)) continue;
+
+    latches += 1;
+    loop->latch = pred;
+    if(!in_loop(loop, pred)) {
+      loop->body[pred->order] = true;
+      loop->size += 1;
+      stack[depth++] = pred;
+    }
+  }
+
+  while(depth) {
+    struct IRBlock* block = stack[--depth];
+
+    for(size_t p = 0; p < block->preds.size; p++) {
+      struct IRBlock* pred = block->preds.members[p];
+      if(in_loop(loop, pred)) continue;
+
+      loop->body[pred->order] = true;
+      loop->size += 1;
+      stack[depth++] = pred;
+    }
+  }
+
+  free(stack);
+
+  if(!latches) {
+    free(loop->body);
+    return false;
+  }
+  if(latches > 1) loop->latch = NULL;
+
+  for(size_t p = 0; p < header->preds.size; p++) {
+    struct IRBlock* pred = header->preds.members[p];
+    if(in_loop(loop, pred)) continue;
+
+    if(loop->preheader) {
+      loop->preheader = NULL;
+      break;
+    }
+    loop->preheader = pred;
+  }
+
+  if(loop->preheader && loop->preheader->nsuccs != 1) loop->preheader = NULL;
+  return true;
+}
+
+
+static bool is_invariant(const struct Loop* loop, const struct IRInstr* instr) {
+  for(size_t i = 0; i < instr->nargs; i++)
+    if(in_loop(loop, instr->args[i]->block)) return false;
+  return true;
+}
+
+// pure instructions can't fail, and neither can a division by a constant
+// other than 0 or -1, so they can run once ahead of the loop even if no
+// iteration would have run them
+static bool can_hoist(const struct IRInstr* instr) {
+  if(instr->op == IR_DIV || instr->op == IR_MOD) {
+    const struct IRInstr* divisor = instr->args[1];
+    return divisor->op == IR_CONST && divisor->imm != 0
+      && divisor->imm != UINT64_MAX;
+  }
+
+  return instr->op != IR_PHI && ir_is_pure(instr->op);
+}
+
+// blocks are in reverse postorder, so an instruction's arguments are hoisted
+// before it is looked at
+static void hoist_invariants(struct Optimizer* o, struct Loop* loop) {
+  for(size_t i = 0; i < o->fn->blocks.size; i++) {
+    struct IRBlock* block = o->fn->blocks.members[i];
+    if(!in_loop(loop, block)) continue;
+
+    size_t kept = 0;
+    for(size_t j = 0; j < block->instrs.size; j++) {
+      struct IRInstr* instr = block->instrs.members[j];
+
+      if(!o->replaced[instr->id] && can_hoist(instr)
+          && is_invariant(loop, instr))
+        insert_last(loop->preheader, instr);
+      else block->instrs.members[kept++] = instr;
+    }
+    block->instrs.size = kept;
+  }
+}
+
+
+static bool find_induction(const struct Loop* loop, struct IRInstr* phi,
+    struct Induction* iv) {
+  struct IRInstr* next = phi->args[pred_index(loop->header, loop->latch)];
+  if(next->nargs != 2) return false;
+
+  iv->phi = phi;
+  iv->init = phi->args[pred_index(loop->header, loop->preheader)];
+  iv->next = next;
+
+  if(next->op == IR_ADD && next->args[0] == phi) iv->step = next->args[1];
+  else if(next->op == IR_ADD && next->args[1] == phi) iv->step = next->args[0];
+  else if(next->op == IR_SUB && next->args[0] == phi) iv->step = next->args[1];
+  else return false;
+
+  return iv->step->op == IR_CONST && iv->step->imm != 0;
+}
+
+// i * k, with k invariant, becomes a phi of its own that starts at init * k
+// and steps by step * k, so each iteration adds instead of multiplying.
+// constant factors are left alone: the backends multiply by an immediate,
+// which is cheaper than carrying another value around the loop
+static void reduce_strength(struct Optimizer* o, const struct Loop* loop,
+    const struct Induction* iv) {
+  struct IRInstrs products;
+  NEW_ARRAYLIST(&products);
+
+  for(size_t i = 0; i < o->fn->blocks.size; i++) {
+    struct IRBlock* block = o->fn->blocks.members[i];
+    if(!in_loop(loop, block)) continue;
+
+    for(size_t j = 0; j < block->instrs.size; j++) {
+      struct IRInstr* instr = block->instrs.members[j];
+      if(instr->op == IR_MUL && !o->replaced[instr->id]
+          && (instr->args[0] == iv->phi || instr->args[1] == iv->phi))
+        APPEND_ARRAYLIST(&products, instr);
+    }
+  }
+
+  for(size_t i = 0; i < products.size; i++) {
+    struct IRInstr* product = products.members[i];
+    struct IRInstr* factor = product->args[product->args[0] == iv->phi];
+
+    if(in_loop(loop, factor->block) || factor->op == IR_CONST) continue;
+
+    struct IRInstr* start = new_binary(o, loop->preheader, IR_MUL,
+        iv->init, factor);
+    struct IRInstr* stride = new_binary(o, loop->preheader, IR_MUL,
+        iv->step, factor);
+    start->kind = stride->kind = product->kind;
+
+    struct IRInstr* phi = new_instr(o, IR_PHI, product->kind, 2);
+    ir_insert(loop->header, 0, phi);
+    phi->args[pred_index(loop->header, loop->preheader)] = start;
+    phi->args[pred_index(loop->header, loop->latch)] =
+      new_binary(o, loop->latch, iv->next->op, phi, stride);
+
+    replace(o, product, phi);
+  }
+
+  free(products.members);
+}
+
+
+// the comparison with its operands swapped, or what it is when it fails;
+// IR_OP_FINAL if the instruction isn't one
+static enum IROp mirror_compare(enum IROp op) {
+  switch(op) {
+    case IR_EQ: return IR_EQ;
+    case IR_NE: return IR_NE;
+    case IR_LT: return IR_GT;
+    case IR_LE: return IR_GE;
+    case IR_GT: return IR_LT;
+    case IR_GE: return IR_LE;
+    default:    return IR_OP_FINAL;
+  }
+}
+
+static enum IROp negate_compare(enum IROp op) {
+  switch(op) {
+    case IR_EQ: return IR_NE;
+    case IR_NE: return IR_EQ;
+    case IR_LT: return IR_GE;
+    case IR_LE: return IR_GT;
+    case IR_GT: return IR_LE;
+    case IR_GE: return IR_LT;
+    default:    return IR_OP_FINAL;
+  }
+}
+
+// how many times the body runs, from the induction variable's first value,
+// its step and the constant bound the header compares it with; false if the
+// header isn't the only way out, or the variable could wrap around first
+static bool count_trips(const struct IRFunction* fn, const struct Loop* loop,
+    const struct Induction* iv, uint64_t* trips) {
+  const struct IRBlock* header = loop->header;
+  const struct IRInstr* branch = ir_terminator(header);
+  if(!branch || branch->op != IR_BRANCH) return false;
+
+  for(size_t i = 0; i < fn->blocks.size; i++) {
+    const struct IRBlock* block = fn->blocks.members[i];
+    if(!in_loop(loop, block) || block == header) continue;
+
+    if(ir_terminator(block)->op == IR_RETURN) return false;
+    for(size_t s = 0; s < block->nsuccs; s++)
+      if(!in_loop(loop, block->succs[s])) return false;
+  }
+
+  bool exits_on_true = !in_loop(loop, header->succs[0]);
+  if(exits_on_true == !in_loop(loop, header->succs[1])) return false;
+
+  const struct IRInstr* condition = branch->args[0];
+  enum IROp op = condition->op;
+  const struct IRInstr* bound;
+
+  if(mirror_compare(op) == IR_OP_FINAL) return false;
+  if(condition->args[0] == iv->phi) bound = condition->args[1];
+  else if(condition->args[1] == iv->phi) {
+    bound = condition->args[0];
+    op = mirror_compare(op);
+  } else return false;
+
+  if(exits_on_true) op = negate_compare(op);
+  if(iv->init->op != IR_CONST || bound->op != IR_CONST) return false;
+
+  uint64_t first = iv->init->imm, last = bound->imm;
+  uint64_t step = iv->next->op == IR_SUB ? -iv->step->imm : iv->step->imm;
+  bool up = step < (uint64_t)1 << 63;
+  uint64_t stride = up ? step : -step;
+
+  if(op == IR_LE) {
+    if(last == UINT64_MAX) return false;
+    last += 1;
+    op = IR_LT;
+  } else if(op == IR_GE) {
+    if(last == 0) return false;
+    last -= 1;
+    op = IR_GT;
+  }
+
+  switch(op) {
+    case IR_LT:
+      if(first >= last) *trips = 0;
+      else if(!up || last - 1 > UINT64_MAX - stride) return false;
+      else *trips = (last - first + stride - 1) / stride;
+      return true;
+    case IR_GT:
+      if(first <= last) *trips = 0;
+      else if(up || last + 1 < stride) return false;
+      else *trips = (first - last + stride - 1) / stride;
+      return true;
+    case IR_NE: {
+      uint64_t distance = up ? last - first : first - last;
+      if(distance % stride) return false;
+      *trips = distance / stride;
+      return true;
+    }
+    case IR_EQ:
+      *trips = first == last;
+      return true;
+    default:
+      return false;
+  }
+}
+
+// a loop that is known to finish, has no effects and defines nothing used
+// after it can be skipped altogether; the preheader jumps straight to the
+// exit, and the loop is left unreachable
+static bool remove_loop(struct Optimizer* o, const struct Loop* loop) {
+  for(size_t i = 0; i < o->fn->blocks.size; i++) {
+    struct IRBlock* block = o->fn->blocks.members[i];
+
+    for(size_t j = 0; j < block->instrs.size; j++) {
+      struct IRInstr* instr = block->instrs.members[j];
+      if(o->replaced[instr->id]) continue;
+
+      if(in_loop(loop, block)) {
+        if(!ir_is_pure(instr->op) && !ir_is_terminator(instr->op))
+          return false;
+      } else if(!is_invariant(loop, instr)) return false;
+    }
+  }
+
+  struct IRBlock* header = loop->header;
+  struct IRBlock* preheader = loop->preheader;
+  struct IRBlock* exit = header->succs[in_loop(loop, header->succs[0])];
+
+  ir_remove_pred(header, pred_index(header, preheader));
+  exit->preds.members[pred_index(exit, header)] = preheader;
+  preheader->succs[0] = exit;
+  return true;
+}
+
+// the variable leaves the loop with its last value, and a loop that never
+// runs has its branch folded
+static bool count_loop(struct Optimizer* o, struct Loop* loop,
+    const struct Induction* iv) {
+  uint64_t trips;
+  if(!count_trips(o->fn, loop, iv, &trips)) return false;
+
+  loop->header->counted = true;
+  loop->header->trips = trips;
+
+  uint64_t step = iv->next->op == IR_SUB ? -iv->step->imm : iv->step->imm;
+  struct IRInstr* last = new_constant(o, loop->preheader,
+      iv->init->imm + trips * step, iv->phi->kind);
+
+  for(size_t i = 0; i < o->fn->blocks.size; i++) {
+    struct IRBlock* block = o->fn->blocks.members[i];
+    if(in_loop(loop, block)) continue;
+
+    for(size_t j = 0; j < block->instrs.size; j++) {
+      struct IRInstr* instr = block->instrs.members[j];
+      for(size_t a = 0; a < instr->nargs; a++)
+        if(instr->args[a] == iv->phi) instr->args[a] = last;
+    }
+  }
+
+  if(trips == 0) {
+    struct IRInstr* branch = ir_terminator(loop->header);
+    bool exits_on_true = !in_loop(loop, loop->header->succs[0]);
+    branch->args[0] = new_constant(o, loop->preheader, exits_on_true,
+        KIND_BOOL);
+  }
+
+  return true;
+}
+
+static int by_size(const void* a, const void* b) {
+  size_t x = ((const struct Loop*)a)->size, y = ((const struct Loop*)b)->size;
+  return (x > y) - (x < y);
+}
+
+// inner loops go first, so invariants move out a level at a time and the
+// outer loop gets another look at them
+static void optimize_loops(struct Optimizer* o) {
+  struct IRFunction* fn = o->fn;
+  struct Loop* loops = malloc(fn->blocks.size * sizeof(*loops));
+  size_t count = 0;
+  bool removed = false;
+
+  for(size_t i = 0; i < fn->blocks.size; i++)
+    if(find_loop(fn, fn->blocks.members[i], &loops[count])) count++;
+  qsort(loops, count, sizeof(*loops), by_size);
+
+  for(size_t i = 0; i < count; i++) {
+    struct Loop* loop = &loops[i];
+    if(!loop->preheader) continue;
+
+    hoist_invariants(o, loop);
+    if(!loop->latch) continue;
+
+    // the phis strength reduction adds go first, so the original ones are
+    // copied out before it runs
+    struct IRInstrs phis;
+    NEW_ARRAYLIST(&phis);
+    for(size_t j = 0; j < loop->header->instrs.size; j++) {
+      struct IRInstr* phi = loop->header->instrs.members[j];
+      if(phi->op != IR_PHI) break;
+      if(!o->replaced[phi->id]) APPEND_ARRAYLIST(&phis, phi);
+    }
+
+    bool counted = false;
+    for(size_t j = 0; j < phis.size; j++) {
+      struct Induction iv;
+      if(!find_induction(loop, phis.members[j], &iv)) continue;
+
+      reduce_strength(o, loop, &iv);
+      counted |= count_loop(o, loop, &iv);
+    }
+
+    free(phis.members);
+    removed |= counted && remove_loop(o, loop);
+  }
+
+  for(size_t i = 0; i < count; i++) free(loops[i].body);
+  free(loops);
+
+  if(removed) ir_order_blocks(fn);
+}
+
+
+
+// ### DEAD CODE ### //
+
+// instructions with effects are live, and so is everything they use; loads
+// have none, they just can't be moved or merged past stores
+static void eliminate_dead(struct Optimizer* o) {
+  bool* live = calloc(o->fn->values, sizeof(*live));
+  struct IRInstr** worklist = malloc(o->fn->values * sizeof(*worklist));
+  size_t pending = 0;
+
+  for(size_t i = 0; i < o->fn->blocks.size; i++) {
+    struct IRBlock* block = o->fn->blocks.members[i];
+
+    for(size_t j = 0; j < block->instrs.size; j++) {
+      struct IRInstr* instr = block->instrs.members[j];
+      if(o->replaced[instr->id]) continue;
+
+      for(size_t a = 0; a < instr->nargs; a++)
+        instr->args[a] = resolve(o, instr->args[a]);
+
+      if(!ir_is_pure(instr->op) && instr->op != IR_LOAD) {
+        live[instr->id] = true;
+        worklist[pending++] = instr;
+      }
+    }
+  }
+
+  while(pending) {
+    struct IRInstr* instr = worklist[--pending];
+
+    for(size_t a = 0; a < instr->nargs; a++)
+      if(!live[instr->args[a]->id]) {
+        live[instr->args[a]->id] = true;
+        worklist[pending++] = instr->args[a];
+      }
+  }
+
+  for(size_t i = 0; i < o->fn->blocks.size; i++) {
+    struct IRInstrs* instrs = &o->fn->blocks.members[i]->instrs;
+    size_t kept = 0;
+
+    for(size_t j = 0; j < instrs->size; j++)
+      if(live[instrs->members[j]->id])
+        instrs->members[kept++] = instrs->members[j];
+    instrs->size = kept;
+  }
+
+  free(live);
+  free(worklist);
+}
+
+
+
+// ### BLOCKS ### //
+
+// a block that is its successor's only predecessor and jumps to it absorbs
+// it, which leaves no phis behind since a phi with one argument is trivial
+static void merge_blocks(struct IRFunction* fn) {
+  for(size_t i = 0; i < fn->blocks.size; i++) {
+    struct IRBlock* block = fn->blocks.members[i];
+
+    while(block->nsuccs == 1) {
+      struct IRBlock* succ = block->succs[0];
+      if(succ == block || succ->preds.size != 1) break;
+
+      block->instrs.size -= 1;
+      for(size_t j = 0; j < succ->instrs.size; j++)
+        ir_append(block, succ->instrs.members[j]);
+      succ->instrs.size = 0;
+
+      block->nsuccs = succ->nsuccs;
+      for(size_t s = 0; s < succ->nsuccs; s++) {
+        struct IRBlock* next = succ->succs[s];
+        block->succs[s] = next;
+
+        for(size_t p = 0; p < next->preds.size; p++)
+          if(next->preds.members[p] == succ) next->preds.members[p] = block;
+      }
+      succ->nsuccs = 0;
+    }
+  }
+
+  ir_order_blocks(fn);
+}
+
+
+// an edge from a block with two successors to one with two predecessors gets
+// a block of its own in between, which keeps the predecessor's place
+static void split_critical_edges(struct IRFunction* fn) {
+  size_t count = fn->blocks.size;
+
+  for(size_t i = 0; i < count; i++) {
+    struct IRBlock* block = fn->blocks.members[i];
+    if(block->nsuccs < 2) continue;
+
+    for(size_t s = 0; s < block->nsuccs; s++) {
+      struct IRBlock* succ = block->succs[s];
+      if(succ->preds.size < 2) continue;
+
+      struct IRBlock* middle = ir_block(fn);
+      middle->sealed = true;
+      ir_append(middle, ir_instr(fn, IR_JUMP, KIND_NONE, 0));
+      middle->succs[middle->nsuccs++] = succ;
+      APPEND_ARRAYLIST(&middle->preds, block);
+      block->succs[s] = middle;
+
+      for(size_t p = 0; p < succ->preds.size; p++)
+        if(succ->preds.members[p] == block) {
+          succ->preds.members[p] = middle;
+          break;
+        }
+    }
+  }
+
+  ir_order_blocks(fn);
+}
+
+
+
+static void optimize_function(struct IRFunction* fn) {
+  struct Optimizer o = { .fn = fn };
+  o.replaced = calloc(fn->values, sizeof(*o.replaced));
+
+  simplify(&o);
+  eliminate_common(&o);
+  simplify(&o);
+  optimize_loops(&o);
+  simplify(&o);
+  eliminate_common(&o);
+  simplify(&o);
+  eliminate_dead(&o);
+  merge_blocks(fn);
+  split_critical_edges(fn);
+
+  free(o.replaced);
+}
+
+void optimize_ir(struct IRProgram* program) {
+  optimize_function(program->init);
+
+  for(size_t i = 0; i < program->functions.size; i++)
+    optimize_function(program->functions.members[i]);
+}
@@ -4,15 +4,30 @@
 #include <argz.h>
 #include "debug.h"
 #include "parser/parser.h"
+#include "parser/loader.h"
+#include "parser/resolver.h"
+#include "interpret/treewalk/comptime.h"
 #include "interpret/treewalk/interpreter.h"
+#include "interpret/treewalk/sample.h"
+#include "interpret/vm/compiler.h"
+#include "interpret/vm/vm.h"
+#include "ir/ir.h"
+#include "native/link.h"
+#include "util/intern.h"
+#include "util/stats.h"
+#include "util/trace.h"
 
 struct Arguments {
   int flags;
+  const char* output;
+  const char* profile;
+  unsigned sample_hz;
+  const char* trace;
   char* argz;
   size_t argz_len;
 };
 
-struct Arguments args = { 0, NULL, 0 };
+struct Arguments args = { 0, NULL, NULL, 0, NULL, NULL, 0 };
 
 static int parseopt(int key, char* arg, struct argp_state *state) {
   switch(key) {
@@ -20,6 +35,22 @@ static int parseopt(int key, char* arg, struct argp_state *state) {
     case 'l': args.flags |= FLAG_LEX;   break;
     case 'a': args.flags |= FLAG_AST;   break;
     case 'b': args.flags |= FLAG_BC;    break;
+    case 'S': args.flags |= FLAG_ASM;   break;
+    case 'o': args.output = arg;        break;
+    case 'c': args.flags |= FLAG_EMIT_C; break;
+    case 'n': args.flags |= FLAG_NO_CACHE; break;
+    case 't': args.flags |= FLAG_TIME_PASSES; break;
+    case 'm': args.flags |= FLAG_MEM_STATS; break;
+    case 'p': args.profile = arg;       break;
+    case 'T': args.trace = arg;         break;
+    case 's': {
+      char* end;
+      unsigned long hz = strtoul(arg, &end, 10);
+      if(*end || hz < 1 || hz > 10000)
+        argp_failure(state, 1, 0, "HZ must be from 1 to 10000");
+      args.sample_hz = hz;
+      break;
+    }
     case ARGP_KEY_ARG:
       argz_add(&args.argz, &args.argz_len, arg);
       break;
@@ -29,6 +60,13 @@ static int parseopt(int key, char* arg, struct argp_state *state) {
       break;
     case ARGP_KEY_END:
       if(args.argz_len < 2) argp_failure(state, 1, 0, "too few arguments");
+      if(args.profile && (args.output || HAS_FLAG(args.flags, FLAG_BC)
+            || HAS_FLAG(args.flags, FLAG_EMIT_C)))
+        argp_failure(state, 1, 0, "--profile only profiles the tree walker");
+      if(args.sample_hz && (args.output || HAS_FLAG(args.flags, FLAG_BC)
+            || HAS_FLAG(args.flags, FLAG_EMIT_C)))
+        argp_failure(state, 1, 0,
+            "--sample-profile only samples the tree walker");
       break;
   }
   return 0;
@@ -37,23 +75,122 @@ static int parseopt(int key, char* arg, struct argp_state *state) {
 int main(int argc, char** argv) {
   struct argp_option options[] = {
     { "debug", 'd', NULL, 0, "Print debug information", 0 },
-    { "lex", 'l', NULL, 0, "Stop after generating tokens, ast, and bytecode, "
-      "respectively. -l, -a, and -b are mutually exclusive; the program will "
+    { "lex", 'l', NULL, 0, "Stop after generating tokens and ast, "
+      "respectively. -l and -a are mutually exclusive; the program will "
       "exit after the latest given stage. When used in conjunction with -d, it "
       "prints the relevant debug info for the stage", 0 },
     { "ast", 'a', NULL, OPTION_ALIAS, NULL, 0 },
-    { "bytecode", 'b', NULL, OPTION_ALIAS, NULL, 0 },
+    { "bytecode", 'b', NULL, 0, "Compile to bytecode and run it on the vm "
+      "instead of walking the tree. With -d, disassemble the bytecode first",
+      0 },
+    { "output", 'o', "FILE", 0, "Compile to a native x86-64 executable at "
+      "FILE, assembled and linked by $CC (cc by default). With -d, print the "
+      "optimized ir first", 0 },
+    { "assembly", 'S', NULL, 0, "With -o, write the assembly to FILE instead "
+      "of linking it", 0 },
+    { "emit-c", 'c', NULL, 0, "Write the program as C99 to the -o FILE, or "
+      "to stdout, instead of running it", 0 },
+    { "no-cache", 'n', NULL, 0, "Parse every file from its source, without "
+      "reading or writing the .ast image cached next to it", 0 },
+    { "time-passes", 't', NULL, 0, "Print the wall and cpu time of every "
+      "phase to stderr once done; parsing is summed over its threads", 0 },
+    { "mem-stats", 'm', NULL, 0, "Print the allocations, bytes allocated and "
+      "peak rss of every phase to stderr once done", 0 },
+    { "profile", 'p', "FILE", 0, "Count the calls, time and evaluations of "
+      "every function and expression as the tree is walked. Call stacks for "
+      "flame graphs go to FILE.folded, and the functions and each line's "
+      "count to FILE.txt", 0 },
+    { "sample-profile", 's', "HZ", 0, "Sample where the tree walker is HZ "
+      "times a second of cpu time, cheaply enough to leave on. The call "
+      "stacks, down to file:row:col, go to the program's FILE.folded", 0 },
+    { "trace", 'T', "FILE", 0, "Write a timeline of every phase, file and "
+      "declaration parsed, and call the tree walker makes to FILE, as "
+      "trace event json for Perfetto or chrome://tracing", 0 },
     { 0 }
   };
 
   int arg_count = 2;
+  int status = 0;
   struct argp argp = { options, parseopt, "FILE", "twonic compiler", NULL, NULL, NULL };
 
   if(argp_parse(&argp, argc, argv, 0, NULL, &arg_count) == 0) {
     const char* filename = argz_next(args.argz, args.argz_len, NULL);
-    struct AST* ast = parse_file(filename, args.flags);
+    bool time_passes = HAS_FLAG(args.flags, FLAG_TIME_PASSES);
+    bool mem_stats = HAS_FLAG(args.flags, FLAG_MEM_STATS);
+    if(time_passes || mem_stats) stats_enable();
+    if(args.trace) trace_start(args.trace);
+
+    struct AST* ast = load_program(filename, args.flags);
+
+    enum Phase phase = stats_enter(PHASE_RESOLVE);
+    bool resolved = ast && resolve_ast(ast);
+    stats_leave(phase);
+
+    phase = stats_enter(PHASE_COMPTIME);
+    if(resolved) resolved = evaluate_comptime(ast);
+    stats_leave(phase);
+
+    // a program that didn't parse, resolve or fold has said why already
+    if(!resolved) status = 1;
+    if(ast && !resolved) {
+      free_ast(ast);
+      ast = NULL;
+    }
+
+    if(ast && (args.output || HAS_FLAG(args.flags, FLAG_EMIT_C))) {
+      phase = stats_enter(PHASE_BUILD_IR);
+      struct IRProgram* program = build_ir(ast);
+      stats_leave(phase);
+
+      phase = stats_enter(PHASE_OPTIMIZE);
+      if(program) optimize_ir(program);
+      stats_leave(phase);
+      if(program && HAS_FLAG(args.flags, FLAG_DEBUG)) print_ir(program);
+
+      phase = stats_enter(PHASE_CODEGEN);
+      if(!program) status = 1;
+      else if(HAS_FLAG(args.flags, FLAG_EMIT_C)) {
+        if(!write_c(program, args.output)) status = 1;
+      } else if(!build_executable(program, args.output,
+            HAS_FLAG(args.flags, FLAG_ASM)))
+        status = 1;
+      stats_leave(phase);
 
-    if(ast) walk_tree(ast);
+      if(program) free_ir(program);
+    } else if(ast && HAS_FLAG(args.flags, FLAG_BC)) {
+      phase = stats_enter(PHASE_COMPILE);
+      struct Program* program = compile_tree(ast);
+      stats_leave(phase);
+      if(program && HAS_FLAG(args.flags, FLAG_DEBUG)) print_program(program);
+
+      phase = stats_enter(PHASE_EXECUTE);
+      if(program) run_program(program);
+      else status = 1;
+      stats_leave(phase);
+    } else if(ast) {
+      struct Profile* profile = args.profile ? new_profile() : NULL;
+
+      phase = stats_enter(PHASE_EXECUTE);
+      if(args.sample_hz) start_sampling(args.sample_hz);
+      if(!walk_tree(ast, profile)) status = 1;
+      if(args.sample_hz) stop_sampling();
+      stats_leave(phase);
+
+      if(args.sample_hz && !write_samples(filename)) status = 1;
+
+      if(profile) {
+        if(!write_profile(profile, args.profile)) status = 1;
+        free_profile(profile);
+      }
+    }
+
+    if(ast) free_ast(ast);
+    if(!trace_finish()) status = 1;
+    intern_destroy();
+
+    // the program's output comes first
+    fflush(stdout);
+    stats_report(stderr, time_passes, mem_stats);
   }
-  return 0;
+  return status;
 }
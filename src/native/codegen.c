@@ -0,0 +1,681 @@
+// codegen.c
+
+#include "codegen.h"
+#include <ctype.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <string.h>
+
+// lowers the ir to gnu assembly for x86-64 linux. every value is computed in
+// %rax, which remembers the last value it held so a use right after the
+// definition doesn't reload it, and then saved to a word of its own below
+// %rbp, unless that one use is all there is. the right operand of a binary
+// instruction is used straight from its slot or as an immediate. constants
+// and parameters have no slots, they are used where they are
+//
+// the caller pushes the arguments in order, so the frame looks like
+//
+//   16 + 8 * (arity - 1 - index)(%rbp)   arguments
+//   -8 * slot(%rbp)                      values
+//
+// a comparison only used by the branch right after it is fused into a
+// conditional jump. phis are resolved at the end of each predecessor, which
+// always ends in a jump since critical edges are split; their copies are
+// ordered so none overwrites a phi another one still reads, and cycles go
+// through %rcx
+//
+// globals are one array in .bss and functions are named _2n_<name>, so they
+// can't clash with libc
+
+struct Native {
+  FILE* out;
+  const struct IRFunction* fn;
+  size_t* uses;                 // by value id
+  size_t* slots;                // by value id, 0 for values without one
+  const struct IRInstr* in_rax; // the value %rax holds, if known
+  size_t labels;                // the first block label of the function
+  size_t strings;
+};
+
+
+
+// ### EMITTING FUNCTIONS ### //
+
+__attribute__((format(printf, 2, 3)))
+static void emit(struct Native* n, const char* format, ...) {
+  va_list args;
+  va_start(args, format);
+
+  fputs("  ", n->out);
+  vfprintf(n->out, format, args);
+  fputc('\n', n->out);
+
+  va_end(args);
+}
+
+static size_t block_label(struct Native* n, const struct IRBlock* block) {
+  return n->labels + block->id;
+}
+
+static void emit_word(struct Native* n, int64_t word, const char* reg) {
+  bool rax = !strcmp(reg, "%rax");
+
+  if(word == 0 && rax) emit(n, "xorl %%eax, %%eax");
+  else if(word > 0 && word <= UINT32_MAX && rax)
+    emit(n, "movl $%" PRId64 ", %%eax", word);
+  else if(word == (int32_t)word) emit(n, "movq $%" PRId64 ", %s", word, reg);
+  else emit(n, "movabsq $%" PRId64 ", %s", word, reg);
+}
+
+// strings go to .rodata, escaped byte by byte so gas sees them verbatim
+static size_t emit_string(struct Native* n, const char* string) {
+  size_t label = n->strings++;
+  fprintf(n->out, "  .section .rodata\n.LS%zu:\n  .string \"", label);
+
+  for(const unsigned char* c = (const unsigned char*)string; *c; c++) {
+    if(*c == '"' || *c == '\\' || !isprint(*c)) fprintf(n->out, "\\%03o", *c);
+    else fputc(*c, n->out);
+  }
+
+  fprintf(n->out, "\"\n  .text\n");
+  return label;
+}
+
+
+
+// ### VALUES ### //
+
+// writes an instruction operand for a value, if it has one: constants that
+// fit an immediate, the arguments' words, or the value's slot
+static bool operand(struct Native* n, const struct IRInstr* value,
+    char* buffer) {
+  switch(value->op) {
+    case IR_CONST:
+      if((int64_t)value->imm != (int32_t)value->imm) return false;
+      sprintf(buffer, "$%" PRId64, (int64_t)value->imm);
+      return true;
+    case IR_PARAM:
+      sprintf(buffer, "%ld(%%rbp)",
+          16 + 8 * (long)(n->fn->arity - 1 - value->imm));
+      return true;
+    default:
+      sprintf(buffer, "%ld(%%rbp)", -8 * (long)n->slots[value->id]);
+      return true;
+  }
+}
+
+static void load(struct Native* n, const struct IRInstr* value,
+    const char* reg) {
+  bool rax = !strcmp(reg, "%rax");
+  if(rax && n->in_rax == value) return;
+
+  char buffer[32];
+  if(value->op == IR_CONST) emit_word(n, value->imm, reg);
+  else {
+    operand(n, value, buffer);
+    emit(n, "movq %s, %s", buffer, reg);
+  }
+
+  if(rax) n->in_rax = value;
+}
+
+// the right operand of a binary instruction, loaded into reg if it has to be
+static void right_operand(struct Native* n, const struct IRInstr* value,
+    const char* reg, char* buffer) {
+  if(operand(n, value, buffer)) return;
+
+  load(n, value, reg);
+  strcpy(buffer, reg);
+}
+
+// saves %rax as the value, if it has a slot
+static void store(struct Native* n, const struct IRInstr* value) {
+  if(n->slots[value->id])
+    emit(n, "movq %%rax, %ld(%%rbp)", -8 * (long)n->slots[value->id]);
+  n->in_rax = value;
+}
+
+static void push(struct Native* n, const struct IRInstr* value) {
+  char buffer[32];
+  if(n->in_rax == value) emit(n, "pushq %%rax");
+  else if(operand(n, value, buffer)) emit(n, "pushq %s", buffer);
+  else {
+    load(n, value, "%rax");
+    emit(n, "pushq %%rax");
+  }
+}
+
+
+
+// whether the next instruction is a value's only use and loads it into %rax
+// before anything else, in which case it never has to leave %rax. that goes
+// for a block's only phi too, which its predecessors then leave in %rax
+static bool stays_in_rax(const struct Native* n, const struct IRBlock* block,
+    size_t index) {
+  const struct IRInstr* instr = block->instrs.members[index];
+  if(n->uses[instr->id] != 1 || (instr->op == IR_PHI && index > 0))
+    return false;
+
+  // constants and parameters in between take no code
+  size_t after = index + 1;
+  while(after < block->instrs.size
+      && (block->instrs.members[after]->op == IR_CONST
+        || block->instrs.members[after]->op == IR_PARAM))
+    after++;
+  if(after >= block->instrs.size) return false;
+
+  const struct IRInstr* next = block->instrs.members[after];
+  if(!next->nargs || next->args[0] != instr) return false;
+
+  switch(next->op) {
+    case IR_PHI:
+    case IR_JUMP: return false;
+    default:      return true;
+  }
+}
+
+
+
+// ### LOWERING ### //
+
+// comparisons are unsigned like the tree walker's
+static const char* condition_code(enum IROp op, bool negate) {
+  switch(op) {
+    case IR_EQ: return negate ? "ne" : "e";
+    case IR_NE: return negate ? "e"  : "ne";
+    case IR_LT: return negate ? "ae" : "b";
+    case IR_LE: return negate ? "a"  : "be";
+    case IR_GT: return negate ? "be" : "a";
+    case IR_GE: return negate ? "b"  : "ae";
+    default:    return NULL;
+  }
+}
+
+// whether the instruction at index is a comparison only the branch right
+// after it uses, which then jumps on the flags instead
+static bool is_fused(struct Native* n, const struct IRBlock* block,
+    size_t index) {
+  const struct IRInstr* instr = block->instrs.members[index];
+  if(!condition_code(instr->op, false) || n->uses[instr->id] != 1
+      || index + 1 >= block->instrs.size)
+    return false;
+
+  const struct IRInstr* next = block->instrs.members[index + 1];
+  return next->op == IR_BRANCH && next->args[0] == instr;
+}
+
+// comparing with memory directly stalls when the word was just stored, as
+// loop counters are, so the left operand is always loaded
+static void lower_compare(struct Native* n, const struct IRInstr* instr) {
+  char right[32];
+  load(n, instr->args[0], "%rax");
+  right_operand(n, instr->args[1], "%rcx", right);
+  emit(n, "cmpq %s, %%rax", right);
+}
+
+static void lower_binary(struct Native* n, const struct IRInstr* instr) {
+  const struct IRInstr* y = instr->args[1];
+  const char* instruction = NULL;
+  char right[32];
+
+  switch(instr->op) {
+    case IR_ADD: instruction = "addq";  break;
+    case IR_SUB: instruction = "subq";  break;
+    case IR_MUL: instruction = "imulq"; break;
+    case IR_AND: instruction = "andq";  break;
+    case IR_OR:  instruction = "orq";   break;
+    case IR_XOR: instruction = "xorq";  break;
+
+    case IR_DIV:
+    case IR_MOD:
+      load(n, instr->args[0], "%rax");
+      load(n, y, "%rcx");
+      if(y->op != IR_CONST) {
+        emit(n, "testq %%rcx, %%rcx");
+        emit(n, "jz _2n_division_by_zero");
+      } else if(!y->imm) emit(n, "jmp _2n_division_by_zero");
+
+      emit(n, "xorl %%edx, %%edx");
+      emit(n, "divq %%rcx");
+      if(instr->op == IR_MOD) emit(n, "movq %%rdx, %%rax");
+      return;
+
+    case IR_SHL:
+    case IR_SHR: {
+      const char* shift = instr->op == IR_SHL ? "shlq" : "shrq";
+
+      if(y->op == IR_CONST) {
+        load(n, instr->args[0], "%rax");
+        emit(n, "%s $%u, %%rax", shift, (unsigned)(y->imm & 63));
+      } else {
+        load(n, y, "%rcx");
+        load(n, instr->args[0], "%rax");
+        emit(n, "%s %%cl, %%rax", shift);
+      }
+      return;
+    }
+
+    default: break;
+  }
+
+  // multiplying by a power of two is a shift
+  if(instr->op == IR_MUL && y->op == IR_CONST && y->imm
+      && !(y->imm & (y->imm - 1))) {
+    load(n, instr->args[0], "%rax");
+    emit(n, "shlq $%d, %%rax", __builtin_ctzll(y->imm));
+    return;
+  }
+
+  if(instruction) {
+    load(n, instr->args[0], "%rax");
+    right_operand(n, y, "%rcx", right);
+    emit(n, "%s %s, %%rax", instruction, right);
+    return;
+  }
+
+  lower_compare(n, instr);
+  emit(n, "set%s %%al", condition_code(instr->op, false));
+  emit(n, "movzbl %%al, %%eax");
+}
+
+// copies the arguments the phis of the successor take from this block. all
+// of them are read before any is written, so a phi is only overwritten once
+// no other copy still needs it, and a cycle of phis reading each other is
+// broken by moving one of them to %rcx first
+static void lower_phis(struct Native* n, const struct IRBlock* block) {
+  const struct IRBlock* succ = block->succs[0];
+  size_t pred = 0;
+  while(succ->preds.members[pred] != block) pred++;
+
+  size_t phis = 0;
+  while(phis < succ->instrs.size
+      && succ->instrs.members[phis]->op == IR_PHI)
+    phis++;
+
+  if(phis == 1 && !n->slots[succ->instrs.members[0]->id]) {
+    load(n, succ->instrs.members[0]->args[pred], "%rax");
+    return;
+  }
+
+  const struct IRInstr** from = malloc(phis * sizeof(*from));
+  const struct IRInstr* in_rcx = NULL;
+  size_t pending = 0;
+
+  for(size_t i = 0; i < phis; i++) {
+    const struct IRInstr* phi = succ->instrs.members[i];
+    from[i] = phi->args[pred];
+    if(from[i] == phi || n->slots[from[i]->id] == n->slots[phi->id])
+      from[i] = NULL;
+    if(from[i]) pending += 1;
+  }
+
+  while(pending) {
+    bool progress = false;
+
+    for(size_t i = 0; i < phis; i++) {
+      const struct IRInstr* phi = succ->instrs.members[i];
+      if(!from[i]) continue;
+
+      bool read = false;
+      for(size_t j = 0; j < phis; j++) read |= j != i && from[j] == phi;
+      if(read) continue;
+
+      if(from[i] == in_rcx) emit(n, "movq %%rcx, %%rax");
+      else load(n, from[i], "%rax");
+      store(n, phi);
+
+      from[i] = NULL;
+      pending -= 1;
+      progress = true;
+    }
+
+    if(progress) continue;
+
+    // every pending phi is read by another, so they form cycles
+    for(size_t i = 0; i < phis; i++)
+      if(from[i]) {
+        in_rcx = succ->instrs.members[i];
+        load(n, in_rcx, "%rcx");
+        break;
+      }
+  }
+
+  free(from);
+  n->in_rax = NULL;
+}
+
+static void lower_jump(struct Native* n, const struct IRBlock* block,
+    const struct IRBlock* to) {
+  if(to->order != block->order + 1)
+    emit(n, "jmp .L%zu", block_label(n, to));
+}
+
+static void lower_branch(struct Native* n, const struct IRBlock* block,
+    size_t index) {
+  const struct IRInstr* condition = block->instrs.members[index]->args[0];
+  const struct IRBlock* then = block->succs[0];
+  const struct IRBlock* otherwise = block->succs[1];
+
+  // fall through to whichever successor comes next
+  bool negate = then->order == block->order + 1;
+  const struct IRBlock* target = negate ? otherwise : then;
+  const struct IRBlock* other = negate ? then : otherwise;
+
+  if(index > 0 && is_fused(n, block, index - 1)) {
+    lower_compare(n, condition);
+    emit(n, "j%s .L%zu",
+        condition_code(condition->op, negate),
+        block_label(n, target));
+  } else {
+    load(n, condition, "%rax");
+    emit(n, "testq %%rax, %%rax");
+    emit(n, "j%s .L%zu", negate ? "z" : "nz", block_label(n, target));
+  }
+
+  lower_jump(n, block, other);
+}
+
+static void lower_call(struct Native* n, const struct IRInstr* instr) {
+  for(size_t i = 0; i < instr->nargs; i++) push(n, instr->args[i]);
+
+  emit(n, "call _2n_%s", instr->name);
+  if(instr->nargs) emit(n, "addq $%zu, %%rsp", 8 * instr->nargs);
+  n->in_rax = NULL;
+}
+
+// each argument is printed by the runtime routine for its kind
+static void lower_print(struct Native* n, const struct IRInstr* instr) {
+  if(instr->nargs) {
+    load(n, instr->args[0], "%rax");
+    emit(n, "call _2n_print_%s", kind_names[instr->kind]);
+  }
+
+  emit(n, "movl $%s, %%edi", instr->imm == '\n' ? "'\\n'" : "' '");
+  emit(n, "call _2n_putchar");
+  n->in_rax = NULL;
+}
+
+static void lower_instr(struct Native* n, const struct IRBlock* block,
+    size_t index) {
+  const struct IRInstr* instr = block->instrs.members[index];
+
+  switch(instr->op) {
+    case IR_CONST:
+    case IR_PARAM:
+    case IR_PHI:
+      return;
+
+    case IR_STRING:
+      emit(n, "leaq .LS%zu(%%rip), %%rax", emit_string(n, instr->name));
+      break;
+    case IR_COPY:
+      load(n, instr->args[0], "%rax");
+      break;
+    case IR_LOAD:
+      emit(n, "movq _2n_globals+%" PRIu64 "(%%rip), %%rax", 8 * instr->imm);
+      break;
+    case IR_CALL:
+      lower_call(n, instr);
+      break;
+
+    case IR_NEG:
+    case IR_NOT:
+      load(n, instr->args[0], "%rax");
+      emit(n, "%s %%rax", instr->op == IR_NEG ? "negq" : "notq");
+      break;
+    case IR_LOGIC_NOT:
+      load(n, instr->args[0], "%rax");
+      emit(n, "testq %%rax, %%rax");
+      emit(n, "sete %%al");
+      emit(n, "movzbl %%al, %%eax");
+      break;
+
+    case IR_STORE:
+      load(n, instr->args[0], "%rax");
+      emit(n, "movq %%rax, _2n_globals+%" PRIu64 "(%%rip)", 8 * instr->imm);
+      return;
+    case IR_PRINT:
+      lower_print(n, instr);
+      return;
+
+    case IR_JUMP:
+      if(block->succs[0]->instrs.size
+          && block->succs[0]->instrs.members[0]->op == IR_PHI)
+        lower_phis(n, block);
+      lower_jump(n, block, block->succs[0]);
+      return;
+    case IR_BRANCH:
+      lower_branch(n, block, index);
+      return;
+    case IR_RETURN:
+      load(n, instr->args[0], "%rax");
+      emit(n, "leave");
+      emit(n, "ret");
+      return;
+
+    default:
+      if(is_fused(n, block, index)) return;
+      lower_binary(n, instr);
+      break;
+  }
+
+  store(n, instr);
+}
+
+
+static void emit_prologue(struct Native* n, const char* name, size_t words) {
+  fprintf(n->out, "\n  .p2align 4\n%s:\n", name);
+  emit(n, "pushq %%rbp");
+  emit(n, "movq %%rsp, %%rbp");
+  if(words) emit(n, "subq $%zu, %%rsp", 8 * words);
+}
+
+static bool has_value(const struct IRInstr* instr) {
+  switch(instr->op) {
+    case IR_CONST:
+    case IR_PARAM:
+    case IR_STORE:
+    case IR_PRINT:
+    case IR_JUMP:
+    case IR_BRANCH:
+    case IR_RETURN: return false;
+    default:        return true;
+  }
+}
+
+// the phi a value can be computed straight into: one of the successor's,
+// if the value's only use is there and nothing reads the phi after the value
+// is defined, not even the successor's other phis
+static const struct IRInstr* coalesced_phi(const struct Native* n,
+    const struct IRBlock* block, size_t index) {
+  const struct IRInstr* instr = block->instrs.members[index];
+  if(instr->op == IR_PHI || !has_value(instr) || n->uses[instr->id] != 1
+      || block->nsuccs != 1)
+    return NULL;
+
+  const struct IRBlock* succ = block->succs[0];
+  size_t pred = 0;
+  while(succ->preds.members[pred] != block) pred++;
+
+  const struct IRInstr* phi = NULL;
+  for(size_t i = 0; i < succ->instrs.size; i++) {
+    const struct IRInstr* candidate = succ->instrs.members[i];
+    if(candidate->op != IR_PHI) break;
+    if(candidate->args[pred] == instr) phi = candidate;
+  }
+  if(!phi) return NULL;
+
+  for(size_t i = index + 1; i < block->instrs.size; i++) {
+    const struct IRInstr* later = block->instrs.members[i];
+    for(size_t a = 0; a < later->nargs; a++)
+      if(later->args[a] == phi) return NULL;
+  }
+
+  for(size_t i = 0; i < succ->instrs.size; i++) {
+    const struct IRInstr* other = succ->instrs.members[i];
+    if(other->op != IR_PHI) break;
+    if(other != phi && other->args[pred] == phi) return NULL;
+  }
+
+  return phi;
+}
+
+// numbers the slots of the values that need one; returns how many there are
+static size_t assign_slots(struct Native* n, const struct IRFunction* fn) {
+  size_t count = 0;
+
+  for(size_t i = 0; i < fn->blocks.size; i++) {
+    const struct IRBlock* block = fn->blocks.members[i];
+    for(size_t j = 0; j < block->instrs.size; j++) {
+      const struct IRInstr* instr = block->instrs.members[j];
+      for(size_t a = 0; a < instr->nargs; a++) n->uses[instr->args[a]->id]++;
+    }
+  }
+
+  for(size_t i = 0; i < fn->blocks.size; i++) {
+    const struct IRBlock* block = fn->blocks.members[i];
+    for(size_t j = 0; j < block->instrs.size; j++) {
+      const struct IRInstr* instr = block->instrs.members[j];
+      if(has_value(instr) && n->uses[instr->id]
+          && !stays_in_rax(n, block, j) && !coalesced_phi(n, block, j))
+        n->slots[instr->id] = ++count;
+    }
+  }
+
+  // phis all have their slots by now
+  for(size_t i = 0; i < fn->blocks.size; i++) {
+    const struct IRBlock* block = fn->blocks.members[i];
+    for(size_t j = 0; j < block->instrs.size; j++) {
+      const struct IRInstr* phi = coalesced_phi(n, block, j);
+      if(phi) n->slots[block->instrs.members[j]->id] = n->slots[phi->id];
+    }
+  }
+
+  return count;
+}
+
+static void lower_function(struct Native* n, const struct IRFunction* fn) {
+  n->fn = fn;
+  n->uses = calloc(fn->values, sizeof(*n->uses));
+  n->slots = calloc(fn->values, sizeof(*n->slots));
+
+  // the frame is kept a multiple of 16 bytes
+  size_t words = assign_slots(n, fn);
+  char name[256];
+  if(fn->name) snprintf(name, sizeof(name), "_2n_%s", fn->name);
+  else strcpy(name, "_2n_init");
+  emit_prologue(n, name, (words + 1) & ~(size_t)1);
+
+  for(size_t i = 0; i < fn->blocks.size; i++) {
+    const struct IRBlock* block = fn->blocks.members[i];
+    // loop headers are aligned like functions
+    for(size_t p = 0; p < block->preds.size; p++)
+      if(block->preds.members[p]->order >= block->order) {
+        emit(n, ".p2align 4");
+        break;
+      }
+
+    if(i) fprintf(n->out, ".L%zu:\n", block_label(n, block));
+    n->in_rax = NULL;
+    if(block->instrs.members[0]->op == IR_PHI
+        && !n->slots[block->instrs.members[0]->id])
+      n->in_rax = block->instrs.members[0];
+
+    for(size_t j = 0; j < block->instrs.size; j++) lower_instr(n, block, j);
+  }
+
+  n->labels += fn->block_ids;
+  free(n->uses);
+  free(n->slots);
+}
+
+// libc's main initializes the globals and calls ours with argc and argv as
+// its first arguments; its result is the exit status
+static void emit_entry(struct Native* n,
+    const struct IRFunction* main_function) {
+  fprintf(n->out, "\n  .globl main\n");
+  emit_prologue(n, "main", 0);
+  emit(n, "pushq %%rdi");
+  emit(n, "pushq %%rsi");
+  emit(n, "call _2n_init");
+
+  for(size_t i = 0; i < main_function->arity; i++) {
+    if(i < 2) emit(n, "pushq %ld(%%rbp)", -8 * (long)(i + 1));
+    else emit(n, "pushq $0");
+  }
+
+  emit(n, "call _2n_main");
+  emit(n, "leave");
+  emit(n, "ret");
+}
+
+// every routine realigns the stack for libc itself, since generated code
+// doesn't keep it aligned
+static const char* runtime =
+  "\n"
+  "  .p2align 4\n"
+  "_2n_print_int:\n"
+  "  movq %rax, %rsi\n"
+  "  leaq .Lformat_int(%rip), %rdi\n"
+  "  jmp _2n_printf\n"
+  "_2n_print_string:\n"
+  "  movq %rax, %rsi\n"
+  "  leaq .Lformat_string(%rip), %rdi\n"
+  "  jmp _2n_printf\n"
+  "_2n_print_bool:\n"
+  "  leaq .Lfalse(%rip), %rdi\n"
+  "  leaq .Ltrue(%rip), %rcx\n"
+  "  testq %rax, %rax\n"
+  "  cmovnz %rcx, %rdi\n"
+  "  jmp _2n_printf\n"
+  "_2n_print_none:\n"
+  "  leaq .Lundefined(%rip), %rdi\n"
+  "_2n_printf:\n"
+  "  pushq %rbp\n"
+  "  movq %rsp, %rbp\n"
+  "  andq $-16, %rsp\n"
+  "  xorl %eax, %eax\n"
+  "  call printf@PLT\n"
+  "  leave\n"
+  "  ret\n"
+  "_2n_print_char:\n"
+  "  movzbl %al, %edi\n"
+  "_2n_putchar:\n"
+  "  pushq %rbp\n"
+  "  movq %rsp, %rbp\n"
+  "  andq $-16, %rsp\n"
+  "  call putchar@PLT\n"
+  "  leave\n"
+  "  ret\n"
+  "_2n_division_by_zero:\n"
+  "  andq $-16, %rsp\n"
+  "  leaq .Ldivision_by_zero(%rip), %rdi\n"
+  "  xorl %eax, %eax\n"
+  "  call printf@PLT\n"
+  "  movl $1, %edi\n"
+  "  call exit@PLT\n"
+  "\n"
+  "  .section .rodata\n"
+  ".Lformat_int:     .string \"%lu\"\n"
+  ".Lformat_string:  .string \"%s\"\n"
+  ".Ltrue:           .string \"true\"\n"
+  ".Lfalse:          .string \"false\"\n"
+  ".Lundefined:      .string \"undefined\"\n"
+  ".Ldivision_by_zero: .string \"ERROR: division by zero\\n\"\n"
+  "  .section .note.GNU-stack,\"\",@progbits\n";
+
+void emit_assembly(const struct IRProgram* program, FILE* out) {
+  struct Native native = { .out = out, .labels = 0, .strings = 0 };
+
+  fprintf(out, "  .text\n");
+  lower_function(&native, program->init);
+
+  for(size_t i = 0; i < program->functions.size; i++)
+    lower_function(&native, program->functions.members[i]);
+
+  emit_entry(&native, program->main);
+
+  fprintf(out, "%s", runtime);
+  fprintf(out, "\n  .bss\n  .p2align 3\n_2n_globals:\n  .zero %zu\n",
+      8 * (program->globals ? program->globals : 1));
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+#include "../ir/ir.h"
+#include <stdio.h>
+
+// writes gnu assembly for x86-64 linux
+void emit_assembly(const struct IRProgram*, FILE*);
@@ -0,0 +1,373 @@
+// emitc.c
+
+#include "emitc.h"
+#include <ctype.h>
+#include <inttypes.h>
+#include <stdarg.h>
+
+// translates the ir to c99. every value is a uint64_t local v<id> assigned
+// once, blocks become labels bb<id> and control flow gotos, and phis are
+// assignments at the end of each predecessor. the rest of the optimizing is
+// left to the c compiler
+//
+// parameters become p<index>, globals g<slot> and functions f_<name>, so
+// none of them can clash with c or libc
+
+struct Emitter {
+  FILE* out;
+};
+
+
+
+// ### EMITTING FUNCTIONS ### //
+
+// writes one indented line
+__attribute__((format(printf, 2, 3)))
+static void emit(struct Emitter* e, const char* format, ...) {
+  va_list args;
+  va_start(args, format);
+
+  fputs("  ", e->out);
+  vfprintf(e->out, format, args);
+  fputc('\n', e->out);
+
+  va_end(args);
+}
+
+// writes part of a line
+__attribute__((format(printf, 2, 3)))
+static void print(struct Emitter* e, const char* format, ...) {
+  va_list args;
+  va_start(args, format);
+  vfprintf(e->out, format, args);
+  va_end(args);
+}
+
+// escapes everything but plain printable characters, trigraphs included
+static void print_string_literal(struct Emitter* e, const char* string) {
+  print(e, "(uint64_t)(uintptr_t)\"");
+
+  for(const unsigned char* c = (const unsigned char*)string; *c; c++) {
+    if(*c == '"' || *c == '\\' || *c == '?' || !isprint(*c))
+      print(e, "\\%03o", *c);
+    else fputc(*c, e->out);
+  }
+
+  print(e, "\"");
+}
+
+
+
+// ### VALUES ### //
+
+// whether an instruction defines a v<id> of its own
+static bool has_local(const struct IRInstr* instr) {
+  switch(instr->op) {
+    case IR_CONST:
+    case IR_PARAM:
+    case IR_STORE:
+    case IR_PRINT:
+    case IR_JUMP:
+    case IR_BRANCH:
+    case IR_RETURN: return false;
+    default:        return true;
+  }
+}
+
+static void print_value(struct Emitter* e, const struct IRInstr* value) {
+  switch(value->op) {
+    case IR_CONST: print(e, "UINT64_C(%" PRIu64 ")", value->imm); break;
+    case IR_PARAM: print(e, "p%" PRIu64, value->imm);              break;
+    default:       print(e, "v%zu", value->id);                    break;
+  }
+}
+
+static const char* infix(enum IROp op) {
+  switch(op) {
+    case IR_ADD: return "+";
+    case IR_SUB: return "-";
+    case IR_MUL: return "*";
+    case IR_AND: return "&";
+    case IR_OR:  return "|";
+    case IR_XOR: return "^";
+    case IR_EQ:  return "==";
+    case IR_NE:  return "!=";
+    case IR_LT:  return "<";
+    case IR_LE:  return "<=";
+    case IR_GT:  return ">";
+    case IR_GE:  return ">=";
+    default:     return NULL;
+  }
+}
+
+// everything is unsigned like the tree walker's, and done on uint64_t,
+// which wraps, so +% and friends are just the plain operators
+static void print_binary(struct Emitter* e, const struct IRInstr* instr) {
+  const struct IRInstr* x = instr->args[0];
+  const struct IRInstr* y = instr->args[1];
+
+  switch(instr->op) {
+    case IR_DIV:
+    case IR_MOD:
+      print(e, "%s_u(", instr->op == IR_DIV ? "div" : "mod");
+      print_value(e, x);
+      print(e, ", ");
+      print_value(e, y);
+      print(e, ")");
+      return;
+
+    case IR_SHL:
+    case IR_SHR:
+      print(e, "(uint64_t)(");
+      print_value(e, x);
+      print(e, " %s (", instr->op == IR_SHL ? "<<" : ">>");
+      print_value(e, y);
+      print(e, " & 63))");
+      return;
+
+    default: break;
+  }
+
+  print(e, "(uint64_t)(");
+  print_value(e, x);
+  print(e, " %s ", infix(instr->op));
+  print_value(e, y);
+  print(e, ")");
+}
+
+static void print_expression(struct Emitter* e, const struct IRInstr* instr) {
+  switch(instr->op) {
+    case IR_STRING: print_string_literal(e, instr->name); return;
+    case IR_LOAD:   print(e, "g%" PRIu64, instr->imm);    return;
+    case IR_COPY:   print_value(e, instr->args[0]);       return;
+    case IR_CALL:
+      print(e, "f_%s(", instr->name);
+      for(size_t i = 0; i < instr->nargs; i++) {
+        if(i) print(e, ", ");
+        print_value(e, instr->args[i]);
+      }
+      print(e, ")");
+      return;
+
+    case IR_NEG:
+    case IR_NOT:
+    case IR_LOGIC_NOT:
+      print(e, "%s", instr->op == IR_NEG ? "-"
+          : instr->op == IR_NOT ? "~" : "(uint64_t)!");
+      print_value(e, instr->args[0]);
+      return;
+
+    default:
+      print_binary(e, instr);
+      return;
+  }
+}
+
+
+
+// ### CONTROL FLOW ### //
+
+static void emit_goto(struct Emitter* e, const struct IRBlock* block,
+    const struct IRBlock* to) {
+  if(to->order != block->order + 1) emit(e, "goto bb%zu;", to->id);
+}
+
+// the phis of the successor all take their argument from this block at
+// once, so with several of them the arguments are read into temporaries
+// first
+static void emit_phis(struct Emitter* e, const struct IRBlock* block) {
+  const struct IRBlock* succ = block->succs[0];
+  size_t pred = 0;
+  while(succ->preds.members[pred] != block) pred++;
+
+  size_t phis = 0;
+  while(phis < succ->instrs.size
+      && succ->instrs.members[phis]->op == IR_PHI)
+    phis++;
+
+  if(phis == 1) {
+    const struct IRInstr* phi = succ->instrs.members[0];
+    if(phi->args[pred] == phi) return;
+
+    print(e, "  v%zu = ", phi->id);
+    print_value(e, phi->args[pred]);
+    print(e, ";\n");
+    return;
+  }
+
+  print(e, "  {\n");
+  for(size_t i = 0; i < phis; i++) {
+    print(e, "    uint64_t t%zu = ", i);
+    print_value(e, succ->instrs.members[i]->args[pred]);
+    print(e, ";\n");
+  }
+  for(size_t i = 0; i < phis; i++)
+    print(e, "    v%zu = t%zu;\n", succ->instrs.members[i]->id, i);
+  print(e, "  }\n");
+}
+
+static void emit_instr(struct Emitter* e, const struct IRBlock* block,
+    const struct IRInstr* instr) {
+  switch(instr->op) {
+    case IR_CONST:
+    case IR_PARAM:
+    case IR_PHI:
+      return;
+
+    case IR_STORE:
+      print(e, "  g%" PRIu64 " = ", instr->imm);
+      print_value(e, instr->args[0]);
+      print(e, ";\n");
+      return;
+    case IR_PRINT:
+      if(instr->nargs) {
+        print(e, "  print_%s(", kind_names[instr->kind]);
+        print_value(e, instr->args[0]);
+        print(e, ");\n");
+      }
+      emit(e, "putchar('%s');", instr->imm == '\n' ? "\\n" : " ");
+      return;
+
+    case IR_JUMP:
+      if(block->succs[0]->instrs.size
+          && block->succs[0]->instrs.members[0]->op == IR_PHI)
+        emit_phis(e, block);
+      emit_goto(e, block, block->succs[0]);
+      return;
+    case IR_BRANCH:
+      print(e, "  if(");
+      print_value(e, instr->args[0]);
+      print(e, ") goto bb%zu;\n", block->succs[0]->id);
+      emit_goto(e, block, block->succs[1]);
+      return;
+    case IR_RETURN:
+      print(e, "  return ");
+      print_value(e, instr->args[0]);
+      print(e, ";\n");
+      return;
+
+    default:
+      print(e, "  v%zu = ", instr->id);
+      print_expression(e, instr);
+      print(e, ";\n");
+      return;
+  }
+}
+
+
+
+static void print_signature(struct Emitter* e, const struct IRFunction* fn) {
+  if(fn->name) print(e, "static uint64_t f_%s(", fn->name);
+  else print(e, "static uint64_t init_globals(");
+
+  for(size_t i = 0; i < fn->arity; i++)
+    print(e, "%suint64_t p%zu", i ? ", " : "", i);
+
+  print(e, "%s)", fn->arity ? "" : "void");
+}
+
+// every value is declared up front, since gotos can't jump past
+// initializations
+static void emit_function(struct Emitter* e, const struct IRFunction* fn) {
+  print(e, "\n");
+  print_signature(e, fn);
+  print(e, " {\n");
+
+  size_t declared = 0;
+  for(size_t i = 0; i < fn->blocks.size; i++) {
+    const struct IRBlock* block = fn->blocks.members[i];
+
+    for(size_t j = 0; j < block->instrs.size; j++) {
+      const struct IRInstr* instr = block->instrs.members[j];
+      if(!has_local(instr)) continue;
+
+      if(declared % 8 == 0) print(e, "%s  uint64_t", declared ? ";\n" : "");
+      print(e, "%s v%zu", declared % 8 ? "," : "", instr->id);
+      declared += 1;
+    }
+  }
+  if(declared) print(e, ";\n");
+
+  for(size_t i = 0; i < fn->blocks.size; i++) {
+    const struct IRBlock* block = fn->blocks.members[i];
+    if(i) print(e, "bb%zu:;\n", block->id);
+
+    for(size_t j = 0; j < block->instrs.size; j++)
+      emit_instr(e, block, block->instrs.members[j]);
+  }
+
+  print(e, "}\n");
+}
+
+// main gets argc and argv as its first arguments, and its result is the exit
+// status
+static void emit_entry(struct Emitter* e,
+    const struct IRFunction* main_function) {
+  print(e, "\nint main(int argc, char** argv) {\n");
+  print(e, "  (void)argc;\n  (void)argv;\n  init_globals();\n");
+  print(e, "  return (int)f_main(");
+
+  for(size_t i = 0; i < main_function->arity; i++) {
+    if(i) print(e, ", ");
+    if(i == 0) print(e, "(uint64_t)argc");
+    else if(i == 1) print(e, "(uint64_t)(uintptr_t)argv");
+    else print(e, "0");
+  }
+
+  print(e, ");\n}\n");
+}
+
+static const char* prelude =
+  "#include <inttypes.h>\n"
+  "#include <stdint.h>\n"
+  "#include <stdio.h>\n"
+  "#include <stdlib.h>\n"
+  "\n"
+  "static inline void print_none(uint64_t x) {\n"
+  "  (void)x;\n"
+  "  fputs(\"undefined\", stdout);\n"
+  "}\n"
+  "static inline void print_int(uint64_t x) { printf(\"%\" PRIu64, x); }\n"
+  "static inline void print_bool(uint64_t x) {\n"
+  "  fputs(x ? \"true\" : \"false\", stdout);\n"
+  "}\n"
+  "static inline void print_char(uint64_t x) { putchar((char)x); }\n"
+  "static inline void print_string(uint64_t x) {\n"
+  "  fputs((const char*)(uintptr_t)x, stdout);\n"
+  "}\n"
+  "\n"
+  "static uint64_t division_by_zero(void) {\n"
+  "  printf(\"ERROR: division by zero\\n\");\n"
+  "  exit(1);\n"
+  "}\n"
+  "static inline uint64_t div_u(uint64_t x, uint64_t y) {\n"
+  "  return y ? x / y : division_by_zero();\n"
+  "}\n"
+  "static inline uint64_t mod_u(uint64_t x, uint64_t y) {\n"
+  "  return y ? x % y : division_by_zero();\n"
+  "}\n";
+
+void emit_c(const struct IRProgram* program, FILE* out) {
+  struct Emitter emitter = { .out = out };
+  fputs(prelude, out);
+
+  for(size_t i = 0; i < program->functions.size; i++) {
+    print(&emitter, "\n");
+    print_signature(&emitter, program->functions.members[i]);
+    print(&emitter, ";");
+  }
+  print(&emitter, "\n");
+
+  if(program->globals) {
+    print(&emitter, "\nstatic uint64_t");
+    for(size_t slot = 0; slot < program->globals; slot++)
+      print(&emitter, "%s g%zu", slot ? "," : "", slot);
+    print(&emitter, ";\n");
+  }
+
+  emit_function(&emitter, program->init);
+  for(size_t i = 0; i < program->functions.size; i++)
+    emit_function(&emitter, program->functions.members[i]);
+
+  emit_entry(&emitter, program->main);
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+#include "../ir/ir.h"
+#include <stdio.h>
+
+// writes the program as c99
+void emit_c(const struct IRProgram*, FILE*);
@@ -0,0 +1,78 @@
+// link.c
+
+#include "codegen.h"
+#include "emitc.h"
+#include "link.h"
+#include <errno.h>
+#include <spawn.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+static bool link_error(const char* what, const char* path) {
+  printf("error: %s %s: %s\n", what, path, strerror(errno));
+  return false;
+}
+
+// runs $CC -o output input and waits for it
+static bool run_linker(const char* input, const char* output) {
+  const char* cc = getenv("CC");
+  if(!cc || !*cc) cc = "cc";
+
+  char* argv[] = {
+    (char*)cc, (char*)"-o", (char*)output, (char*)input, NULL
+  };
+
+  pid_t pid;
+  int status;
+  if((errno = posix_spawnp(&pid, cc, NULL, NULL, argv, environ)))
+    return link_error("could not run", cc);
+  if(waitpid(pid, &status, 0) < 0) return link_error("could not wait for", cc);
+
+  if(!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    printf("error: %s failed to assemble and link %s\n", cc, output);
+    return false;
+  }
+
+  return true;
+}
+
+bool build_executable(const struct IRProgram* program, const char* output,
+    bool assembly) {
+  if(assembly) {
+    FILE* file = fopen(output, "w");
+    if(!file) return link_error("could not open", output);
+
+    emit_assembly(program, file);
+    fclose(file);
+    return true;
+  }
+
+  char path[] = "/tmp/twonic-XXXXXX.s";
+  int fd = mkstemps(path, 2);
+  if(fd < 0) return link_error("could not create", path);
+
+  FILE* file = fdopen(fd, "w");
+  emit_assembly(program, file);
+  fclose(file);
+
+  bool ok = run_linker(path, output);
+  unlink(path);
+  return ok;
+}
+
+bool write_c(const struct IRProgram* program, const char* output) {
+  if(!output) {
+    emit_c(program, stdout);
+    return true;
+  }
+
+  FILE* file = fopen(output, "w");
+  if(!file) return link_error("could not open", output);
+
+  emit_c(program, file);
+  fclose(file);
+  return true;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include "../ir/ir.h"
+
+// compiles the program to an executable at output, assembling and linking it
+// with the system's c compiler ($CC, or cc); with assembly set, the assembly
+// itself is written to output instead
+bool build_executable(const struct IRProgram*, const char* output,
+    bool assembly);
+
+// writes the program as c99 to output, or stdout if it is NULL
+bool write_c(const struct IRProgram*, const char* output);
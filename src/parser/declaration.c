@@ -6,7 +6,7 @@
 #include "type.h"
 
 struct Variable* parse_variable(struct Parser* parser) {
-  struct Variable* variable = malloc(sizeof(*variable));
+  struct Variable* variable = arena_alloc(parser->arena, sizeof(*variable));
 
   variable->vars = parse_vardecls(parser);
 
@@ -17,10 +17,10 @@ struct Variable* parse_variable(struct Parser* parser) {
 
 
 struct Struct* parse_struct(struct Parser* parser) {
-  struct Struct* _struct = malloc(sizeof(*_struct));
+  struct Struct* _struct = arena_alloc(parser->arena, sizeof(*_struct));
 
   if(MATCH_TOKEN(parser, IDENTIFIER_LIT))
-    _struct->name = parser->previous.as.string;
+    _struct->name = token_string(parser, &parser->previous);
   else _struct->name = NULL;
 
   if(MATCH_TOKEN(parser, LEFT_PAREN)) {
@@ -33,10 +33,10 @@ struct Struct* parse_struct(struct Parser* parser) {
 
 
 struct Union* parse_union(struct Parser* parser) {
-  struct Union* _union = malloc(sizeof(*_union));
+  struct Union* _union = arena_alloc(parser->arena, sizeof(*_union));
 
   if(MATCH_TOKEN(parser, IDENTIFIER_LIT))
-    _union->name = parser->previous.as.string;
+    _union->name = token_string(parser, &parser->previous);
   else _union->name = NULL;
 
   if(MATCH_TOKEN(parser, LEFT_PAREN)) {
@@ -49,10 +49,10 @@ struct Union* parse_union(struct Parser* parser) {
 
 
 struct FuncSig* parse_funcsig(struct Parser* parser) {
-  struct FuncSig* fs = malloc(sizeof(*fs));
+  struct FuncSig* fs = arena_alloc(parser->arena, sizeof(*fs));
 
   if(MATCH_TOKEN(parser, IDENTIFIER_LIT))
-    fs->name = parser->previous.as.string;
+    fs->name = token_string(parser, &parser->previous);
   else fs->name = NULL;
 
   EXPECT_TOKEN(parser, LEFT_PAREN, EXPECTED_LEFT_PAREN);
@@ -70,7 +70,11 @@ struct FuncSig* parse_funcsig(struct Parser* parser) {
 
 
 static struct Function* parse_function(struct Parser* parser) {
-  struct Function* func = malloc(sizeof(*func));
+  struct Function* func = arena_alloc(parser->arena, sizeof(*func));
+  func->file = parser->filename;
+
+  func->body = 0;
+  refer_node(parser->nodes, &func->body);
 
   func->sig = parse_funcsig(parser);
 
@@ -85,7 +89,7 @@ static struct Function* parse_function(struct Parser* parser) {
 // probably overkill lol
 static const char* parse_include(struct Parser* parser) {
   EXPECT_TOKEN(parser, STRING_LIT, EXPECTED_STRING);
-  const char* include = parser->previous.as.string;
+  const char* include = token_string(parser, &parser->previous);
   EXPECT_TOKEN(parser, SEMICOLON, EXPECTED_END_OF_DECLARATION);
 
   return include;
@@ -95,7 +99,8 @@ static const char* parse_include(struct Parser* parser) {
 struct Declaration* parse_declaration(struct Parser* parser) {
   parser->is_panic = false;
 
-  struct Declaration* decl = malloc(sizeof(*decl));
+  struct Declaration* decl = arena_alloc(parser->arena, sizeof(*decl));
+  decl->file = parser->filename;
 
   if(MATCH_TOKEN(parser, LET)) {
     decl->type = DECL_VAR;
@@ -127,58 +132,59 @@ struct Declaration* parse_declaration(struct Parser* parser) {
 
 // ### PRINT FUNCTIONS ## //
 
-void print_variable(const struct Variable* ast) {
+void print_variable(const struct Nodes* nodes, const struct Variable* ast) {
   if(ast == NULL) { printf("(NULL)"); return; }
 
-  print_vardecls(ast->vars);
+  print_vardecls(nodes, ast->vars);
 }
 
 
-void print_struct(const struct Struct* ast) {
+void print_struct(const struct Nodes* nodes, const struct Struct* ast) {
   if(ast == NULL) { printf("(NULL)"); return; }
 
   printf("(struct ");
   if(ast->name) printf("%s ", ast->name);
-  if(ast->fields) print_vardecls(ast->fields);
+  if(ast->fields) print_vardecls(nodes, ast->fields);
   printf(")");
 }
 
 
-void print_union(const struct Union* ast) {
+void print_union(const struct Nodes* nodes, const struct Union* ast) {
   if(ast == NULL) { printf("(NULL)"); return; }
 
   printf("(union ");
   if(ast->name) printf("%s ", ast->name);
-  if(ast->fields) print_types(ast->fields);
+  if(ast->fields) print_types(nodes, ast->fields);
   printf(")");
 }
 
 
-void print_funcsig(const struct FuncSig* ast) {
+void print_funcsig(const struct Nodes* nodes, const struct FuncSig* ast) {
   if(ast == NULL) { printf("(NULL)"); return; }
 
   printf("(sig ");
   if(ast->name) printf("%s ", ast->name);
 
   printf("(");
-  if(ast->args) { print_vardecls(ast->args); printf(") "); }
+  if(ast->args) { print_vardecls(nodes, ast->args); printf(") "); }
   else printf("void) ");
 
   printf("(");
-  if(ast->returns) { print_type(ast->returns); printf(") "); }
+  if(ast->returns) { print_type(nodes, ast->returns); printf(") "); }
   else printf("void) ");
 
   printf("\b)");
 }
 
 
-static void print_func(const struct Function* ast) {
+static void print_func(const struct Nodes* nodes,
+    const struct Function* ast) {
   if(ast == NULL) { printf("(NULL)"); return; }
 
   printf("(function ");
-  print_funcsig(ast->sig);
+  print_funcsig(nodes, ast->sig);
   printf(" (");
-  print_block(ast->body);
+  print_block(nodes, ast->body);
   printf("))");
 }
 
@@ -189,14 +195,15 @@ static void print_include(const char* ast) {
 }
 
 
-void print_declaration(const struct Declaration* ast) {
+void print_declaration(const struct Nodes* nodes,
+    const struct Declaration* ast) {
   if(ast == NULL) { printf("(NULL)"); return; }
 
   switch(ast->type) {
-    case DECL_VAR:    print_variable(ast->as.var);    break;
-    case DECL_STRUCT: print_struct(ast->as._struct);  break;
-    case DECL_UNION:  print_union(ast->as._union);    break;
-    case DECL_FUNC:   print_func(ast->as.function);   break;
+    case DECL_VAR:    print_variable(nodes, ast->as.var);    break;
+    case DECL_STRUCT: print_struct(nodes, ast->as._struct);  break;
+    case DECL_UNION:  print_union(nodes, ast->as._union);    break;
+    case DECL_FUNC:   print_func(nodes, ast->as.function);   break;
     case DECL_INC:    print_include(ast->as.include); break;
   }
 }
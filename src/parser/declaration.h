@@ -25,7 +25,9 @@ struct FuncSig {
 
 struct Function {
   struct FuncSig* sig;
-  struct Block* body;
+  uint32_t body;    // an EXPR_BLOCK
+  size_t slots;     // size of the frame, set by the resolver
+  const char* file; // it was parsed from; set again when read from an image
 };
 
 struct Declaration {
@@ -39,6 +41,7 @@ struct Declaration {
     struct Function* function;
     const char* include;
   } as;
+  const char* file; // like a function's, for reporting errors in it
 };
 
 struct Variable* parse_variable(struct Parser*);
@@ -47,8 +50,8 @@ struct Union* parse_union(struct Parser*);
 struct FuncSig* parse_funcsig(struct Parser*);
 struct Declaration* parse_declaration(struct Parser*);
 
-void print_variable(const struct Variable*);
-void print_struct(const struct Struct*);
-void print_union(const struct Union*);
-void print_funcsig(const struct FuncSig*);
-void print_declaration(const struct Declaration*);
+void print_variable(const struct Nodes*, const struct Variable*);
+void print_struct(const struct Nodes*, const struct Struct*);
+void print_union(const struct Nodes*, const struct Union*);
+void print_funcsig(const struct Nodes*, const struct FuncSig*);
+void print_declaration(const struct Nodes*, const struct Declaration*);
@@ -4,12 +4,33 @@
 #include "declaration.h"
 #include "list.h"
 #include <stdio.h>
+#include <string.h>
 
 
 // ### ALLOCATION FUNCTIONS ### //
 
-static struct Expression* alloc_literal(enum ValueType type, void* value) {
-  struct Expression* expr = malloc(sizeof(*expr));
+static uint32_t last_offset(const struct Parser* parser) {
+  return parser->tokens.offsets[parser->cursor ? parser->cursor - 1 : 0];
+}
+
+// placed at the last token read, which is where the expression starts for
+// anything not built around an operand parsed before it
+static uint32_t alloc_expression(struct Parser* parser, enum ExprType type,
+    uint8_t op, uint32_t lhs, uint32_t rhs) {
+  return push_node(parser->nodes, type, op, last_offset(parser), lhs, rhs);
+}
+
+// placed where the operand it's built around starts
+static uint32_t alloc_around(struct Parser* parser, uint32_t first,
+    enum ExprType type, uint8_t op, uint32_t lhs, uint32_t rhs) {
+  uint32_t expr = alloc_expression(parser, type, op, lhs, rhs);
+  if(first) parser->nodes->offsets[expr] = parser->nodes->offsets[first];
+  return expr;
+}
+
+static uint32_t alloc_literal(struct Parser* parser, enum ValueType type,
+    void* value) {
+  uint32_t expr = alloc_expression(parser, EXPR_LITERAL, 0, 0, 0);
 
   struct Value literal = { .type = type };
 
@@ -27,145 +48,104 @@ static struct Expression* alloc_literal(enum ValueType type, void* value) {
     literal.as.string = *(char**)value; break;
   }
 
-  expr->type = EXPR_LITERAL;
-  expr->as.literal = literal;
-
+  set_literal(parser->nodes, expr, literal);
   return expr;
 }
 
 
-static struct Expression* alloc_unary(enum TokenType op,
-    struct Expression* operand) {
-  struct Expression* expr = malloc(sizeof(*expr));
-
-  struct Unary unary = { .op = op, .operand = operand };
-
-  expr->type = EXPR_UNARY;
-  expr->as.unary = unary;
-
-  return expr;
+static uint32_t alloc_unary(struct Parser* parser, enum TokenType op,
+    uint32_t operand) {
+  return alloc_expression(parser, EXPR_UNARY, op, operand, 0);
 }
 
 
-static struct Expression* alloc_binary(enum TokenType op,
-    struct Expression* left, struct Expression* right) {
-  struct Expression* expr = malloc(sizeof(*expr));
-
-  struct Binary binary = { .op = op, .left = left, .right = right };
-
-  expr->type = EXPR_BINARY;
-  expr->as.binary = binary;
-
-  return expr;
+static uint32_t alloc_binary(struct Parser* parser, enum ExprType type,
+    enum TokenType op, uint32_t left, uint32_t right) {
+  return alloc_around(parser, left, type, op, left, right);
 }
 
 
-static struct Expression* alloc_group(struct Expression* expr) {
-  struct Expression* group = malloc(sizeof(*group));
-  group->type = EXPR_GROUP;
-  group->as.group.expr = expr;
-  return group;
+static uint32_t alloc_group(struct Parser* parser, uint32_t expr) {
+  return alloc_expression(parser, EXPR_GROUP, 0, expr, 0);
 }
 
 
-static struct Expression* alloc_call(struct Expression* callee,
-    struct Expression* arguments) {
-  struct Expression* expr = malloc(sizeof(*expr));
-  expr->type = EXPR_CALL;
-  expr->as.call.callee = callee;
-  expr->as.call.arguments = arguments;
-  return expr;
+static uint32_t alloc_call(struct Parser* parser, uint32_t callee,
+    uint32_t arguments) {
+  return alloc_around(parser, callee, EXPR_CALL, 0, callee, arguments);
 }
 
 
-static struct Expression* alloc_field(struct Expression* parent,
+static uint32_t alloc_field(struct Parser* parser, uint32_t parent,
     const char* field) {
-  struct Expression* expr = malloc(sizeof(*expr));
-  expr->type = EXPR_FIELD;
-  expr->as.field.parent = parent;
-  expr->as.field.field = field;
-  return expr;
+  uint32_t name = push_name(parser->nodes, field);
+  return alloc_around(parser, parent, EXPR_FIELD, 0, parent, name);
 }
 
 
-static struct Expression* alloc_array_index(struct Expression* array,
-    struct Expression* index) {
-  struct Expression* expr = malloc(sizeof(*expr));
-  expr->type = EXPR_ARRAY_INDEX;
-  expr->as.array_index.array = array;
-  expr->as.array_index.index = index;
-  return expr;
+static uint32_t alloc_array_index(struct Parser* parser, uint32_t array,
+    uint32_t index) {
+  return alloc_around(parser, array, EXPR_ARRAY_INDEX, 0, array, index);
 }
 
 
-static struct Expression* alloc_cast(struct Expression* expr,
+static uint32_t alloc_cast(struct Parser* parser, uint32_t expr,
     struct Type* type) {
-  struct Expression* cast = malloc(sizeof(*cast));
-  cast->type = EXPR_CAST;
-  cast->as.cast.expr = expr;
-  cast->as.cast.type = type;
-  return cast;
+  uint32_t at = push_type(parser->nodes, type);
+  return alloc_around(parser, expr, EXPR_CAST, 0, expr, at);
 }
 
 
 #define ALLOC_LITERAL(tag, _type, value) \
-  ({ _type a = value; alloc_literal(VAL_##tag, &a); })
+  ({ _type a = value; alloc_literal(parser, VAL_##tag, &a); })
 
 
 
 // ### PARSING FUNCTIONS ## //
 
-static struct Expression* parse_group(struct Parser* parser) {
-  struct Expression* group = malloc(sizeof(*group));
+// made after what's in it, like every node, at the parenthesis
+static uint32_t parse_group(struct Parser* parser) {
+  uint32_t offset = last_offset(parser);
 
-  struct Expression* expr = parse_expression(parser);
+  uint32_t expr = parse_expression(parser);
 
-  EXPECT_TOKEN(parser, RIGHT_PAREN, EXPECTED_RIGHT_PAREN);
+  EXPECT_NODE_TOKEN(parser, RIGHT_PAREN, EXPECTED_RIGHT_PAREN);
 
-  group->type = EXPR_GROUP;
-
-  if(group) group->as.group.expr = expr;
-  return group;
+  return push_node(parser->nodes, EXPR_GROUP, 0, offset, expr, 0);
 }
 
 
-static struct Expression* parse_expressions(struct Parser* parser) {
-  struct Expression* head = malloc(sizeof(*head));
+// the expressions are put in extra as their count and then the nodes, and
+// where they start is returned
+static uint32_t parse_expressions(struct Parser* parser) {
+  size_t start = parser->pending.size;
 
-  struct Expression* tail = head;
-  tail->type = EXPR_LIST;
-  tail->as.list.current = parse_expression(parser);
+  do {
+    uint32_t expr = parse_expression(parser);
+    APPEND_VECTOR(&parser->pending, expr);
+  } while(MATCH_TOKEN(parser, COMMA));
 
-  while(MATCH_TOKEN(parser, COMMA)) {
-    tail->as.list.next = malloc(sizeof(*(tail->as.list.next)));
-    tail = tail->as.list.next;
+  uint32_t count = parser->pending.size - start;
+  uint32_t at = push_extra(parser->nodes, &count, 1);
+  push_extra(parser->nodes, parser->pending.members + start, count);
 
-    tail->type = EXPR_LIST;
-    tail->as.list.current = parse_expression(parser);
-  }
-
-  // (a (b (c NULL))) -> (a (b c))
-  struct Expression* c = tail->as.list.current;
-  *tail = *c;
-  free(c);
-
-  return head;
+  parser->pending.size = start;
+  return at;
 }
 
 
-static struct Expression* parse_array_init(struct Parser* parser) {
-  struct Expression* expr = malloc(sizeof(*expr));
-  expr->type = EXPR_ARRAY_INIT;
+static uint32_t parse_array_init(struct Parser* parser) {
+  uint32_t offset = last_offset(parser);
 
-  expr->as.array_init.elements = parse_expressions(parser);
+  uint32_t elements = parse_expressions(parser);
 
-  EXPECT_TOKEN(parser, RIGHT_BRACKET, EXPECTED_RIGHT_BRACKET);
+  EXPECT_NODE_TOKEN(parser, RIGHT_BRACKET, EXPECTED_RIGHT_BRACKET);
 
-  return expr;
+  return push_node(parser->nodes, EXPR_ARRAY_INIT, 0, offset, elements, 0);
 }
 
 
-static struct Expression* parse_primary(struct Parser* parser) {
+static uint32_t parse_primary(struct Parser* parser) {
   if(MATCH_TOKEN(parser, TRUE) || MATCH_TOKEN(parser, FALSE))
     return ALLOC_LITERAL(BOOL,bool,parser->previous.type==TOKEN_TRUE?true:false);
 
@@ -179,10 +159,12 @@ static struct Expression* parse_primary(struct Parser* parser) {
     return ALLOC_LITERAL(CHAR, char, parser->previous.as.character);
 
   if(MATCH_TOKEN(parser, STRING_LIT))
-    return ALLOC_LITERAL(STRING, const char*, parser->previous.as.string);
+    return ALLOC_LITERAL(STRING, const char*,
+        token_string(parser, &parser->previous));
 
   if(MATCH_TOKEN(parser, IDENTIFIER_LIT))
-    return ALLOC_LITERAL(IDENTIFIER, const char*, parser->previous.as.string);
+    return ALLOC_LITERAL(IDENTIFIER, const char*,
+        token_string(parser, &parser->previous));
 
   if(MATCH_TOKEN(parser, LEFT_PAREN))
     return parse_group(parser);
@@ -191,42 +173,44 @@ static struct Expression* parse_primary(struct Parser* parser) {
     return parse_array_init(parser);
 
   if(MATCH_TOKEN(parser, ERROR))
-    return RETURN_ERROR(parser, parser->previous.as.integer);
+    return RETURN_NODE_ERROR(parser, parser->previous.as.integer);
 
   if(MATCH_TOKEN(parser, EOF))
-    return RETURN_ERROR(parser, ERROR_UNEXPECTED_EOF);
+    return RETURN_NODE_ERROR(parser, ERROR_UNEXPECTED_EOF);
 
-  return RETURN_ERROR(parser, ERROR_EXPECTED_EXPRESSION);
+  return RETURN_NODE_ERROR(parser, ERROR_EXPECTED_EXPRESSION);
 }
 
 
-static struct Expression* parse_call(struct Parser* parser) {
-  struct Expression* primary = parse_primary(parser);
+static uint32_t parse_call(struct Parser* parser) {
+  uint32_t primary = parse_primary(parser);
 
   while(!MATCH_TOKEN(parser, EOF)) {
     if(MATCH_TOKEN(parser, LEFT_PAREN)) {
-      if(MATCH_TOKEN(parser, RIGHT_PAREN))
-        primary = alloc_call(primary, NULL);
-      else {
-        primary = alloc_call(primary, parse_expressions(parser));
-        EXPECT_TOKEN(parser, RIGHT_PAREN, EXPECTED_RIGHT_PAREN);
+      if(MATCH_TOKEN(parser, RIGHT_PAREN)) {
+        uint32_t none = 0;
+        primary = alloc_call(parser, primary,
+            push_extra(parser->nodes, &none, 1));
+      } else {
+        primary = alloc_call(parser, primary, parse_expressions(parser));
+        EXPECT_NODE_TOKEN(parser, RIGHT_PAREN, EXPECTED_RIGHT_PAREN);
       }
 
-      // TODO: handle arguments; requires ExprList
-
     } else if(MATCH_TOKEN(parser, DOT)) {
-      EXPECT_TOKEN(parser, IDENTIFIER_LIT, EXPECTED_IDENTIFIER);
-      primary = alloc_field(primary, parser->previous.as.string);
+      EXPECT_NODE_TOKEN(parser, IDENTIFIER_LIT, EXPECTED_IDENTIFIER);
+      primary = alloc_field(parser, primary,
+          token_string(parser, &parser->previous));
 
     } else if(MATCH_TOKEN(parser, ARROW)) {
-      EXPECT_TOKEN(parser, IDENTIFIER_LIT, EXPECTED_IDENTIFIER);
-      primary = alloc_field(alloc_group(alloc_unary(TOKEN_MUL, primary)),
-          parser->previous.as.string);
+      EXPECT_NODE_TOKEN(parser, IDENTIFIER_LIT, EXPECTED_IDENTIFIER);
+      primary = alloc_field(parser,
+          alloc_group(parser, alloc_unary(parser, TOKEN_MUL, primary)),
+          token_string(parser, &parser->previous));
 
     } else if(MATCH_TOKEN(parser, LEFT_BRACKET)) {
-      struct Expression* index = parse_expression(parser);
-      EXPECT_TOKEN(parser, RIGHT_BRACKET, EXPECTED_RIGHT_BRACKET);
-      primary = alloc_array_index(primary, index);
+      uint32_t index = parse_expression(parser);
+      EXPECT_NODE_TOKEN(parser, RIGHT_BRACKET, EXPECTED_RIGHT_BRACKET);
+      primary = alloc_array_index(parser, primary, index);
 
     } else break;
   }
@@ -235,12 +219,12 @@ static struct Expression* parse_call(struct Parser* parser) {
 }
 
 
-static struct Expression* parse_unary(struct Parser* parser) {
+static uint32_t parse_unary(struct Parser* parser) {
   if(MATCH_TOKEN(parser, BIT_NOT) || MATCH_TOKEN(parser, LOGIC_NOT)
       || MATCH_TOKEN(parser, SUB) || MATCH_TOKEN(parser, BIT_AND)
       || MATCH_TOKEN(parser, MUL) || MATCH_TOKEN(parser, TRY)) {
     enum TokenType op = parser->previous.type;
-    return alloc_unary(op, parse_unary(parser));
+    return alloc_unary(parser, op, parse_unary(parser));
   }
 
   return parse_call(parser);
@@ -248,12 +232,12 @@ static struct Expression* parse_unary(struct Parser* parser) {
 
 
 #define DEFINE_BINARY(name, prev, condition) \
-static struct Expression* parse_##name(struct Parser* parser) { \
-  struct Expression* left = parse_##prev(parser); \
+static uint32_t parse_##name(struct Parser* parser) { \
+  uint32_t left = parse_##prev(parser); \
   while(condition) { \
     enum TokenType op = parser->previous.type; \
-    struct Expression* right = parse_##prev(parser); \
-    left = alloc_binary(op, left, right); \
+    uint32_t right = parse_##prev(parser); \
+    left = alloc_binary(parser, EXPR_BINARY, op, left, right); \
   } \
   return left; \
 }
@@ -287,11 +271,11 @@ DEFINE_BINARY(logic_and, equal, MATCH_TOKEN(parser, LOGIC_AND))
 DEFINE_BINARY(logic_or, logic_and, MATCH_TOKEN(parser, LOGIC_OR))
 
 
-static struct Expression* parse_cast(struct Parser* parser) {
-  struct Expression* expression = parse_logic_or(parser);
+static uint32_t parse_cast(struct Parser* parser) {
+  uint32_t expression = parse_logic_or(parser);
 
   if(MATCH_TOKEN(parser, AS))
-    expression = alloc_cast(expression, NULL); // TODO: cast type
+    expression = alloc_cast(parser, expression, NULL); // TODO: cast type
 
   return expression;
 }
@@ -313,14 +297,13 @@ static struct Expression* parse_cast(struct Parser* parser) {
   || MATCH_TOKEN(parser, BIT_XOR_ASSIGN) \
   || MATCH_TOKEN(parser, BIT_OR_ASSIGN)
 
-static struct Expression* parse_assign(struct Parser* parser) {
-  struct Expression* left = parse_cast(parser);
+static uint32_t parse_assign(struct Parser* parser) {
+  uint32_t left = parse_cast(parser);
 
   while(MATCH_ASSIGN_OPS(parser)) {
     enum TokenType op = parser->previous.type;
-    struct Expression* right = parse_cast(parser);
-    left = alloc_binary(op, left, right);
-    left->type = EXPR_ASSIGN;
+    uint32_t right = parse_cast(parser);
+    left = alloc_binary(parser, EXPR_ASSIGN, op, left, right);
   }
   return left;
 }
@@ -331,179 +314,121 @@ DEFINE_BINARY(fallback, assign,
 #undef DEFINE_BINARY
 
 
-static struct Expression* parse_block_expression(struct Parser*);
-
-struct Block* parse_block(struct Parser* parser) {
-  struct Block* block = malloc(sizeof(*block));
+static void push_statement(struct Parser* parser, enum StatementType type,
+    uint32_t index) {
+  APPEND_VECTOR(&parser->pending, type);
+  APPEND_VECTOR(&parser->pending, index);
+}
 
-  NEW_ARRAYLIST(&block->stmts);
-  block->expr = NULL;
+// the blocks in a block are closed before it is, so its statements wait
+// aside until then, and only then go into extra after its count. like every
+// node it's made after what's in it
+uint32_t parse_block(struct Parser* parser) {
+  uint32_t offset = last_offset(parser);
+  size_t start = parser->pending.size;
+  uint32_t last = 0;
 
   while(!MATCH_TOKEN(parser, RIGHT_CURLY) && !MATCH_TOKEN(parser, EOF)) {
     if(MATCH_TOKEN(parser, LET)) {
-      struct Statement stmt;
-      stmt.type = STMT_VAR;
-      stmt.as.var = parse_variable(parser);
-      APPEND_ARRAYLIST(&block->stmts, stmt);
+      struct Variable* var = parse_variable(parser);
+      push_statement(parser, STMT_VAR, push_var(parser->nodes, var));
 
     } else if(MATCH_TOKEN(parser, LEFT_CURLY)) {
-      struct Block* blk = parse_block(parser);
-      if(MATCH_TOKEN(parser, SEMICOLON)) {
-        struct Expression* expr = malloc(sizeof(*expr));
-        expr->type = EXPR_BLOCK;
-        expr->as.block = *blk;
-        free(blk);
-
-        struct Statement stmt;
-        stmt.type = STMT_EXPR;
-        stmt.as.expr = expr;
-        APPEND_ARRAYLIST(&block->stmts, stmt);
-      } else {
-        struct Statement stmt;
-        stmt.type = STMT_BLOCK;
-        stmt.as.block = blk;
-        APPEND_ARRAYLIST(&block->stmts, stmt);
-      }
+      uint32_t blk = parse_block(parser);
+      if(MATCH_TOKEN(parser, SEMICOLON)) push_statement(parser, STMT_EXPR, blk);
+      else push_statement(parser, STMT_BLOCK, blk);
 
     } else {
-      struct Expression* expr = parse_expression(parser);
+      uint32_t expr = parse_expression(parser);
       if(MATCH_TOKEN(parser, SEMICOLON)) {
         parser->is_panic = false;
-
-        struct Statement stmt;
-        stmt.type = STMT_EXPR;
-        stmt.as.expr = expr;
-        APPEND_ARRAYLIST(&block->stmts, stmt);
+        push_statement(parser, STMT_EXPR, expr);
 
       } else if(MATCH_TOKEN(parser, RIGHT_CURLY)) {
-        block->expr = expr;
+        last = expr;
         break;
 
-      } else RETURN_ERROR(parser, ERROR_EXPECTED_END_OF_BLOCK);
+      } else RETURN_NODE_ERROR(parser, ERROR_EXPECTED_END_OF_BLOCK);
     }
   }
 
-  return block;
-}
-
+  struct Nodes* nodes = parser->nodes;
+  uint32_t count = (parser->pending.size - start) / 2;
 
-static struct Expression* parse_block_expression(struct Parser* parser) {
-  struct Expression* expr = malloc(sizeof(*expr));
-  expr->type = EXPR_BLOCK;
+  uint32_t statements = push_extra(nodes, &count, 1);
+  push_extra(nodes, parser->pending.members + start, 2 * count);
+  parser->pending.size = start;
 
-  struct Block* block = parse_block(parser);
-  expr->as.block = *block;
-  free(block);
-
-  return expr;
+  return push_node(nodes, EXPR_BLOCK, 0, offset, statements, last);
 }
 
 
-static struct Expression* parse_ifwhile(struct Parser* parser) {
-  struct Expression* expr = malloc(sizeof(*expr));
+// made once its clauses are, so a clause that fails to parse doesn't leave
+// a node with half of its extra
+static uint32_t parse_ifwhile(struct Parser* parser) {
+  uint32_t offset = last_offset(parser);
+  enum ExprType type;
 
   switch(parser->previous.type) {
-    case TOKEN_IF: expr->type =    EXPR_IF;    break;
-    case TOKEN_WHILE: expr->type = EXPR_WHILE; break;
-    default: RETURN_ERROR(parser, ERROR_UNREACHABLE); return NULL;
+    case TOKEN_IF: type =    EXPR_IF;    break;
+    case TOKEN_WHILE: type = EXPR_WHILE; break;
+    default: return RETURN_NODE_ERROR(parser, ERROR_UNREACHABLE);
   }
 
   struct IfWhile ifwhile;
 
-  EXPECT_TOKEN(parser, LEFT_PAREN, EXPECTED_LEFT_PAREN);
+  EXPECT_NODE_TOKEN(parser, LEFT_PAREN, EXPECTED_LEFT_PAREN);
   ifwhile.condition = parse_expression(parser);
-  EXPECT_TOKEN(parser, RIGHT_PAREN, EXPECTED_RIGHT_PAREN);
+  EXPECT_NODE_TOKEN(parser, RIGHT_PAREN, EXPECTED_RIGHT_PAREN);
 
   ifwhile.body = parse_expression(parser);
 
   if(MATCH_TOKEN(parser, ELSE))
     ifwhile.else_clause = parse_expression(parser);
+  else ifwhile.else_clause = 0;
 
-  expr->as.ifwhile = ifwhile;
-  return expr;
+  uint32_t clauses[] = { ifwhile.body, ifwhile.else_clause };
+  return push_node(parser->nodes, type, 0, offset, ifwhile.condition,
+      push_extra(parser->nodes, clauses, 2));
 }
 
 
-// this one is fun :) its just a vardecl + while loop in a block
-static struct Expression* parse_for(struct Parser* parser) {
-  EXPECT_TOKEN(parser, LEFT_PAREN, EXPECTED_LEFT_PAREN);
+// the clauses are kept apart so the backends can see the loop's shape
+static uint32_t parse_for(struct Parser* parser) {
+  uint32_t offset = last_offset(parser);
 
-  struct Variable* init;
-  if(MATCH_TOKEN(parser, SEMICOLON))
-    init = NULL;
-  else if(MATCH_TOKEN(parser, LET))
-    init = parse_variable(parser);
+  uint32_t init[2] = { STMT_EXPR, 0 };
+  uint32_t condition = 0, step = 0, body;
 
-  struct Expression* cond;
-  if(MATCH_TOKEN(parser, SEMICOLON))
-    cond = NULL;
-  else {
-    cond = parse_expression(parser);
-    EXPECT_TOKEN(parser, SEMICOLON, EXPECTED_END_OF_STATEMENT);
-  }
+  EXPECT_NODE_TOKEN(parser, LEFT_PAREN, EXPECTED_LEFT_PAREN);
 
-  struct Expression* inc;
-  if(MATCH_TOKEN(parser, RIGHT_PAREN))
-    inc = NULL;
-  else {
-    inc = parse_expression(parser);
-    EXPECT_TOKEN(parser, RIGHT_PAREN, EXPECTED_RIGHT_PAREN);
+  if(MATCH_TOKEN(parser, LET)) {
+    init[0] = STMT_VAR;
+    init[1] = push_var(parser->nodes, parse_variable(parser));
+  } else if(!MATCH_TOKEN(parser, SEMICOLON)) {
+    init[1] = parse_expression(parser);
+    EXPECT_NODE_TOKEN(parser, SEMICOLON, EXPECTED_END_OF_STATEMENT);
   }
 
-  struct Expression* body = parse_expression(parser);
-
-  if(inc) {
-    struct Statement stmt;
-    stmt.type = STMT_EXPR;
-    stmt.as.expr = body;
-
-    struct Statement inc_stmt;
-    inc_stmt.type = STMT_EXPR;
-    inc_stmt.as.expr = inc;
-
-    struct Expression* new_body = malloc(sizeof(*new_body));
-    new_body->type = EXPR_BLOCK;
-    NEW_ARRAYLIST(&new_body->as.block.stmts);
-
-    APPEND_ARRAYLIST(&new_body->as.block.stmts, stmt);
-    APPEND_ARRAYLIST(&new_body->as.block.stmts, inc_stmt);
-
-    body = new_body;
+  if(!MATCH_TOKEN(parser, SEMICOLON)) {
+    condition = parse_expression(parser);
+    EXPECT_NODE_TOKEN(parser, SEMICOLON, EXPECTED_END_OF_STATEMENT);
   }
 
-  if(!cond) cond = ALLOC_LITERAL(BOOL, bool, true);
-  struct Expression* _while = malloc(sizeof(*_while));
-  _while->type = EXPR_WHILE;
-  _while->as.ifwhile = (struct IfWhile){
-    .condition = cond,
-    .body = body,
-    .else_clause = NULL,
-  };
-  body = _while;
-
-  if(init) {
-    struct Statement init_stmt;
-    init_stmt.type = STMT_VAR;
-    init_stmt.as.var = init;
-
-    struct Statement body_stmt;
-    body_stmt.type = STMT_EXPR;
-    body_stmt.as.expr = body;
-
-    struct Expression* new_body = malloc(sizeof(*new_body));
-    new_body->type = EXPR_BLOCK;
-    NEW_ARRAYLIST(&new_body->as.block.stmts);
-    APPEND_ARRAYLIST(&new_body->as.block.stmts, init_stmt);
-    APPEND_ARRAYLIST(&new_body->as.block.stmts, body_stmt);
-
-    body = new_body;
+  if(!MATCH_TOKEN(parser, RIGHT_PAREN)) {
+    step = parse_expression(parser);
+    EXPECT_NODE_TOKEN(parser, RIGHT_PAREN, EXPECTED_RIGHT_PAREN);
   }
 
-  return body;
+  body = parse_expression(parser);
+
+  uint32_t clauses[] = { init[0], init[1], condition, step };
+  return push_node(parser->nodes, EXPR_FOR, 0, offset,
+      push_extra(parser->nodes, clauses, 4), body);
 }
 
 
-struct Expression* parse_expression(struct Parser* parser) {
+uint32_t parse_expression(struct Parser* parser) {
   if(MATCH_TOKEN(parser, IF) || MATCH_TOKEN(parser, WHILE))
     return parse_ifwhile(parser);
 
@@ -511,12 +436,12 @@ struct Expression* parse_expression(struct Parser* parser) {
     return parse_for(parser);
 
   if(MATCH_TOKEN(parser, LEFT_CURLY))
-    return parse_block_expression(parser);
+    return parse_block(parser);
 
   if(MATCH_TOKEN(parser, CONTINUE) || MATCH_TOKEN(parser, BREAK)
       || MATCH_TOKEN(parser, RETURN)) {
     enum TokenType op = parser->previous.type;
-    return alloc_unary(op, parse_expression(parser));
+    return alloc_unary(parser, op, parse_expression(parser));
   }
 
   return parse_fallback(parser);
@@ -527,8 +452,6 @@ struct Expression* parse_expression(struct Parser* parser) {
 // ### PRINTING FUNCTIONS ## //
 
 static void print_literal(const struct Value* ast) {
-  if(ast == NULL) { printf("(NULL)"); return; }
-
   switch(ast->type) {
   case VAL_BOOL:       printf("%s", ast->as.boolean? "true" : "false"); break;
   case VAL_INT:        printf("%zu", ast->as.integer);                  break;
@@ -540,140 +463,152 @@ static void print_literal(const struct Value* ast) {
 }
 
 
-static void print_unary(const struct Unary* ast) {
-  if(ast == NULL) { printf("(NULL)"); return; }
-
+static void print_unary(const struct Nodes* nodes, const struct Unary* ast) {
   printf("%s ", token_strings[ast->op]);
-  print_expression(ast->operand);
+  print_expression(nodes, ast->operand);
 }
 
 
-static void print_binary(const struct Binary* ast) {
-  if(ast == NULL) { printf("(NULL)"); return; }
-
+static void print_binary(const struct Nodes* nodes,
+    const struct Binary* ast) {
   printf("%s ", token_strings[ast->op]);
-  print_expression(ast->left);
+  print_expression(nodes, ast->left);
   printf(" ");
-  print_expression(ast->right);
+  print_expression(nodes, ast->right);
 }
 
 
-static void print_group(const struct Grouping* ast) {
-  if(ast == NULL) { printf("(NULL)"); return; }
+static void print_group(const struct Nodes* nodes, uint32_t expr) {
   printf("GROUP ");
 
-  print_expression(ast->expr);
+  print_expression(nodes, expr);
 }
 
 
-static void print_ifwhile(const struct Expression* ast) {
-  if(ast->type == EXPR_IF) printf("IF ");
-  else if(ast->type == EXPR_WHILE) printf("WHILE ");
+static void print_ifwhile(const struct Nodes* nodes, uint32_t ast) {
+  if(nodes->tags[ast] == EXPR_IF) printf("IF ");
+  else if(nodes->tags[ast] == EXPR_WHILE) printf("WHILE ");
+
+  struct IfWhile ifwhile = ifwhile_of(nodes, ast);
 
   printf("(COND ");
-  print_expression(ast->as.ifwhile.condition);
+  print_expression(nodes, ifwhile.condition);
   printf(") ");
 
   printf("(BODY ");
-  print_expression(ast->as.ifwhile.body);
+  print_expression(nodes, ifwhile.body);
   printf(") ");
 
   printf("(ELSE ");
-  print_expression(ast->as.ifwhile.else_clause);
+  print_expression(nodes, ifwhile.else_clause);
   printf(")");
 }
 
 
-static void print_statements(const struct StatementList*);
-
-static void print_statement(const struct Statement* ast) {
-  if(ast == NULL) { printf("(NULL)"); return; }
+static void print_statement(const struct Nodes* nodes,
+    const struct Statement* ast) {
+  if(!has_statement(ast)) { printf("(NULL)"); return; }
 
   switch(ast->type) {
-    case STMT_EXPR:  print_expression(ast->as.expr); break;
-    case STMT_BLOCK: print_block(ast->as.block);     break;
-    case STMT_VAR:   print_variable(ast->as.var);    break;
+    case STMT_EXPR:  print_expression(nodes, ast->as.expr); break;
+    case STMT_BLOCK: print_block(nodes, ast->as.block);     break;
+    case STMT_VAR:   print_variable(nodes, ast->as.var);    break;
   }
 }
 
 
-static void print_statements(const struct StatementList* ast) {
-  if(ast == NULL) { printf("(NULL)"); return; }
+static void print_for(const struct Nodes* nodes, const struct ForLoop* ast) {
+  printf("FOR ");
+
+  printf("(INIT ");
+  print_statement(nodes, &ast->init);
+  printf(") ");
+
+  printf("(COND ");
+  print_expression(nodes, ast->condition);
+  printf(") ");
+
+  printf("(STEP ");
+  print_expression(nodes, ast->step);
+  printf(") ");
+
+  printf("(BODY ");
+  print_expression(nodes, ast->body);
+  printf(")");
+}
+
 
+static void print_statements(const struct Nodes* nodes,
+    const struct Block* ast) {
   for(size_t i = 0; i < ast->size; i++) {
-    print_statement(&ast->members[i]);
+    struct Statement stmt = block_statement(nodes, ast, i);
+    print_statement(nodes, &stmt);
     printf(" ");
   }
   printf("\b");
 }
 
-void print_block(const struct Block* ast) {
-  if(ast == NULL) { printf("(NULL)"); return; }
+void print_block(const struct Nodes* nodes, uint32_t ast) {
+  if(!ast) { printf("(NULL)"); return; }
+
+  struct Block block = block_of(nodes, ast);
 
   printf("BLOCK (");
-  print_statements(&ast->stmts);
+  print_statements(nodes, &block);
   printf(")");
 
-  if(ast->expr) {
+  if(block.expr) {
     printf(" ");
-    print_expression(ast->expr);
+    print_expression(nodes, block.expr);
   }
 }
 
 
-static void print_expressions(const struct ExprList* ast) {
-  if(ast == NULL) { printf("(NULL)"); return; }
-
-  print_expression(ast->current);
-  printf(" ");
-  print_expression(ast->next);
+static void print_expressions(const struct Nodes* nodes,
+    const struct ExprList* ast) {
+  for(size_t i = 0; i < ast->size; i++) {
+    if(i) printf(" ");
+    print_expression(nodes, list_member(nodes, ast, i));
+  }
 }
 
 
-static void print_call(const struct Call* ast) {
-  if(ast == NULL) { printf("(NULL)"); return; }
-
-  print_expression(ast->callee);
+static void print_call(const struct Nodes* nodes, const struct Call* ast) {
+  print_expression(nodes, ast->callee);
 
   printf(" (");
-  if(ast->arguments)
-    print_expression(ast->arguments);
+  print_expressions(nodes, &ast->arguments);
   printf(")");
 }
 
 
-static void print_field(const struct Field* ast) {
-  if(ast == NULL) { printf("(NULL)"); return; }
-
+static void print_field(const struct Nodes* nodes, const struct Field* ast) {
   printf(". ");
-  print_expression(ast->parent);
+  print_expression(nodes, ast->parent);
   printf(" %s", ast->field);
 }
 
 
-static void print_array_index(const struct ArrayIndex* ast) {
-  if(ast == NULL) { printf("(NULL)"); return; }
-
+static void print_array_index(const struct Nodes* nodes,
+    const struct ArrayIndex* ast) {
   printf("@ ");
-  print_expression(ast->array);
+  print_expression(nodes, ast->array);
   printf(" ");
-  print_expression(ast->index);
+  print_expression(nodes, ast->index);
 }
 
 
-static void print_array_init(const struct ArrayInit* ast) {
-  if(ast == NULL) { printf("(NULL)"); return; }
+static void print_array_init(const struct Nodes* nodes, uint32_t elements) {
+  struct ExprList list = list_at(nodes, elements);
 
   printf("[] ");
-  print_expression(ast->elements);
+  print_expressions(nodes, &list);
 }
 
 
-static void print_cast(const struct Cast* ast) {
-  if(ast == NULL) { printf("(NULL)"); return; }
-
+static void print_cast(const struct Nodes* nodes, const struct Cast* ast) {
   printf("as ");
-  print_expression(ast->expr);
+  print_expression(nodes, ast->expr);
 
   printf(" (%%type");
   // TODO: type
@@ -681,28 +616,66 @@ static void print_cast(const struct Cast* ast) {
 }
 
 
-void print_expression(const struct Expression* ast) {
-  if(ast == NULL) { printf("(NULL)"); return; }
+void print_expression(const struct Nodes* nodes, uint32_t ast) {
+  if(!ast) { printf("(NULL)"); return; }
 
-  if(ast->type != EXPR_LITERAL) printf("(");
+  enum ExprType type = nodes->tags[ast];
+  uint32_t lhs = nodes->data[ast].lhs;
 
-  switch(ast->type) {
-    case EXPR_LITERAL:     print_literal(&ast->as.literal);         break;
-    case EXPR_UNARY:       print_unary(&ast->as.unary);             break;
-    case EXPR_BINARY:      print_binary(&ast->as.binary);           break;
-    case EXPR_GROUP:       print_group(&ast->as.group);             break;
+  bool is_leaf = type == EXPR_LITERAL || type == EXPR_VARIABLE;
+  if(!is_leaf) printf("(");
+
+  switch(type) {
+    case EXPR_LITERAL: {
+      struct Value literal = literal_of(nodes, ast);
+      print_literal(&literal);
+      break;
+    }
+    case EXPR_VARIABLE:
+      printf("%s", variable_of(nodes, ast).name);
+      break;
+    case EXPR_UNARY: {
+      struct Unary unary = unary_of(nodes, ast);
+      print_unary(nodes, &unary);
+      break;
+    }
+    case EXPR_BINARY:
+    case EXPR_ASSIGN: {
+      struct Binary binary = binary_of(nodes, ast);
+      print_binary(nodes, &binary);
+      break;
+    }
+    case EXPR_GROUP:       print_group(nodes, lhs);      break;
     case EXPR_IF:          __attribute__((fallthrough));
-    case EXPR_WHILE:       print_ifwhile(ast);                      break;
-    case EXPR_BLOCK:       print_block(&ast->as.block);             break;
-    case EXPR_CALL:        print_call(&ast->as.call);               break;
-    case EXPR_FIELD:       print_field(&ast->as.field);             break;
-    case EXPR_ARRAY_INDEX: print_array_index(&ast->as.array_index); break;
-    case EXPR_ARRAY_INIT:  print_array_init(&ast->as.array_init);   break;
-    case EXPR_LIST:        print_expressions(&ast->as.list);        break;
-    case EXPR_CAST:        print_cast(&ast->as.cast);               break;
-    case EXPR_ASSIGN:      print_binary(&ast->as.binary);           break;
-    break;
+    case EXPR_WHILE:       print_ifwhile(nodes, ast);    break;
+    case EXPR_FOR: {
+      struct ForLoop loop = forloop_of(nodes, ast);
+      print_for(nodes, &loop);
+      break;
+    }
+    case EXPR_BLOCK:       print_block(nodes, ast);      break;
+    case EXPR_CALL: {
+      struct Call call = call_of(nodes, ast);
+      print_call(nodes, &call);
+      break;
+    }
+    case EXPR_FIELD: {
+      struct Field field = field_of(nodes, ast);
+      print_field(nodes, &field);
+      break;
+    }
+    case EXPR_ARRAY_INDEX: {
+      struct ArrayIndex index = array_index_of(nodes, ast);
+      print_array_index(nodes, &index);
+      break;
+    }
+    case EXPR_ARRAY_INIT:  print_array_init(nodes, lhs); break;
+    case EXPR_CAST: {
+      struct Cast cast = cast_of(nodes, ast);
+      print_cast(nodes, &cast);
+      break;
+    }
   }
 
-  if(ast->type != EXPR_LITERAL) printf(")");
+  if(!is_leaf) printf(")");
 }
@@ -1,103 +1,211 @@
 #pragma once
 
-#include "../util/arraylist.h" // my greatest shame :(
 #include "../value.h"
+#include "nodes.h"
 #include "parser.h"
 
+// what a node holds, taken out of the columns as nodes.h lays them out.
+// children are nodes, and 0 where they're missing
+
 struct Statement {
-  enum { STMT_EXPR, STMT_BLOCK, STMT_VAR } type;
+  enum StatementType type;
   union {
-    struct Block* block;
-    struct Expression* expr;
+    uint32_t block; // an EXPR_BLOCK
+    uint32_t expr;
     struct Variable* var;
   } as;
 };
 
-DEFINE_ARRAYLIST(StatementList, struct Statement);
-
+// the statements are in extra, from stmts on
 struct Block {
-  struct StatementList stmts;
-  struct Expression* expr;
+  uint32_t stmts;
+  uint32_t size;
+  uint32_t expr;
 };
 
 struct IfWhile {
-  struct Expression* condition;
-  struct Expression* body;
-  struct Expression* else_clause;
+  uint32_t condition;
+  uint32_t body;
+  uint32_t else_clause;
+};
+
+// init is a statement so it can declare the loop variable, which is scoped
+// to the loop; any of the three clauses can be missing, init by being the
+// expression 0
+struct ForLoop {
+  struct Statement init;
+  uint32_t condition;
+  uint32_t step;
+  uint32_t body;
 };
 
 struct Unary {
-  struct Expression* operand;
+  uint32_t operand;
   enum TokenType op;
 };
 
 struct Binary {
-  struct Expression* left;
-  struct Expression* right;
+  uint32_t left;
+  uint32_t right;
   enum TokenType op;
 };
 
-struct Grouping {
-  struct Expression* expr;
+// the arguments of a call or the elements of an array, which are in extra
+// from first on
+struct ExprList {
+  uint32_t first;
+  uint32_t size;
 };
 
 struct Call {
-  struct Expression* callee;
-  struct Expression* arguments;
+  uint32_t callee;
+  struct ExprList arguments;
 };
 
 struct Field {
-  struct Expression* parent;
+  uint32_t parent;
   const char* field;
 };
 
 struct ArrayIndex {
-  struct Expression* array;
-  struct Expression* index;
-};
-
-struct ArrayInit {
-  struct Expression* elements;
-};
-
-
-struct ExprList {
-  struct Expression* current;
-  struct Expression* next;
+  uint32_t array;
+  uint32_t index;
 };
 
 struct Cast {
-  struct Expression* expr;
+  uint32_t expr;
   struct Type* type;
 };
 
-struct Expression {
-  enum {
-    EXPR_LITERAL, EXPR_UNARY, EXPR_BINARY, EXPR_GROUP, EXPR_CALL, EXPR_FIELD,
-    EXPR_ARRAY_INDEX, EXPR_ARRAY_INIT, EXPR_CAST,
-    EXPR_ASSIGN, EXPR_LIST, EXPR_BLOCK, EXPR_IF, EXPR_WHILE
-  } type;
-  union {
-    // Statement Expressions
-    struct Block block;
-    struct IfWhile ifwhile;
-
-    // Normal Expressions
-    struct Cast cast;
-    struct ArrayIndex array_index;
-    struct ArrayInit array_init;
-    struct ExprList list;
-    struct Field field;
-    struct Call call;
-    struct Grouping group;
-    struct Binary binary;
-    struct Unary unary;
-    struct Value literal;
-  } as;
+// an identifier the resolver has bound to a local or global; depth 0 is the
+// current function's frame and depth 1 the toplevel
+struct VarRef {
+  const char* name;
+  size_t depth;
+  size_t slot;
 };
 
-struct Expression* parse_expression(struct Parser*);
-struct Block* parse_block(struct Parser*);
 
-void print_expression(const struct Expression*);
-void print_block(const struct Block*);
+static inline struct Value literal_of(const struct Nodes* nodes,
+    uint32_t node) {
+  struct Value value = { .type = nodes->ops[node] };
+  uint64_t bits = nodes->data[node].lhs
+    | (uint64_t)nodes->data[node].rhs << 32;
+  memcpy(&value.as, &bits, sizeof(value.as));
+  return value;
+}
+
+// turns any node into a literal
+static inline void set_literal(struct Nodes* nodes, uint32_t node,
+    struct Value value) {
+  uint64_t bits = 0;
+  memcpy(&bits, &value.as, sizeof(value.as));
+  nodes->tags[node] = EXPR_LITERAL;
+  nodes->ops[node] = value.type;
+  nodes->data[node] = (struct NodeData){ (uint32_t)bits, bits >> 32 };
+}
+
+static inline bool is_identifier(const struct Nodes* nodes, uint32_t node) {
+  return nodes->tags[node] == EXPR_LITERAL
+    && nodes->ops[node] == VAL_IDENTIFIER;
+}
+
+static inline struct VarRef variable_of(const struct Nodes* nodes,
+    uint32_t node) {
+  return (struct VarRef){
+    nodes->names.members[nodes->data[node].rhs], nodes->ops[node],
+    nodes->data[node].lhs,
+  };
+}
+
+static inline struct Unary unary_of(const struct Nodes* nodes, uint32_t node) {
+  return (struct Unary){ nodes->data[node].lhs, nodes->ops[node] };
+}
+
+static inline struct Binary binary_of(const struct Nodes* nodes,
+    uint32_t node) {
+  return (struct Binary){
+    nodes->data[node].lhs, nodes->data[node].rhs, nodes->ops[node],
+  };
+}
+
+// the count of the expressions at extra, and then them
+static inline struct ExprList list_at(const struct Nodes* nodes,
+    uint32_t at) {
+  return (struct ExprList){ at + 1, nodes->extra[at] };
+}
+
+static inline uint32_t list_member(const struct Nodes* nodes,
+    const struct ExprList* list, size_t i) {
+  return nodes->extra[list->first + i];
+}
+
+static inline struct Call call_of(const struct Nodes* nodes, uint32_t node) {
+  return (struct Call){
+    nodes->data[node].lhs, list_at(nodes, nodes->data[node].rhs),
+  };
+}
+
+static inline struct Field field_of(const struct Nodes* nodes, uint32_t node) {
+  return (struct Field){
+    nodes->data[node].lhs, nodes->names.members[nodes->data[node].rhs],
+  };
+}
+
+static inline struct ArrayIndex array_index_of(const struct Nodes* nodes,
+    uint32_t node) {
+  return (struct ArrayIndex){ nodes->data[node].lhs, nodes->data[node].rhs };
+}
+
+static inline struct Cast cast_of(const struct Nodes* nodes, uint32_t node) {
+  return (struct Cast){
+    nodes->data[node].lhs, nodes->types.members[nodes->data[node].rhs],
+  };
+}
+
+static inline struct Block block_of(const struct Nodes* nodes, uint32_t node) {
+  uint32_t at = nodes->data[node].lhs;
+  return (struct Block){ at + 1, nodes->extra[at], nodes->data[node].rhs };
+}
+
+static inline struct IfWhile ifwhile_of(const struct Nodes* nodes,
+    uint32_t node) {
+  uint32_t at = nodes->data[node].rhs;
+  return (struct IfWhile){
+    nodes->data[node].lhs, nodes->extra[at], nodes->extra[at + 1],
+  };
+}
+
+// the statement of the two words at extra
+static inline struct Statement statement_at(const struct Nodes* nodes,
+    uint32_t at) {
+  struct Statement stmt = { .type = nodes->extra[at] };
+  if(stmt.type == STMT_VAR)
+    stmt.as.var = nodes->vars.members[nodes->extra[at + 1]];
+  else stmt.as.expr = nodes->extra[at + 1];
+  return stmt;
+}
+
+static inline struct Statement block_statement(const struct Nodes* nodes,
+    const struct Block* block, size_t i) {
+  return statement_at(nodes, block->stmts + 2 * i);
+}
+
+static inline struct ForLoop forloop_of(const struct Nodes* nodes,
+    uint32_t node) {
+  uint32_t at = nodes->data[node].lhs;
+  return (struct ForLoop){
+    statement_at(nodes, at), nodes->extra[at + 2], nodes->extra[at + 3],
+    nodes->data[node].rhs,
+  };
+}
+
+static inline bool has_statement(const struct Statement* stmt) {
+  return stmt->type != STMT_EXPR || stmt->as.expr;
+}
+
+uint32_t parse_expression(struct Parser*);
+uint32_t parse_block(struct Parser*);
+
+void print_expression(const struct Nodes*, uint32_t);
+void print_block(const struct Nodes*, uint32_t);
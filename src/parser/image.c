@@ -0,0 +1,905 @@
+// image.c
+
+#include "../util/hash.h"
+#include "../util/intern.h"
+#include "../util/readfile.h"
+#include "../util/stats.h"
+#include "declaration.h"
+#include "expression.h"
+#include "image.h"
+#include "type.h"
+#include <fcntl.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+
+// bump whenever any node's layout changes; images are only ever read back on
+// the machine that wrote them, so byte order and sizes are the native ones
+#define IMAGE_VERSION 7
+#define IMAGE_MAGIC "2nic"
+#define EXTENSION ".ast"
+
+// nodes keep the alignment the arena would have given them
+#define ALIGN(x) \
+  (((x) + sizeof(max_align_t) - 1) & ~(sizeof(max_align_t) - 1))
+
+// what a pointer slot holds for a missing node, which stays NULL on loading
+#define NONE ((uint64_t)-1)
+
+// followed by the nodes, the offsets of the pointer slots among them, the
+// offsets of the string slots, the offsets of the expression slots, the
+// strings, each a 32 bit length and the bytes with a '\0' after them, the
+// expressions' columns one after another, and their tables of names, types
+// and variables. pointer slots hold the offset of their node, string slots
+// the index of their string, and expression slots are ids into the columns,
+// which stay as they are.
+//
+// what the columns point at is swapped the same way: a string literal's
+// payload is its string's index, the names are 32 bit indices too, and the
+// types and variables are the offsets of their nodes, NONE if missing
+//
+// the checksum is of everything after the header, and an image that doesn't
+// match it is ignored before any of it is read
+struct ImageHeader {
+  char magic[4];
+  uint32_t version;
+  uint64_t hash;
+  uint64_t checksum;
+  uint64_t nodes;       // bytes
+  uint64_t pointers;
+  uint64_t references;  // string slots
+  uint64_t expressions; // expression slots
+  uint64_t strings;
+  uint64_t table;       // bytes of strings
+  uint64_t decls;
+  uint64_t members;     // offset of the array of declarations
+  uint64_t count;       // of expressions, the missing one included
+  uint64_t extra;       // words
+  uint64_t names;
+  uint64_t types;
+  uint64_t vars;
+};
+
+DEFINE_ARRAYLIST(OffsetList, uint64_t);
+
+struct ImageWriter {
+  char* nodes;
+  size_t size, capacity;
+  struct OffsetList pointers;
+  struct OffsetList references;
+  struct OffsetList expressions;
+  const struct Nodes* store;
+  struct NodeData* data;  // the store's, once its strings are swapped
+  uint32_t* names;        // and its tables
+  uint64_t* types;
+  uint64_t* vars;
+  struct HashMap strings; // index + 1 by string
+  char* table;
+  size_t table_size, table_capacity, nstrings;
+};
+
+
+static const char* image_path(const char* source) {
+  size_t len = strlen(source);
+  char* path = stats_malloc(len + sizeof(EXTENSION));
+
+  memcpy(path, source, len);
+  memcpy(path + len, EXTENSION, sizeof(EXTENSION));
+  return path;
+}
+
+// of the parts after the header, in the order they're written. each is
+// summed on its own into the checksum
+#define PARTS 13
+
+static void part_sizes(const struct ImageHeader* header,
+    size_t sizes[PARTS]) {
+  size_t count = header->count;
+  size_t each[PARTS] = {
+    header->nodes, header->pointers * sizeof(uint64_t),
+    header->references * sizeof(uint64_t),
+    header->expressions * sizeof(uint64_t), header->table,
+    count * sizeof(uint8_t), count * sizeof(uint8_t),
+    count * sizeof(uint32_t), count * sizeof(struct NodeData),
+    header->extra * sizeof(uint32_t), header->names * sizeof(uint32_t),
+    header->types * sizeof(uint64_t), header->vars * sizeof(uint64_t),
+  };
+  memcpy(sizes, each, sizeof(each));
+}
+
+
+
+// ### WRITING ### //
+
+static void reserve(char** bytes, size_t* capacity, size_t needed) {
+  if(needed <= *capacity) return;
+
+  while(*capacity < needed) *capacity = *capacity ? *capacity << 1 : 4096;
+  *bytes = stats_realloc(*bytes, *capacity);
+}
+
+// the node is copied as it is, and every pointer in it overwritten after
+static uint64_t put(struct ImageWriter* w, const void* node, size_t size) {
+  uint64_t at = w->size;
+
+  reserve(&w->nodes, &w->capacity, at + ALIGN(size));
+  memcpy(w->nodes + at, node, size);
+  memset(w->nodes + at + size, 0, ALIGN(size) - size);
+  w->size += ALIGN(size);
+
+  return at;
+}
+
+static void set_slot(struct ImageWriter* w, uint64_t slot, uintptr_t value) {
+  memcpy(w->nodes + slot, &value, sizeof(value));
+}
+
+static void link_node(struct ImageWriter* w, uint64_t slot, uint64_t node) {
+  if(node == NONE) {
+    set_slot(w, slot, 0);
+    return;
+  }
+
+  set_slot(w, slot, node);
+  APPEND_ARRAYLIST(&w->pointers, slot);
+}
+
+// from 0, in the order they were first written
+static uintptr_t string_index(struct ImageWriter* w, const char* string) {
+  uintptr_t index = hm_get(&w->strings, string);
+  if(!index) {
+    uint32_t len = strlen(string);
+    size_t at = w->table_size;
+
+    reserve(&w->table, &w->table_capacity, at + sizeof(len) + len + 1);
+    memcpy(w->table + at, &len, sizeof(len));
+    memcpy(w->table + at + sizeof(len), string, len + 1);
+    w->table_size += sizeof(len) + len + 1;
+
+    index = ++w->nstrings;
+    hm_set(&w->strings, string, index);
+  }
+
+  return index - 1;
+}
+
+static void link_string(struct ImageWriter* w, uint64_t slot,
+    const char* string) {
+  if(!string) {
+    set_slot(w, slot, 0);
+    return;
+  }
+
+  set_slot(w, slot, string_index(w, string));
+  APPEND_ARRAYLIST(&w->references, slot);
+}
+
+static void link_expression(struct ImageWriter* w, uint64_t slot) {
+  APPEND_ARRAYLIST(&w->expressions, slot);
+}
+
+#define SLOT(at, type, field) ((at) + offsetof(type, field))
+
+static uint64_t write_type(struct ImageWriter*, const struct Type*);
+static uint64_t write_variable(struct ImageWriter*, const struct Variable*);
+static uint64_t write_struct(struct ImageWriter*, const struct Struct*);
+static uint64_t write_union(struct ImageWriter*, const struct Union*);
+static uint64_t write_funcsig(struct ImageWriter*, const struct FuncSig*);
+
+// each member's slots are at its place in the list
+#define MEMBER(at, type, i) \
+  ((at) + offsetof(type, members) + (i) * sizeof(*((type*)0)->members))
+
+static uint64_t write_vardecls(struct ImageWriter* w,
+    const struct VarDeclList* ast) {
+  if(!ast) return NONE;
+  uint64_t at = put(w, ast,
+      sizeof(*ast) + ast->size * sizeof(*ast->members));
+
+  for(size_t i = 0; i < ast->size; i++) {
+    const struct VarDecl* decl = &ast->members[i];
+    uint64_t var = MEMBER(at, struct VarDeclList, i);
+
+    link_string(w, SLOT(var, struct VarDecl, lvalue.name), decl->lvalue.name);
+    link_node(w, SLOT(var, struct VarDecl, lvalue.type),
+        write_type(w, decl->lvalue.type));
+    link_expression(w, SLOT(var, struct VarDecl, rvalue));
+  }
+  return at;
+}
+
+static uint64_t write_types(struct ImageWriter* w,
+    const struct TypeList* ast) {
+  if(!ast) return NONE;
+  uint64_t at = put(w, ast,
+      sizeof(*ast) + ast->size * sizeof(*ast->members));
+
+  for(size_t i = 0; i < ast->size; i++)
+    link_node(w, MEMBER(at, struct TypeList, i),
+        write_type(w, ast->members[i]));
+  return at;
+}
+
+static uint64_t write_type(struct ImageWriter* w, const struct Type* ast) {
+  if(!ast) return NONE;
+  uint64_t at = put(w, ast, sizeof(*ast));
+
+  switch(ast->type) {
+    case TYPE_PRIMITIVE: break;
+    case TYPE_WRAPPER:
+      link_node(w, SLOT(at, struct Type, as.wrapper.type),
+          write_type(w, ast->as.wrapper.type));
+      break;
+    case TYPE_ARRAY:
+      link_expression(w, SLOT(at, struct Type, as.array.size));
+      link_node(w, SLOT(at, struct Type, as.array.type),
+          write_type(w, ast->as.array.type));
+      break;
+    case TYPE_COMPOUND: {
+      uint64_t slot = SLOT(at, struct Type, as.compound.as);
+      switch(ast->as.compound.type) {
+        case COMP_STRUCT:
+          link_node(w, slot, write_struct(w, ast->as.compound.as._struct));
+          break;
+        case COMP_UNION:
+          link_node(w, slot, write_union(w, ast->as.compound.as._union));
+          break;
+        case COMP_FUNC:
+          link_node(w, slot, write_funcsig(w, ast->as.compound.as.sig));
+          break;
+      }
+      break;
+    }
+  }
+
+  return at;
+}
+
+static uint64_t write_variable(struct ImageWriter* w,
+    const struct Variable* ast) {
+  uint64_t at = put(w, ast, sizeof(*ast));
+  link_node(w, SLOT(at, struct Variable, vars), write_vardecls(w, ast->vars));
+  return at;
+}
+
+static uint64_t write_struct(struct ImageWriter* w, const struct Struct* ast) {
+  uint64_t at = put(w, ast, sizeof(*ast));
+  link_string(w, SLOT(at, struct Struct, name), ast->name);
+  link_node(w, SLOT(at, struct Struct, fields), write_vardecls(w, ast->fields));
+  return at;
+}
+
+static uint64_t write_union(struct ImageWriter* w, const struct Union* ast) {
+  uint64_t at = put(w, ast, sizeof(*ast));
+  link_string(w, SLOT(at, struct Union, name), ast->name);
+  link_node(w, SLOT(at, struct Union, fields), write_types(w, ast->fields));
+  return at;
+}
+
+static uint64_t write_funcsig(struct ImageWriter* w,
+    const struct FuncSig* ast) {
+  uint64_t at = put(w, ast, sizeof(*ast));
+  link_string(w, SLOT(at, struct FuncSig, name), ast->name);
+  link_node(w, SLOT(at, struct FuncSig, args), write_vardecls(w, ast->args));
+  link_node(w, SLOT(at, struct FuncSig, returns), write_type(w, ast->returns));
+  return at;
+}
+
+static uint64_t write_function(struct ImageWriter* w,
+    const struct Function* ast) {
+  uint64_t at = put(w, ast, sizeof(*ast));
+  link_node(w, SLOT(at, struct Function, sig), write_funcsig(w, ast->sig));
+  link_string(w, SLOT(at, struct Function, file), NULL); // may have moved
+  link_expression(w, SLOT(at, struct Function, body));
+  return at;
+}
+
+static uint64_t write_declaration(struct ImageWriter* w,
+    const struct Declaration* ast) {
+  uint64_t at = put(w, ast, sizeof(*ast));
+  uint64_t slot = SLOT(at, struct Declaration, as);
+
+  switch(ast->type) {
+    case DECL_VAR:    link_node(w, slot, write_variable(w, ast->as.var));       break;
+    case DECL_STRUCT: link_node(w, slot, write_struct(w, ast->as._struct));     break;
+    case DECL_UNION:  link_node(w, slot, write_union(w, ast->as._union));       break;
+    case DECL_FUNC:   link_node(w, slot, write_function(w, ast->as.function));  break;
+    case DECL_INC:    link_string(w, slot, ast->as.include);               break;
+  }
+  link_string(w, SLOT(at, struct Declaration, file), NULL); // may have moved
+
+  return at;
+}
+
+#undef SLOT
+#undef MEMBER
+
+
+// every type and variable in the tables is only ever reached from the one
+// node
+static void write_columns(struct ImageWriter* w) {
+  const struct Nodes* store = w->store;
+
+  w->data = stats_malloc(store->size * sizeof(*w->data));
+  memcpy(w->data, store->data, store->size * sizeof(*w->data));
+
+  for(size_t i = 1; i < store->size; i++)
+    if(store->tags[i] == EXPR_LITERAL
+        && (store->ops[i] == VAL_STRING || store->ops[i] == VAL_IDENTIFIER))
+      w->data[i] = (struct NodeData){
+        string_index(w, literal_of(store, i).as.string), 0,
+      };
+
+#define TABLE(name, write) \
+  w->name = stats_malloc((store->name.size ? store->name.size : 1) \
+      * sizeof(*w->name)); \
+  for(size_t i = 0; i < store->name.size; i++) \
+    w->name[i] = write(w, store->name.members[i]);
+
+  TABLE(names, string_index);
+  TABLE(types, write_type);
+  TABLE(vars, write_variable);
+
+#undef TABLE
+}
+
+static bool write_all(int fd, const void* bytes, size_t size) {
+  while(size) {
+    ssize_t wrote = write(fd, bytes, size);
+    if(wrote <= 0) return false;
+    bytes = (const char*)bytes + wrote;
+    size -= wrote;
+  }
+  return true;
+}
+
+void save_image(const char* source, uint64_t hash, const struct AST* ast) {
+  struct ImageWriter w = {
+    .nodes = NULL, .size = 0, .capacity = 0,
+    .table = NULL, .table_size = 0, .table_capacity = 0, .nstrings = 0,
+  };
+  NEW_ARRAYLIST(&w.pointers);
+  NEW_ARRAYLIST(&w.references);
+  NEW_ARRAYLIST(&w.expressions);
+  hm_init(&w.strings);
+
+  uint64_t members = put(&w, ast->members,
+      (ast->size ? ast->size : 1) * sizeof(*ast->members));
+  for(size_t i = 0; i < ast->size; i++)
+    link_node(&w, members + i * sizeof(*ast->members),
+        write_declaration(&w, ast->members[i]));
+
+  const struct Nodes* store = w.store = &ast->nodes;
+  write_columns(&w);
+
+  struct ImageHeader header = {
+    .magic = IMAGE_MAGIC, .version = IMAGE_VERSION, .hash = hash,
+    .nodes = w.size, .pointers = w.pointers.size,
+    .references = w.references.size, .expressions = w.expressions.size,
+    .strings = w.nstrings, .table = w.table_size, .decls = ast->size,
+    .members = members, .count = store->size, .extra = store->extra_size,
+    .names = store->names.size, .types = store->types.size,
+    .vars = store->vars.size,
+  };
+
+  const void* parts[PARTS] = {
+    w.nodes, w.pointers.members, w.references.members, w.expressions.members,
+    w.table, store->tags, store->ops, store->offsets, w.data, store->extra,
+    w.names, w.types, w.vars,
+  };
+  size_t sizes[PARTS];
+  part_sizes(&header, sizes);
+
+  for(size_t i = 0; i < PARTS; i++)
+    header.checksum = checksum_more(header.checksum, parts[i], sizes[i]);
+
+  // written aside and renamed over the old image, so a reader never sees
+  // half of one
+  const char* path = image_path(source);
+  char* temp = stats_malloc(strlen(path) + 32);
+  sprintf(temp, "%s.%ld", path, (long)getpid());
+
+  int fd = open(temp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if(fd >= 0) {
+    bool ok = write_all(fd, &header, sizeof(header));
+    for(size_t i = 0; ok && i < PARTS; i++)
+      ok = write_all(fd, parts[i], sizes[i]);
+
+    close(fd);
+    if(!ok || rename(temp, path)) unlink(temp);
+  }
+
+  free(temp);
+  free((void*)path);
+  free(w.nodes);
+  free(w.table);
+  free(w.data);
+  free(w.names);
+  free(w.types);
+  free(w.vars);
+  free(w.pointers.members);
+  free(w.references.members);
+  free(w.expressions.members);
+  hm_destroy(&w.strings);
+}
+
+
+
+// ### LOADING ### //
+
+#define COLUMN_BYTES (2 * sizeof(uint8_t) + sizeof(uint32_t) \
+    + sizeof(struct NodeData))
+
+// every offset is checked, so a damaged image is only ever ignored
+static bool check_header(const struct ImageHeader* header, size_t size,
+    uint64_t hash) {
+  if(memcmp(header->magic, IMAGE_MAGIC, sizeof(header->magic))
+      || header->version != IMAGE_VERSION || header->hash != hash)
+    return false;
+
+  uint64_t slots = header->pointers + header->references
+    + header->expressions;
+  if(header->pointers > size || header->references > size
+      || header->expressions > size || header->nodes > size
+      || header->table > size || header->strings > header->table
+      || header->count > size
+      || header->extra > size || header->names > size
+      || header->types > size || header->vars > size || header->count == 0)
+    return false;
+
+  return sizeof(*header) + header->nodes + slots * sizeof(uint64_t)
+    + header->table + header->count * COLUMN_BYTES
+    + (header->extra + header->names) * sizeof(uint32_t)
+    + (header->types + header->vars) * sizeof(uint64_t) == size
+    && header->decls <= header->nodes / sizeof(struct Declaration*)
+    && header->members % sizeof(struct Declaration*) == 0
+    && header->members + header->decls * sizeof(struct Declaration*)
+      <= header->nodes;
+}
+
+static uint64_t checksum_of(const struct ImageHeader* header,
+    const char* parts) {
+  size_t sizes[PARTS];
+  part_sizes(header, sizes);
+
+  uint64_t sum = 0;
+  for(size_t i = 0; i < PARTS; i++) {
+    sum = checksum_more(sum, (const uint8_t*)parts, sizes[i]);
+    parts += sizes[i];
+  }
+  return sum;
+}
+
+static bool check_slot(const struct ImageHeader* header, uint64_t slot) {
+  return slot % sizeof(uintptr_t) == 0
+    && slot + sizeof(uintptr_t) <= header->nodes;
+}
+
+// once the pointers are fixed up, every node they lead to has to be inside
+// the image and tagged with a kind there is before it's used. the writer
+// puts a node after whatever points at it, so a pointer leading back is
+// damage, and following them always comes to an end. the expressions in a
+// node found through an expression come before that one, as it was parsed
+// after them
+struct ImageCheck {
+  const struct ImageHeader* header;
+  const char* base;
+  const struct Nodes* nodes;
+  uint32_t before; // of the expressions in the nodes
+};
+
+static bool check_node(const struct ImageCheck* c, const void* parent,
+    const void* node, size_t size) {
+  uintptr_t at = (uintptr_t)node - (uintptr_t)c->base;
+  return (uintptr_t)node > (uintptr_t)parent && at < c->header->nodes
+    && at % sizeof(max_align_t) == 0 && size <= c->header->nodes - at;
+}
+
+// a list's members have to fit after it too
+#define CHECK_LIST(c, parent, ast) \
+  (check_node(c, parent, ast, sizeof(*(ast))) \
+   && (ast)->size <= (c)->header->nodes / sizeof(*(ast)->members) \
+   && check_node(c, parent, ast, \
+     sizeof(*(ast)) + (ast)->size * sizeof(*(ast)->members)))
+
+static bool check_type(const struct ImageCheck*, const void*,
+    const struct Type*);
+
+static bool check_vardecls(const struct ImageCheck* c, const void* parent,
+    const struct VarDeclList* ast) {
+  if(!ast) return true;
+  if(!CHECK_LIST(c, parent, ast)) return false;
+
+  for(size_t i = 0; i < ast->size; i++)
+    if(ast->members[i].rvalue >= c->before
+        || !check_type(c, ast, ast->members[i].lvalue.type))
+      return false;
+  return true;
+}
+
+static bool check_types(const struct ImageCheck* c, const void* parent,
+    const struct TypeList* ast) {
+  if(!ast) return true;
+  if(!CHECK_LIST(c, parent, ast)) return false;
+
+  for(size_t i = 0; i < ast->size; i++)
+    if(!check_type(c, ast, ast->members[i])) return false;
+  return true;
+}
+
+#undef CHECK_LIST
+
+static bool check_struct(const struct ImageCheck* c, const void* parent,
+    const struct Struct* ast) {
+  return check_node(c, parent, ast, sizeof(*ast))
+    && check_vardecls(c, ast, ast->fields);
+}
+
+static bool check_union(const struct ImageCheck* c, const void* parent,
+    const struct Union* ast) {
+  return check_node(c, parent, ast, sizeof(*ast))
+    && check_types(c, ast, ast->fields);
+}
+
+static bool check_funcsig(const struct ImageCheck* c, const void* parent,
+    const struct FuncSig* ast) {
+  return check_node(c, parent, ast, sizeof(*ast))
+    && check_vardecls(c, ast, ast->args) && check_type(c, ast, ast->returns);
+}
+
+static bool check_type(const struct ImageCheck* c, const void* parent,
+    const struct Type* ast) {
+  if(!ast) return true;
+  if(!check_node(c, parent, ast, sizeof(*ast))) return false;
+
+  switch(ast->type) {
+    case TYPE_PRIMITIVE:
+      return ast->as.primitive >= TOKEN_INT8
+        && ast->as.primitive < TOKEN_TRUE;
+    case TYPE_WRAPPER:
+      return (ast->as.wrapper.op == TOKEN_BIT_NOT
+          || ast->as.wrapper.op == TOKEN_QUESTION
+          || ast->as.wrapper.op == TOKEN_BIT_AND)
+        && check_type(c, ast, ast->as.wrapper.type);
+    case TYPE_ARRAY:
+      return ast->as.array.size < c->before
+        && check_type(c, ast, ast->as.array.type);
+    case TYPE_COMPOUND:
+      switch(ast->as.compound.type) {
+        case COMP_STRUCT:
+          return check_struct(c, ast, ast->as.compound.as._struct);
+        case COMP_UNION:
+          return check_union(c, ast, ast->as.compound.as._union);
+        case COMP_FUNC:
+          return check_funcsig(c, ast, ast->as.compound.as.sig);
+        default: return false;
+      }
+    default:
+      return false;
+  }
+}
+
+static bool check_variable(const struct ImageCheck* c, const void* parent,
+    const struct Variable* ast) {
+  return check_node(c, parent, ast, sizeof(*ast))
+    && check_vardecls(c, ast, ast->vars);
+}
+
+static bool check_declaration(const struct ImageCheck* c, const void* parent,
+    const struct Declaration* ast) {
+  if(!check_node(c, parent, ast, sizeof(*ast))) return false;
+
+  switch(ast->type) {
+    case DECL_VAR:    return check_variable(c, ast, ast->as.var);
+    case DECL_STRUCT: return check_struct(c, ast, ast->as._struct);
+    case DECL_UNION:  return check_union(c, ast, ast->as._union);
+    case DECL_FUNC: {
+      const struct Function* function = ast->as.function;
+      return check_node(c, ast, function, sizeof(*function))
+        && c->nodes->tags[function->body] == EXPR_BLOCK
+        && check_funcsig(c, function, function->sig);
+    }
+    case DECL_INC:    return true;
+    default:          return false;
+  }
+}
+
+// one of the node's statements, whose nodes have to come before it
+static bool load_statement(const struct ImageHeader* header, const char* base,
+    struct Nodes* nodes, uint32_t at, uint32_t node) {
+  uint32_t index = nodes->extra[at + 1];
+
+  switch(nodes->extra[at]) {
+    case STMT_EXPR:  return index < node;
+    case STMT_BLOCK:
+      return index < node && nodes->tags[index] == EXPR_BLOCK;
+    case STMT_VAR:
+      return index < nodes->vars.size
+        && check_variable(&(struct ImageCheck){ header, base, nodes, node },
+          base, nodes->vars.members[index]);
+    default:         return false;
+  }
+}
+
+static bool check_list(const struct Nodes* nodes, uint32_t at,
+    uint32_t node) {
+  if(at >= nodes->extra_size
+      || nodes->extra[at] > nodes->extra_size - at - 1) return false;
+
+  for(size_t i = 0; i < nodes->extra[at]; i++)
+    if(nodes->extra[at + 1 + i] >= node) return false;
+  return true;
+}
+
+// whether everything the node refers to is in the image, swapping back
+// what the writer swapped on the way. the parser pushes a node after its
+// children, so one referring to itself or a later node is damage, and
+// walking the tree always comes to an end
+static bool load_node(const struct ImageHeader* header, const char* base,
+    const char** strings, struct Nodes* nodes, uint32_t node) {
+  struct NodeData* data = &nodes->data[node];
+  size_t size = node, extra = nodes->extra_size;
+
+  switch(nodes->tags[node]) {
+    case EXPR_LITERAL: {
+      if(nodes->ops[node] > VAL_PTR) return false;
+      if(nodes->ops[node] == VAL_BOOL) return data->lhs <= 1 && !data->rhs;
+      if(nodes->ops[node] != VAL_STRING && nodes->ops[node] != VAL_IDENTIFIER)
+        return true;
+      if(data->lhs >= header->strings) return false;
+
+      struct Value literal = {
+        .type = nodes->ops[node], .as.string = strings[data->lhs],
+      };
+      set_literal(nodes, node, literal);
+      return true;
+    }
+    case EXPR_UNARY:
+      return nodes->ops[node] < TOKEN_EOF && data->lhs < size;
+    case EXPR_GROUP:
+      return data->lhs < size;
+    case EXPR_BINARY:
+    case EXPR_ASSIGN:
+      return nodes->ops[node] < TOKEN_EOF && data->lhs < size
+        && data->rhs < size;
+    case EXPR_ARRAY_INDEX:
+      return data->lhs < size && data->rhs < size;
+    case EXPR_CALL:
+      return data->lhs < size && check_list(nodes, data->rhs, node);
+    case EXPR_ARRAY_INIT:
+      return check_list(nodes, data->lhs, node);
+    case EXPR_VARIABLE:
+      return data->rhs < nodes->names.size;
+    case EXPR_FIELD:
+      return data->lhs < size && data->rhs < nodes->names.size;
+    case EXPR_CAST:
+      return data->lhs < size && data->rhs < nodes->types.size
+        && check_type(&(struct ImageCheck){ header, base, nodes, node },
+          base, nodes->types.members[data->rhs]);
+    case EXPR_BLOCK: {
+      if(data->lhs >= extra || data->rhs >= size) return false;
+      uint32_t count = nodes->extra[data->lhs];
+      if(count > (extra - data->lhs - 1) / 2) return false;
+
+      for(size_t i = 0; i < count; i++)
+        if(!load_statement(header, base, nodes, data->lhs + 1 + 2 * i, node))
+          return false;
+      return true;
+    }
+    case EXPR_IF:
+    case EXPR_WHILE:
+      return data->lhs < size && (size_t)data->rhs + 2 <= extra
+        && nodes->extra[data->rhs] < size
+        && nodes->extra[data->rhs + 1] < size;
+    case EXPR_FOR:
+      return (size_t)data->lhs + 4 <= extra && data->rhs < size
+        && nodes->extra[data->lhs + 2] < size
+        && nodes->extra[data->lhs + 3] < size
+        && load_statement(header, base, nodes, data->lhs, node);
+    default:
+      return false;
+  }
+}
+
+// the names, and the nodes of the types and variables, which only have to be
+// in the image here: each is checked with the node that uses it, as the
+// expressions in it have to come before that one
+static bool load_tables(const struct ImageHeader* header, const char* base,
+    const char** strings, const char* tables, struct Nodes* nodes) {
+  for(size_t i = 0; i < header->names; i++) {
+    uint32_t index;
+    memcpy(&index, tables, sizeof(index));
+    tables += sizeof(index);
+
+    if(index >= header->strings) return false;
+    push_name(nodes, strings[index]);
+  }
+
+#define TABLE(push, size) \
+  for(size_t i = 0; i < (size); i++) { \
+    uint64_t offset; \
+    memcpy(&offset, tables, sizeof(offset)); \
+    tables += sizeof(offset); \
+    \
+    if(offset != NONE && offset >= header->nodes) return false; \
+    push(nodes, offset == NONE ? NULL : (void*)(base + offset)); \
+  }
+
+  TABLE(push_type, header->types);
+  TABLE(push_var, header->vars);
+
+#undef TABLE
+
+  return true;
+}
+
+static bool load_columns(const struct ImageHeader* header, const char* base,
+    const char** strings, const char* columns, struct Nodes* nodes) {
+  size_t count = header->count;
+  reserve_nodes(nodes, count);
+  reserve_extra(nodes, header->extra);
+
+#define COLUMN(name, size) \
+  memcpy(nodes->name, columns, (size) * sizeof(*nodes->name)); \
+  columns += (size) * sizeof(*nodes->name);
+
+  COLUMN(tags, count);
+  COLUMN(ops, count);
+  COLUMN(offsets, count);
+  COLUMN(data, count);
+  COLUMN(extra, header->extra);
+
+#undef COLUMN
+
+  nodes->size = count;
+  nodes->extra_size = header->extra;
+  if(!load_tables(header, base, strings, columns, nodes)) return false;
+
+  if(nodes->tags[0] != EXPR_LITERAL || nodes->ops[0] != VAL_UNDEFINED)
+    return false;
+  for(size_t i = 1; i < count; i++)
+    if(!load_node(header, base, strings, nodes, i)) return false;
+  return true;
+}
+
+static const char** load_strings(const struct ImageHeader* header,
+    const char* table) {
+  const char** strings = stats_malloc((header->strings ? header->strings : 1)
+      * sizeof(*strings));
+  size_t at = 0;
+
+  for(size_t i = 0; i < header->strings; i++) {
+    uint32_t len;
+    if(at + sizeof(len) > header->table) goto fail;
+    memcpy(&len, table + at, sizeof(len));
+    at += sizeof(len);
+
+    if(at + len + 1 > header->table || table[at + len]) goto fail;
+    strings[i] = intern(table + at, len);
+    at += len + 1;
+  }
+
+  if(at == header->table) return strings;
+
+fail:
+  free(strings);
+  return NULL;
+}
+
+struct AST* load_image(const char* source, uint64_t hash) {
+  const char* path = image_path(source);
+  bool exists = !access(path, R_OK);
+  struct Source image = exists ? read_file(path) : (struct Source){ 0 };
+  free((void*)path);
+  if(!exists) return NULL;
+
+  struct ImageHeader header;
+  if(image.size < sizeof(header)) {
+    close_file(&image);
+    return NULL;
+  }
+  memcpy(&header, image.text, sizeof(header));
+  const char* nodes = image.text + sizeof(header);
+
+  if(!check_header(&header, image.size, hash)
+      || checksum_of(&header, nodes) != header.checksum) {
+    close_file(&image);
+    return NULL;
+  }
+
+  // where each part starts, now that they're known to fit
+  const char* pointers = nodes + header.nodes;
+  const char* references = pointers + header.pointers * sizeof(uint64_t);
+  const char* expressions =
+    references + header.references * sizeof(uint64_t);
+  const char* table = expressions + header.expressions * sizeof(uint64_t);
+  const char* columns = table + header.table;
+
+  const char** strings = load_strings(&header, table);
+  if(!strings) {
+    close_file(&image);
+    return NULL;
+  }
+
+  struct AST* ast = new_ast();
+
+  // one block for the whole tree, which the offsets are then made into
+  // pointers into
+  char* base = arena_alloc(&ast->arena, header.nodes);
+  memcpy(base, nodes, header.nodes);
+
+  bool ok = true;
+  for(size_t i = 0; ok && i < header.pointers; i++) {
+    uint64_t slot;
+    uintptr_t node;
+    memcpy(&slot, pointers + i * sizeof(slot), sizeof(slot));
+
+    if(!(ok = check_slot(&header, slot))) break;
+    memcpy(&node, base + slot, sizeof(node));
+    if(!(ok = node < header.nodes)) break;
+
+    node += (uintptr_t)base;
+    memcpy(base + slot, &node, sizeof(node));
+  }
+
+  for(size_t i = 0; ok && i < header.references; i++) {
+    uint64_t slot;
+    uintptr_t index;
+    memcpy(&slot, references + i * sizeof(slot), sizeof(slot));
+
+    if(!(ok = check_slot(&header, slot))) break;
+    memcpy(&index, base + slot, sizeof(index));
+    if(!(ok = index < header.strings)) break;
+
+    memcpy(base + slot, &strings[index], sizeof(strings[index]));
+  }
+
+  // expression slots are only 32 bits wide
+  for(size_t i = 0; ok && i < header.expressions; i++) {
+    uint64_t slot;
+    uint32_t node;
+    memcpy(&slot, expressions + i * sizeof(slot), sizeof(slot));
+
+    if(!(ok = slot % sizeof(node) == 0 && slot + sizeof(node) <= header.nodes))
+      break;
+    memcpy(&node, base + slot, sizeof(node));
+    if(!(ok = node < header.count)) break;
+
+    refer_node(&ast->nodes, (uint32_t*)(base + slot));
+  }
+
+  ok = ok && load_columns(&header, base, strings, columns, &ast->nodes);
+
+  // the declarations stay where they were loaded, in the arena
+  struct Declaration** members = (struct Declaration**)(base + header.members);
+  struct ImageCheck check = { &header, base, &ast->nodes, header.count };
+  for(size_t i = 0; ok && i < header.decls; i++)
+    ok = check_declaration(&check, members, members[i]);
+
+  free(strings);
+  close_file(&image);
+
+  if(!ok) {
+    free_ast(ast);
+    return NULL;
+  }
+
+  ast->members = members;
+  ast->size = ast->capacity = header.decls;
+
+  for(size_t i = 0; i < ast->size; i++) {
+    ast->members[i]->file = source;
+    if(ast->members[i]->type == DECL_FUNC)
+      ast->members[i]->as.function->file = source;
+  }
+
+  return ast;
+}
+
+#undef IMAGE_VERSION
+#undef IMAGE_MAGIC
+#undef EXTENSION
+#undef ALIGN
+#undef NONE
+#undef COLUMN_BYTES
+#undef PARTS
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdint.h>
+#include "parser.h"
+
+// a parsed file is cached next to its source as an image: the nodes of its
+// declarations with offsets in place of pointers, the offsets of every
+// pointer, its expressions' columns as they are, their tables of names,
+// types and variables, and the strings it uses. loading one is a copy and a
+// pass over those offsets, the tables and the columns, with no lexing,
+// parsing or per-node allocation. the hash is of the source an image was
+// made from, and an image that doesn't match it, or whose own checksum
+// doesn't, is ignored
+
+// NULL if there's no usable image for the source
+struct AST* load_image(const char* source, uint64_t hash);
+// failing to write one is not an error, the file is just parsed next time
+void save_image(const char* source, uint64_t hash, const struct AST*);
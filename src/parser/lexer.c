@@ -1,6 +1,8 @@
 // lexer.c
 
 #include "lexer.h"
+#include "scan.h"
+#include "../util/intern.h"
 #include <ctype.h>
 #include <stdio.h>
 #include <string.h>
@@ -9,7 +11,6 @@
 
 static inline char next(struct Parser* parser) {
   CURRENT(parser) += 1;
-  parser->col += 1;
   return *(CURRENT(parser) - 1);
 }
 
@@ -34,18 +35,28 @@ static inline char over(const struct Parser* parser) {
 
 static void skip_whitespace(struct Parser* parser) {
   while(true) {
-    switch(*CURRENT(parser)) {
-      case '\n': parser->row += 1; parser->col = 0;
-                 __attribute__((fallthrough));
-      case ' ':
-      case '\r':
-      case '\t': next(parser); break;
-      case '/':
-        if(over(parser) == '/')
-          while(peek(parser) != '\n' && !is_at_end(parser)) next(parser);
-        break;
-      default: return;
-    }
+    CURRENT(parser) = skip_blanks(CURRENT(parser));
+
+    if(peek(parser) != '/' || over(parser) != '/') return;
+    CURRENT(parser) = skip_to_newline(CURRENT(parser) + 2);
+  }
+}
+
+// the lexer doesn't track lines; they're counted from the last offset that
+// was asked for, so printing every token's location stays linear
+void update_location(struct Parser* parser, size_t offset) {
+  const char* target = parser->source + offset;
+
+  if(parser->located > target) {
+    parser->located = parser->source;
+    parser->row = parser->col = 0;
+  }
+
+  for(; parser->located < target; parser->located++) {
+    if(*parser->located == '\n') {
+      parser->row += 1;
+      parser->col = 0;
+    } else parser->col += 1;
   }
 }
 
@@ -66,18 +77,16 @@ static inline enum TokenType match_arrow(struct Parser* parser,
   return match(parser, '>') ? t2 : match_wrap(parser, '=', '%', t1);
 }
 
-// don't forget to free the string :)
 static struct Token lex_string(struct Parser* parser) {
   const char* start = CURRENT(parser);
 
   while(peek(parser) != '"' && !is_at_end(parser)) next(parser);
   if(is_at_end(parser)) return TOKEN_NEW_ERROR(ERROR_LEX_UNTERMINATED_STRING);
 
-  char* literal = calloc(CURRENT(parser) - start, sizeof(char));
-  memcpy(literal, start, CURRENT(parser) - start);
+  size_t len = CURRENT(parser) - start;
 
   next(parser);
-  return TOKEN_NEW_STRING(literal);
+  return TOKEN_NEW_STRING(start - parser->source, len);
 }
 
 static struct Token lex_char(struct Parser* parser) {
@@ -102,8 +111,8 @@ static struct Token lex_number(struct Parser* parser) {
     while(isdigit(peek(parser))) next(parser);
   }
 
-  char buf[CURRENT(parser) - start];
-  memset(buf, '\0', CURRENT(parser) - start);
+  char buf[CURRENT(parser) - start + 1];
+  memset(buf, '\0', CURRENT(parser) - start + 1);
   memcpy(buf, start, CURRENT(parser) - start);
 
   if(is_floating) return TOKEN_NEW_FLOAT(strtod(buf, NULL));
@@ -113,179 +122,104 @@ static struct Token lex_number(struct Parser* parser) {
   }
 }
 
-static struct Token check_keyword(const char* word, size_t start, size_t length,
-    const char* rest, enum TokenType type) {
-  if(strlen(word) == start + length && memcmp(word + start, rest, length) == 0) {
-    free((char*)word);
-    return TOKEN_NEW(type);
-  }
-
-  return TOKEN_NEW_IDENTIFIER(word);
+// keywords are found with a perfect hash of their first and last two
+// characters, checked against the raw slice so identifiers are never copied.
+// every keyword has its own bucket; a collision shows up as an initializer
+// override warning
+#define KEYWORD_BUCKETS 128
+#define MAX_KEYWORD_LEN 8
+#define KEYWORD_HASH(first, second_last, last) \
+  (((unsigned char)(first) + 3 * (unsigned char)(second_last) \
+    + 5 * (unsigned char)(last)) & (KEYWORD_BUCKETS - 1))
+#define KEYWORD(word, first, second_last, last, type) \
+  [KEYWORD_HASH(first, second_last, last)] = { word, sizeof(word) - 1, type }
+
+static const struct Keyword {
+  const char* word;
+  size_t len;
+  enum TokenType type;
+} keywords[KEYWORD_BUCKETS] = {
+  KEYWORD("and",      'a', 'n', 'd', TOKEN_LOGIC_AND),
+  KEYWORD("as",       'a', 'a', 's', TOKEN_AS),
+  KEYWORD("bool",     'b', 'o', 'l', TOKEN_BOOL),
+  KEYWORD("break",    'b', 'a', 'k', TOKEN_BREAK),
+  KEYWORD("catch",    'c', 'c', 'h', TOKEN_CATCH),
+  KEYWORD("char",     'c', 'a', 'r', TOKEN_CHAR),
+  KEYWORD("continue", 'c', 'u', 'e', TOKEN_CONTINUE),
+  KEYWORD("else",     'e', 's', 'e', TOKEN_ELSE),
+  KEYWORD("enum",     'e', 'u', 'm', TOKEN_ENUM),
+  KEYWORD("extern",   'e', 'r', 'n', TOKEN_EXTERN),
+  KEYWORD("false",    'f', 's', 'e', TOKEN_FALSE),
+  KEYWORD("float16",  'f', '1', '6', TOKEN_FLOAT16),
+  KEYWORD("float32",  'f', '3', '2', TOKEN_FLOAT32),
+  KEYWORD("float64",  'f', '6', '4', TOKEN_FLOAT64),
+  KEYWORD("float8",   'f', 't', '8', TOKEN_FLOAT8),
+  KEYWORD("for",      'f', 'o', 'r', TOKEN_FOR),
+  KEYWORD("fsize",    'f', 'z', 'e', TOKEN_FSIZE),
+  KEYWORD("function", 'f', 'o', 'n', TOKEN_FUNCTION),
+  KEYWORD("if",       'i', 'i', 'f', TOKEN_IF),
+  KEYWORD("include",  'i', 'd', 'e', TOKEN_INCLUDE),
+  KEYWORD("int16",    'i', '1', '6', TOKEN_INT16),
+  KEYWORD("int32",    'i', '3', '2', TOKEN_INT32),
+  KEYWORD("int64",    'i', '6', '4', TOKEN_INT64),
+  KEYWORD("int8",     'i', 't', '8', TOKEN_INT8),
+  KEYWORD("isize",    'i', 'z', 'e', TOKEN_ISIZE),
+  KEYWORD("let",      'l', 'e', 't', TOKEN_LET),
+  KEYWORD("match",    'm', 'c', 'h', TOKEN_MATCH),
+  KEYWORD("mut",      'm', 'u', 't', TOKEN_MUT),
+  KEYWORD("noreturn", 'n', 'r', 'n', TOKEN_NORETURN),
+  KEYWORD("or",       'o', 'o', 'r', TOKEN_LOGIC_OR),
+  KEYWORD("orelse",   'o', 's', 'e', TOKEN_ORELSE),
+  KEYWORD("return",   'r', 'r', 'n', TOKEN_RETURN),
+  KEYWORD("struct",   's', 'c', 't', TOKEN_STRUCT),
+  KEYWORD("true",     't', 'u', 'e', TOKEN_TRUE),
+  KEYWORD("try",      't', 'r', 'y', TOKEN_TRY),
+  KEYWORD("type",     't', 'p', 'e', TOKEN_TYPE),
+  KEYWORD("uint16",   'u', '1', '6', TOKEN_UINT16),
+  KEYWORD("uint32",   'u', '3', '2', TOKEN_UINT32),
+  KEYWORD("uint64",   'u', '6', '4', TOKEN_UINT64),
+  KEYWORD("uint8",    'u', 't', '8', TOKEN_UINT8),
+  KEYWORD("union",    'u', 'o', 'n', TOKEN_UNION),
+  KEYWORD("usize",    'u', 'z', 'e', TOKEN_USIZE),
+  KEYWORD("void",     'v', 'i', 'd', TOKEN_VOID),
+  KEYWORD("where",    'w', 'r', 'e', TOKEN_WHERE),
+  KEYWORD("while",    'w', 'l', 'e', TOKEN_WHILE),
+};
+
+static enum TokenType keyword_type(const char* word, size_t len) {
+  if(len < 2 || len > MAX_KEYWORD_LEN) return TOKEN_IDENTIFIER_LIT;
+
+  const struct Keyword* keyword =
+    &keywords[KEYWORD_HASH(word[0], word[len - 2], word[len - 1])];
+
+  if(keyword->len == len && !memcmp(keyword->word, word, len))
+    return keyword->type;
+  return TOKEN_IDENTIFIER_LIT;
 }
 
+#undef KEYWORD_BUCKETS
+#undef MAX_KEYWORD_LEN
+#undef KEYWORD_HASH
+#undef KEYWORD
+
 static struct Token lex_identifier(struct Parser* parser) {
   const char* start = CURRENT(parser) - 1;
 
-  while(isalnum(peek(parser)) || peek(parser) == '_') next(parser);
+  CURRENT(parser) = skip_identifier(CURRENT(parser));
 
   size_t len = CURRENT(parser) - start;
-  char* literal = calloc(len, sizeof(char));
-  memcpy(literal, start, len);
-
-  switch(literal[0]) {
-    case 'l': return check_keyword(literal, 1, 2, "et", TOKEN_LET);
-    case 'n': return check_keyword(literal, 1, 7, "oreturn", TOKEN_NORETURN);
-    case 'r': return check_keyword(literal, 1, 5, "eturn", TOKEN_RETURN);
-    case 's': return check_keyword(literal, 1, 5, "truct", TOKEN_STRUCT);
-    case 'v': return check_keyword(literal, 1, 3, "oid", TOKEN_VOID);
-    case 'a':
-      if(len > 1) {
-        switch(literal[1]) {
-          case 'n': return check_keyword(literal, 2, 1, "d", TOKEN_LOGIC_AND);
-          case 's': return TOKEN_NEW(TOKEN_AS);
-        }
-      } break;
-    case 'w':
-      if(len > 2 && literal[1] == 'h') {
-        switch(literal[2]) {
-          case 'e': return check_keyword(literal, 3, 2, "re", TOKEN_WHERE);
-          case 'i': return check_keyword(literal, 3, 2, "le", TOKEN_WHILE);
-        }
-      } break;
-    case 'b':
-      if(len > 1) { // bool break
-        switch(literal[1]) {
-          case 'o': return check_keyword(literal, 2, 2, "ol", TOKEN_BOOL);
-          case 'r': return check_keyword(literal, 2, 3, "eak", TOKEN_BREAK);
-        }
-      } break;
-    case 'c': // char continue
-      if(len > 1) {
-        switch(literal[1]) {
-          case 'a': return check_keyword(literal, 2, 3, "tch", TOKEN_CATCH);
-          case 'h': return check_keyword(literal, 2, 2, "ar", TOKEN_CHAR);
-          case 'o': return check_keyword(literal, 2, 6, "ntinue", TOKEN_CONTINUE);
-        }
-      } break;
-    case 'e': // else enum extern
-      if(len > 1) {
-        switch(literal[1]) {
-          case 'l': return check_keyword(literal, 2, 2, "se", TOKEN_ELSE);
-          case 'n': return check_keyword(literal, 2, 2, "um", TOKEN_ENUM);
-          case 'x': return check_keyword(literal, 2, 4, "tern", TOKEN_EXTERN);
-        }
-      } break;
-    case 'f': // false float for fsize function
-      if(len > 1) {
-        switch(literal[1]) {
-          case 'a': return check_keyword(literal, 2, 3, "lse", TOKEN_FALSE);
-          case 'l':
-            if(len >= 6 && literal[2] == 'o' && literal[3] == 'a'
-                && literal[4] == 't') {
-              if(len == 6 && literal[5] == '8') return TOKEN_NEW(TOKEN_FLOAT8);
-              switch(literal[5]) {
-                case '1': return check_keyword(literal, 6, 1, "6", TOKEN_FLOAT16);
-                case '3': return check_keyword(literal, 6, 1, "2", TOKEN_FLOAT32);
-                case '6': return check_keyword(literal, 6, 1, "4", TOKEN_FLOAT64);
-              }
-            } break;
-          case 'o': return check_keyword(literal, 2, 1, "r", TOKEN_FOR);
-          case 's': return check_keyword(literal, 2, 3, "ize", TOKEN_FSIZE);
-          case 'u': return check_keyword(literal, 2, 6, "nction", TOKEN_FUNCTION);
-        }
-      } break;
-    case 'i': // if include int isize
-      if(len > 1) {
-        switch(literal[1]) {
-          case 'f': free(literal); return TOKEN_NEW(TOKEN_IF);
-          case 'n':
-            if(len > 2) {
-              switch(literal[2]) {
-                case 'c':
-                  return check_keyword(literal, 3, 4, "lude", TOKEN_INCLUDE);
-                case 't':
-                  if(len == 4)
-                    return check_keyword(literal, 3, 1, "8", TOKEN_INT8);
-                  if(len == 5) {
-                    switch(literal[3]) {
-                      case '1':
-                        return check_keyword(literal, 4, 1, "6", TOKEN_INT16);
-                      case '3':
-                        return check_keyword(literal, 4, 1, "2", TOKEN_INT32);
-                      case '6':
-                        return check_keyword(literal, 4, 1, "4", TOKEN_INT64);
-                    }
-                  } break;
-              }
-            } break;
-          case 's': return check_keyword(literal, 2, 3, "ize", TOKEN_ISIZE);
-        }
-      } break;
-    case 'm': // match mut
-      if(len > 1) {
-        switch(literal[1]) {
-          case 'a': return check_keyword(literal, 2, 3, "tch", TOKEN_MATCH);
-          case 'u': return check_keyword(literal, 2, 1, "t", TOKEN_MUT);
-        }
-      } break;
-    case 'o': {
-      if(len > 1) {
-        switch(literal[1]) {
-          case 'r': {
-            if(len > 2)
-              return check_keyword(literal, 2, 4, "else", TOKEN_ORELSE);
-            else return TOKEN_NEW(TOKEN_LOGIC_OR);
-          }
-        }
-      }
-    } break;
-    case 't': // true type
-      if(len > 1) {
-        switch(literal[1]) {
-          case 'r': {
-            if(len > 2) {
-              switch(literal[2]) {
-                case 'y': return TOKEN_NEW(TOKEN_TRY);
-                case 'u': return check_keyword(literal, 3, 1, "e", TOKEN_TRUE);
-              }
-            } break;
-          }
-          case 'y': return check_keyword(literal, 2, 2, "pe", TOKEN_TYPE);
-        }
-      } break;
-    case 'u': // uint union usize
-      if(len > 1) {
-        switch(literal[1]) {
-          case 'i':
-            if(len == 5 && literal[2] == 'n' && literal[3] == 't'
-                && literal[4] == '8') {
-              free(literal);
-              return TOKEN_NEW(TOKEN_UINT8);
-            }
-            if(len > 5 && literal[2] == 'n' && literal[3] == 't') {
-              switch(literal[4]) {
-                case '1': return check_keyword(literal, 5, 1, "6", TOKEN_UINT16);
-                case '3': return check_keyword(literal, 5, 1, "2", TOKEN_UINT32);
-                case '6': return check_keyword(literal, 5, 1, "4", TOKEN_UINT64);
-              }
-            } break;
-          case 'n': return check_keyword(literal, 2, 3, "ion", TOKEN_UNION);
-          case 's': return check_keyword(literal, 2, 3, "ize", TOKEN_USIZE);
-        }
-      } break;
-      break;
-  }
+  enum TokenType type = keyword_type(start, len);
+  if(type != TOKEN_IDENTIFIER_LIT) return TOKEN_NEW(type);
 
-  return TOKEN_NEW_IDENTIFIER(literal);
+  return TOKEN_NEW_IDENTIFIER(start - parser->source, len);
 }
 
-struct Token lex_token(struct Parser* parser) {
-  skip_whitespace(parser);
+static struct Token lex_token(struct Parser* parser) {
   if(*CURRENT(parser) == '\0') return TOKEN_NEW(TOKEN_EOF);
 
   char c = next(parser);
   if(isdigit(c)) return lex_number(parser);
-  if(isalpha(c) || c == '_') return lex_identifier(parser);
+  if(IS_IDENTIFIER_START(c)) return lex_identifier(parser);
 
   switch(c) {
     case '(':  return TOKEN_NEW(TOKEN_LEFT_PAREN);
@@ -318,3 +252,23 @@ struct Token lex_token(struct Parser* parser) {
 
   return TOKEN_NEW_ERROR(ERROR_LEX_INVALID_SYMBOL);
 }
+
+// generated code averages a token per five or so bytes
+void tokenize(struct Parser* parser, size_t size) {
+  struct Token token;
+  init_tokens(&parser->tokens, size / 5 + 16);
+
+  do {
+    skip_whitespace(parser);
+    const char* start = CURRENT(parser);
+
+    token = lex_token(parser);
+    push_token(&parser->tokens, token, start - parser->source,
+        CURRENT(parser) - start);
+  } while(token.type != TOKEN_EOF);
+}
+
+const char* token_string(const struct Parser* parser,
+    const struct Token* token) {
+  return intern(parser->source + token->as.slice.offset, token->as.slice.len);
+}
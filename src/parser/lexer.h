@@ -3,4 +3,8 @@
 #include "token.h"
 #include "parser.h"
 
-struct Token lex_token(struct Parser*);
+void tokenize(struct Parser*, size_t);
+void update_location(struct Parser*, size_t);
+
+// the interned spelling of an identifier or string token
+const char* token_string(const struct Parser*, const struct Token*);
@@ -1,75 +1,81 @@
 // list.c
 
 #include <stdio.h>
+#include <string.h>
 #include "list.h"
 #include "type.h"
 #include "expression.h"
 
-static struct LValue* parse_lvalue(struct Parser* parser) {
-  struct LValue* lv = malloc(sizeof(*lv));
+static struct LValue parse_lvalue(struct Parser* parser) {
+  struct LValue lv = { .name = NULL, .type = NULL, .slot = 0 };
 
-  EXPECT_TOKEN(parser, IDENTIFIER_LIT, EXPECTED_IDENTIFIER);
-  lv->name = parser->previous.as.string;
+  EXPECT_OR(parser, IDENTIFIER_LIT, EXPECTED_IDENTIFIER, lv);
+  lv.name = token_string(parser, &parser->previous);
 
   if(MATCH_TOKEN(parser, COLON))
-    lv->type = parse_type(parser);
-  else lv->type = NULL;
+    lv.type = parse_type(parser);
 
   return lv;
 }
 
 
-static struct VarDecl* parse_vardecl(struct Parser* parser) {
-  struct VarDecl* var = malloc(sizeof(*var));
+static struct VarDecl parse_vardecl(struct Parser* parser) {
+  struct VarDecl var = { .lvalue = parse_lvalue(parser), .rvalue = 0 };
 
-  var->lvalue = parse_lvalue(parser);
-  var->rvalue = NULL;
-
-  if(!MATCH_TOKEN(parser, ASSIGN))
-    return var;
-
-  if(!MATCH_TOKEN(parser, UNDEFINED))
-    var->rvalue = parse_expression(parser);
+  if(MATCH_TOKEN(parser, ASSIGN) && !MATCH_TOKEN(parser, UNDEFINED))
+    var.rvalue = parse_expression(parser);
 
   return var;
 }
 
 
+// a declaration's initializer can hold a block declaring more of them, so
+// they're all pushed on the one stack, and each list takes its own off
 struct VarDeclList* parse_vardecls(struct Parser* parser) {
-  struct VarDeclList* head = malloc(sizeof(*head));
-  struct VarDeclList* tail = head;
+  size_t start = parser->decls.size;
 
-  tail->current = parse_vardecl(parser);
-  tail->next = NULL;
+  do {
+    struct VarDecl var = parse_vardecl(parser);
+    APPEND_VECTOR(&parser->decls, var);
+  } while(MATCH_TOKEN(parser, COMMA));
 
-  while(MATCH_TOKEN(parser, COMMA)) {
-    tail->next = malloc(sizeof(*(tail->next)));
-    tail = tail->next;
-    tail->next = NULL;
+  size_t size = parser->decls.size - start;
+  struct VarDeclList* list = arena_alloc(parser->arena,
+      sizeof(*list) + size * sizeof(*list->members));
 
-    tail->current = parse_vardecl(parser);
-  }
+  list->size = size;
+  memcpy(list->members, parser->decls.members + start,
+      size * sizeof(*list->members));
+  for(size_t i = 0; i < size; i++)
+    refer_node(parser->nodes, &list->members[i].rvalue);
 
-  return head;
+  parser->decls.size = start;
+  return list;
+}
+
+size_t count_vardecls(const struct VarDeclList* list) {
+  return list ? list->size : 0;
 }
 
 
 struct TypeList* parse_types(struct Parser* parser) {
-  struct TypeList* head = malloc(sizeof(*head));
-  struct TypeList* tail = head;
+  size_t start = parser->types.size;
 
-  tail->current = parse_type(parser);
-  tail->next = NULL;
+  do {
+    struct Type* type = parse_type(parser);
+    APPEND_VECTOR(&parser->types, type);
+  } while(MATCH_TOKEN(parser, COMMA));
 
-  while(MATCH_TOKEN(parser, COMMA)) {
-    tail->next = malloc(sizeof(*(tail->next)));
-    tail = tail->next;
-    tail->next = NULL;
+  size_t size = parser->types.size - start;
+  struct TypeList* list = arena_alloc(parser->arena,
+      sizeof(*list) + size * sizeof(*list->members));
 
-    tail->current = parse_type(parser);
-  }
+  list->size = size;
+  memcpy(list->members, parser->types.members + start,
+      size * sizeof(*list->members));
 
-  return head;
+  parser->types.size = start;
+  return list;
 }
 
 
@@ -77,43 +83,43 @@ struct TypeList* parse_types(struct Parser* parser) {
 // ### PRINT FUNCTIONS ### //
 
 
-static void print_lvalue(const struct LValue* ast) {
-  if(ast == NULL) { printf("(NULL)"); return; }
+// one without a name is what's left of a declaration that failed to parse
+static void print_lvalue(const struct Nodes* nodes, const struct LValue* ast) {
+  if(ast->name == NULL) { printf("(NULL)"); return; }
 
   printf("(%s ", ast->name);
-  print_type(ast->type);
+  print_type(nodes, ast->type);
   printf(")");
 }
 
 
-static void print_vardecl(const struct VarDecl* ast) {
+static void print_vardecl(const struct Nodes* nodes,
+    const struct VarDecl* ast) {
   if(ast == NULL) { printf("(NULL)"); return; }
 
   printf("(:= ");
-  print_lvalue(ast->lvalue);
+  print_lvalue(nodes, &ast->lvalue);
   printf(" ");
-  print_expression(ast->rvalue);
+  print_expression(nodes, ast->rvalue);
   printf(")");
 }
 
 
-void print_vardecls(const struct VarDeclList* ast) {
+void print_vardecls(const struct Nodes* nodes, const struct VarDeclList* ast) {
   if(ast == NULL) { printf("(NULL)"); return; }
 
-  print_vardecl(ast->current);
-  if(ast->next) {
-    printf(" ");
-    print_vardecls(ast->next);
+  for(size_t i = 0; i < ast->size; i++) {
+    if(i) printf(" ");
+    print_vardecl(nodes, &ast->members[i]);
   }
 }
 
 
-void print_types(const struct TypeList* ast) {
+void print_types(const struct Nodes* nodes, const struct TypeList* ast) {
   if(ast == NULL) { printf("(NULL)"); return; }
 
-  print_type(ast->current);
-  if(ast->next) {
-    printf(" ");
-    print_types(ast->next);
+  for(size_t i = 0; i < ast->size; i++) {
+    if(i) printf(" ");
+    print_type(nodes, ast->members[i]);
   }
 }
@@ -2,24 +2,21 @@
 
 #include "parser.h"
 
-struct LValue {
-  const char* name;
-  struct Type* type;
+// a list is its size and then its members, all in one piece of the arena,
+// so walking one is a scan. a missing one is NULL rather than empty
+struct VarDeclList {
+  size_t size;
+  struct VarDecl members[];
 };
 
-struct VarDecl {
-  struct LValue* lvalue;
-  struct Expression* rvalue;
+struct TypeList {
+  size_t size;
+  struct Type* members[];
 };
 
-#define DEF_LINKED_LIST(name, _type) \
-  struct name { _type current; struct name* next; }
-
-DEF_LINKED_LIST(VarDeclList, struct VarDecl*);
-DEF_LINKED_LIST(TypeList, struct Type*);
-
 struct VarDeclList* parse_vardecls(struct Parser*);
+size_t count_vardecls(const struct VarDeclList*);
 struct TypeList* parse_types(struct Parser*);
 
-void print_vardecls(const struct VarDeclList*);
-void print_types(const struct TypeList*);
+void print_vardecls(const struct Nodes*, const struct VarDeclList*);
+void print_types(const struct Nodes*, const struct TypeList*);
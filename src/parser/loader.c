@@ -0,0 +1,241 @@
+// loader.c
+
+#include "../util/hash.h"
+#include "../util/intern.h"
+#include "../util/stats.h"
+#include "declaration.h"
+#include "loader.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+// includes are only found as files are parsed, so past this many threads
+// there's rarely anything left for another one to do
+#define MAX_WORKERS 16
+
+struct Module {
+  const char* path;       // as errors report it, from the working directory
+  struct AST* ast;        // NULL until parsed, or if it didn't parse
+  struct Module** includes;
+  size_t nincludes;
+  struct Module* queued;  // next in the queue
+  bool visited;
+};
+
+DEFINE_ARRAYLIST(ModuleList, struct Module*);
+
+struct Loader {
+  pthread_mutex_t lock;
+  pthread_cond_t wake;    // a module was queued, or the last one finished
+  struct HashMap modules; // by real path
+  struct ModuleList all;
+  struct Module* queue;
+  size_t pending;         // queued or being parsed
+  int flags;
+  bool failed;
+};
+
+
+static void include_error(const struct Module* module, const char* include) {
+  flockfile(stdout);
+  print_error_place("%s", module->path);
+  printf(" at \"%s\"\n", include);
+  print_error_message(PARSE_ERROR_CODES + ERROR_NO_SUCH_INCLUDE,
+      error_strings[ERROR_NO_SUCH_INCLUDE]);
+  funlockfile(stdout);
+}
+
+// "std.io" included from dir/main.2c is dir/std/io.2c
+static const char* include_path(const char* from, const char* include) {
+  const char* slash = strrchr(from, '/');
+  size_t dir = slash ? (size_t)(slash - from) + 1 : 0;
+  size_t len = strlen(include);
+
+  char* path = stats_malloc(dir + len + sizeof(".2c"));
+  memcpy(path, from, dir);
+  for(size_t i = 0; i < len; i++)
+    path[dir + i] = include[i] == '.' ? '/' : include[i];
+  memcpy(path + dir + len, ".2c", sizeof(".2c"));
+
+  const char* interned = intern_cstr(path);
+  free(path);
+  return interned;
+}
+
+// the same file reached through different paths is still one module
+static const char* real_path(const char* path) {
+  char* real = realpath(path, NULL);
+  if(!real) return NULL;
+
+  const char* interned = intern_cstr(real);
+  free(real);
+  return interned;
+}
+
+// the module for a file, queued to be parsed the first time it's seen. the
+// lock must be held
+static struct Module* find_module(struct Loader* loader, const char* path,
+    const char* real) {
+  struct Module* module = (struct Module*)hm_get(&loader->modules, real);
+  if(module) return module;
+
+  module = stats_malloc(sizeof(*module));
+  *module = (struct Module){
+    .path = path, .ast = NULL, .includes = NULL, .nincludes = 0,
+    .queued = loader->queue, .visited = false,
+  };
+
+  hm_set(&loader->modules, real, (uintptr_t)module);
+  APPEND_ARRAYLIST(&loader->all, module);
+
+  loader->queue = module;
+  loader->pending += 1;
+  pthread_cond_signal(&loader->wake);
+
+  return module;
+}
+
+
+// parsing and finding the included files happen without the lock held; only
+// queueing what was found takes it
+static void parse_module(struct Loader* loader, struct Module* module) {
+  struct AST* ast = parse_file(module->path, loader->flags);
+
+  size_t count = 0;
+  for(size_t i = 0; ast && i < ast->size; i++)
+    count += ast->members[i]->type == DECL_INC;
+
+  const char** paths = stats_malloc((count ? count : 1) * sizeof(*paths));
+  const char** reals = stats_malloc((count ? count : 1) * sizeof(*reals));
+  for(size_t i = 0, n = 0; n < count; i++) {
+    if(ast->members[i]->type != DECL_INC) continue;
+
+    paths[n] = include_path(module->path, ast->members[i]->as.include);
+    reals[n] = real_path(paths[n]);
+    if(!reals[n]) include_error(module, ast->members[i]->as.include);
+    n += 1;
+  }
+
+  pthread_mutex_lock(&loader->lock);
+  module->ast = ast;
+  if(!ast) loader->failed = true;
+
+  module->includes =
+    stats_malloc((count ? count : 1) * sizeof(*module->includes));
+  for(size_t i = 0; i < count; i++) {
+    if(reals[i])
+      module->includes[module->nincludes++] =
+        find_module(loader, paths[i], reals[i]);
+    else loader->failed = true;
+  }
+
+  loader->pending -= 1;
+  if(!loader->pending) pthread_cond_broadcast(&loader->wake);
+  pthread_mutex_unlock(&loader->lock);
+
+  free(paths);
+  free(reals);
+}
+
+static void* work(void* arg) {
+  struct Loader* loader = arg;
+
+  pthread_mutex_lock(&loader->lock);
+  while(true) {
+    while(!loader->queue && loader->pending)
+      pthread_cond_wait(&loader->wake, &loader->lock);
+    if(!loader->queue) break;
+
+    struct Module* module = loader->queue;
+    loader->queue = module->queued;
+
+    pthread_mutex_unlock(&loader->lock);
+    parse_module(loader, module);
+    pthread_mutex_lock(&loader->lock);
+  }
+  pthread_mutex_unlock(&loader->lock);
+
+  return NULL;
+}
+
+// the root is parsed first, so a program without includes never starts a
+// thread; the calling thread works alongside the others
+static void parse_all(struct Loader* loader, struct Module* root) {
+  loader->queue = NULL;
+  parse_module(loader, root);
+  if(!loader->queue) return;
+
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  size_t workers = cores < 1 ? 0
+    : cores > MAX_WORKERS ? MAX_WORKERS - 1 : (size_t)cores - 1;
+
+  pthread_t threads[MAX_WORKERS];
+  size_t started = 0;
+  while(started < workers
+      && !pthread_create(&threads[started], NULL, work, loader))
+    started += 1;
+
+  work(loader);
+  for(size_t i = 0; i < started; i++) pthread_join(threads[i], NULL);
+}
+
+
+// includes before includers, and a cycle is cut where it closes. every
+// module is reached, so every module's expressions end up in the program's
+static void gather(struct AST* ast, struct Module* module) {
+  if(module->visited) return;
+  module->visited = true;
+
+  for(size_t i = 0; i < module->nincludes; i++)
+    gather(ast, module->includes[i]);
+  for(size_t i = 0; i < module->ast->size; i++)
+    APPEND_VECTOR(ast, module->ast->members[i]);
+  merge_nodes(&ast->nodes, &module->ast->nodes);
+}
+
+struct AST* load_program(const char* filename, int flags) {
+  struct Loader loader = { .queue = NULL, .pending = 0, .flags = flags,
+    .failed = false };
+  pthread_mutex_init(&loader.lock, NULL);
+  pthread_cond_init(&loader.wake, NULL);
+  hm_init(&loader.modules);
+  NEW_ARRAYLIST(&loader.all);
+
+  // a missing root is left for parse_file to report
+  const char* path = intern_cstr(filename);
+  const char* real = real_path(path);
+  struct Module* root = find_module(&loader, path, real ? real : path);
+
+  parse_all(&loader, root);
+
+  struct AST* ast = NULL;
+  if(!loader.failed) {
+    ast = new_ast();
+
+    gather(ast, root);
+  }
+
+  for(size_t i = 0; i < loader.all.size; i++) {
+    struct Module* module = loader.all.members[i];
+
+    if(module->ast) {
+      if(ast) {
+        arena_adopt(&ast->arena, &module->ast->arena);
+        free(module->ast);
+      } else free_ast(module->ast);
+    }
+
+    free(module->includes);
+    free(module);
+  }
+
+  free(loader.all.members);
+  hm_destroy(&loader.modules);
+  pthread_cond_destroy(&loader.wake);
+  pthread_mutex_destroy(&loader.lock);
+
+  return ast;
+}
+
+#undef MAX_WORKERS
@@ -0,0 +1,9 @@
+#pragma once
+
+#include "parser.h"
+
+// parses a file and everything it includes, on as many threads as there are
+// cores, into a single AST with every included file's declarations ahead of
+// its includer's. each file is parsed once however often it's included.
+// "std.io" names std/io.2c next to the including file
+struct AST* load_program(const char*, int);
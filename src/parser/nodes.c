@@ -0,0 +1,219 @@
+// nodes.c
+
+#include "nodes.h"
+#include "../util/panic.h"
+#include "../util/stats.h"
+
+void init_nodes(struct Nodes* nodes) {
+  nodes->size = 0;
+  nodes->capacity = 64;
+
+  nodes->tags = stats_malloc(nodes->capacity * sizeof(*nodes->tags));
+  nodes->ops = stats_malloc(nodes->capacity * sizeof(*nodes->ops));
+  nodes->offsets = stats_malloc(nodes->capacity * sizeof(*nodes->offsets));
+  nodes->data = stats_malloc(nodes->capacity * sizeof(*nodes->data));
+
+  nodes->extra_size = 0;
+  nodes->extra_capacity = 64;
+  nodes->extra = stats_malloc(nodes->extra_capacity * sizeof(*nodes->extra));
+
+  NEW_ARRAYLIST(&nodes->names);
+  NEW_ARRAYLIST(&nodes->types);
+  NEW_ARRAYLIST(&nodes->vars);
+  NEW_ARRAYLIST(&nodes->refs);
+
+  push_node(nodes, EXPR_LITERAL, 0, 0, 0, 0); // the missing node
+}
+
+void free_nodes(struct Nodes* nodes) {
+  free(nodes->tags);
+  free(nodes->ops);
+  free(nodes->offsets);
+  free(nodes->data);
+  free(nodes->extra);
+  free(nodes->names.members);
+  free(nodes->types.members);
+  free(nodes->vars.members);
+  free(nodes->refs.members);
+}
+
+
+void reserve_nodes(struct Nodes* nodes, size_t needed) {
+  if(needed <= nodes->capacity) return;
+  if(needed > UINT32_MAX) panic(1, "program is too large");
+
+  while(nodes->capacity < needed) nodes->capacity *= 2;
+  nodes->tags = stats_realloc(nodes->tags,
+      nodes->capacity * sizeof(*nodes->tags));
+  nodes->ops = stats_realloc(nodes->ops, nodes->capacity * sizeof(*nodes->ops));
+  nodes->offsets = stats_realloc(nodes->offsets,
+      nodes->capacity * sizeof(*nodes->offsets));
+  nodes->data = stats_realloc(nodes->data,
+      nodes->capacity * sizeof(*nodes->data));
+}
+
+void reserve_extra(struct Nodes* nodes, size_t needed) {
+  if(needed <= nodes->extra_capacity) return;
+  if(needed > UINT32_MAX) panic(1, "program is too large");
+
+  while(nodes->extra_capacity < needed) nodes->extra_capacity *= 2;
+  nodes->extra = stats_realloc(nodes->extra,
+      nodes->extra_capacity * sizeof(*nodes->extra));
+}
+
+uint32_t push_node(struct Nodes* nodes, enum ExprType type, uint8_t op,
+    uint32_t offset, uint32_t lhs, uint32_t rhs) {
+  reserve_nodes(nodes, nodes->size + 1);
+
+  nodes->tags[nodes->size] = type;
+  nodes->ops[nodes->size] = op;
+  nodes->offsets[nodes->size] = offset;
+  nodes->data[nodes->size] = (struct NodeData){ lhs, rhs };
+  return nodes->size++;
+}
+
+uint32_t push_extra(struct Nodes* nodes, const uint32_t* words, size_t size) {
+  reserve_extra(nodes, nodes->extra_size + size);
+
+  uint32_t at = nodes->extra_size;
+  memcpy(nodes->extra + at, words, size * sizeof(*words));
+  nodes->extra_size += size;
+  return at;
+}
+
+// a table's indices are 32 bits like every other in the nodes
+#define PUSH_TABLE(nodes, table, member) \
+  ({ \
+    if((nodes)->table.size >= UINT32_MAX) panic(1, "program is too large"); \
+    APPEND_ARRAYLIST(&(nodes)->table, member); \
+    (uint32_t)((nodes)->table.size - 1); \
+  })
+
+uint32_t push_name(struct Nodes* nodes, const char* name) {
+  return PUSH_TABLE(nodes, names, name);
+}
+
+uint32_t push_type(struct Nodes* nodes, struct Type* type) {
+  return PUSH_TABLE(nodes, types, type);
+}
+
+uint32_t push_var(struct Nodes* nodes, struct Variable* var) {
+  return PUSH_TABLE(nodes, vars, var);
+}
+
+#undef PUSH_TABLE
+
+void refer_node(struct Nodes* nodes, uint32_t* ref) {
+  APPEND_ARRAYLIST(&nodes->refs, ref);
+}
+
+
+// the first node of the second is the missing one, which isn't copied, so
+// the rest of them move down by one
+static uint32_t moved(uint32_t node, size_t base) {
+  return node ? node + base - 1 : 0;
+}
+
+static void move_statements(uint32_t* words, size_t count, size_t base,
+    size_t vars) {
+  for(size_t i = 0; i < count; i++) {
+    uint32_t* index = &words[2 * i + 1];
+    if(words[2 * i] == STMT_VAR) *index += vars;
+    else *index = moved(*index, base);
+  }
+}
+
+static void move_list(uint32_t* words, size_t base) {
+  for(size_t i = 0; i < words[0]; i++)
+    words[1 + i] = moved(words[1 + i], base);
+}
+
+// every node's children are moved by the number of nodes already in the
+// first, and what they index in extra and the tables by the size of its
+void merge_nodes(struct Nodes* into, struct Nodes* from) {
+  size_t base = into->size, extra = into->extra_size;
+  size_t names = into->names.size, types = into->types.size;
+  size_t vars = into->vars.size;
+  size_t count = from->size - 1;
+
+  reserve_nodes(into, base + count);
+  memcpy(into->tags + base, from->tags + 1, count * sizeof(*into->tags));
+  memcpy(into->ops + base, from->ops + 1, count * sizeof(*into->ops));
+  memcpy(into->offsets + base, from->offsets + 1,
+      count * sizeof(*into->offsets));
+  memcpy(into->data + base, from->data + 1, count * sizeof(*into->data));
+  into->size += count;
+
+  push_extra(into, from->extra, from->extra_size);
+  for(size_t i = 0; i < from->names.size; i++)
+    push_name(into, from->names.members[i]);
+  for(size_t i = 0; i < from->types.size; i++)
+    push_type(into, from->types.members[i]);
+  for(size_t i = 0; i < from->vars.size; i++)
+    push_var(into, from->vars.members[i]);
+
+  for(size_t i = base; i < into->size; i++) {
+    struct NodeData* data = &into->data[i];
+
+    switch((enum ExprType)into->tags[i]) {
+      case EXPR_LITERAL: break;
+      case EXPR_VARIABLE:
+        data->rhs += names;
+        break;
+      case EXPR_UNARY:
+      case EXPR_GROUP:
+        data->lhs = moved(data->lhs, base);
+        break;
+      case EXPR_BINARY:
+      case EXPR_ASSIGN:
+      case EXPR_ARRAY_INDEX:
+        data->lhs = moved(data->lhs, base);
+        data->rhs = moved(data->rhs, base);
+        break;
+      case EXPR_CALL:
+        data->lhs = moved(data->lhs, base);
+        data->rhs += extra;
+        move_list(&into->extra[data->rhs], base);
+        break;
+      case EXPR_ARRAY_INIT:
+        data->lhs += extra;
+        move_list(&into->extra[data->lhs], base);
+        break;
+      case EXPR_FIELD:
+        data->lhs = moved(data->lhs, base);
+        data->rhs += names;
+        break;
+      case EXPR_CAST:
+        data->lhs = moved(data->lhs, base);
+        data->rhs += types;
+        break;
+      case EXPR_BLOCK:
+        move_statements(&into->extra[extra + data->lhs + 1],
+            into->extra[extra + data->lhs], base, vars);
+        data->lhs += extra;
+        data->rhs = moved(data->rhs, base);
+        break;
+      case EXPR_IF:
+      case EXPR_WHILE:
+        data->lhs = moved(data->lhs, base);
+        data->rhs += extra;
+        into->extra[data->rhs] = moved(into->extra[data->rhs], base);
+        into->extra[data->rhs + 1] = moved(into->extra[data->rhs + 1], base);
+        break;
+      case EXPR_FOR:
+        data->lhs += extra;
+        move_statements(&into->extra[data->lhs], 1, base, vars);
+        into->extra[data->lhs + 2] = moved(into->extra[data->lhs + 2], base);
+        into->extra[data->lhs + 3] = moved(into->extra[data->lhs + 3], base);
+        data->rhs = moved(data->rhs, base);
+        break;
+    }
+  }
+
+  for(size_t i = 0; i < from->refs.size; i++) {
+    *from->refs.members[i] = moved(*from->refs.members[i], base);
+    APPEND_ARRAYLIST(&into->refs, from->refs.members[i]);
+  }
+
+  free_nodes(from);
+}
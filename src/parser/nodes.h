@@ -0,0 +1,91 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include "../util/arraylist.h"
+
+// the expressions of an ast, as columns: a node is an index into every one
+// of them, and so are its children, which always come before it. index 0 is
+// never a node and stands for a missing one. what lhs and rhs hold depends
+// on the tag, and whatever doesn't fit in them is in extra, which they then
+// index:
+//
+//   LITERAL      op the value's type, lhs and rhs the halves of its payload
+//   VARIABLE     op the depth, lhs the slot, rhs its name in names
+//   UNARY        op, lhs the operand
+//   BINARY       op, lhs and rhs the operands, as with ASSIGN
+//   GROUP        lhs the expression
+//   CALL         lhs the callee, rhs its arguments
+//   FIELD        lhs the parent, rhs the field's name in names
+//   ARRAY_INDEX  lhs the array, rhs the index
+//   ARRAY_INIT   lhs its elements
+//   CAST         lhs the expression, rhs the type in types
+//   BLOCK        lhs the statements, rhs the trailing expression
+//   IF, WHILE    lhs the condition, rhs the body and the else clause
+//   FOR          lhs the init, the condition and the step, rhs the body
+//
+// the arguments and elements are their count and then the nodes. a block's
+// statements are their count and then two words apiece: the kind, and a
+// node or the variable's index in vars. the init of a for loop is a
+// statement too
+enum ExprType {
+  EXPR_LITERAL, EXPR_UNARY, EXPR_BINARY, EXPR_GROUP, EXPR_CALL, EXPR_FIELD,
+  EXPR_ARRAY_INDEX, EXPR_ARRAY_INIT, EXPR_CAST,
+  EXPR_ASSIGN, EXPR_BLOCK, EXPR_IF, EXPR_WHILE, EXPR_FOR,
+  EXPR_VARIABLE
+};
+
+enum StatementType { STMT_EXPR, STMT_BLOCK, STMT_VAR };
+
+struct NodeData {
+  uint32_t lhs, rhs;
+};
+
+// nodes held outside of the columns, by declarations and types, which have
+// to be moved along when one ast's nodes are appended to another's
+DEFINE_ARRAYLIST(NodeRefs, uint32_t*);
+
+struct Type;
+struct Variable;
+
+// what the nodes name or declare, which they index like they do extra
+DEFINE_ARRAYLIST(NodeNames, const char*);
+DEFINE_ARRAYLIST(NodeTypes, struct Type*);
+DEFINE_ARRAYLIST(NodeVars, struct Variable*);
+
+struct Nodes {
+  uint8_t* tags;
+  uint8_t* ops;
+  uint32_t* offsets; // into its file, of the token it was parsed at
+  struct NodeData* data;
+  size_t size;
+  size_t capacity;
+
+  uint32_t* extra;
+  size_t extra_size;
+  size_t extra_capacity;
+
+  struct NodeNames names;
+  struct NodeTypes types;
+  struct NodeVars vars;
+
+  struct NodeRefs refs;
+};
+
+void init_nodes(struct Nodes*);
+void free_nodes(struct Nodes*);
+
+// room for at least that many nodes, or words of extra, in all
+void reserve_nodes(struct Nodes*, size_t);
+void reserve_extra(struct Nodes*, size_t);
+
+uint32_t push_node(struct Nodes*, enum ExprType, uint8_t, uint32_t,
+    uint32_t, uint32_t);
+uint32_t push_extra(struct Nodes*, const uint32_t*, size_t);
+uint32_t push_name(struct Nodes*, const char*);
+uint32_t push_type(struct Nodes*, struct Type*);
+uint32_t push_var(struct Nodes*, struct Variable*);
+void refer_node(struct Nodes*, uint32_t*);
+
+// moves every node of the second into the first, and frees the second
+void merge_nodes(struct Nodes*, struct Nodes*);
@@ -1,9 +1,15 @@
 // parser.c
 
+#include <stdarg.h>
+#include "../util/hash.h"
+#include "../util/lines.h"
 #include "../util/readfile.h"
+#include "../util/stats.h"
+#include "../util/trace.h"
 #include "../util/textcolor.h"
 #include "declaration.h"
 #include "expression.h"
+#include "image.h"
 #include "parser.h"
 
 const char* error_strings[ERROR_FINAL] = {
@@ -35,26 +41,32 @@ const char* error_strings[ERROR_FINAL] = {
   "expected ']'",
   "expected assignment",
   "expected a string",
+
+  "no such file to include",
+  "undefined variable",
+  "array size isn't a compile-time constant",
+  "function is already defined",
 };
 
+// files can be parsed on several threads, so whatever a parser prints holds
+// stdout until it's done
 void print_error(struct Parser* ctx, enum ParseErrorType type) {
   ctx->is_panic = true; ctx->did_panic = true;
+  flockfile(stdout);
+  // the error is reported at the previous token, like its text is
+  update_location(ctx, ctx->tokens.offsets[ctx->cursor ? ctx->cursor - 1 : 0]);
 
-  set_color(COLATTR_BRIGHT, ERR_ERR_COLOR, COL_DEFAULT);
-  printf("error");
-  reset_color();
-
-  printf(" @ ");
-  set_color(COLATTR_BRIGHT, ERR_LOC_COLOR, COL_DEFAULT);
-  printf("%s:(%zu, %zu)", ctx->filename, ctx->row, ctx->col);
-  reset_color();
+  print_error_place("%s:(%zu, %zu)", ctx->filename, ctx->row, ctx->col);
 
   if(ctx->previous.type >= TOKEN_IDENTIFIER_LIT
       && ctx->previous.type <= TOKEN_BOOL_LIT) {
     printf(" at literal ");
     switch(ctx->previous.type) {
       case TOKEN_IDENTIFIER_LIT:
-      case TOKEN_STRING_LIT: printf("\"%s\"", ctx->previous.as.string);   break;
+      case TOKEN_STRING_LIT:
+        printf("\"%.*s\"", (int)ctx->previous.as.slice.len,
+            ctx->source + ctx->previous.as.slice.offset);
+        break;
       case TOKEN_INT_LIT:    printf("%zd",    ctx->previous.as.integer);  break;
       case TOKEN_FLOAT_LIT:  printf("%f",     ctx->previous.as.floating); break;
       case TOKEN_CHAR_LIT:   printf("'%c'",   ctx->previous.as.character);break;
@@ -64,70 +76,225 @@ void print_error(struct Parser* ctx, enum ParseErrorType type) {
     printf("\n");
   } else printf(" at token \"%s\"\n ", TOKEN_STR(&ctx->previous));
 
+  print_error_message(PARSE_ERROR_CODES + type, error_strings[type]);
+  funlockfile(stdout);
+}
+
+void print_error_place(const char* format, ...) {
   set_color(COLATTR_BRIGHT, ERR_ERR_COLOR, COL_DEFAULT);
-  printf("  %03d", type);
+  printf("error");
+  reset_color();
+
+  printf(" @ ");
+  set_color(COLATTR_BRIGHT, ERR_LOC_COLOR, COL_DEFAULT);
+  va_list args;
+  va_start(args, format);
+  vprintf(format, args);
+  va_end(args);
   reset_color();
-  printf(": %s\n", error_strings[type]);
+}
+
+void print_error_message(int code, const char* message) {
+  set_color(COLATTR_BRIGHT, ERR_ERR_COLOR, COL_DEFAULT);
+  printf("  %03d", code);
+  reset_color();
+  printf(": %s\n", message);
+}
+
+// the file is only read again, and its lines counted, once there's an error
+static bool place_of(const char* file, uint32_t offset,
+    size_t* row, size_t* col) {
+  struct LineMap map;
+  if(!open_lines(&map, file)) return false;
+
+  *row = line_of(&map, offset);
+  *col = offset - map.starts[*row];
+  close_lines(&map);
+  return true;
+}
+
+void print_error_at(const char* file, uint32_t offset) {
+  size_t row, col;
+  if(place_of(file, offset, &row, &col))
+    print_error_place("%s:(%zu, %zu)", file, row, col);
+  else print_error_place("%s", file);
+}
+
+void print_error_also(const char* what, const char* file, uint32_t offset) {
+  printf("  %s @ ", what);
+  set_color(COLATTR_BRIGHT, ERR_LOC_COLOR, COL_DEFAULT);
+  size_t row, col;
+  if(place_of(file, offset, &row, &col))
+    printf("%s:(%zu, %zu)", file, row, col);
+  else printf("%s", file);
+  reset_color();
+  printf("\n");
 }
 
 static void print_ast(const struct AST* ast) {
+  flockfile(stdout);
   for(size_t i = 0; i < ast->size; i++) {
-    print_declaration(ast->members[i]);
+    print_declaration(&ast->nodes, ast->members[i]);
     printf("\n");
   }
+  funlockfile(stdout);
 }
 
-static void print_token(struct Parser* parser) {
-  if(parser->current.type == TOKEN_EOF) return;
+static void print_token(struct Parser* parser, const struct Token* token,
+    size_t offset) {
+  update_location(parser, offset);
 
   printf("%24s %02u (%02zu, %02zu) | ",
-    TOKEN_STR(&parser->current), parser->current.type,
-    parser->row, parser->col);
+    TOKEN_STR(token), token->type, parser->row, parser->col);
 
-  switch(parser->current.type) {
+  switch(token->type) {
     case TOKEN_IDENTIFIER_LIT:
-    case TOKEN_STRING_LIT: printf("\"%s\"",parser->current.as.string);   break;
-    case TOKEN_INT_LIT:    printf("%zd",   parser->current.as.integer);  break;
-    case TOKEN_FLOAT_LIT:  printf("%f",    parser->current.as.floating); break;
-    case TOKEN_CHAR_LIT:   printf("'%c'",  parser->current.as.character);break;
-    case TOKEN_BOOL_LIT:   printf("%d",    parser->current.as.boolean);  break;
+    case TOKEN_STRING_LIT:
+      printf("\"%.*s\"", (int)token->as.slice.len,
+          parser->source + token->as.slice.offset);
+      break;
+    case TOKEN_INT_LIT:    printf("%zd",   token->as.integer);  break;
+    case TOKEN_FLOAT_LIT:  printf("%f",    token->as.floating); break;
+    case TOKEN_CHAR_LIT:   printf("'%c'",  token->as.character);break;
+    case TOKEN_BOOL_LIT:   printf("%d",    token->as.boolean);  break;
     default: break;
   }
   printf("\n");
 }
 
 static void print_tokens(struct Parser* parser) {
-  while((parser->current = lex_token(parser)).type != TOKEN_EOF)
-    print_token(parser);
+  flockfile(stdout);
+  for(size_t i = 0; i + 1 < parser->tokens.size; i++) {
+    struct Token token = token_at(&parser->tokens, i);
+    print_token(parser, &token, parser->tokens.offsets[i]);
+  }
+  funlockfile(stdout);
 }
 
-struct AST* parse_file(const char* filename, int flags) {
+// what a declaration's span in a --trace is labelled with
+static const char* declaration_name(const struct Declaration* decl) {
+  switch(decl->type) {
+    case DECL_VAR:    return "let";
+    case DECL_STRUCT: return decl->as._struct->name;
+    case DECL_UNION:  return decl->as._union->name;
+    case DECL_FUNC:   return decl->as.function->sig->name;
+    case DECL_INC:    return decl->as.include;
+  }
+  return NULL;
+}
+
+// after a declaration that failed, on to the next one that could start, so
+// a token no declaration starts with isn't tried forever. let also starts
+// statements, so only the other declarations are looked for
+static void synchronize(struct Parser* parser) {
+  while(parser->current.type != TOKEN_EOF
+      && parser->current.type != TOKEN_FUNCTION
+      && parser->current.type != TOKEN_STRUCT
+      && parser->current.type != TOKEN_UNION
+      && parser->current.type != TOKEN_INCLUDE) {
+    parser->previous = parser->current;
+    parser->current = next_token(parser);
+  }
+}
+
+static struct AST* read_and_parse(const char* filename, int flags) {
   struct Parser parser;
   parser.filename = filename;
   parser.col = 0; parser.row = 0;
-  parser.is_panic = false;
+  parser.is_panic = false; parser.did_panic = false;
   parser.flags = flags;
 
-  const char* program = read_file(filename);
-  parser.program_index = program;
+  enum Phase phase = stats_enter(PHASE_READ);
+  struct Source source = read_file(filename);
+  stats_leave(phase);
 
-  struct AST* ast = malloc(sizeof(*ast));
-  NEW_ARRAYLIST(ast);
+  // an image has no tokens to print
+  bool cached = !HAS_FLAG(flags, FLAG_NO_CACHE) && !HAS_FLAG(flags, FLAG_LEX);
+  uint64_t hash = 0;
+  struct AST* image = NULL;
 
-  if(HAS_FLAG(parser.flags, FLAG_LEX)) {
-    print_tokens(&parser);
-    parser.program_index = program;
+  if(cached) {
+    phase = stats_enter(PHASE_IMAGE);
+    hash = hash_bytes((const uint8_t*)source.text, source.size);
+    image = load_image(filename, hash);
+    stats_leave(phase);
   }
 
-  parser.current = lex_token(&parser);
+  if(image) {
+    close_file(&source);
+    if(HAS_FLAG(flags, FLAG_AST)) print_ast(image);
+    return image;
+  }
+
+  parser.source = source.text;
+  parser.located = source.text;
+  parser.program_index = source.text;
+
+  struct AST* ast = new_ast();
+  parser.arena = &ast->arena;
+  parser.nodes = &ast->nodes;
+  NEW_VECTOR(&parser.pending);
+  NEW_VECTOR(&parser.decls);
+  NEW_VECTOR(&parser.types);
+
+  phase = stats_enter(PHASE_LEX);
+  tokenize(&parser, source.size);
+  stats_leave(phase);
+  if(HAS_FLAG(parser.flags, FLAG_LEX)) print_tokens(&parser);
+
+  phase = stats_enter(PHASE_PARSE);
+  parser.cursor = 0;
+  parser.current = token_at(&parser.tokens, 0);
   while(!MATCH_TOKEN(&parser, EOF)) {
-    APPEND_ARRAYLIST(ast, parse_declaration(&parser));
+    uint64_t start = trace_begin();
+    struct Declaration* decl = parse_declaration(&parser);
+    trace_end("parse_declaration",
+        parser.did_panic ? NULL : declaration_name(decl), start);
+
+    APPEND_VECTOR(ast, decl);
+    if(parser.is_panic) synchronize(&parser);
   }
+  stats_leave(phase);
 
-  free((char*)program);
+  free_tokens(&parser.tokens);
+  FREE_VECTOR(&parser.pending);
+  FREE_VECTOR(&parser.decls);
+  FREE_VECTOR(&parser.types);
+  close_file(&source);
 
   if(HAS_FLAG(parser.flags, FLAG_AST)) print_ast(ast);
 
-  if(!parser.did_panic) return ast;
-  else return NULL;
+  if(!parser.did_panic) {
+    if(cached) {
+      phase = stats_enter(PHASE_IMAGE);
+      save_image(filename, hash, ast);
+      stats_leave(phase);
+    }
+    return ast;
+  }
+
+  free_ast(ast);
+  return NULL;
+}
+
+struct AST* parse_file(const char* filename, int flags) {
+  uint64_t start = trace_begin();
+  struct AST* ast = read_and_parse(filename, flags);
+  trace_end("parse_file", filename, start);
+  return ast;
+}
+
+struct AST* new_ast(void) {
+  struct AST* ast = stats_malloc(sizeof(*ast));
+  arena_init(&ast->arena);
+  NEW_ARENA_VECTOR(ast, &ast->arena);
+  ast->globals = 0;
+  init_nodes(&ast->nodes);
+  return ast;
+}
+
+void free_ast(struct AST* ast) {
+  arena_destroy(&ast->arena);
+  free_nodes(&ast->nodes);
+  free(ast);
 }
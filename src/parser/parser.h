@@ -3,13 +3,23 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include "../debug.h"
-#include "../util/arraylist.h"
+#include "../util/arena.h"
+#include "../util/vector.h"
+#include "nodes.h"
 
 struct Parser;
 
 #include "lexer.h"
 
-DEFINE_ARRAYLIST(AST, struct Declaration*);
+// the declarations of a file, the arena everything under them lives in, and
+// the expressions, which live in columns of their own. the declarations are
+// a vector pooled in the arena
+struct AST {
+  VECTOR_FIELDS(struct Declaration*, 0);
+  size_t globals; // number of toplevel variables, set by the resolver
+  struct Arena arena;
+  struct Nodes nodes;
+};
 
 #define ERR_LOC_COLOR  COL_BLUE
 #define ERR_ERR_COLOR  COL_RED
@@ -45,12 +55,49 @@ enum ParseErrorType {
   ERROR_EXPECTED_ASSIGN,
   ERROR_EXPECTED_STRING,
 
+  ERROR_NO_SUCH_INCLUDE,
+  ERROR_UNDEFINED_VARIABLE,
+  ERROR_NOT_CONSTANT,
+  ERROR_REDEFINED_FUNCTION,
+
   ERROR_FINAL,
 };
 
+extern const char* error_strings[ERROR_FINAL];
+
+// a variable as declared in a list, a statement or a global. here rather
+// than with the lists because the parser keeps them in room of its own
+struct LValue {
+  const char* name;
+  struct Type* type;
+  size_t slot; // set by the resolver
+};
+
+struct VarDecl {
+  struct LValue lvalue;
+  uint32_t rvalue; // 0 without one
+};
+
+// with room for what all but the longest blocks and lists need. a parser's
+// stacks are in it, so it's never copied
+DEFINE_VECTOR(NodeWords, uint32_t, 64);
+DEFINE_VECTOR(PendingDecls, struct VarDecl, 16);
+DEFINE_VECTOR(PendingTypes, struct Type*, 16);
+
 struct Parser {
   const char* filename;
+  const char* source; // start of the file, which token slices are relative to
   const char* program_index;
+  struct Arena* arena;
+  struct Nodes* nodes;
+  // what the blocks, calls and lists still being parsed have so far, each
+  // from where it started. they're copied out whole once closed
+  struct NodeWords pending;
+  struct PendingDecls decls;
+  struct PendingTypes types;
+  struct TokenBuffer tokens;
+  size_t cursor; // index of current
+  const char* located; // row and col are only brought up to here on demand
   size_t row, col;
   int flags;
   struct Token previous, current;
@@ -58,23 +105,58 @@ struct Parser {
 };
 
 
+// the last token is always EOF, and reading past it keeps returning it
+static inline struct Token next_token(struct Parser* parser) {
+  if(parser->cursor + 1 < parser->tokens.size) parser->cursor += 1;
+  return token_at(&parser->tokens, parser->cursor);
+}
+
 void print_error(struct Parser*, enum ParseErrorType);
+
+// what every error is printed as, for the passes that report their own:
+// "error @ " and the place, then what it was at, then the code and message
+__attribute__((format(printf, 1, 2)))
+void print_error_place(const char*, ...);
+void print_error_message(int, const char*);
+
+// the place of a node in its file, as "file:(row, col)" like the parser's,
+// from the offset the node keeps
+void print_error_at(const char*, uint32_t);
+// another place the error concerns, like where a name was first defined,
+// printed after the message as "  what @ file:(row, col)"
+void print_error_also(const char*, const char*, uint32_t);
+
+// where each enum of errors starts its codes, so no two errors share one.
+// the resolver and comptime report theirs as parse errors
+#define PARSE_ERROR_CODES   0
+#define COMPILE_ERROR_CODES 100
+#define IR_ERROR_CODES      200
+struct AST* new_ast(void);
 struct AST* parse_file(const char*, int);
+void free_ast(struct AST*);
+
+#define ERROR_VALUE(parser, error, none) \
+  ({ if(!(parser)->is_panic) print_error(parser, error); none; })
 
-#define RETURN_ERROR(parser, error) \
-  ({ if(!(parser)->is_panic) print_error(parser, error); NULL; })
+#define RETURN_ERROR(parser, error) ERROR_VALUE(parser, error, NULL)
+#define RETURN_NODE_ERROR(parser, error) ERROR_VALUE(parser, error, 0)
 
 #define MATCH_TOKEN(parser, _type) \
   ((parser)->current.type == (TOKEN_##_type) ? \
    ({ (parser)->previous = (parser)->current; \
-    (parser)->current = lex_token(parser); true; }) : false)
+    (parser)->current = next_token(parser); true; }) : false)
 
-#define EXPECT_TOKEN(parser, _type, error) do { \
+#define EXPECT_OR(parser, _type, error, none) do { \
   if(MATCH_TOKEN(parser, ERROR)) \
-    return RETURN_ERROR(parser, (parser)->current.as.integer); \
+    return ERROR_VALUE(parser, (parser)->current.as.integer, none); \
   if(!MATCH_TOKEN(parser, _type)) \
-    return RETURN_ERROR(parser, ERROR_##error); \
+    return ERROR_VALUE(parser, ERROR_##error, none); \
   } while(0)
 
+#define EXPECT_TOKEN(parser, _type, error) \
+  EXPECT_OR(parser, _type, error, NULL)
+#define EXPECT_NODE_TOKEN(parser, _type, error) \
+  EXPECT_OR(parser, _type, error, 0)
+
 #define PRINT_INDENT(indent) \
   for(size_t jfkdla = 0; jfkdla < (indent); jfkdla++) printf("  ");
@@ -0,0 +1,243 @@
+// resolver.c
+
+#include "resolver.h"
+#include "declaration.h"
+#include "expression.h"
+#include <stdio.h>
+
+// slots are handed out stack-wise: a block's locals are released when it
+// ends, so sibling blocks share slots and a frame is only as large as its
+// deepest nesting
+
+struct Binding {
+  const char* name;
+  size_t slot;
+};
+
+DEFINE_ARRAYLIST(Bindings, struct Binding);
+
+struct Resolver {
+  struct Nodes* nodes;
+  struct Bindings locals, globals;
+  const char* file; // of the declaration being resolved
+  size_t next_slot;
+  size_t slots;
+  bool had_error;
+};
+
+
+static void resolve_error(struct Resolver* r, uint32_t ast, const char* name) {
+  r->had_error = true;
+
+  print_error_at(r->file, r->nodes->offsets[ast]);
+  printf(" at \"%s\"\n", name);
+  print_error_message(PARSE_ERROR_CODES + ERROR_UNDEFINED_VARIABLE,
+      error_strings[ERROR_UNDEFINED_VARIABLE]);
+}
+
+
+static size_t declare(struct Bindings* scope, const char* name, size_t slot) {
+  struct Binding binding = { .name = name, .slot = slot };
+  APPEND_ARRAYLIST(scope, binding);
+  return slot;
+}
+
+static size_t declare_local(struct Resolver* r, const char* name) {
+  size_t slot = declare(&r->locals, name, r->next_slot++);
+  if(r->next_slot > r->slots) r->slots = r->next_slot;
+  return slot;
+}
+
+// names are interned, so the innermost binding is found by pointer
+static const struct Binding* lookup(const struct Bindings* scope,
+    const char* name) {
+  for(size_t i = scope->size; i > 0; i--)
+    if(scope->members[i - 1].name == name) return &scope->members[i - 1];
+
+  return NULL;
+}
+
+
+static void resolve_expression(struct Resolver*, uint32_t);
+static void resolve_block(struct Resolver*, uint32_t);
+static void resolve_for(struct Resolver*, const struct ForLoop*);
+
+// the name moves into the table of names, as the node's payload becomes
+// the slot
+static void resolve_identifier(struct Resolver* r, uint32_t ast) {
+  const char* name = literal_of(r->nodes, ast).as.string;
+  const struct Binding* binding;
+  size_t depth;
+
+  if((binding = lookup(&r->locals, name))) depth = 0;
+  else if((binding = lookup(&r->globals, name))) depth = 1;
+  else {
+    resolve_error(r, ast, name);
+    return;
+  }
+
+  uint32_t at = push_name(r->nodes, name);
+  r->nodes->tags[ast] = EXPR_VARIABLE;
+  r->nodes->ops[ast] = depth;
+  r->nodes->data[ast] = (struct NodeData){ binding->slot, at };
+}
+
+// the arguments of a call or the elements of an array
+static void resolve_list(struct Resolver* r, uint32_t at) {
+  struct ExprList list = list_at(r->nodes, at);
+  for(size_t i = 0; i < list.size; i++)
+    resolve_expression(r, list_member(r->nodes, &list, i));
+}
+
+static void resolve_expression(struct Resolver* r, uint32_t ast) {
+  if(!ast) return;
+
+  const struct Nodes* nodes = r->nodes;
+  struct NodeData data = nodes->data[ast];
+
+  switch((enum ExprType)nodes->tags[ast]) {
+    case EXPR_LITERAL:
+      if(is_identifier(nodes, ast)) resolve_identifier(r, ast);
+      break;
+    case EXPR_UNARY:
+    case EXPR_GROUP:
+    case EXPR_FIELD:
+    case EXPR_CAST:
+      resolve_expression(r, data.lhs);
+      break;
+    case EXPR_ARRAY_INIT:
+      resolve_list(r, data.lhs);
+      break;
+    case EXPR_BINARY:
+    case EXPR_ASSIGN:
+    case EXPR_ARRAY_INDEX:
+      resolve_expression(r, data.lhs);
+      resolve_expression(r, data.rhs);
+      break;
+    case EXPR_CALL:
+      // functions are called by name, so a plain callee is left alone
+      if(nodes->tags[data.lhs] != EXPR_LITERAL)
+        resolve_expression(r, data.lhs);
+      resolve_list(r, data.rhs);
+      break;
+    case EXPR_BLOCK:
+      resolve_block(r, ast);
+      break;
+    case EXPR_IF:
+    case EXPR_WHILE: {
+      struct IfWhile ifwhile = ifwhile_of(nodes, ast);
+      resolve_expression(r, ifwhile.condition);
+      resolve_expression(r, ifwhile.body);
+      resolve_expression(r, ifwhile.else_clause);
+      break;
+    }
+    case EXPR_FOR: {
+      struct ForLoop loop = forloop_of(nodes, ast);
+      resolve_for(r, &loop);
+      break;
+    }
+    case EXPR_VARIABLE:
+      break;
+  }
+}
+
+
+static void resolve_variable(struct Resolver* r, struct Variable* ast) {
+  for(size_t i = 0; i < ast->vars->size; i++) {
+    struct VarDecl* var = &ast->vars->members[i];
+
+    // declared afterwards so that the initializer still sees a shadowed name
+    resolve_expression(r, var->rvalue);
+    var->lvalue.slot = declare_local(r, var->lvalue.name);
+  }
+}
+
+static void resolve_statement(struct Resolver* r,
+    const struct Statement* ast) {
+  switch(ast->type) {
+    case STMT_EXPR:  resolve_expression(r, ast->as.expr); break;
+    case STMT_BLOCK: resolve_block(r, ast->as.block);     break;
+    case STMT_VAR:   resolve_variable(r, ast->as.var);    break;
+  }
+}
+
+static void resolve_block(struct Resolver* r, uint32_t ast) {
+  size_t locals = r->locals.size, next_slot = r->next_slot;
+  struct Block block = block_of(r->nodes, ast);
+
+  for(size_t i = 0; i < block.size; i++) {
+    struct Statement stmt = block_statement(r->nodes, &block, i);
+    resolve_statement(r, &stmt);
+  }
+
+  resolve_expression(r, block.expr);
+
+  r->locals.size = locals;
+  r->next_slot = next_slot;
+}
+
+// the loop variable goes out of scope with the loop
+static void resolve_for(struct Resolver* r, const struct ForLoop* ast) {
+  size_t locals = r->locals.size, next_slot = r->next_slot;
+
+  resolve_statement(r, &ast->init);
+  resolve_expression(r, ast->condition);
+  resolve_expression(r, ast->step);
+  resolve_expression(r, ast->body);
+
+  r->locals.size = locals;
+  r->next_slot = next_slot;
+}
+
+
+// the arguments take the first slots, in order
+static void resolve_function(struct Resolver* r, struct Function* ast) {
+  r->locals.size = 0;
+  r->next_slot = 0;
+  r->slots = 0;
+
+  struct VarDeclList* args = ast->sig->args;
+  for(size_t i = 0; i < count_vardecls(args); i++)
+    args->members[i].lvalue.slot =
+      declare_local(r, args->members[i].lvalue.name);
+
+  resolve_block(r, ast->body);
+  ast->slots = r->slots;
+}
+
+static void resolve_globals(struct Resolver* r, struct Variable* ast) {
+  for(size_t i = 0; i < ast->vars->size; i++) {
+    struct VarDecl* var = &ast->vars->members[i];
+
+    resolve_expression(r, var->rvalue);
+    var->lvalue.slot = declare(&r->globals, var->lvalue.name, r->globals.size);
+  }
+}
+
+bool resolve_ast(struct AST* ast) {
+  struct Resolver resolver = {
+    .nodes = &ast->nodes, .file = NULL, .had_error = false,
+  };
+  NEW_ARRAYLIST(&resolver.locals);
+  NEW_ARRAYLIST(&resolver.globals);
+
+  // every global is visible to every function, whichever comes first
+  for(size_t i = 0; i < ast->size; i++)
+    if(ast->members[i]->type == DECL_VAR) {
+      resolver.file = ast->members[i]->file;
+      resolve_globals(&resolver, ast->members[i]->as.var);
+    }
+
+  for(size_t i = 0; i < ast->size; i++)
+    if(ast->members[i]->type == DECL_FUNC) {
+      resolver.file = ast->members[i]->file;
+      resolve_function(&resolver, ast->members[i]->as.function);
+    }
+
+  ast->globals = resolver.globals.size;
+
+  free(resolver.locals.members);
+  free(resolver.globals.members);
+
+  return !resolver.had_error;
+}
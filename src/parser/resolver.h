@@ -0,0 +1,7 @@
+#pragma once
+
+#include "parser.h"
+
+// binds every identifier in the tree to a frame slot, so the backends never
+// look variables up by name. returns false if any identifier is undefined
+bool resolve_ast(struct AST*);
@@ -0,0 +1,167 @@
+// scan.c
+
+#include "scan.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __SSE2__
+
+#include <immintrin.h>
+
+// each kernel builds a mask of the bytes that belong to the run, 16 or 32 at
+// a time, and stops at the first clear bit
+
+#define SPLAT(c) _mm_set1_epi8(c)
+
+static const char* skip_blanks_sse2(const char* p) {
+  for(;; p += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i*)p);
+    __m128i blank = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(v, SPLAT(' ')),
+          _mm_cmpeq_epi8(v, SPLAT('\n'))),
+        _mm_or_si128(_mm_cmpeq_epi8(v, SPLAT('\t')),
+          _mm_cmpeq_epi8(v, SPLAT('\r'))));
+
+    unsigned mask = ~_mm_movemask_epi8(blank) & 0xffff;
+    if(mask) return p + __builtin_ctz(mask);
+  }
+}
+
+static const char* skip_to_newline_sse2(const char* p) {
+  for(;; p += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i*)p);
+    __m128i end = _mm_or_si128(_mm_cmpeq_epi8(v, SPLAT('\n')),
+        _mm_cmpeq_epi8(v, _mm_setzero_si128()));
+
+    unsigned mask = _mm_movemask_epi8(end);
+    if(mask) return p + __builtin_ctz(mask);
+  }
+}
+
+// sse2 only has signed compares, so x - lo <u n is tested as
+// (x - lo) ^ 0x80 <s n ^ 0x80
+static inline __m128i in_range(__m128i v, char lo, char n) {
+  __m128i biased = _mm_xor_si128(_mm_sub_epi8(v, SPLAT(lo)), SPLAT(0x80));
+  return _mm_cmplt_epi8(biased, SPLAT((char)(n ^ 0x80)));
+}
+
+static const char* skip_identifier_sse2(const char* p) {
+  for(;; p += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i*)p);
+    __m128i letter = in_range(_mm_or_si128(v, SPLAT(0x20)), 'a', 26);
+    __m128i digit = in_range(v, '0', 10);
+    __m128i under = _mm_cmpeq_epi8(v, SPLAT('_'));
+
+    __m128i ident = _mm_or_si128(_mm_or_si128(letter, digit), under);
+    unsigned mask = ~_mm_movemask_epi8(ident) & 0xffff;
+    if(mask) return p + __builtin_ctz(mask);
+  }
+}
+
+#undef SPLAT
+
+#ifdef __x86_64__
+
+// the same kernels 32 bytes at a time, built for avx2 whatever the rest of
+// the program is built for, and only called on cpus that have it
+
+#define AVX2 __attribute__((target("avx2")))
+#define SPLAT(c) _mm256_set1_epi8(c)
+
+AVX2 static const char* skip_blanks_avx2(const char* p) {
+  for(;; p += 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i*)p);
+    __m256i blank = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(v, SPLAT(' ')),
+          _mm256_cmpeq_epi8(v, SPLAT('\n'))),
+        _mm256_or_si256(_mm256_cmpeq_epi8(v, SPLAT('\t')),
+          _mm256_cmpeq_epi8(v, SPLAT('\r'))));
+
+    uint32_t mask = ~(uint32_t)_mm256_movemask_epi8(blank);
+    if(mask) return p + __builtin_ctz(mask);
+  }
+}
+
+AVX2 static const char* skip_to_newline_avx2(const char* p) {
+  for(;; p += 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i*)p);
+    __m256i end = _mm256_or_si256(_mm256_cmpeq_epi8(v, SPLAT('\n')),
+        _mm256_cmpeq_epi8(v, _mm256_setzero_si256()));
+
+    uint32_t mask = _mm256_movemask_epi8(end);
+    if(mask) return p + __builtin_ctz(mask);
+  }
+}
+
+// avx2 has unsigned min, so x - lo <u n is min(x - lo, n - 1) == x - lo
+AVX2 static inline __m256i in_range_avx2(__m256i v, char lo, char n) {
+  __m256i offset = _mm256_sub_epi8(v, SPLAT(lo));
+  return _mm256_cmpeq_epi8(_mm256_min_epu8(offset, SPLAT(n - 1)), offset);
+}
+
+AVX2 static const char* skip_identifier_avx2(const char* p) {
+  for(;; p += 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i*)p);
+    __m256i letter = in_range_avx2(_mm256_or_si256(v, SPLAT(0x20)), 'a', 26);
+    __m256i digit = in_range_avx2(v, '0', 10);
+    __m256i under = _mm256_cmpeq_epi8(v, SPLAT('_'));
+
+    __m256i ident = _mm256_or_si256(_mm256_or_si256(letter, digit), under);
+    uint32_t mask = ~(uint32_t)_mm256_movemask_epi8(ident);
+    if(mask) return p + __builtin_ctz(mask);
+  }
+}
+
+#undef SPLAT
+#undef AVX2
+
+// the dynamic linker asks once which kernel each name is, so the choice
+// costs nothing per call. that's before the sanitizers are set up, so a
+// resolver mustn't be instrumented by them
+#define DISPATCH(name) \
+  __attribute__((no_sanitize("address", "undefined"))) \
+  static const char* (*resolve_##name(void))(const char*) { \
+    __builtin_cpu_init(); \
+    return __builtin_cpu_supports("avx2") ? name##_avx2 : name##_sse2; \
+  } \
+  const char* name(const char*) __attribute__((ifunc("resolve_" #name)))
+
+#else
+
+#define DISPATCH(name) \
+  const char* name(const char* p) { return name##_sse2(p); }
+
+#endif
+
+DISPATCH(skip_blanks);
+DISPATCH(skip_to_newline);
+DISPATCH(skip_identifier);
+
+#undef DISPATCH
+
+#else
+
+static inline bool is_blank(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static inline bool is_identifier(char c) {
+  return IS_IDENTIFIER_START(c) || (c >= '0' && c <= '9');
+}
+
+const char* skip_blanks(const char* p) {
+  while(is_blank(*p)) p++;
+  return p;
+}
+
+const char* skip_to_newline(const char* p) {
+  while(*p != '\n' && *p != '\0') p++;
+  return p;
+}
+
+const char* skip_identifier(const char* p) {
+  while(is_identifier(*p)) p++;
+  return p;
+}
+
+#endif
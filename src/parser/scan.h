@@ -0,0 +1,13 @@
+#pragma once
+
+// scanning kernels for the lexer's long runs, with avx2 used where the cpu
+// has it. each returns the first byte that doesn't belong to the run. they
+// may read up to 32 bytes past it, so the text must be followed by
+// SOURCE_PADDING zero bytes, which read_file guarantees
+
+const char* skip_blanks(const char*);      // spaces, tabs and newlines
+const char* skip_to_newline(const char*);  // a comment body; stops at '\0' too
+const char* skip_identifier(const char*);  // [A-Za-z0-9_]
+
+#define IS_IDENTIFIER_START(c) \
+  ((((c) | 0x20) >= 'a' && ((c) | 0x20) <= 'z') || (c) == '_')
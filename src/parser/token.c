@@ -1,6 +1,8 @@
 // token.c
 
 #include "token.h"
+#include "../util/panic.h"
+#include "../util/stats.h"
 
 const char* token_strings[TOKEN_EOF] = {
   "UNDEFINED TOKEN",
@@ -108,3 +110,46 @@ const char* token_strings[TOKEN_EOF] = {
   "false",
   "ERROR TOKEN",
 };
+
+
+void init_tokens(struct TokenBuffer* tokens, size_t capacity) {
+  tokens->size = 0;
+  tokens->capacity = capacity ? capacity : 1;
+
+  tokens->types = stats_malloc(tokens->capacity * sizeof(*tokens->types));
+  tokens->offsets = stats_malloc(tokens->capacity * sizeof(*tokens->offsets));
+  tokens->lengths = stats_malloc(tokens->capacity * sizeof(*tokens->lengths));
+  tokens->payloads = stats_malloc(tokens->capacity * sizeof(*tokens->payloads));
+}
+
+static void grow_tokens(struct TokenBuffer* tokens) {
+  tokens->capacity *= 2;
+
+  tokens->types = stats_realloc(tokens->types,
+      tokens->capacity * sizeof(*tokens->types));
+  tokens->offsets = stats_realloc(tokens->offsets,
+      tokens->capacity * sizeof(*tokens->offsets));
+  tokens->lengths = stats_realloc(tokens->lengths,
+      tokens->capacity * sizeof(*tokens->lengths));
+  tokens->payloads = stats_realloc(tokens->payloads,
+      tokens->capacity * sizeof(*tokens->payloads));
+}
+
+void push_token(struct TokenBuffer* tokens, struct Token token,
+    size_t offset, size_t length) {
+  if(offset + length > UINT32_MAX) panic(1, "file is too large");
+  if(tokens->size >= tokens->capacity) grow_tokens(tokens);
+
+  tokens->types[tokens->size] = token.type;
+  tokens->offsets[tokens->size] = offset;
+  tokens->lengths[tokens->size] = length;
+  tokens->payloads[tokens->size] = token.as.integer;
+  tokens->size += 1;
+}
+
+void free_tokens(struct TokenBuffer* tokens) {
+  free(tokens->types);
+  free(tokens->offsets);
+  free(tokens->lengths);
+  free(tokens->payloads);
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdint.h>
 #include "../util/arraylist.h"
 
 enum TokenType {
@@ -106,10 +107,17 @@ enum TokenType {
   TOKEN_EOF,
 };
 
+// where an identifier or string sits in the source; the lexer never copies
+// them, the parser interns the ones it keeps
+struct Slice {
+  size_t offset;
+  size_t len;
+};
+
 struct Token {
   enum TokenType type;
   union {
-    const char* string;
+    struct Slice slice;
     size_t integer;
     double floating;
     char character;
@@ -122,12 +130,47 @@ extern const char* token_strings[TOKEN_EOF];
 
 #define _NEW_TOKEN(type, as) (struct Token){ type, as }
 
-#define TOKEN_NEW(type) _NEW_TOKEN(type, { NULL })
+#define TOKEN_NEW(type) _NEW_TOKEN(type, { .integer = 0 })
+
+#define _NEW_SLICE_TOKEN(type, off, _len) \
+  (struct Token){ type, { .slice = { .offset = (off), .len = (_len) } } }
 
-#define TOKEN_NEW_IDENTIFIER(lit) _NEW_TOKEN(TOKEN_IDENTIFIER_LIT,    { lit })
-#define TOKEN_NEW_STRING(lit)     _NEW_TOKEN(TOKEN_STRING_LIT,        { lit })
+#define TOKEN_NEW_IDENTIFIER(off, len) \
+  _NEW_SLICE_TOKEN(TOKEN_IDENTIFIER_LIT, off, len)
+#define TOKEN_NEW_STRING(off, len) \
+  _NEW_SLICE_TOKEN(TOKEN_STRING_LIT, off, len)
 #define TOKEN_NEW_ERROR(lit)      _NEW_TOKEN(TOKEN_ERROR,{ .integer   = lit })
 #define TOKEN_NEW_INT(lit)   _NEW_TOKEN(TOKEN_INT_LIT,   { .integer   = lit })
 #define TOKEN_NEW_FLOAT(lit) _NEW_TOKEN(TOKEN_FLOAT_LIT, { .floating  = lit })
 #define TOKEN_NEW_CHAR(lit)  _NEW_TOKEN(TOKEN_CHAR_LIT,  { .character = lit })
 #define TOKEN_NEW_BOOL(lit)  _NEW_TOKEN(TOKEN_BOOL_LIT,  { .boolean   = lit })
+
+// every token of a file, one array per field. the payload holds a literal's
+// value; identifiers and strings are sliced out of the offset and length
+struct TokenBuffer {
+  uint8_t* types;
+  uint32_t* offsets;
+  uint32_t* lengths;
+  size_t* payloads;
+  size_t size;
+  size_t capacity;
+};
+
+void init_tokens(struct TokenBuffer*, size_t);
+void push_token(struct TokenBuffer*, struct Token, size_t, size_t);
+void free_tokens(struct TokenBuffer*);
+
+static inline struct Token token_at(const struct TokenBuffer* tokens,
+    size_t index) {
+  struct Token token = { .type = tokens->types[index] };
+  token.as.integer = tokens->payloads[index];
+
+  if(token.type == TOKEN_IDENTIFIER_LIT)
+    token.as.slice = (struct Slice){ tokens->offsets[index],
+      tokens->lengths[index] };
+  else if(token.type == TOKEN_STRING_LIT) // without the quotes
+    token.as.slice = (struct Slice){ tokens->offsets[index] + 1,
+      tokens->lengths[index] - 2 };
+
+  return token;
+}
@@ -7,7 +7,7 @@
 
 
 struct Type* parse_type(struct Parser* parser) {
-  struct Type* type = malloc(sizeof(*type));
+  struct Type* type = arena_alloc(parser->arena, sizeof(*type));
   type->is_mutable = MATCH_TOKEN(parser, MUT);
 
   if(parser->current.type >= TOKEN_INT8 && parser->current.type < TOKEN_TRUE) {
@@ -15,7 +15,7 @@ struct Type* parse_type(struct Parser* parser) {
     type->as.primitive = parser->current.type;
 
     // since i didn't use the iterator to get here
-    parser->current = lex_token(parser);
+    parser->current = next_token(parser);
 
   } else if(MATCH_TOKEN(parser, BIT_NOT) || MATCH_TOKEN(parser, QUESTION)
       || MATCH_TOKEN(parser, BIT_AND)) {
@@ -25,6 +25,8 @@ struct Type* parse_type(struct Parser* parser) {
 
   } else if(MATCH_TOKEN(parser, LEFT_BRACKET)) {
     type->type = TYPE_ARRAY;
+    type->as.array.size = 0;
+    refer_node(parser->nodes, &type->as.array.size);
 
     if(!MATCH_TOKEN(parser, RIGHT_BRACKET)) {
       type->as.array.size = parse_expression(parser);
@@ -61,47 +63,49 @@ static void print_primitive(const enum TokenType ast) {
 }
 
 
-static void print_wrapper(const struct Wrapper* ast) {
+static void print_wrapper(const struct Nodes* nodes,
+    const struct Wrapper* ast) {
   if(ast == NULL) { printf("(NULL)"); return; }
 
   printf("(%s ", token_strings[ast->op]);
-  print_type(ast->type);
+  print_type(nodes, ast->type);
   printf(")");
 }
 
 
-static void print_array(const struct Array* ast) {
+static void print_array(const struct Nodes* nodes, const struct Array* ast) {
   if(ast == NULL) { printf("(NULL)"); return; }
 
   printf("([] ");
-  print_expression(ast->size);
+  print_expression(nodes, ast->size);
   printf(" ");
-  print_type(ast->type);
+  print_type(nodes, ast->type);
   printf(")");
 }
 
 
-static void print_compound(const struct Compound* ast) {
+static void print_compound(const struct Nodes* nodes,
+    const struct Compound* ast) {
   if(ast == NULL) { printf("(NULL)"); return; }
 
   printf("(");
   switch(ast->type) {
-    case COMP_STRUCT: print_struct(ast->as._struct); break;
-    case COMP_UNION:  print_union(ast->as._union);   break;
-    case COMP_FUNC:   print_funcsig(ast->as.sig);    break;
+    case COMP_STRUCT: print_struct(nodes, ast->as._struct); break;
+    case COMP_UNION:  print_union(nodes, ast->as._union);   break;
+    case COMP_FUNC:   print_funcsig(nodes, ast->as.sig);    break;
   }
 
 }
 
 
-void print_type(const struct Type* ast) {
+void print_type(const struct Nodes* nodes, const struct Type* ast) {
   if(ast == NULL) { printf("(NULL)"); return; }
 
   if(ast->is_mutable) printf("mut ");
   switch(ast->type) {
-    case TYPE_PRIMITIVE: print_primitive(ast->as.primitive); break;
-    case TYPE_WRAPPER:   print_wrapper(&ast->as.wrapper);    break;
-    case TYPE_ARRAY:     print_array(&ast->as.array);        break;
-    case TYPE_COMPOUND:  print_compound(&ast->as.compound);  break;
+    case TYPE_PRIMITIVE: print_primitive(ast->as.primitive);       break;
+    case TYPE_WRAPPER:   print_wrapper(nodes, &ast->as.wrapper);   break;
+    case TYPE_ARRAY:     print_array(nodes, &ast->as.array);       break;
+    case TYPE_COMPOUND:  print_compound(nodes, &ast->as.compound); break;
   }
 }
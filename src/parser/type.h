@@ -15,7 +15,7 @@ struct Wrapper {
 };
 
 struct Array {
-  struct Expression* size;
+  uint32_t size; // 0 when left to the initializer
   struct Type* type;
 };
 
@@ -40,4 +40,4 @@ struct Type {
 };
 
 struct Type* parse_type(struct Parser*);
-void print_type(const struct Type*);
+void print_type(const struct Nodes*, const struct Type*);
@@ -0,0 +1,93 @@
+// arena.c
+
+#include "arena.h"
+#include "panic.h"
+#include "stats.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define BLOCK_SIZE (64 * 1024)
+#define ALIGN(x) \
+  (((x) + sizeof(max_align_t) - 1) & ~(sizeof(max_align_t) - 1))
+
+void arena_init(struct Arena* arena) {
+  arena->head = NULL;
+}
+
+void arena_destroy(struct Arena* arena) {
+  struct ArenaBlock* block = arena->head;
+
+  while(block) {
+    struct ArenaBlock* next = block->next;
+    free(block);
+    block = next;
+  }
+
+  arena->head = NULL;
+}
+
+// the blocks go behind the head, which keeps being allocated from
+void arena_adopt(struct Arena* arena, struct Arena* from) {
+  if(!from->head) return;
+
+  if(arena->head) {
+    struct ArenaBlock* last = from->head;
+    while(last->next) last = last->next;
+
+    last->next = arena->head->next;
+    arena->head->next = from->head;
+  } else arena->head = from->head;
+
+  from->head = NULL;
+}
+
+static struct ArenaBlock* new_block(size_t capacity) {
+  struct ArenaBlock* block = malloc(sizeof(*block) + capacity);
+  if(!block) panic(1, "out of memory");
+
+  block->capacity = capacity;
+  block->used = 0;
+
+  return block;
+}
+
+void* arena_alloc(struct Arena* arena, size_t size) {
+  stats_count(size);
+  size = ALIGN(size);
+  struct ArenaBlock* head = arena->head;
+
+  if(head && head->capacity - head->used >= size) {
+    void* ptr = (char*)head->data + head->used;
+    head->used += size;
+    return ptr;
+  }
+
+  // oversized requests get a block of their own behind the current one, so
+  // the rest of the current block isn't wasted
+  if(size > BLOCK_SIZE / 4 && head) {
+    struct ArenaBlock* block = new_block(size);
+    block->used = size;
+    block->next = head->next;
+    head->next = block;
+    return block->data;
+  }
+
+  struct ArenaBlock* block = new_block(size > BLOCK_SIZE ? size : BLOCK_SIZE);
+  block->used = size;
+  block->next = head;
+  arena->head = block;
+
+  return block->data;
+}
+
+const char* arena_string(struct Arena* arena, const char* string, size_t len) {
+  char* copy = arena_alloc(arena, len + 1);
+
+  memcpy(copy, string, len);
+  copy[len] = '\0';
+
+  return copy;
+}
+
+#undef BLOCK_SIZE
+#undef ALIGN
@@ -0,0 +1,29 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// a bump allocator; everything allocated from an arena lives until the whole
+// arena is destroyed
+
+struct ArenaBlock {
+  struct ArenaBlock* next;
+  size_t capacity;
+  size_t used;
+  max_align_t data[];
+};
+
+struct Arena {
+  struct ArenaBlock* head;
+};
+
+void arena_init(struct Arena*);
+void arena_destroy(struct Arena*);
+
+// moves every block of the second arena into the first, leaving it empty
+void arena_adopt(struct Arena*, struct Arena*);
+
+void* arena_alloc(struct Arena*, size_t);
+const char* arena_string(struct Arena*, const char*, size_t);
+
+#endif
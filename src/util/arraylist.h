@@ -1,7 +1,10 @@
 #pragma once
 
+#include "stats.h"
 #include <stdlib.h>
 
+// lists count what they allocate, for --mem-stats
+
 #define DEFINE_ARRAYLIST(name, memtype) \
   struct name { memtype* members; size_t size; size_t capacity; }
 
@@ -10,7 +13,8 @@
     if((list)->size >= (list)->capacity) { \
       (list)->capacity *= 2; \
       (list)->members = \
-      realloc((list)->members, (list)->capacity * sizeof(*(list)->members)); \
+      stats_realloc((list)->members, \
+        (list)->capacity * sizeof(*(list)->members)); \
     } \
     (list)->members[(list)->size++] = member; \
   } while(0)
@@ -20,7 +24,8 @@
   do { \
     (list)->capacity = 4; \
     (list)->size = 0; \
-    (list)->members = calloc((list)->capacity, sizeof(*(list)->members)); \
+    (list)->members = \
+      stats_calloc((list)->capacity, sizeof(*(list)->members)); \
   } while(0)
 
 #define FREE_MEMBERS(list, freefn) \
@@ -19,76 +19,196 @@ uint64_t hash(const uint8_t* bytes) {
   return hash;
 }
 
+uint64_t hash_bytes(const uint8_t* bytes, size_t len) {
+  uint64_t hash = FNV_OFFSET_BASIS;
+
+  for(size_t i = 0; i < len; i++) {
+    hash ^= (uint64_t)bytes[i];
+    hash *= FNV_PRIME;
+  }
+
+  return hash;
+}
+
+// every step is one to one, so changing any one word always changes the sum
+uint64_t checksum_more(uint64_t sum, const uint8_t* bytes, size_t len) {
+  size_t i = 0;
+
+  for(; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, bytes + i, sizeof(word));
+    sum = (sum ^ word) * FNV_PRIME;
+  }
+  for(; i < len; i++) sum = (sum ^ bytes[i]) * FNV_PRIME;
+
+  return sum;
+}
+
 #undef FNV_OFFSET_BASIS
 #undef FNV_PRIME
 
 
-void hm_init(struct HashMap* hm) {
-  hm->capacity = 16;
+#define CONTROL_EMPTY   ((uint8_t)0x80)
+#define CONTROL_DELETED ((uint8_t)0xfe)
+// full slots hold the low 7 bits of the hash, so their top bit is clear
+
+// keys are interned, so the pointer itself is hashed. arena alignment leaves
+// its low bits zero, which the multiply folds into the high bits
+static uint64_t hash_key(const char* key) {
+  uint64_t h = (uint64_t)(uintptr_t)key * 0x9e3779b97f4a7c15u;
+  return h ^ (h >> 32);
+}
+
+#define H1(h) ((h) >> 7)
+#define H2(h) ((uint8_t)((h) & 0x7f))
+
+// bit i is set if control byte i of the group matches
+#ifdef __SSE2__
+
+#include <emmintrin.h>
+
+static inline unsigned group_match(const uint8_t* group, uint8_t byte) {
+  __m128i ctrl = _mm_loadu_si128((const __m128i*)group);
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(byte)));
+}
+
+// empty and deleted are the only bytes with the top bit set
+static inline unsigned group_match_free(const uint8_t* group) {
+  return _mm_movemask_epi8(_mm_loadu_si128((const __m128i*)group));
+}
+
+#else
+
+static inline unsigned group_match(const uint8_t* group, uint8_t byte) {
+  unsigned mask = 0;
+  for(unsigned i = 0; i < HM_GROUP; i++) mask |= (group[i] == byte) << i;
+  return mask;
+}
+
+static inline unsigned group_match_free(const uint8_t* group) {
+  unsigned mask = 0;
+  for(unsigned i = 0; i < HM_GROUP; i++) mask |= (group[i] >> 7) << i;
+  return mask;
+}
+
+#endif
+
+// groups are visited in triangular order, which reaches every group when
+// their count is a power of two
+#define FOR_EACH_GROUP(hm, h, group) \
+  for(size_t group = H1(h) & ((hm)->capacity / HM_GROUP - 1), step = 1; ; \
+      group = (group + step++) & ((hm)->capacity / HM_GROUP - 1))
+
+static void hm_alloc(struct HashMap* hm, size_t capacity) {
+  hm->capacity = capacity;
   hm->length = 0;
+  hm->deleted = 0;
 
-  hm->values = calloc(hm->capacity, sizeof(struct HashItem));
+  hm->control = malloc(capacity);
+  memset(hm->control, CONTROL_EMPTY, capacity);
+  hm->values = malloc(capacity * sizeof(struct HashItem));
 }
-void hm_destroy(struct HashMap* hm) {
-  for(size_t i = 0; i < hm->capacity; i++) free((void*)hm->values[i].key);
-  free(hm->values);
+
+void hm_init(struct HashMap* hm) {
+  hm_alloc(hm, HM_GROUP);
 }
 
-static size_t hm_index(const struct HashMap* hm, const char* key) {
-  return hash((uint8_t*)key) & (hm->capacity - 1);
+void hm_destroy(struct HashMap* hm) {
+  free(hm->control);
+  free(hm->values);
 }
 
-static struct HashItem* _hm_get(const struct HashMap* hm, const char* key) {
-  size_t index = hm_index(hm, key);
-  struct HashItem* item = &hm->values[index];
+static struct HashItem* hm_find(const struct HashMap* hm, const char* key,
+    uint64_t h) {
+  FOR_EACH_GROUP(hm, h, group) {
+    const uint8_t* control = &hm->control[group * HM_GROUP];
 
-  while((item = &hm->values[index++ & (hm->capacity - 1)])->key)
-    if(!strcmp(item->key, key)) return item;
+    for(unsigned match = group_match(control, H2(h)); match;
+        match &= match - 1) {
+      size_t slot = group * HM_GROUP + __builtin_ctz(match);
+      if(hm->values[slot].key == key) return &hm->values[slot];
+    }
 
-  return item;
+    // a group with an empty slot was never full, so the key can't be further
+    if(group_match(control, CONTROL_EMPTY)) return NULL;
+  }
 }
 
 uintptr_t hm_get(const struct HashMap* hm, const char* key) {
-  struct HashItem* item = _hm_get(hm, key);
-  if(item->key) return item->value;
+  struct HashItem* item = hm_find(hm, key, hash_key(key));
+  if(item) return item->value;
   return 0;
 }
 
-static void _hm_set(struct HashMap* hm, const char* key, size_t value) {
-  struct HashItem* item = _hm_get(hm, key);
-  if(!item->key) {
+// only for keys that aren't in the map yet
+static void hm_insert(struct HashMap* hm, const char* key, uintptr_t value,
+    uint64_t h) {
+  FOR_EACH_GROUP(hm, h, group) {
+    unsigned free_slots = group_match_free(&hm->control[group * HM_GROUP]);
+    if(!free_slots) continue;
+
+    size_t slot = group * HM_GROUP + __builtin_ctz(free_slots);
+    if(hm->control[slot] == CONTROL_DELETED) hm->deleted -= 1;
+
+    hm->control[slot] = H2(h);
+    hm->values[slot] = (struct HashItem){ key, value };
     hm->length += 1;
-    item->key = calloc(sizeof(*item->key), strlen(key) + 1);
-    strcpy((char*)item->key, key);
+    return;
   }
-  item->value = value;
 }
 
-static void hm_expand(struct HashMap* hm) {
-  hm->capacity <<= 1;
-  struct HashItem* old = hm->values;
-  hm->values = calloc(hm->capacity, sizeof(struct HashItem));
+// entries are moved into fresh arrays, which also clears every tombstone. the
+// size only doubles if the map is really full, not just full of tombstones
+static void hm_rehash(struct HashMap* hm) {
+  struct HashMap old = *hm;
 
-  for(size_t i = 0; i < (hm->capacity >> 1); i++) {
-    struct HashItem* item = &old[i];
-    if(item->key) _hm_set(hm, item->key, item->value);
-  }
+  size_t capacity = old.capacity;
+  if(old.length * 2 >= capacity) capacity <<= 1;
+  hm_alloc(hm, capacity);
+
+  for(size_t i = 0; i < old.capacity; i++)
+    if(!(old.control[i] & 0x80)) {
+      const struct HashItem* item = &old.values[i];
+      hm_insert(hm, item->key, item->value, hash_key(item->key));
+    }
 
-  free(old);
+  hm_destroy(&old);
 }
 
-void hm_set(struct HashMap* hm, const char* key, size_t value) {
-  if(hm->length >= (hm->capacity >> 1)) hm_expand(hm);
-  _hm_set(hm, key, value);
+void hm_set(struct HashMap* hm, const char* key, uintptr_t value) {
+  uint64_t h = hash_key(key);
+
+  struct HashItem* item = hm_find(hm, key, h);
+  if(item) {
+    item->value = value;
+    return;
+  }
+
+  // kept at most 7/8 full, counting tombstones, so probes always end
+  if((hm->length + hm->deleted + 1) * 8 > hm->capacity * 7) hm_rehash(hm);
+  hm_insert(hm, key, value, h);
 }
 
 void hm_remove(struct HashMap* hm, const char* key) {
-  struct HashItem* item = _hm_get(hm, key);
-
-  if(item->key) {
-    free((char*)item->key);
-    hm->length -= 1;
-    item->key = NULL;
-    item->value = 0;
+  struct HashItem* item = hm_find(hm, key, hash_key(key));
+  if(!item) return;
+
+  size_t slot = item - hm->values;
+  const uint8_t* group = &hm->control[slot - slot % HM_GROUP];
+
+  // if the group still has an empty slot no probe ever went past it, so the
+  // slot can be emptied outright instead of leaving a tombstone
+  if(group_match(group, CONTROL_EMPTY)) hm->control[slot] = CONTROL_EMPTY;
+  else {
+    hm->control[slot] = CONTROL_DELETED;
+    hm->deleted += 1;
   }
+
+  hm->length -= 1;
 }
+
+#undef CONTROL_EMPTY
+#undef CONTROL_DELETED
+#undef H1
+#undef H2
+#undef FOR_EACH_GROUP
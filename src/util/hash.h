@@ -5,16 +5,30 @@
 #include <stddef.h>
 
 uint64_t hash(const uint8_t*);
+uint64_t hash_bytes(const uint8_t*, size_t);
+// carries a sum, from 0, on over more bytes a word at a time, which is
+// several times faster than hash_bytes. for noticing damage, not for keys
+uint64_t checksum_more(uint64_t, const uint8_t*, size_t);
+
+// keys must come from intern() and are compared by pointer; the map doesn't
+// own them
 
 struct HashItem {
   const char* key;
   uintptr_t value;
 };
 
+// a swiss table: slots come in groups of HM_GROUP, and every slot has a
+// control byte that is either empty, deleted or 7 bits of its key's hash, so
+// a whole group is matched against a lookup at once
+#define HM_GROUP 16
+
 struct HashMap {
+  uint8_t* control;
   struct HashItem* values;
   size_t capacity;
   size_t length;
+  size_t deleted;
 };
 
 void hm_init(struct HashMap*);
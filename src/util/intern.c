@@ -0,0 +1,97 @@
+// intern.c
+
+#include "intern.h"
+#include "arena.h"
+#include "hash.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct InternEntry {
+  const char* string;
+  uint64_t hash;
+  size_t len;
+};
+
+// files are parsed on several threads at once, so the table is split into
+// shards by the top bits of the hash, each behind its own lock
+#define SHARD_BITS 4
+#define SHARDS (1 << SHARD_BITS)
+
+struct InternTable {
+  pthread_mutex_t lock;
+  struct Arena strings;
+  struct InternEntry* entries;
+  size_t capacity;
+  size_t length;
+};
+
+static struct InternTable tables[SHARDS] = {
+  [0 ... SHARDS - 1] = { .lock = PTHREAD_MUTEX_INITIALIZER },
+};
+
+static void intern_expand(struct InternTable* table) {
+  size_t capacity = table->capacity ? table->capacity << 1 : 256;
+  struct InternEntry* entries = calloc(capacity, sizeof(*entries));
+
+  for(size_t i = 0; i < table->capacity; i++) {
+    struct InternEntry* old = &table->entries[i];
+    if(!old->string) continue;
+
+    size_t index = old->hash & (capacity - 1);
+    while(entries[index].string) index = (index + 1) & (capacity - 1);
+    entries[index] = *old;
+  }
+
+  free(table->entries);
+  table->entries = entries;
+  table->capacity = capacity;
+}
+
+const char* intern(const char* string, size_t len) {
+  uint64_t h = hash_bytes((const uint8_t*)string, len);
+  struct InternTable* table = &tables[h >> (64 - SHARD_BITS)];
+
+  pthread_mutex_lock(&table->lock);
+  if(table->length >= (table->capacity >> 1)) intern_expand(table);
+
+  size_t index = h & (table->capacity - 1);
+  struct InternEntry* entry;
+
+  while((entry = &table->entries[index])->string) {
+    if(entry->hash == h && entry->len == len
+        && !memcmp(entry->string, string, len))
+      break;
+    index = (index + 1) & (table->capacity - 1);
+  }
+
+  if(!entry->string) {
+    entry->string = arena_string(&table->strings, string, len);
+    entry->hash = h;
+    entry->len = len;
+    table->length += 1;
+  }
+
+  // the entry can move as soon as the lock is let go
+  const char* interned = entry->string;
+  pthread_mutex_unlock(&table->lock);
+  return interned;
+}
+
+const char* intern_cstr(const char* string) {
+  return intern(string, strlen(string));
+}
+
+void intern_destroy(void) {
+  for(size_t i = 0; i < SHARDS; i++) {
+    arena_destroy(&tables[i].strings);
+    free(tables[i].entries);
+    tables[i].entries = NULL;
+    tables[i].capacity = 0;
+    tables[i].length = 0;
+  }
+}
+
+#undef SHARD_BITS
+#undef SHARDS
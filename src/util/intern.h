@@ -0,0 +1,15 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stddef.h>
+
+// every distinct spelling is stored once; two interned strings are equal if
+// and only if their pointers are equal. interned strings live until
+// intern_destroy, and interning is safe from several threads at once
+
+const char* intern(const char*, size_t);
+const char* intern_cstr(const char*);
+
+void intern_destroy(void);
+
+#endif
@@ -0,0 +1,38 @@
+// lines.c
+
+#include "lines.h"
+#include <unistd.h>
+
+bool open_lines(struct LineMap* map, const char* filename) {
+  if(access(filename, R_OK)) return false;
+  map->source = read_file(filename);
+
+  map->size = map->source.size;
+  if(map->size && map->source.text[map->size - 1] == '\n') map->size -= 1;
+
+  map->lines = 1;
+  for(size_t i = 0; i < map->size; i++)
+    map->lines += map->source.text[i] == '\n';
+
+  map->starts = malloc(map->lines * sizeof(*map->starts));
+  map->starts[0] = 0;
+  for(size_t i = 0, line = 1; i < map->size; i++)
+    if(map->source.text[i] == '\n') map->starts[line++] = i + 1;
+
+  return true;
+}
+
+void close_lines(struct LineMap* map) {
+  free(map->starts);
+  close_file(&map->source);
+}
+
+size_t line_of(const struct LineMap* map, size_t offset) {
+  size_t low = 0, high = map->lines;
+  while(high - low > 1) {
+    size_t mid = low + (high - low) / 2;
+    if(map->starts[mid] <= offset) low = mid;
+    else high = mid;
+  }
+  return low;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "readfile.h"
+#include <stdbool.h>
+
+// where each line of a file starts, to turn the byte offsets the ast keeps
+// back into rows and columns once a program has run
+struct LineMap {
+  struct Source source;
+  size_t* starts;
+  size_t lines; // a final newline doesn't start another one
+  size_t size;  // of the text, without that newline
+};
+
+// false if the file can't be read
+bool open_lines(struct LineMap*, const char*);
+void close_lines(struct LineMap*);
+
+// counted from 0
+size_t line_of(const struct LineMap*, size_t);
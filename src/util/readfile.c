@@ -3,23 +3,68 @@
 
 #include "panic.h"
 #include "readfile.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
-static size_t get_filesize(FILE* file) {
-  fseek(file, 0, SEEK_END);
-  size_t filesize = ftell(file);
-  fseek(file, 0, SEEK_SET);
-  return filesize + 1;
+#define ROUND_UP(x, to) (((x) + (to) - 1) / (to) * (to))
+
+// pipes and other unmappable files are read into the heap instead
+static struct Source read_stream(int fd) {
+  size_t capacity = 1 << 16, size = 0;
+  char* text = malloc(capacity + SOURCE_PADDING);
+  ssize_t got;
+
+  while((got = read(fd, text + size, capacity - size)) > 0) {
+    size += got;
+    if(size == capacity) {
+      capacity <<= 1;
+      text = realloc(text, capacity + SOURCE_PADDING);
+    }
+  }
+  if(got < 0) panic(1, "Failed to read file");
+
+  for(size_t i = 0; i < SOURCE_PADDING; i++) text[size + i] = '\0';
+  return (struct Source){ text, size, 0 };
 }
 
-char* read_file(const char* filename) {
-  FILE* file = fopen(filename, "r");
-  if(!file) panic(1, "Failed to open file");
+// the file is mapped over the start of a zeroed anonymous mapping, so the
+// padding past its end is zero even when the size is a multiple of a page
+static struct Source map_file(int fd, size_t size) {
+  size_t page = sysconf(_SC_PAGESIZE);
+  size_t mapped = ROUND_UP(size + SOURCE_PADDING, page);
 
-  size_t filesize = get_filesize(file);
-  char* program = calloc(filesize, sizeof(char));
+  char* text = mmap(NULL, mapped, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS,
+      -1, 0);
+  if(text == MAP_FAILED) panic(1, "Failed to map file");
 
-  fread(program, filesize, sizeof(char), file);
-  fclose(file);
+  if(size && mmap(text, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0)
+      == MAP_FAILED) panic(1, "Failed to map file");
 
-  return program;
+  madvise(text, size, MADV_SEQUENTIAL);
+  return (struct Source){ text, size, mapped };
 }
+
+struct Source read_file(const char* filename) {
+  int fd = open(filename, O_RDONLY);
+  if(fd < 0) panic(1, "Failed to open file");
+
+  struct stat st;
+  if(fstat(fd, &st) < 0) panic(1, "Failed to open file");
+
+  struct Source source = S_ISREG(st.st_mode)
+    ? map_file(fd, st.st_size)
+    : read_stream(fd);
+
+  close(fd);
+  return source;
+}
+
+void close_file(struct Source* source) {
+  if(source->mapped) munmap((void*)source->text, source->mapped);
+  else free((void*)source->text);
+  source->text = NULL;
+}
+
+#undef ROUND_UP
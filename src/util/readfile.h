@@ -3,4 +3,16 @@
 #include <stdio.h>
 #include <stdlib.h>
 
-char* read_file(const char*);
+// at least this many zero bytes follow the text of a source, so scanners can
+// stop at the first '\0' or read a whole word past the end without faulting
+#define SOURCE_PADDING 64
+
+// a read-only view of a whole file
+struct Source {
+  const char* text;
+  size_t size;
+  size_t mapped; // length of the mapping, or 0 if text was read into the heap
+};
+
+struct Source read_file(const char*);
+void close_file(struct Source*);
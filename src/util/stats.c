@@ -0,0 +1,198 @@
+// stats.c
+
+#include "stats.h"
+#include "trace.h"
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <time.h>
+
+static const char* phase_names[PHASE_FINAL] = {
+  "other", "read", "image", "lex", "parse", "resolve", "comptime",
+  "build ir", "optimize", "codegen", "compile", "execute",
+};
+
+// the loader parses on several threads, so everything is atomic
+struct PhaseStats {
+  atomic_uint_fast64_t wall, cpu; // nanoseconds
+  atomic_uint_fast64_t allocations, bytes;
+  atomic_long peak_rss;           // kilobytes, when the phase was last left
+  atomic_bool ran;
+};
+
+bool stats_enabled = false;
+
+static struct PhaseStats phases[PHASE_FINAL];
+
+// of every vector, over the whole process
+static atomic_uint_fast64_t growths, copied, spills;
+static uint64_t wall_start, cpu_start; // of the whole process
+
+// each thread's phase, and when the time it's spent in it was last counted
+static _Thread_local enum Phase current = PHASE_OTHER;
+static _Thread_local uint64_t segment_wall, segment_cpu;
+
+// when each phase was entered, for its span in a --trace
+static _Thread_local uint64_t entered[PHASE_FINAL];
+
+
+static uint64_t clock_ns(clockid_t clock) {
+  struct timespec ts;
+  clock_gettime(clock, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+void stats_enable(void) {
+  stats_enabled = true;
+  wall_start = clock_ns(CLOCK_MONOTONIC);
+  cpu_start = clock_ns(CLOCK_PROCESS_CPUTIME_ID);
+}
+
+// the time since the last call goes to the current phase
+static void count_segment(void) {
+  uint64_t wall = clock_ns(CLOCK_MONOTONIC);
+  uint64_t cpu = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+
+  if(current != PHASE_OTHER) {
+    atomic_fetch_add_explicit(&phases[current].wall, wall - segment_wall,
+        memory_order_relaxed);
+    atomic_fetch_add_explicit(&phases[current].cpu, cpu - segment_cpu,
+        memory_order_relaxed);
+  }
+
+  segment_wall = wall;
+  segment_cpu = cpu;
+}
+
+enum Phase stats_enter(enum Phase phase) {
+  enum Phase previous = current;
+  if(!stats_enabled && !trace_enabled) return previous;
+
+  if(stats_enabled) {
+    count_segment();
+    atomic_store_explicit(&phases[phase].ran, true, memory_order_relaxed);
+  }
+  current = phase;
+  entered[phase] = trace_begin();
+  return previous;
+}
+
+// ru_maxrss only grows, but threads can leave out of order
+static void count_peak(void) {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+
+  long peak = atomic_load_explicit(&phases[current].peak_rss,
+      memory_order_relaxed);
+  while(usage.ru_maxrss > peak
+      && !atomic_compare_exchange_weak(&phases[current].peak_rss, &peak,
+        usage.ru_maxrss));
+}
+
+void stats_leave(enum Phase previous) {
+  if(!stats_enabled && !trace_enabled) return;
+  trace_end(phase_names[current], NULL, entered[current]);
+
+  if(stats_enabled) {
+    count_segment();
+    count_peak();
+  }
+  current = previous;
+}
+
+
+void stats_count(size_t size) {
+  if(!stats_enabled) return;
+
+  atomic_fetch_add_explicit(&phases[current].allocations, 1,
+      memory_order_relaxed);
+  atomic_fetch_add_explicit(&phases[current].bytes, size,
+      memory_order_relaxed);
+}
+
+void* stats_malloc(size_t size) {
+  stats_count(size);
+  return malloc(size);
+}
+
+void* stats_calloc(size_t count, size_t size) {
+  stats_count(count * size);
+  return calloc(count, size);
+}
+
+// a reallocation counts as a new allocation of the whole size
+void* stats_realloc(void* ptr, size_t size) {
+  stats_count(size);
+  return realloc(ptr, size);
+}
+
+void stats_grow(size_t bytes, bool spilled) {
+  if(!stats_enabled) return;
+
+  atomic_fetch_add_explicit(&growths, 1, memory_order_relaxed);
+  atomic_fetch_add_explicit(&copied, bytes, memory_order_relaxed);
+  if(spilled) atomic_fetch_add_explicit(&spills, 1, memory_order_relaxed);
+}
+
+
+static void print_bytes(FILE* out, double bytes) {
+  if(bytes >= 1 << 20) fprintf(out, " %10.1f MB", bytes / (1 << 20));
+  else if(bytes >= 1 << 10) fprintf(out, " %10.1f KB", bytes / (1 << 10));
+  else fprintf(out, " %10.0f B ", bytes);
+}
+
+void stats_report(FILE* out, bool time, bool memory) {
+  if(!stats_enabled) return;
+
+  fprintf(out, "%-10s", "phase");
+  if(time) fprintf(out, " %12s %12s", "wall ms", "cpu ms");
+  if(memory) fprintf(out, " %12s %13s %13s", "allocations", "allocated",
+      "peak rss");
+  fprintf(out, "\n");
+
+  uint64_t allocations = 0, bytes = 0;
+  for(size_t i = 1; i <= PHASE_FINAL; i++) {
+    struct PhaseStats* phase = &phases[i % PHASE_FINAL]; // other goes last
+    if(!phase->ran && !(memory && phase->allocations)) continue;
+
+    fprintf(out, "%-10s", phase_names[i % PHASE_FINAL]);
+    if(time && i % PHASE_FINAL == PHASE_OTHER)
+      fprintf(out, " %12s %12s", "", "");
+    else if(time)
+      fprintf(out, " %12.3f %12.3f", phase->wall / 1e6, phase->cpu / 1e6);
+
+    if(memory) {
+      fprintf(out, " %12" PRIuFAST64, (uint_fast64_t)phase->allocations);
+      print_bytes(out, phase->bytes);
+      if(phase->peak_rss) print_bytes(out, phase->peak_rss * 1024.0);
+    }
+    fprintf(out, "\n");
+
+    allocations += phase->allocations;
+    bytes += phase->bytes;
+  }
+
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+
+  fprintf(out, "%-10s", "total");
+  if(time)
+    fprintf(out, " %12.3f %12.3f",
+        (clock_ns(CLOCK_MONOTONIC) - wall_start) / 1e6,
+        (clock_ns(CLOCK_PROCESS_CPUTIME_ID) - cpu_start) / 1e6);
+  if(memory) {
+    fprintf(out, " %12" PRIu64, allocations);
+    print_bytes(out, bytes);
+    print_bytes(out, usage.ru_maxrss * 1024.0);
+  }
+  fprintf(out, "\n");
+
+  if(memory && growths) {
+    fprintf(out, "vectors grew %" PRIuFAST64 " times, %" PRIuFAST64
+        " of them out of their own room, and copied %" PRIuFAST64
+        " bytes doing it\n", (uint_fast64_t)growths, (uint_fast64_t)spills,
+        (uint_fast64_t)copied);
+  }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+// where time and memory go, for --time-passes and --mem-stats. a phase is
+// entered and left around each stage of the compiler; time is only counted
+// to the innermost phase, and summed over every thread that runs it.
+// allocations go to whichever phase the allocating thread is in. with
+// --trace, every phase entered is also a span
+
+enum Phase {
+  PHASE_OTHER, // allocations outside any phase; its time isn't measured
+  PHASE_READ,
+  PHASE_IMAGE,
+  PHASE_LEX,
+  PHASE_PARSE,
+  PHASE_RESOLVE,
+  PHASE_COMPTIME,
+  PHASE_BUILD_IR,
+  PHASE_OPTIMIZE,
+  PHASE_CODEGEN,
+  PHASE_COMPILE,
+  PHASE_EXECUTE,
+  PHASE_FINAL,
+};
+
+extern bool stats_enabled;
+
+void stats_enable(void);
+
+// returns the phase to go back to when this one is left
+enum Phase stats_enter(enum Phase);
+void stats_leave(enum Phase);
+
+void stats_count(size_t);
+void* stats_malloc(size_t);
+void* stats_calloc(size_t, size_t);
+void* stats_realloc(void*, size_t);
+
+// a vector grew, copying that many bytes, and whether out of its own room
+void stats_grow(size_t, bool);
+
+void stats_report(FILE*, bool time, bool memory);
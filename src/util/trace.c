@@ -0,0 +1,155 @@
+// trace.c
+
+#include "trace.h"
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// events a thread keeps; past this many its oldest are overwritten. the
+// ring is only touched as far as it's filled
+#define RING_SIZE (1 << 20)
+
+// names and details aren't copied, so they have to outlive the trace
+struct TraceEvent {
+  const char* name;
+  const char* detail;
+  uint64_t start, duration; // nanoseconds
+};
+
+struct TraceRing {
+  struct TraceEvent* events;
+  uint64_t written;
+  unsigned tid;
+  struct TraceRing* next;
+};
+
+bool trace_enabled = false;
+
+static const char* trace_path = NULL;
+static uint64_t trace_epoch;
+static _Atomic(struct TraceRing*) rings = NULL;
+static atomic_uint threads = 0;
+static _Thread_local struct TraceRing* ring = NULL;
+
+
+uint64_t trace_clock(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+// a thread's ring is made the first time it records anything, and pushed
+// onto the list of them without a lock
+static struct TraceRing* own_ring(void) {
+  struct TraceRing* made = malloc(sizeof(*made));
+  made->events = malloc(RING_SIZE * sizeof(*made->events));
+  made->written = 0;
+  made->tid = atomic_fetch_add(&threads, 1) + 1;
+
+  made->next = atomic_load(&rings);
+  while(!atomic_compare_exchange_weak(&rings, &made->next, made));
+
+  return made;
+}
+
+static void finish_at_exit(void) {
+  trace_finish();
+}
+
+// the thread that starts the trace is the first one in it
+void trace_start(const char* path) {
+  trace_path = path;
+  trace_epoch = trace_clock();
+  trace_enabled = true;
+  ring = own_ring();
+  atexit(finish_at_exit);
+}
+
+void trace_span(const char* name, const char* detail, uint64_t start) {
+  uint64_t end = trace_clock();
+  if(!ring) ring = own_ring();
+
+  ring->events[ring->written++ & (RING_SIZE - 1)] =
+    (struct TraceEvent){ name, detail, start, end - start };
+}
+
+
+static void write_string(FILE* out, const char* string) {
+  fputc('"', out);
+  for(; *string; string++) {
+    if(*string == '"' || *string == '\\') fprintf(out, "\\%c", *string);
+    else if((unsigned char)*string < 0x20)
+      fprintf(out, "\\u%04x", (unsigned char)*string);
+    else fputc(*string, out);
+  }
+  fputc('"', out);
+}
+
+static void write_ring(FILE* out, const struct TraceRing* r, int pid) {
+  uint64_t first = r->written > RING_SIZE ? r->written - RING_SIZE : 0;
+
+  fprintf(out, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,"
+      "\"tid\":%u,\"args\":{\"name\":\"", pid, r->tid);
+  if(r->tid == 1) fprintf(out, "main");
+  else fprintf(out, "thread %u", r->tid);
+  if(first) fprintf(out, " (%llu earlier events dropped)",
+      (unsigned long long)first);
+  fprintf(out, "\"}}");
+
+  for(uint64_t i = first; i < r->written; i++) {
+    const struct TraceEvent* event = &r->events[i & (RING_SIZE - 1)];
+
+    fprintf(out, ",\n{\"name\":");
+    write_string(out, event->name);
+    fprintf(out, ",\"ph\":\"X\",\"pid\":%d,\"tid\":%u,\"ts\":%.3f,"
+        "\"dur\":%.3f", pid, r->tid, (event->start - trace_epoch) / 1e3,
+        event->duration / 1e3);
+
+    if(event->detail) {
+      fprintf(out, ",\"args\":{\"detail\":");
+      write_string(out, event->detail);
+      fprintf(out, "}");
+    }
+    fprintf(out, "}");
+  }
+}
+
+// once only; whatever the threads recorded is dropped after
+bool trace_finish(void) {
+  if(!trace_path) return true;
+
+  const char* path = trace_path;
+  trace_path = NULL;
+  trace_enabled = false;
+
+  FILE* out = fopen(path, "w");
+  bool ok = out;
+  if(!ok) printf("error: could not open %s: %s\n", path, strerror(errno));
+
+  int pid = getpid();
+  if(ok) fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+      "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,"
+      "\"args\":{\"name\":\"2nic\"}}", pid);
+
+  struct TraceRing* next;
+  for(struct TraceRing* r = atomic_load(&rings); r; r = next) {
+    if(ok) write_ring(out, r, pid);
+    next = r->next;
+    free(r->events);
+    free(r);
+  }
+  atomic_store(&rings, NULL);
+  ring = NULL;
+
+  if(ok) {
+    fprintf(out, "\n]}\n");
+    fclose(out);
+  }
+  return ok;
+}
+
+#undef RING_SIZE
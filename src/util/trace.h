@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// --trace: spans of what the compiler and the tree walker did, written as
+// chrome's trace event json for perfetto or chrome://tracing. each thread
+// keeps its own ring of the latest events, which nothing else touches until
+// they're written at exit
+
+extern bool trace_enabled;
+
+// the trace is also written if the program exits before trace_finish
+void trace_start(const char*);
+bool trace_finish(void);
+
+uint64_t trace_clock(void);
+
+// a span starts when trace_begin returns, and is recorded by trace_end with
+// what it was about, if anything. both are free while tracing is off
+static inline uint64_t trace_begin(void) {
+  return trace_enabled ? trace_clock() : 0;
+}
+
+void trace_span(const char*, const char*, uint64_t);
+
+static inline void trace_end(const char* name, const char* detail,
+    uint64_t start) {
+  if(start) trace_span(name, detail, start);
+}
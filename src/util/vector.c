@@ -0,0 +1,47 @@
+// vector.c
+
+#include "vector.h"
+#include "panic.h"
+#include "stats.h"
+#include <stdint.h>
+#include <stdlib.h>
+
+// capacities double from 4, so growing one member at a time is amortized
+void* grow_vector(void* members, void* local, struct Arena* pool,
+    size_t size, size_t* capacity, size_t needed, size_t width) {
+  size_t grown = *capacity ? *capacity : 4;
+  while(grown < needed) grown *= 2;
+  if(grown > SIZE_MAX / width) panic(1, "out of memory");
+
+  void* moved;
+  if(pool) moved = arena_alloc(pool, grown * width);
+  else {
+    stats_count(grown * width);
+    moved = members == local
+      ? malloc(grown * width) : realloc(members, grown * width);
+  }
+  if(!moved) panic(1, "out of memory");
+
+  if(pool || members == local) memcpy(moved, members, size * width);
+  stats_grow(size * width, members == local);
+
+  *capacity = grown;
+  return moved;
+}
+
+void* shrink_vector(void* members, void* local, size_t room,
+    struct Arena* pool, size_t size, size_t* capacity, size_t width) {
+  if(pool || members == local || size == *capacity) return members;
+
+  if(size <= room) {
+    memcpy(local, members, size * width);
+    free(members);
+    *capacity = room;
+    return local;
+  }
+
+  void* shrunk = realloc(members, size * width);
+  if(!shrunk) return members; // it's still whole where it was
+  *capacity = size;
+  return shrunk;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+
+// typed growable arrays. a vector keeps its first members in room of its
+// own, as many as it's defined with, and only takes memory once they
+// outgrow it: from the heap, or from its pool if it was made with an arena.
+// a pooled vector leaves what it outgrew behind, and is freed with the arena.
+//
+// members is wherever the members are, which can be inside the vector, so
+// one with room of its own mustn't be copied or moved once it's made
+
+#define VECTOR_FIELDS(memtype, room) \
+  memtype* members; \
+  size_t size; \
+  size_t capacity; \
+  struct Arena* pool; /* NULL for the heap */ \
+  memtype local[room]
+
+#define DEFINE_VECTOR(name, memtype, room) \
+  struct name { VECTOR_FIELDS(memtype, room); }
+
+#define VECTOR_ROOM(vec) (sizeof((vec)->local) / sizeof(*(vec)->local))
+
+#define NEW_ARENA_VECTOR(vec, arena) \
+  do { \
+    (vec)->members = (vec)->local; \
+    (vec)->size = 0; \
+    (vec)->capacity = VECTOR_ROOM(vec); \
+    (vec)->pool = (arena); \
+  } while(0)
+
+#define NEW_VECTOR(vec) NEW_ARENA_VECTOR(vec, NULL)
+
+// room for at least that many members in all
+#define RESERVE_VECTOR(vec, needed) \
+  do { \
+    size_t reserved = (needed); \
+    if(reserved > (vec)->capacity) \
+      (vec)->members = grow_vector((vec)->members, (vec)->local, \
+          (vec)->pool, (vec)->size, &(vec)->capacity, reserved, \
+          sizeof(*(vec)->members)); \
+  } while(0)
+
+#define APPEND_VECTOR(vec, member) \
+  do { \
+    if((vec)->size >= (vec)->capacity) RESERVE_VECTOR(vec, (vec)->size + 1); \
+    (vec)->members[(vec)->size++] = (member); \
+  } while(0)
+
+// count members copied from an array, which mustn't be the vector's own
+#define APPEND_VECTOR_MANY(vec, from, count) \
+  do { \
+    size_t appended = (count); \
+    RESERVE_VECTOR(vec, (vec)->size + appended); \
+    memcpy((vec)->members + (vec)->size, (from), \
+        appended * sizeof(*(vec)->members)); \
+    (vec)->size += appended; \
+  } while(0)
+
+// gives back the heap memory it doesn't use, moving home if it fits again
+#define SHRINK_VECTOR(vec) \
+  ((vec)->members = shrink_vector((vec)->members, (vec)->local, \
+      VECTOR_ROOM(vec), (vec)->pool, (vec)->size, &(vec)->capacity, \
+      sizeof(*(vec)->members)))
+
+#define FREE_VECTOR(vec) \
+  do { \
+    if((vec)->members != (vec)->local && !(vec)->pool) free((vec)->members); \
+  } while(0)
+
+void* grow_vector(void*, void*, struct Arena*, size_t, size_t*, size_t,
+    size_t);
+void* shrink_vector(void*, void*, size_t, struct Arena*, size_t, size_t*,
+    size_t);
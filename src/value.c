@@ -1,13 +1,77 @@
 // value.c
 
 #include "value.h"
-#include <stdlib.h>
+#include <stdio.h>
 
-struct Value* alloc_int_val(size_t x) {
-  struct Value* val = malloc(sizeof(*val));
+bool is_truthy(const struct Value* value) {
+  switch(value->type) {
+    case VAL_UNDEFINED: return false;
+    case VAL_BOOL:      return value->as.boolean;
+    case VAL_INT:       return value->as.integer != 0;
+    case VAL_FLOAT:     return value->as.floating != 0;
+    case VAL_CHAR:      return value->as.character != '\0';
+    default:            return true;
+  }
+}
+
+static bool is_number(const struct Value* value) {
+  return MATCH_VAL(value, INT) || MATCH_VAL(value, FLOAT);
+}
+
+static double to_float(const struct Value* value) {
+  if(MATCH_VAL(value, INT)) return (double)value->as.integer;
+  return value->as.floating;
+}
+
+// values of different types are never equal; chars are ordered among
+// themselves, and an int with a float is taken as a float
+bool arith_values(enum Arith op, const struct Value* x, const struct Value* y,
+    struct Value* result) {
+  if(op == ARITH_EQ || op == ARITH_NE) {
+    bool equal = x->type == y->type;
+    if(equal) switch(x->type) {
+      case VAL_BOOL:  equal = x->as.boolean == y->as.boolean;     break;
+      case VAL_FLOAT: equal = x->as.floating == y->as.floating;   break;
+      case VAL_CHAR:  equal = x->as.character == y->as.character; break;
+      case VAL_UNDEFINED:                                         break;
+      default:        equal = x->as.ptr == y->as.ptr;             break;
+    }
+    *result = BOOL_VAL(op == ARITH_EQ ? equal : !equal);
+    return true;
+  }
 
-  val->type = VAL_INT;
-  val->as.integer = x;
+  if(MATCH_VAL(x, CHAR) && MATCH_VAL(y, CHAR)) {
+    switch(op) {
+      case ARITH_LT: *result = BOOL_VAL(x->as.character < y->as.character);
+        return true;
+      case ARITH_LE: *result = BOOL_VAL(x->as.character <= y->as.character);
+        return true;
+      default: return false;
+    }
+  }
+
+  if(!is_number(x) || !is_number(y)) return false;
+  double a = to_float(x), b = to_float(y);
+  switch(op) {
+    case ARITH_ADD: *result = FLOAT_VAL(a + b);  return true;
+    case ARITH_SUB: *result = FLOAT_VAL(a - b);  return true;
+    case ARITH_MUL: *result = FLOAT_VAL(a * b);  return true;
+    case ARITH_DIV: *result = FLOAT_VAL(a / b);  return true;
+    case ARITH_LT:  *result = BOOL_VAL(a < b);   return true;
+    case ARITH_LE:  *result = BOOL_VAL(a <= b);  return true;
+    default:        return false;
+  }
+}
 
-  return val;
+void print_value(const struct Value* value) {
+  switch(value->type) {
+    case VAL_UNDEFINED:  printf("undefined");                            break;
+    case VAL_BOOL:       printf("%s", value->as.boolean? "true":"false"); break;
+    case VAL_INT:        printf("%zu", value->as.integer);                break;
+    case VAL_FLOAT:      printf("%g", value->as.floating);                break;
+    case VAL_CHAR:       printf("%c", value->as.character);               break;
+    case VAL_STRING:
+    case VAL_IDENTIFIER: printf("%s", value->as.string);                  break;
+    case VAL_PTR:        printf("%p", (void*)value->as.ptr);              break;
+  }
 }
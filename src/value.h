@@ -9,6 +9,8 @@ enum ValueType {
   VAL_STRING, VAL_IDENTIFIER, VAL_PTR
 };
 
+// 16 bytes, so it is passed and returned in registers; nothing that produces
+// a value should ever need to allocate one
 struct Value {
   enum ValueType type;
   union {
@@ -24,4 +26,20 @@ struct Value {
 #define MATCH_VAL(val, _type) ((val)->type == VAL_##_type)
 #define FROM_INT(val) ((val)->as.integer)
 
-struct Value* alloc_int_val(size_t);
+#define UNDEFINED_VAL  ((struct Value){ VAL_UNDEFINED, { 0 } })
+#define INT_VAL(x)     ((struct Value){ VAL_INT,   { .integer  = (x) } })
+#define FLOAT_VAL(x)   ((struct Value){ VAL_FLOAT, { .floating = (x) } })
+#define BOOL_VAL(x)    ((struct Value){ VAL_BOOL,  { .boolean  = (x) } })
+
+// what the interpreters do to any two values other than two ints, which
+// each does inline
+enum Arith {
+  ARITH_ADD, ARITH_SUB, ARITH_MUL, ARITH_DIV, ARITH_MOD,
+  ARITH_EQ, ARITH_NE, ARITH_LT, ARITH_LE,
+};
+
+bool is_truthy(const struct Value*);
+// false if the operands can't be put together like that
+bool arith_values(enum Arith, const struct Value*, const struct Value*,
+    struct Value*);
+void print_value(const struct Value*);
@@ -0,0 +1,99 @@
+#!/bin/sh
+# runs every program in tests/ on the tree walker, the vm, the native backend
+# and the c backend, and diffs what each prints with the program's .out
+# file. the walker then runs it again from a cached image of it, whole and
+# damaged, which has to be noticed and the source parsed instead. a program
+# leaves out backends it isn't meant for with a line like
+#
+#   // skip: bc
+#
+# usage: tests/run.sh [compiler], with $CC compiling the native and c output
+
+build=${1:-build/build}
+tests=$(dirname "$0")
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+
+passed=0
+failed=0
+
+# what the program prints on one backend, on stdout, and its complaints on
+# stderr. nothing is cached, so no images are left next to the programs
+run() {
+  case $1 in
+    walk)   "$build" -n "$2" ;;
+    bc)     "$build" -n -b "$2" ;;
+    native) "$build" -n -o "$tmp/native" "$2" && "$tmp/native" ;;
+    c)      "$build" -n -c -o "$tmp/c.c" "$2" \
+              && ${CC:-cc} -w -o "$tmp/c" "$tmp/c.c" && "$tmp/c" ;;
+  esac
+}
+
+# flips every bit of the byte at an offset into a file
+flip() {
+  byte=$(od -An -tu1 -j "$2" -N1 "$1" | tr -d ' ')
+  printf "\\$(printf %o $((255 - byte)))" \
+    | dd of="$1" bs=1 seek="$2" conv=notrunc 2> /dev/null
+}
+
+# a copy of the program with a fresh image next to it, damaged as asked.
+# every run parses a damaged one again and writes it back whole
+cache() {
+  cp "$1" "$tmp/image.2c"
+  rm -f "$tmp/image.2c.ast"
+  "$build" "$tmp/image.2c" > /dev/null 2>&1
+  [ -f "$tmp/image.2c.ast" ] || return 1
+
+  size=$(wc -c < "$tmp/image.2c.ast")
+  case $2 in
+    whole)     ;;
+    magic)     flip "$tmp/image.2c.ast" 0 ;;
+    first)     flip "$tmp/image.2c.ast" 120 ;;
+    middle)    flip "$tmp/image.2c.ast" $((size / 2)) ;;
+    last)      flip "$tmp/image.2c.ast" $((size - 1)) ;;
+    truncated) head -c $((size - 1)) "$tmp/image.2c.ast" > "$tmp/cut" \
+                 && mv "$tmp/cut" "$tmp/image.2c.ast" ;;
+  esac
+}
+
+check() {
+  if diff -u "$tests/$1.out" "$tmp/out" > "$tmp/diff"; then
+    passed=$((passed + 1))
+  else
+    failed=$((failed + 1))
+    echo "FAIL $1 $2"
+    head -n 40 "$tmp/diff" "$tmp/err"
+  fi
+}
+
+for program in "$tests"/*.2c; do
+  name=$(basename "$program" .2c)
+  skip=$(sed -n 's|^// skip: ||p' "$program")
+
+  for backend in walk bc native c; do
+    case " $skip " in *" $backend "*) continue ;; esac
+    rm -f "$tmp/native" "$tmp/c.c" "$tmp/c"
+
+    run $backend "$program" > "$tmp/out" 2> "$tmp/err"
+    check "$name" "on $backend"
+  done
+
+  # a whole image is read and left as it is, and a damaged one is written
+  # again, over it
+  for damage in whole magic first middle last truncated; do
+    : > "$tmp/out"
+    if cache "$program" $damage; then
+      before=$(ls -i "$tmp/image.2c.ast")
+      "$build" "$tmp/image.2c" > "$tmp/out" 2> "$tmp/err"
+      after=$(ls -i "$tmp/image.2c.ast")
+
+      if [ "$before" = "$after" ]; then read=whole; else read=ignored; fi
+      if [ $damage = whole ]; then meant=whole; else meant=ignored; fi
+      [ $read = $meant ] || echo "the image was $read" >> "$tmp/out"
+    fi
+    check "$name" "from a $damage image"
+  done
+done
+
+echo "$passed passed, $failed failed"
+[ $failed -eq 0 ]